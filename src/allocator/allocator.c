@@ -35,6 +35,8 @@ typedef struct linear_allocator_s
 static i32 ms_tempIndex;
 static mutex_t ms_perm_mtx;
 static tlsf_t ms_perm;
+static i64 ms_permCount;
+static i64 ms_permBytes;
 static linear_allocator_t ms_temp[kTempFrames];
 
 // ----------------------------------------------------------------------------
@@ -169,6 +171,8 @@ void* pim_malloc(EAlloc type, i32 bytes)
         case EAlloc_Perm:
             mutex_lock(&ms_perm_mtx);
             ptr = tlsf_memalign(ms_perm, kAlign, bytes);
+            ++ms_permCount;
+            ms_permBytes += bytes;
             mutex_unlock(&ms_perm_mtx);
             break;
         case EAlloc_Temp:
@@ -195,6 +199,28 @@ void* pim_malloc(EAlloc type, i32 bytes)
     return ptr;
 }
 
+i64 alloc_permcount(void)
+{
+    mutex_lock(&ms_perm_mtx);
+    const i64 count = ms_permCount;
+    mutex_unlock(&ms_perm_mtx);
+    return count;
+}
+
+i64 alloc_permbytes(void)
+{
+    mutex_lock(&ms_perm_mtx);
+    const i64 bytes = ms_permBytes;
+    mutex_unlock(&ms_perm_mtx);
+    return bytes;
+}
+
+i64 alloc_tempbytes(void)
+{
+    const u64 head = load_u64(&(ms_temp[ms_tempIndex].head), MO_Relaxed);
+    return (i64)head;
+}
+
 void pim_free(void* ptr)
 {
     if (ptr)
@@ -219,6 +245,7 @@ void pim_free(void* ptr)
         case EAlloc_Perm:
             mutex_lock(&ms_perm_mtx);
             tlsf_free(ms_perm, hdr);
+            ms_permBytes -= userBytes + kAlign;
             mutex_unlock(&ms_perm_mtx);
             break;
         case EAlloc_Temp:
@@ -8,6 +8,13 @@ void alloc_sys_init(void);
 void alloc_sys_update(void);
 void alloc_sys_shutdown(void);
 
+// perm allocations made since init, reallocs that moved included
+i64 alloc_permcount(void);
+// perm bytes in use, headers included
+i64 alloc_permbytes(void);
+// temp bytes allocated so far this frame
+i64 alloc_tempbytes(void);
+
 void* pim_malloc(EAlloc allocator, i32 bytes);
 void pim_free(void* ptr);
 void* pim_realloc(EAlloc allocator, void* prev, i32 bytes);
@@ -0,0 +1,281 @@
+#include "assets/archive.h"
+
+#include "allocator/allocator.h"
+#include "common/atomics.h"
+#include "common/sort.h"
+#include "io/fd.h"
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+#include <string.h>
+
+static const char kArchiveId[4] = { 'P', 'I', 'M', 'A' };
+
+static bool InArchive(const fmap_t map, dbytes_t db)
+{
+    return (db.offset >= 0) && (db.size >= 0) && (db.offset <= map.size - db.size);
+}
+
+archive_t* archive_open(const char* path)
+{
+    ASSERT(path);
+
+    fmap_t map = { 0 };
+    fd_t fd = fd_open(path, false);
+    if (fd_isopen(fd))
+    {
+        map = fmap_create(fd, false);
+        fd_close(&fd);
+    }
+    if (!fmap_isopen(map) || (map.size < (i32)sizeof(darchive_t)))
+    {
+        goto cleanup;
+    }
+
+    const u8* base = map.ptr;
+    darchive_t hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.id, kArchiveId, sizeof(hdr.id)) ||
+        (hdr.version != kArchiveVersion) ||
+        (hdr.count < 0) ||
+        (hdr.entries.size != (i32)sizeof(darchiveentry_t) * hdr.count) ||
+        (hdr.entries.offset & (kArchiveMinAlign - 1)) ||
+        !InArchive(map, hdr.entries))
+    {
+        INTERRUPT();
+        goto cleanup;
+    }
+
+    const darchiveentry_t* entries = (const darchiveentry_t*)(base + hdr.entries.offset);
+    for (i32 i = 0; i < hdr.count; ++i)
+    {
+        const darchiveentry_t entry = entries[i];
+        if (!InArchive(map, entry.blob) ||
+            (entry.rawSize < 0) ||
+            ((entry.codec == ArchiveCodec_None) && (entry.rawSize != entry.blob.size)) ||
+            ((i > 0) && (guid_cmp(entries[i - 1].name, entry.name) >= 0)))
+        {
+            INTERRUPT();
+            goto cleanup;
+        }
+    }
+
+    archive_t* ar = perm_calloc(sizeof(*ar));
+    ar->map = map;
+    ar->entries = entries;
+    ar->count = hdr.count;
+    ar->refCount = 1;
+    return ar;
+
+cleanup:
+    fmap_destroy(&map);
+    return NULL;
+}
+
+void archive_retain(archive_t* ar)
+{
+    if (ar)
+    {
+        inc_i32(&ar->refCount, MO_Relaxed);
+    }
+}
+
+void archive_release(archive_t* ar)
+{
+    if (ar)
+    {
+        // inc and dec return the previous value
+        if (dec_i32(&ar->refCount, MO_AcqRel) == 1)
+        {
+            fmap_destroy(&ar->map);
+            pim_free(ar);
+        }
+    }
+}
+
+bool archive_find(const archive_t* ar, guid_t name, archiveblob_t* blobOut)
+{
+    ASSERT(blobOut);
+    memset(blobOut, 0, sizeof(*blobOut));
+    if (!ar)
+    {
+        return false;
+    }
+
+    const darchiveentry_t* pim_noalias entries = ar->entries;
+    i32 lo = 0;
+    i32 hi = ar->count;
+    while (lo < hi)
+    {
+        const i32 mid = (lo + hi) >> 1;
+        const i32 cmp = guid_cmp(entries[mid].name, name);
+        if (cmp == 0)
+        {
+            const darchiveentry_t entry = entries[mid];
+            blobOut->ptr = (const u8*)ar->map.ptr + entry.blob.offset;
+            blobOut->size = entry.blob.size;
+            blobOut->rawSize = entry.rawSize;
+            blobOut->codec = (ArchiveCodec)entry.codec;
+            return true;
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+void* archive_decode(archiveblob_t blob)
+{
+    if ((blob.codec != ArchiveCodec_Deflate) || (blob.rawSize <= 0))
+    {
+        ASSERT(false);
+        return NULL;
+    }
+    char* dst = perm_malloc(blob.rawSize);
+    const i32 len = stbi_zlib_decode_buffer(dst, blob.rawSize, blob.ptr, blob.size);
+    if (len != blob.rawSize)
+    {
+        pim_free(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool WriteZeros(archivewriter_t* wr, i32 count)
+{
+    static const u8 kZeros[4096];
+    while (count > 0)
+    {
+        const i32 len = count < NELEM(kZeros) ? count : NELEM(kZeros);
+        if (fstr_write(wr->fd, kZeros, len) != len)
+        {
+            return false;
+        }
+        wr->offset += len;
+        count -= len;
+    }
+    return true;
+}
+
+static bool Align(archivewriter_t* wr, i32 align)
+{
+    const i32 aligned = (wr->offset + (align - 1)) & ~(align - 1);
+    return WriteZeros(wr, aligned - wr->offset);
+}
+
+static i32 CmpEntry(const void* lhs, const void* rhs, void* usr)
+{
+    const darchiveentry_t* a = lhs;
+    const darchiveentry_t* b = rhs;
+    return guid_cmp(a->name, b->name);
+}
+
+bool archive_begin(archivewriter_t* wr, const char* path)
+{
+    ASSERT(wr);
+    ASSERT(path);
+    memset(wr, 0, sizeof(*wr));
+    wr->fd = fstr_open(path, "wb");
+    if (!fstr_isopen(wr->fd))
+    {
+        return false;
+    }
+    // header is rewritten by archive_end
+    return WriteZeros(wr, sizeof(darchive_t));
+}
+
+bool archive_contains(const archivewriter_t* wr, guid_t name)
+{
+    const darchiveentry_t* pim_noalias entries = wr->entries;
+    const i32 count = wr->count;
+    for (i32 i = 0; i < count; ++i)
+    {
+        if (guid_eq(entries[i].name, name))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool archive_add(archivewriter_t* wr, guid_t name, const void* data, i32 size, ArchiveCodec codec)
+{
+    ASSERT(wr);
+    ASSERT(data || !size);
+    if (!fstr_isopen(wr->fd) || guid_isnull(name) || archive_contains(wr, name))
+    {
+        return false;
+    }
+
+    const void* src = data;
+    i32 srcSize = size;
+    u8* compressed = NULL;
+    if ((codec == ArchiveCodec_Deflate) && (size > 0))
+    {
+        i32 len = 0;
+        compressed = stbi_zlib_compress((u8*)data, size, &len, 8);
+        // not worth decoding unless it saves an eighth
+        if (compressed && (len < (size - (size >> 3))))
+        {
+            src = compressed;
+            srcSize = len;
+        }
+        else
+        {
+            codec = ArchiveCodec_None;
+        }
+    }
+    else
+    {
+        codec = ArchiveCodec_None;
+    }
+
+    bool wrote = Align(wr, srcSize >= kArchiveAlign ? kArchiveAlign : kArchiveMinAlign);
+    darchiveentry_t entry = { 0 };
+    entry.name = name;
+    entry.codec = codec;
+    entry.rawSize = size;
+    entry.blob.offset = wr->offset;
+    entry.blob.size = srcSize;
+    wrote = wrote && (fstr_write(wr->fd, src, srcSize) == srcSize);
+    pim_free(compressed);
+    if (wrote)
+    {
+        wr->offset += srcSize;
+        wr->rawBytes += size;
+        PermReserve(wr->entries, wr->count + 1);
+        wr->entries[wr->count++] = entry;
+    }
+    return wrote;
+}
+
+bool archive_end(archivewriter_t* wr)
+{
+    ASSERT(wr);
+    bool wrote = false;
+    if (fstr_isopen(wr->fd))
+    {
+        pimsort(wr->entries, wr->count, sizeof(wr->entries[0]), CmpEntry, NULL);
+
+        darchive_t hdr = { 0 };
+        memcpy(hdr.id, kArchiveId, sizeof(hdr.id));
+        hdr.version = kArchiveVersion;
+        hdr.count = wr->count;
+        wrote = Align(wr, kArchiveMinAlign);
+        hdr.entries = dbytes_new(wr->count, sizeof(wr->entries[0]), &wr->offset);
+        wrote = wrote && (fstr_write(wr->fd, wr->entries, hdr.entries.size) == hdr.entries.size);
+        fstr_seek(wr->fd, 0);
+        wrote = wrote && (fstr_write(wr->fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+        fstr_close(&wr->fd);
+    }
+    pim_free(wr->entries);
+    memset(wr, 0, sizeof(*wr));
+    return wrote;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "common/macro.h"
+#include "common/guid.h"
+#include "common/dbytes.h"
+#include "io/fmap.h"
+#include "io/fstr.h"
+
+PIM_C_BEGIN
+
+// cooked asset archive: every mesh and texture of a map in one file that is
+// mapped once. blobs are looked up by guid and referenced in place.
+#define kArchiveVersion     1
+// blobs this large start on the windows mapping granularity,
+// smaller ones are packed at float4 alignment
+#define kArchiveAlign       (64 << 10)
+#define kArchiveMinAlign    16
+
+typedef enum
+{
+    ArchiveCodec_None = 0,
+    ArchiveCodec_Deflate,   // zlib stream, decoded into a private copy
+} ArchiveCodec;
+
+typedef struct darchiveentry_s
+{
+    guid_t name;
+    i32 codec;
+    i32 rawSize;            // size once decoded
+    dbytes_t blob;
+} darchiveentry_t;
+
+typedef struct darchive_s
+{
+    char id[4];             // "PIMA"
+    i32 version;
+    i32 count;
+    dbytes_t entries;       // darchiveentry_t sorted by name
+} darchive_t;
+
+typedef struct archive_s
+{
+    fmap_t map;
+    const darchiveentry_t* entries;
+    i32 count;
+    i32 refCount;
+} archive_t;
+
+typedef struct archiveblob_s
+{
+    const void* ptr;
+    i32 size;
+    i32 rawSize;
+    ArchiveCodec codec;
+} archiveblob_t;
+
+typedef struct archivewriter_s
+{
+    fstr_t fd;
+    darchiveentry_t* entries;
+    i32 count;
+    i32 offset;
+    i32 rawBytes;
+} archivewriter_t;
+
+// returns null if the file is missing or invalid; starts with one reference
+archive_t* archive_open(const char* path);
+void archive_retain(archive_t* ar);
+void archive_release(archive_t* ar);
+
+bool archive_find(const archive_t* ar, guid_t name, archiveblob_t* blobOut);
+// decodes a compressed blob into a new perm allocation of blob.rawSize bytes
+void* archive_decode(archiveblob_t blob);
+
+bool archive_begin(archivewriter_t* wr, const char* path);
+// false if the name is already in the archive or the write failed
+bool archive_add(archivewriter_t* wr, guid_t name, const void* data, i32 size, ArchiveCodec codec);
+bool archive_contains(const archivewriter_t* wr, guid_t name);
+bool archive_end(archivewriter_t* wr);
+
+PIM_C_END
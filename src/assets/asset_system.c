@@ -1,27 +1,92 @@
 #include "assets/asset_system.h"
 
 #include "allocator/allocator.h"
+#include "common/atomics.h"
+#include "common/cmd.h"
+#include "common/console.h"
 #include "common/cvar.h"
 #include "common/fnv1a.h"
 #include "common/profiler.h"
 #include "common/sort.h"
 #include "common/stringutil.h"
+#include "common/time.h"
 #include "containers/sdict.h"
+#include "io/fstr.h"
+#include "math/scalar.h"
 #include "quake/q_packfile.h"
 #include "quake/q_bspfile.h"
+#include "threading/intrin.h"
+#include "threading/mutex.h"
+#include "threading/semaphore.h"
+#include "threading/task.h"
+#include "threading/thread.h"
 #include "ui/cimgui.h"
 #include "ui/cimgui_ext.h"
+#include <stdlib.h>
+
+#define kIoThreads 2
+#define kMaxDecodes 16
 
 static cvar_t cv_basedir = { .type = cvart_text,.name = "basedir",.value = "data",.desc = "base directory for game data" };
 static cvar_t cv_game = { .type = cvart_text,.name = "game",.value = "id1",.desc = "name of the active game" };
+static cvar_t cv_asset_budget = { .type = cvart_float,.name = "asset_budget",.value = "2",.minFloat = 0.0f,.maxFloat = 100.0f,.desc = "milliseconds per frame spent completing streamed assets" };
+
+typedef struct assetwaiter_s
+{
+    asset_done_fn onDone;
+    void* usr;
+} assetwaiter_t;
+
+typedef struct assetreq_s
+{
+    task_t task;            // decode task, must be first
+    assetload_t load;
+    asset_decode_fn onDecode;
+    assetwaiter_t* waiters;
+    i32 waiterCount;
+    i32 priority;
+    i32 status;             // AssetStat
+    i32 slot;
+    u64 order;
+} assetreq_t;
 
 static sdict_t ms_assets;
 static folder_t ms_folder;
 
+// main thread only
+static assetreq_t** ms_slots;
+static i32* ms_versions;
+static i32 ms_slotCount;
+static i32* ms_freeSlots;
+static i32 ms_freeCount;
+static assetreq_t** ms_active;
+static i32 ms_activeCount;
+static i32 ms_decodeCount;
+static sdict_t ms_inflight;     // path -> slot
+static u64 ms_order;
+static i64 ms_bytesLoaded;
+static i32 ms_loadsDone;
+
+// shared with the io threads, guarded by ms_ioMtx
+static mutex_t ms_ioMtx;
+static assetreq_t** ms_queue;   // binary heap, see ReqLess
+static i32 ms_queueLen;
+static assetreq_t** ms_read;
+static i32 ms_readLen;
+
+static semaphore_t ms_ioSema;
+static thread_t ms_ioThreads[kIoThreads];
+static i32 ms_running;
+
+static i32 PIM_CDECL IoThreadFn(void* arg);
+static cmdstat_t CmdPakBench(i32 argc, const char** argv);
+
 void asset_sys_init(void)
 {
     cvar_reg(&cv_basedir);
     cvar_reg(&cv_game);
+    cvar_reg(&cv_asset_budget);
+    cmd_reg("pak_bench", CmdPakBench);
 
     sdict_t assets;
     sdict_new(&assets, sizeof(asset_t), EAlloc_Perm);
@@ -52,18 +117,75 @@ void asset_sys_init(void)
 
     ms_assets = assets;
     ms_folder = folder;
+
+    sdict_new(&ms_inflight, sizeof(i32), EAlloc_Perm);
+    mutex_create(&ms_ioMtx);
+    semaphore_create(&ms_ioSema, 0);
+    store_i32(&ms_running, 1, MO_Release);
+    for (i32 i = 0; i < kIoThreads; ++i)
+    {
+        thread_create(ms_ioThreads + i, IoThreadFn, NULL);
+    }
 }
 
+static i32 Pump(double budgetMs);
+
 ProfileMark(pm_update, asset_sys_update)
 void asset_sys_update()
 {
     ProfileBegin(pm_update);
 
+    Pump(cvar_get_float(&cv_asset_budget));
+
     ProfileEnd(pm_update);
 }
 
 void asset_sys_shutdown(void)
 {
+    // owners flush their requests before they shut down. anything left,
+    // eg. from quitting mid-stream, is dropped without callbacks.
+    store_i32(&ms_running, 0, MO_Release);
+    semaphore_signal(ms_ioSema, kIoThreads);
+    for (i32 i = 0; i < kIoThreads; ++i)
+    {
+        thread_join(ms_ioThreads + i);
+    }
+    for (i32 i = 0; i < ms_slotCount; ++i)
+    {
+        assetreq_t* req = ms_slots[i];
+        if (req)
+        {
+            if (load_i32(&req->status, MO_Acquire) == AssetStat_Decoding)
+            {
+                task_await(req);
+            }
+            pim_free(req->load.data);
+            pim_free(req->waiters);
+            pim_free(req);
+        }
+    }
+    pim_free(ms_slots);
+    pim_free(ms_versions);
+    pim_free(ms_freeSlots);
+    pim_free(ms_active);
+    pim_free(ms_queue);
+    pim_free(ms_read);
+    ms_slots = NULL;
+    ms_versions = NULL;
+    ms_freeSlots = NULL;
+    ms_active = NULL;
+    ms_queue = NULL;
+    ms_read = NULL;
+    ms_slotCount = 0;
+    ms_decodeCount = 0;
+    ms_freeCount = 0;
+    ms_activeCount = 0;
+    ms_queueLen = 0;
+    ms_readLen = 0;
+    sdict_del(&ms_inflight);
+    semaphore_destroy(&ms_ioSema);
+    mutex_destroy(&ms_ioMtx);
+
     sdict_del(&ms_assets);
     folder_free(&ms_folder);
 }
@@ -75,6 +197,445 @@ bool asset_get(const char* name, asset_t* asset)
     return sdict_get(&ms_assets, name, asset);
 }
 
+static const pack_t* FindPack(const void* ptr)
+{
+    const u8* p = ptr;
+    for (i32 i = 0; i < ms_folder.length; ++i)
+    {
+        const pack_t* pack = ms_folder.packs + i;
+        const u8* base = pack->mapped.ptr;
+        if ((p >= base) && (p < base + pack->mapped.size))
+        {
+            return pack;
+        }
+    }
+    return NULL;
+}
+
+static bool AdviseAsset(const char* name, FmapAdvice advice)
+{
+    asset_t asset;
+    if (asset_get(name, &asset))
+    {
+        const pack_t* pack = FindPack(asset.pData);
+        if (pack)
+        {
+            const i64 offset = (const u8*)asset.pData - (const u8*)pack->mapped.ptr;
+            fmap_advise(pack->mapped, offset, asset.length, advice);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool asset_prefetch(const char* name)
+{
+    ASSERT(name);
+    return AdviseAsset(name, FmapAdvice_WillNeed);
+}
+
+// one read per page, so every page faults in once
+static u32 TouchPages(const asset_t asset)
+{
+    const u8* bytes = asset.pData;
+    u32 sum = 0;
+    for (i32 i = 0; i < asset.length; i += 4096)
+    {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+// first touch time of a pak asset with and without a prefetch hint.
+// pages are dropped from this process between runs; for a cold file cache
+// also purge the os standby list (RAMMap) or drop_caches before running.
+static cmdstat_t CmdPakBench(i32 argc, const char** argv)
+{
+    const char* name = argc > 1 ? argv[1] : "maps/e1m1.bsp";
+    const i32 iterations = argc > 2 ? i1_max(1, atoi(argv[2])) : 8;
+    asset_t asset;
+    if (!asset_get(name, &asset))
+    {
+        con_logf(LogSev_Error, "cmd", "pak_bench: '%s' is not in a pak.", name);
+        return cmdstat_err;
+    }
+
+    double plainMs = 0.0;
+    double hintMs = 0.0;
+    double hintedMs = 0.0;
+    u32 sum = 0;
+    for (i32 i = 0; i < iterations; ++i)
+    {
+        AdviseAsset(name, FmapAdvice_DontNeed);
+        u64 begin = time_now();
+        sum += TouchPages(asset);
+        plainMs += time_milli(time_now() - begin);
+
+        AdviseAsset(name, FmapAdvice_DontNeed);
+        begin = time_now();
+        asset_prefetch(name);
+        const u64 hinted = time_now();
+        sum += TouchPages(asset);
+        hintMs += time_milli(hinted - begin);
+        hintedMs += time_milli(time_now() - hinted);
+    }
+    con_logf(LogSev_Info, "cmd", "pak_bench: %s, %d KB, first touch %.3f ms; with willneed %.3f ms + %.3f ms to issue (%u)",
+        name,
+        asset.length >> 10,
+        plainMs / iterations,
+        hintedMs / iterations,
+        hintMs / iterations,
+        sum & 1);
+    return cmdstat_ok;
+}
+
+// ----------------------------------------------------------------------------
+
+// higher priority first, then first come first served
+static bool ReqLess(const assetreq_t* lhs, const assetreq_t* rhs)
+{
+    if (lhs->priority != rhs->priority)
+    {
+        return lhs->priority > rhs->priority;
+    }
+    return lhs->order < rhs->order;
+}
+
+static void SiftUp(assetreq_t** heap, i32 i)
+{
+    while (i > 0)
+    {
+        const i32 parent = (i - 1) >> 1;
+        if (!ReqLess(heap[i], heap[parent]))
+        {
+            break;
+        }
+        assetreq_t* tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void SiftDown(assetreq_t** heap, i32 len, i32 i)
+{
+    while (true)
+    {
+        const i32 lhs = i * 2 + 1;
+        const i32 rhs = lhs + 1;
+        i32 best = i;
+        if ((lhs < len) && ReqLess(heap[lhs], heap[best]))
+        {
+            best = lhs;
+        }
+        if ((rhs < len) && ReqLess(heap[rhs], heap[best]))
+        {
+            best = rhs;
+        }
+        if (best == i)
+        {
+            break;
+        }
+        assetreq_t* tmp = heap[i];
+        heap[i] = heap[best];
+        heap[best] = tmp;
+        i = best;
+    }
+}
+
+static void ReadFile(assetload_t* load)
+{
+    fstr_t fd = fstr_open(load->path, "rb");
+    if (fstr_isopen(fd))
+    {
+        const i64 size = fstr_size(fd);
+        if ((size > 0) && (size < 0x7fffffff))
+        {
+            load->data = perm_malloc((i32)size);
+            load->size = fstr_read(fd, load->data, (i32)size);
+            if (load->size != size)
+            {
+                pim_free(load->data);
+                load->data = NULL;
+                load->size = 0;
+            }
+        }
+        fstr_close(&fd);
+    }
+}
+
+static i32 PIM_CDECL IoThreadFn(void* arg)
+{
+    while (true)
+    {
+        semaphore_wait(ms_ioSema);
+        if (!load_i32(&ms_running, MO_Acquire))
+        {
+            break;
+        }
+
+        assetreq_t* req = NULL;
+        mutex_lock(&ms_ioMtx);
+        if (ms_queueLen > 0)
+        {
+            req = ms_queue[0];
+            ms_queueLen -= 1;
+            ms_queue[0] = ms_queue[ms_queueLen];
+            SiftDown(ms_queue, ms_queueLen, 0);
+            store_i32(&req->status, AssetStat_Reading, MO_Release);
+        }
+        mutex_unlock(&ms_ioMtx);
+
+        if (req)
+        {
+            ReadFile(&req->load);
+            mutex_lock(&ms_ioMtx);
+            PermReserve(ms_read, ms_readLen + 1);
+            ms_read[ms_readLen++] = req;
+            mutex_unlock(&ms_ioMtx);
+        }
+    }
+    return 0;
+}
+
+static void DecodeFn(task_t* pbase, i32 begin, i32 end)
+{
+    assetreq_t* req = (assetreq_t*)pbase;
+    req->onDecode(&req->load);
+}
+
+static void Retire(assetreq_t* req)
+{
+    const i32 slot = req->slot;
+    ASSERT(ms_slots[slot] == req);
+    sdict_rm(&ms_inflight, req->load.path, NULL);
+    ms_slots[slot] = NULL;
+    ms_versions[slot] += 1;
+    PermReserve(ms_freeSlots, ms_freeCount + 1);
+    ms_freeSlots[ms_freeCount++] = slot;
+
+    ms_bytesLoaded += req->load.size;
+    ms_loadsDone += 1;
+
+    // removed from ms_inflight above, so a callback requesting this path
+    // again starts a fresh read
+    for (i32 i = 0; i < req->waiterCount; ++i)
+    {
+        const assetwaiter_t waiter = req->waiters[i];
+        waiter.onDone(&req->load, waiter.usr);
+    }
+    ASSERT(!req->load.result);
+
+    pim_free(req->load.data);
+    pim_free(req->waiters);
+    pim_free(req);
+}
+
+// advances active requests, then runs callbacks of ready ones until the
+// budget runs out. returns the number of requests retired.
+ProfileMark(pm_pump, asset_pump)
+static i32 Pump(double budgetMs)
+{
+    ProfileBegin(pm_pump);
+
+    mutex_lock(&ms_ioMtx);
+    const i32 readLen = ms_readLen;
+    if (readLen > 0)
+    {
+        PermReserve(ms_active, ms_activeCount + readLen);
+        for (i32 i = 0; i < readLen; ++i)
+        {
+            assetreq_t* req = ms_read[i];
+            store_i32(&req->status, AssetStat_Read, MO_Release);
+            ms_active[ms_activeCount++] = req;
+        }
+        ms_readLen = 0;
+    }
+    mutex_unlock(&ms_ioMtx);
+
+    const u64 start = time_now();
+    i32 retired = 0;
+    for (i32 i = 0; i < ms_activeCount; )
+    {
+        assetreq_t* req = ms_active[i];
+        switch (load_i32(&req->status, MO_Acquire))
+        {
+        case AssetStat_Read:
+            if (req->onDecode && req->load.data)
+            {
+                // every task sits in each worker's queue; leave room for the frame
+                if (ms_decodeCount >= kMaxDecodes)
+                {
+                    break;
+                }
+                ++ms_decodeCount;
+                store_i32(&req->status, AssetStat_Decoding, MO_Release);
+                task_submit(req, DecodeFn, 1);
+            }
+            else
+            {
+                store_i32(&req->status, AssetStat_Ready, MO_Release);
+            }
+            continue;
+        case AssetStat_Decoding:
+            if (task_stat(req) == TaskStatus_Complete)
+            {
+                --ms_decodeCount;
+                store_i32(&req->status, AssetStat_Ready, MO_Release);
+                continue;
+            }
+            break;
+        case AssetStat_Ready:
+            if ((retired == 0) || (time_milli(time_now() - start) < budgetMs))
+            {
+                ms_active[i] = ms_active[--ms_activeCount];
+                Retire(req);
+                ++retired;
+                continue;
+            }
+            break;
+        default:
+            ASSERT(false);
+            break;
+        }
+        ++i;
+    }
+
+    ProfileEnd(pm_pump);
+    return retired;
+}
+
+assetfuture_t asset_load_async(
+    const char* path,
+    AssetPri priority,
+    asset_decode_fn onDecode,
+    asset_done_fn onDone,
+    void* usr)
+{
+    ASSERT(path);
+    ASSERT(onDone);
+    ASSERT(priority >= 0);
+    ASSERT(priority < AssetPri_COUNT);
+
+    const assetwaiter_t waiter = { .onDone = onDone,.usr = usr };
+
+    i32 slot = -1;
+    if (sdict_get(&ms_inflight, path, &slot))
+    {
+        assetreq_t* req = ms_slots[slot];
+        ASSERT(req);
+        ASSERT(req->onDecode == onDecode);
+        PermReserve(req->waiters, req->waiterCount + 1);
+        req->waiters[req->waiterCount++] = waiter;
+        if (priority > req->priority)
+        {
+            mutex_lock(&ms_ioMtx);
+            if (load_i32(&req->status, MO_Relaxed) == AssetStat_Queued)
+            {
+                for (i32 i = 0; i < ms_queueLen; ++i)
+                {
+                    if (ms_queue[i] == req)
+                    {
+                        req->priority = priority;
+                        SiftUp(ms_queue, i);
+                        break;
+                    }
+                }
+            }
+            mutex_unlock(&ms_ioMtx);
+        }
+        const assetfuture_t future = { slot, ms_versions[slot] };
+        return future;
+    }
+
+    if (ms_freeCount > 0)
+    {
+        slot = ms_freeSlots[--ms_freeCount];
+    }
+    else
+    {
+        slot = ms_slotCount++;
+        PermReserve(ms_slots, ms_slotCount);
+        PermReserve(ms_versions, ms_slotCount);
+        ms_versions[slot] = 1;
+    }
+
+    assetreq_t* req = perm_calloc(sizeof(*req));
+    StrCpy(ARGS(req->load.path), path);
+    req->onDecode = onDecode;
+    req->waiters = perm_malloc(sizeof(req->waiters[0]));
+    req->waiters[0] = waiter;
+    req->waiterCount = 1;
+    req->priority = priority;
+    req->status = AssetStat_Queued;
+    req->slot = slot;
+    req->order = ms_order++;
+    ms_slots[slot] = req;
+    sdict_add(&ms_inflight, path, &slot);
+
+    mutex_lock(&ms_ioMtx);
+    PermReserve(ms_queue, ms_queueLen + 1);
+    ms_queue[ms_queueLen] = req;
+    SiftUp(ms_queue, ms_queueLen);
+    ms_queueLen += 1;
+    mutex_unlock(&ms_ioMtx);
+    semaphore_signal(ms_ioSema, 1);
+
+    const assetfuture_t future = { slot, ms_versions[slot] };
+    return future;
+}
+
+AssetStat asset_load_stat(assetfuture_t future)
+{
+    const i32 slot = future.index;
+    if ((slot >= 0) && (slot < ms_slotCount) && (ms_versions[slot] == future.version))
+    {
+        const assetreq_t* req = ms_slots[slot];
+        if (req)
+        {
+            return (AssetStat)load_i32(&req->status, MO_Acquire);
+        }
+    }
+    return AssetStat_Null;
+}
+
+static void WaitStep(void)
+{
+    if (Pump(1e9) == 0)
+    {
+        // help with decode tasks that landed in this thread's queue
+        task_sys_update();
+        intrin_yield();
+    }
+}
+
+ProfileMark(pm_await, asset_load_await)
+void asset_load_await(assetfuture_t future)
+{
+    ProfileBegin(pm_await);
+    while (asset_load_stat(future) != AssetStat_Null)
+    {
+        WaitStep();
+    }
+    ProfileEnd(pm_await);
+}
+
+ProfileMark(pm_flush, asset_load_flush)
+void asset_load_flush(void)
+{
+    ProfileBegin(pm_flush);
+    while (asset_load_pending() > 0)
+    {
+        WaitStep();
+    }
+    ProfileEnd(pm_flush);
+}
+
+i32 asset_load_pending(void)
+{
+    return ms_slotCount - ms_freeCount;
+}
+
 // ----------------------------------------------------------------------------
 
 typedef enum
@@ -153,6 +714,12 @@ void asset_gui(bool* pEnabled)
 
     if (igBegin("AssetSystem", pEnabled, 0))
     {
+        if (igCollapsingHeader1("Streaming"))
+        {
+            igValueInt("Pending", asset_load_pending());
+            igValueInt("Completed", ms_loadsDone);
+            igText("Loaded: %.2f MB", ms_bytesLoaded / (double)(1 << 20));
+        }
         if (igCollapsingHeader1("Packs"))
         {
             igIndent(0.0f);
@@ -176,11 +743,11 @@ void asset_gui(bool* pEnabled)
                     used += files[i].length;
                 }
                 const i32 overhead = (sizeof(dpackfile_t) * fileCount) + sizeof(dpackheader_t);
-                const i32 empty = (pack.mapped.size - used) - overhead;
+                const i32 empty = (i32)(pack.mapped.size - used) - overhead;
                 const dpackheader_t* hdr = pack.mapped.ptr;
 
                 igValueInt("File Count", fileCount);
-                igValueInt("Bytes", pack.mapped.size);
+                igValueInt("Bytes", (i32)pack.mapped.size);
                 igValueInt("Used", used);
                 igValueInt("Empty", empty);
                 igValueInt("Header Offset", hdr->offset);
@@ -10,11 +10,68 @@ typedef struct asset_s
     const void* pData;
 } asset_t;
 
+typedef enum
+{
+    AssetPri_Low = 0,
+    AssetPri_Normal,
+    AssetPri_High,
+
+    AssetPri_COUNT
+} AssetPri;
+
+typedef enum
+{
+    AssetStat_Null = 0,     // unknown, or retired after its callbacks ran
+    AssetStat_Queued,       // waiting for an io thread
+    AssetStat_Reading,      // file read in flight
+    AssetStat_Read,         // handed back to the main thread
+    AssetStat_Decoding,     // decode task in flight
+    AssetStat_Ready,        // waiting for the main thread to run callbacks
+} AssetStat;
+
+typedef struct assetload_s
+{
+    char path[PIM_PATH];
+    void* data;             // file contents, null if the read failed
+    i32 size;
+    void* result;           // output of the decode fn, null if it failed
+} assetload_t;
+
+typedef struct assetfuture_s
+{
+    i32 index;
+    i32 version;
+} assetfuture_t;
+
+// runs on a task worker once the file is read; may only use perm memory.
+typedef void(PIM_CDECL *asset_decode_fn)(assetload_t* load);
+// runs on the main thread, from asset_sys_update or a wait.
+// a callback that keeps load->result must set it to null; one that
+// doesn't need it frees it, since requests for a path are shared.
+typedef void(PIM_CDECL *asset_done_fn)(assetload_t* load, void* usr);
+
 void asset_sys_init(void);
 void asset_sys_update(void);
 void asset_sys_shutdown(void);
 
 bool asset_get(const char* name, asset_t* assetOut);
+// asks the os to page a pak asset in ahead of its first use
+bool asset_prefetch(const char* name);
+
+// reads path on an io thread, decodes it on a task worker, then calls onDone
+// on the main thread. requests for a path already in flight share its read.
+assetfuture_t asset_load_async(
+    const char* path,
+    AssetPri priority,
+    asset_decode_fn onDecode,
+    asset_done_fn onDone,
+    void* usr);
+AssetStat asset_load_stat(assetfuture_t future);
+// blocks until the callbacks of future have run
+void asset_load_await(assetfuture_t future);
+// blocks until every request has completed
+void asset_load_flush(void);
+i32 asset_load_pending(void);
 
 void asset_gui(bool* pEnabled);
 
@@ -25,6 +25,14 @@ static cvar_t cv_conlogpath =
     .desc="Path to the console log file"
 };
 
+static cvar_t cv_constdout =
+{
+    .type=cvart_bool,
+    .name="constdout",
+    .value="0",
+    .desc="Echo console output to stdout"
+};
+
 static void con_gui(void);
 static i32 OnTextInput(ImGuiInputTextCallbackData* data);
 static void ExecCmd(const char* cmd);
@@ -48,6 +56,7 @@ static char* ms_history[MAX_HISTORY];
 void con_sys_init(void)
 {
     cvar_reg(&cv_conlogpath);
+    cvar_reg(&cv_constdout);
 
     ms_file = fstr_open(cv_conlogpath.value, "wb");
     con_clear();
@@ -224,6 +233,10 @@ void con_puts(u32 color, const char* line)
         {
             fstr_puts(ms_file, line);
         }
+        if (cvar_get_bool(&cv_constdout))
+        {
+            fd_puts(fd_stdout, line);
+        }
 
         char** lines = ms_lines;
         u32* colors = ms_colors;
@@ -43,6 +43,11 @@ static node_t* ms_top[kMaxThreads];
 static i32 ms_avgWindow = 20;
 static dict_t ms_node_dict;
 
+#define kMaxProfValues 32
+static i32 ms_valueCount;
+static const char* ms_valueNames[kMaxProfValues];
+static float ms_values[kMaxProfValues];
+
 // ----------------------------------------------------------------------------
 
 static void EnsureDict(void)
@@ -63,6 +68,11 @@ void profile_gui(bool* pEnabled)
     {
         igSliderInt("avg over # frames", &ms_avgWindow, 1, 1000, "%d");
 
+        for (i32 i = 0; i < ms_valueCount; ++i)
+        {
+            igText("%s: %.3f", ms_valueNames[i], ms_values[i]);
+        }
+
         node_t* root = ms_prevroots[0].fchild;
 
         igSeparator();
@@ -87,6 +97,25 @@ void profile_gui(bool* pEnabled)
     ProfileEnd(pm_gui);
 }
 
+void profile_value(const char* name, float value)
+{
+    ASSERT(name);
+    for (i32 i = 0; i < ms_valueCount; ++i)
+    {
+        if ((ms_valueNames[i] == name) || StrCmp(ms_valueNames[i], PIM_PATH, name) == 0)
+        {
+            ms_values[i] = value;
+            return;
+        }
+    }
+    if (ms_valueCount < kMaxProfValues)
+    {
+        ms_valueNames[ms_valueCount] = name;
+        ms_values[ms_valueCount] = value;
+        ++ms_valueCount;
+    }
+}
+
 // ----------------------------------------------------------------------------
 
 void _ProfileBegin(profmark_t* mark)
@@ -277,6 +306,7 @@ static void VisitGui(const node_t* node)
 #else
 
 void profile_gui(bool* pEnabled) {}
+void profile_value(const char* name, float value) {}
 
 void _ProfileBegin(profmark_t* mark) {}
 void _ProfileEnd(profmark_t* mark) {}
@@ -14,6 +14,10 @@ typedef struct profmrk_s
 
 void profile_gui(bool* pEnabled);
 
+// shows a named value above the marks, until set again.
+// name must outlive the profiler, eg. a string literal.
+void profile_value(const char* name, float value);
+
 void _ProfileBegin(profmark_t* mark);
 void _ProfileEnd(profmark_t* mark);
 
@@ -0,0 +1,834 @@
+#include "common/schema.h"
+#include "common/serialize.h"
+#include "common/stringutil.h"
+#include "common/cmd.h"
+#include "common/console.h"
+#include "common/random.h"
+#include "common/time.h"
+#include "common/fnv1a.h"
+#include "common/guid.h"
+#include "math/types.h"
+#include "allocator/allocator.h"
+#include "io/fd.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char kSchemaId[4] = { 'P', 'I', 'M', 'S' };
+
+static i32 FieldStride(const schemafield_t* field)
+{
+    return field->elem ? field->elem->size : field->stride;
+}
+
+static bool HasArrays(const schema_t* schema)
+{
+    for (i32 i = 0; i < schema->fieldCount; ++i)
+    {
+        const schemafield_t* field = schema->fields + i;
+        if ((field->type == SchemaType_Array) ||
+            ((field->type == SchemaType_Struct) && HasArrays(field->elem)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const schemafield_t* FindField(const schema_t* schema, const char* key, i32 len)
+{
+    for (i32 i = 0; i < schema->fieldCount; ++i)
+    {
+        const schemafield_t* field = schema->fields + i;
+        if ((StrLen(field->name) == len) && !MemICmp(field->name, key, len))
+        {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+
+#define kJsonDepth 64
+
+typedef struct jsonframe_s
+{
+    const schema_t* schema;     // dict bound to a struct, null when ignored
+    u8* base;
+    const schemafield_t* field; // float4 read from an array
+    i32 lane;
+} jsonframe_t;
+
+typedef struct jsonreader_s
+{
+    const schema_t* schema;
+    u8* dst;
+    const schemafield_t* field; // where the next value lands
+    i32 lane;                   // float4 component of a flattened key, or -1
+    u8* base;
+    i32 depth;
+    jsonframe_t frames[kJsonDepth];
+} jsonreader_t;
+
+static void WriteNumber(u8* dst, const schemafield_t* field, i32 lane, double value)
+{
+    dst += field->offset;
+    switch (field->type)
+    {
+    default:
+        break;
+    case SchemaType_I32:
+        *(i32*)dst = (i32)value;
+        break;
+    case SchemaType_U32:
+        *(u32*)dst = (u32)value;
+        break;
+    case SchemaType_F32:
+        *(float*)dst = (float)value;
+        break;
+    case SchemaType_F4:
+        if ((lane >= 0) && (lane < 4))
+        {
+            ((float*)dst)[lane] = (float)value;
+        }
+        break;
+    }
+}
+
+static bool JsonPush(jsonreader_t* rd, jsonframe_t frame)
+{
+    if (rd->depth >= kJsonDepth)
+    {
+        return false;
+    }
+    rd->frames[rd->depth++] = frame;
+    rd->field = NULL;
+    return true;
+}
+
+static bool JsonPop(void* usr)
+{
+    jsonreader_t* rd = usr;
+    ASSERT(rd->depth > 0);
+    --rd->depth;
+    rd->field = NULL;
+    return true;
+}
+
+static bool JsonBeginDict(void* usr)
+{
+    jsonreader_t* rd = usr;
+    jsonframe_t frame = { 0 };
+    if (!rd->depth)
+    {
+        frame.schema = rd->schema;
+        frame.base = rd->dst;
+    }
+    else if (rd->field && (rd->field->type == SchemaType_Struct))
+    {
+        frame.schema = rd->field->elem;
+        frame.base = rd->base + rd->field->offset;
+    }
+    return JsonPush(rd, frame);
+}
+
+static bool JsonBeginArray(void* usr)
+{
+    jsonreader_t* rd = usr;
+    jsonframe_t frame = { 0 };
+    if (rd->field && (rd->field->type == SchemaType_F4) && (rd->lane < 0))
+    {
+        frame.base = rd->base;
+        frame.field = rd->field;
+    }
+    return JsonPush(rd, frame);
+}
+
+static bool JsonKey(void* usr, const char* str, i32 len)
+{
+    jsonreader_t* rd = usr;
+    ASSERT(rd->depth > 0);
+    const jsonframe_t* frame = rd->frames + rd->depth - 1;
+    rd->field = NULL;
+    rd->lane = -1;
+    rd->base = frame->base;
+    if (!frame->schema)
+    {
+        return true;
+    }
+    rd->field = FindField(frame->schema, str, len);
+    if (!rd->field && (len > 2) && (str[len - 2] == '.'))
+    {
+        // "name.x" from files written by ser_setfield_f4
+        static const char kLanes[] = "xyzw";
+        const schemafield_t* field = FindField(frame->schema, str, len - 2);
+        const char* lane = StrIChr(ARGS(kLanes), str[len - 1]);
+        if (field && (field->type == SchemaType_F4) && lane)
+        {
+            rd->field = field;
+            rd->lane = (i32)(lane - kLanes);
+        }
+    }
+    return true;
+}
+
+static bool JsonNumber(void* usr, double value)
+{
+    jsonreader_t* rd = usr;
+    if (rd->field)
+    {
+        WriteNumber(rd->base, rd->field, rd->lane, value);
+        rd->field = NULL;
+    }
+    else if (rd->depth > 0)
+    {
+        jsonframe_t* frame = rd->frames + rd->depth - 1;
+        if (frame->field)
+        {
+            WriteNumber(frame->base, frame->field, frame->lane++, value);
+        }
+    }
+    return true;
+}
+
+static bool JsonBool(void* usr, bool value)
+{
+    return JsonNumber(usr, value ? 1.0 : 0.0);
+}
+
+static bool ParseHex(const char* str, u64* valueOut)
+{
+    char digits[17];
+    memcpy(digits, str, 16);
+    digits[16] = 0;
+    char* end = NULL;
+    *valueOut = strtoull(digits, &end, 16);
+    return end == (digits + 16);
+}
+
+static bool JsonString(void* usr, const char* str, i32 len)
+{
+    jsonreader_t* rd = usr;
+    const schemafield_t* field = rd->field;
+    rd->field = NULL;
+    if (field && (field->type == SchemaType_Guid) && (len == 32))
+    {
+        guid_t value;
+        if (ParseHex(str, &value.a) && ParseHex(str + 16, &value.b))
+        {
+            memcpy(rd->base + field->offset, &value, sizeof(value));
+        }
+    }
+    return true;
+}
+
+static bool JsonNull(void* usr)
+{
+    jsonreader_t* rd = usr;
+    rd->field = NULL;
+    return true;
+}
+
+bool schema_fromjson(const schema_t* schema, const char* text, void* dst)
+{
+    ASSERT(schema);
+    ASSERT(dst);
+    if (!text || !text[0])
+    {
+        return false;
+    }
+    jsonreader_t* rd = tmp_calloc(sizeof(*rd));
+    rd->schema = schema;
+    rd->dst = dst;
+    rd->lane = -1;
+    const ser_sax_t sax =
+    {
+        .usr = rd,
+        .beginDict = JsonBeginDict,
+        .endDict = JsonPop,
+        .beginArray = JsonBeginArray,
+        .endArray = JsonPop,
+        .key = JsonKey,
+        .string = JsonString,
+        .number = JsonNumber,
+        .boolean = JsonBool,
+        .null = JsonNull,
+    };
+    return ser_sax(text, &sax);
+}
+
+// ----------------------------------------------------------------------------
+
+typedef struct jsonbuf_s
+{
+    char* ptr;
+    i32 length;
+} jsonbuf_t;
+
+static void JsonCat(jsonbuf_t* buf, const char* str)
+{
+    const i32 len = StrLen(str);
+    const i32 back = buf->length;
+    buf->ptr = perm_realloc(buf->ptr, back + len + 1);
+    memcpy(buf->ptr + back, str, len + 1);
+    buf->length = back + len;
+}
+
+static void JsonIndent(jsonbuf_t* buf, i32 indent)
+{
+    for (i32 i = 0; i < indent; ++i)
+    {
+        JsonCat(buf, "    ");
+    }
+}
+
+static void JsonStruct(jsonbuf_t* buf, const schema_t* schema, const u8* src, i32 indent)
+{
+    char tmp[PIM_PATH];
+    JsonCat(buf, "{");
+    bool first = true;
+    for (i32 i = 0; i < schema->fieldCount; ++i)
+    {
+        const schemafield_t* field = schema->fields + i;
+        if (field->type == SchemaType_Array)
+        {
+            continue;
+        }
+        JsonCat(buf, first ? "\n" : ",\n");
+        first = false;
+        JsonIndent(buf, indent + 1);
+        SPrintf(ARGS(tmp), "\"%s\": ", field->name);
+        JsonCat(buf, tmp);
+
+        const u8* ptr = src + field->offset;
+        switch (field->type)
+        {
+        default:
+            ASSERT(false);
+            break;
+        case SchemaType_I32:
+            SPrintf(ARGS(tmp), "%d", *(const i32*)ptr);
+            JsonCat(buf, tmp);
+            break;
+        case SchemaType_U32:
+            SPrintf(ARGS(tmp), "%u", *(const u32*)ptr);
+            JsonCat(buf, tmp);
+            break;
+        case SchemaType_F32:
+            // enough digits to read back the same float
+            SPrintf(ARGS(tmp), "%.9g", *(const float*)ptr);
+            JsonCat(buf, tmp);
+            break;
+        case SchemaType_F4:
+        {
+            const float* v = (const float*)ptr;
+            SPrintf(ARGS(tmp), "[%.9g, %.9g, %.9g, %.9g]", v[0], v[1], v[2], v[3]);
+            JsonCat(buf, tmp);
+        }
+        break;
+        case SchemaType_Guid:
+        {
+            guid_t value;
+            memcpy(&value, ptr, sizeof(value));
+            SPrintf(ARGS(tmp), "\"%016llx%016llx\"", value.a, value.b);
+            JsonCat(buf, tmp);
+        }
+        break;
+        case SchemaType_Struct:
+            JsonStruct(buf, field->elem, ptr, indent + 1);
+            break;
+        }
+    }
+    JsonCat(buf, "\n");
+    JsonIndent(buf, indent);
+    JsonCat(buf, "}");
+}
+
+char* schema_tojson(const schema_t* schema, const void* src, i32* lenOut)
+{
+    ASSERT(schema);
+    ASSERT(src);
+    jsonbuf_t buf = { 0 };
+    JsonStruct(&buf, schema, src, 0);
+    JsonCat(&buf, "\n");
+    if (lenOut)
+    {
+        *lenOut = buf.length;
+    }
+    return buf.ptr;
+}
+
+bool schema_loadjson(const schema_t* schema, const char* path, void* dst)
+{
+    bool loaded = false;
+    fd_t fd = fd_open(path, false);
+    if (fd_isopen(fd))
+    {
+        i32 size = (i32)fd_size(fd);
+        if (size > 0)
+        {
+            char* text = perm_malloc(size + 1);
+            i32 readSize = fd_read(fd, text, size);
+            text[size] = 0;
+            loaded = (readSize == size) && schema_fromjson(schema, text, dst);
+            pim_free(text);
+        }
+        fd_close(&fd);
+    }
+    return loaded;
+}
+
+bool schema_savejson(const schema_t* schema, const char* path, const void* src)
+{
+    bool wrote = false;
+    i32 len = 0;
+    char* text = schema_tojson(schema, src, &len);
+    fd_t fd = fd_create(path);
+    if (fd_isopen(fd))
+    {
+        wrote = fd_write(fd, text, len) == len;
+        fd_close(&fd);
+    }
+    pim_free(text);
+    return wrote;
+}
+
+// ----------------------------------------------------------------------------
+
+u32 schema_layout(const schema_t* schema)
+{
+    ASSERT(schema);
+    u32 hash = Fnv32Dword(schema->size, Fnv32Bias);
+    for (i32 i = 0; i < schema->fieldCount; ++i)
+    {
+        const schemafield_t* field = schema->fields + i;
+        hash = Fnv32String(field->name, hash);
+        hash = Fnv32Dword(field->type, hash);
+        hash = Fnv32Dword(field->offset, hash);
+        hash = Fnv32Dword(field->stride, hash);
+        if (field->elem)
+        {
+            hash = Fnv32Dword(schema_layout(field->elem), hash);
+        }
+    }
+    return hash;
+}
+
+static i32 AlignUp(i32 x)
+{
+    return (x + (kSchemaAlign - 1)) & ~(kSchemaAlign - 1);
+}
+
+// zero fills, so that padding is deterministic
+static u8* Extend(schemawriter_t* wr, i32 size)
+{
+    const i32 back = wr->size;
+    ASSERT(size >= back);
+    wr->ptr = perm_realloc(wr->ptr, size > 0 ? size : 1);
+    memset(wr->ptr + back, 0, size - back);
+    wr->size = size;
+    return wr->ptr;
+}
+
+void schema_begin(schemawriter_t* wr, const schema_t* schema)
+{
+    ASSERT(wr);
+    ASSERT(schema);
+    memset(wr, 0, sizeof(*wr));
+    wr->schema = schema;
+    // header, then the root
+    Extend(wr, AlignUp(sizeof(dschema_t)) + schema->size);
+}
+
+dbytes_t schema_push(schemawriter_t* wr, const void* src, i32 count, i32 stride)
+{
+    ASSERT(wr);
+    ASSERT(count >= 0);
+    ASSERT(stride > 0);
+    dbytes_t db = { 0 };
+    if (count > 0)
+    {
+        ASSERT(src);
+        db.offset = AlignUp(wr->size);
+        db.size = count * stride;
+        u8* ptr = Extend(wr, db.offset + db.size);
+        memcpy(ptr + db.offset, src, db.size);
+    }
+    return db;
+}
+
+void* schema_end(schemawriter_t* wr, const void* root, i32* sizeOut)
+{
+    ASSERT(wr);
+    ASSERT(wr->schema);
+    ASSERT(root);
+    ASSERT(sizeOut);
+    const schema_t* schema = wr->schema;
+    u8* ptr = wr->ptr;
+    dschema_t hdr = { 0 };
+    memcpy(hdr.id, kSchemaId, sizeof(hdr.id));
+    hdr.version = schema->version;
+    hdr.layout = schema_layout(schema);
+    hdr.size = wr->size;
+    hdr.root.offset = AlignUp(sizeof(dschema_t));
+    hdr.root.size = schema->size;
+    memcpy(ptr, &hdr, sizeof(hdr));
+    memcpy(ptr + hdr.root.offset, root, schema->size);
+    *sizeOut = wr->size;
+    memset(wr, 0, sizeof(*wr));
+    return ptr;
+}
+
+bool schema_save(schemawriter_t* wr, const void* root, const char* path)
+{
+    ASSERT(path);
+    i32 size = 0;
+    void* blob = schema_end(wr, root, &size);
+    bool wrote = false;
+    fd_t fd = fd_create(path);
+    if (fd_isopen(fd))
+    {
+        wrote = fd_write(fd, blob, size) == size;
+        fd_close(&fd);
+    }
+    pim_free(blob);
+    return wrote;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool InBlob(i32 size, dbytes_t db)
+{
+    return (db.offset >= 0) &&
+        (db.size >= 0) &&
+        (db.offset <= size - db.size) &&
+        !(db.offset & (kSchemaAlign - 1));
+}
+
+static bool ViewStruct(const schema_t* schema, const u8* blob, i32 size, const u8* src)
+{
+    for (i32 i = 0; i < schema->fieldCount; ++i)
+    {
+        const schemafield_t* field = schema->fields + i;
+        if (field->type == SchemaType_Struct)
+        {
+            if (!ViewStruct(field->elem, blob, size, src + field->offset))
+            {
+                return false;
+            }
+        }
+        else if (field->type == SchemaType_Array)
+        {
+            dbytes_t db;
+            memcpy(&db, src + field->offset, sizeof(db));
+            if (!db.size)
+            {
+                continue;
+            }
+            const i32 stride = FieldStride(field);
+            ASSERT(stride > 0);
+            if (!InBlob(size, db) || (db.size % stride))
+            {
+                return false;
+            }
+            if (field->elem && HasArrays(field->elem))
+            {
+                const u8* elems = blob + db.offset;
+                const i32 count = db.size / stride;
+                for (i32 j = 0; j < count; ++j)
+                {
+                    if (!ViewStruct(field->elem, blob, size, elems + j * stride))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+const void* schema_view(const schema_t* schema, const void* blob, i32 size)
+{
+    ASSERT(schema);
+    if (!blob || (size < (i32)sizeof(dschema_t)))
+    {
+        return NULL;
+    }
+    const u8* base = blob;
+    dschema_t hdr;
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.id, kSchemaId, sizeof(hdr.id)) ||
+        (hdr.version != schema->version) ||
+        (hdr.layout != schema_layout(schema)) ||
+        (hdr.size != size) ||
+        (hdr.root.size != schema->size) ||
+        !InBlob(size, hdr.root))
+    {
+        return NULL;
+    }
+    const u8* root = base + hdr.root.offset;
+    if (!ViewStruct(schema, base, size, root))
+    {
+        INTERRUPT();
+        return NULL;
+    }
+    return root;
+}
+
+const void* schema_open(const schema_t* schema, const char* path, fmap_t* mapOut)
+{
+    ASSERT(path);
+    ASSERT(mapOut);
+    fmap_t map = { 0 };
+    fd_t fd = fd_open(path, false);
+    if (fd_isopen(fd))
+    {
+        map = fmap_create(fd, false);
+        fd_close(&fd);
+    }
+    const void* root = NULL;
+    if (fmap_isopen(map) && (map.size <= 0x7fffffff))
+    {
+        root = schema_view(schema, map.ptr, (i32)map.size);
+    }
+    if (!root)
+    {
+        fmap_destroy(&map);
+    }
+    *mapOut = map;
+    return root;
+}
+
+// ----------------------------------------------------------------------------
+// ser_bench
+
+typedef struct benchobj_s
+{
+    float4 translation;
+    float4 rotation;
+    float4 scale;
+    float4 st;
+    float4 flatAlbedo;
+    guid_t name;
+    u32 flags;
+    float ior;
+} benchobj_t;
+
+typedef struct benchscene_s
+{
+    i32 count;
+    dbytes_t objects;
+} benchscene_t;
+
+static const schemafield_t kBenchObjFields[] =
+{
+    SCHEMA_FIELD(benchobj_t, translation, SchemaType_F4),
+    SCHEMA_FIELD(benchobj_t, rotation, SchemaType_F4),
+    SCHEMA_FIELD(benchobj_t, scale, SchemaType_F4),
+    SCHEMA_FIELD(benchobj_t, st, SchemaType_F4),
+    SCHEMA_FIELD(benchobj_t, flatAlbedo, SchemaType_F4),
+    SCHEMA_FIELD(benchobj_t, name, SchemaType_Guid),
+    SCHEMA_FIELD(benchobj_t, flags, SchemaType_U32),
+    SCHEMA_FIELD(benchobj_t, ior, SchemaType_F32),
+};
+static const schema_t kBenchObjSchema = SCHEMA_DEF(benchobj_t, 1, kBenchObjFields);
+
+static const schemafield_t kBenchSceneFields[] =
+{
+    SCHEMA_FIELD(benchscene_t, count, SchemaType_I32),
+    SCHEMA_ARRAY(benchscene_t, objects, &kBenchObjSchema),
+};
+static const schema_t kBenchSceneSchema = SCHEMA_DEF(benchscene_t, 1, kBenchSceneFields);
+
+// what each path found, so that they can be checked against each other
+typedef struct benchsum_s
+{
+    i32 objects;
+    i64 flags;
+    bool inFlags;
+} benchsum_t;
+
+static bool SumKey(void* usr, const char* str, i32 len)
+{
+    benchsum_t* sum = usr;
+    sum->inFlags = (len == 5) && !memcmp(str, "flags", 5);
+    sum->objects += sum->inFlags;
+    return true;
+}
+
+static bool SumNumber(void* usr, double value)
+{
+    benchsum_t* sum = usr;
+    if (sum->inFlags)
+    {
+        sum->flags += (i64)value;
+        sum->inFlags = false;
+    }
+    return true;
+}
+
+static benchsum_t SumTree(ser_obj_t* root)
+{
+    benchsum_t sum = { 0 };
+    ser_obj_t* objects = ser_dict_get(root, "objects");
+    const i32 len = ser_array_len(objects);
+    for (i32 i = 0; i < len; ++i)
+    {
+        ser_obj_t* flags = ser_dict_get(ser_array_get(objects, i), "flags");
+        if (flags)
+        {
+            sum.objects += 1;
+            sum.flags += (i64)ser_num_get(flags);
+        }
+    }
+    return sum;
+}
+
+static char* WriteBenchScene(const benchobj_t* objs, i32 count)
+{
+    // generous upper bound on one object's text
+    const i32 kObjText = 640;
+    char* text = perm_malloc(kObjText * count + 64);
+    i32 len = SPrintf(text, 64, "{\n    \"objects\": [\n");
+    for (i32 i = 0; i < count; ++i)
+    {
+        const benchobj_t o = objs[i];
+        len += SPrintf(text + len, kObjText,
+            "        {\n"
+            "            \"name\": \"%016llx%016llx\",\n"
+            "            \"translation\": [%.9g, %.9g, %.9g, %.9g],\n"
+            "            \"rotation\": [%.9g, %.9g, %.9g, %.9g],\n"
+            "            \"scale\": [%.9g, %.9g, %.9g, %.9g],\n"
+            "            \"st\": [%.9g, %.9g, %.9g, %.9g],\n"
+            "            \"flatAlbedo\": [%.9g, %.9g, %.9g, %.9g],\n"
+            "            \"flags\": %u,\n"
+            "            \"ior\": %.9g\n"
+            "        }%s\n",
+            o.name.a, o.name.b,
+            o.translation.x, o.translation.y, o.translation.z, o.translation.w,
+            o.rotation.x, o.rotation.y, o.rotation.z, o.rotation.w,
+            o.scale.x, o.scale.y, o.scale.z, o.scale.w,
+            o.st.x, o.st.y, o.st.z, o.st.w,
+            o.flatAlbedo.x, o.flatAlbedo.y, o.flatAlbedo.z, o.flatAlbedo.w,
+            o.flags,
+            o.ior,
+            (i + 1) < count ? "," : "");
+    }
+    len += SPrintf(text + len, 64, "    ]\n}\n");
+    return text;
+}
+
+// parse time and perm allocations for a large scene description, read as a
+// ser_obj_t tree, walked with the sax reader, and viewed as a schema blob.
+// ser_bench [objects]
+static cmdstat_t CmdSerBench(i32 argc, const char** argv)
+{
+    const i32 count = argc > 1 ? atoi(argv[1]) : 20000;
+    if ((count < 1) || (count > (1 << 20)))
+    {
+        con_logf(LogSev_Error, "cmd", "ser_bench: object count out of range");
+        return cmdstat_err;
+    }
+
+    prng_t rng = prng_get();
+    benchobj_t* objs = perm_malloc(sizeof(objs[0]) * count);
+    i64 flagSum = 0;
+    for (i32 i = 0; i < count; ++i)
+    {
+        benchobj_t o;
+        o.translation = (float4) { prng_f32(&rng) * 100.0f, prng_f32(&rng) * 100.0f, prng_f32(&rng) * 100.0f, 1.0f };
+        o.rotation = (float4) { prng_f32(&rng), prng_f32(&rng), prng_f32(&rng), prng_f32(&rng) };
+        o.scale = (float4) { 1.0f, 1.0f, 1.0f, 0.0f };
+        o.st = (float4) { 1.0f, 1.0f, prng_f32(&rng), prng_f32(&rng) };
+        o.flatAlbedo = (float4) { prng_f32(&rng), prng_f32(&rng), prng_f32(&rng), 1.0f };
+        o.name = guid_rand(&rng);
+        o.flags = prng_u32(&rng) & 0x1ff;
+        o.ior = 1.0f + prng_f32(&rng);
+        objs[i] = o;
+        flagSum += o.flags;
+    }
+    prng_set(rng);
+
+    char* text = WriteBenchScene(objs, count);
+    const i32 textLen = StrLen(text);
+
+    schemawriter_t wr;
+    schema_begin(&wr, &kBenchSceneSchema);
+    benchscene_t scene = { 0 };
+    scene.count = count;
+    scene.objects = schema_push(&wr, objs, count, sizeof(objs[0]));
+    i32 blobSize = 0;
+    void* blob = schema_end(&wr, &scene, &blobSize);
+
+    cmdstat_t status = cmdstat_ok;
+
+    // tree
+    {
+        const i64 allocs = alloc_permcount();
+        const u64 begin = time_now();
+        ser_obj_t* root = ser_read(text);
+        const benchsum_t sum = SumTree(root);
+        ser_obj_del(root);
+        const double ms = time_milli(time_now() - begin);
+        con_logf(LogSev_Info, "cmd", "ser_bench: tree  %8.2f ms %9lld allocs", ms, alloc_permcount() - allocs);
+        if ((sum.objects != count) || (sum.flags != flagSum))
+        {
+            status = cmdstat_err;
+        }
+    }
+    // sax
+    {
+        benchsum_t sum = { 0 };
+        const ser_sax_t sax =
+        {
+            .usr = &sum,
+            .key = SumKey,
+            .number = SumNumber,
+        };
+        const i64 allocs = alloc_permcount();
+        const u64 begin = time_now();
+        const bool read = ser_sax(text, &sax);
+        const double ms = time_milli(time_now() - begin);
+        con_logf(LogSev_Info, "cmd", "ser_bench: sax   %8.2f ms %9lld allocs", ms, alloc_permcount() - allocs);
+        if (!read || (sum.objects != count) || (sum.flags != flagSum))
+        {
+            status = cmdstat_err;
+        }
+    }
+    // blob, validated then read in place
+    {
+        const i64 allocs = alloc_permcount();
+        const u64 begin = time_now();
+        benchsum_t sum = { 0 };
+        const benchscene_t* view = schema_view(&kBenchSceneSchema, blob, blobSize);
+        if (view)
+        {
+            const benchobj_t* pim_noalias viewObjs = schema_at(blob, view->objects);
+            const i32 len = view->objects.size / sizeof(viewObjs[0]);
+            for (i32 i = 0; i < len; ++i)
+            {
+                sum.flags += viewObjs[i].flags;
+            }
+            sum.objects = len;
+        }
+        const double ms = time_milli(time_now() - begin);
+        con_logf(LogSev_Info, "cmd", "ser_bench: blob  %8.2f ms %9lld allocs", ms, alloc_permcount() - allocs);
+        if ((sum.objects != count) || (sum.flags != flagSum))
+        {
+            status = cmdstat_err;
+        }
+    }
+    con_logf(LogSev_Info, "cmd", "ser_bench: %d objects, %d KB of json, %d KB of blob%s",
+        count, textLen >> 10, blobSize >> 10, status == cmdstat_ok ? "" : ", paths disagree");
+
+    pim_free(blob);
+    pim_free(text);
+    pim_free(objs);
+    return status;
+}
+
+void schema_sys_init(void)
+{
+    cmd_reg("ser_bench", CmdSerBench);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "common/macro.h"
+#include "common/dbytes.h"
+#include "io/fmap.h"
+#include <stddef.h>
+
+PIM_C_BEGIN
+
+// field tables for plain structs. a schema lets a struct be read from and
+// written to json without building a ser_obj_t tree, and packed into a flat
+// blob that is validated once and then read in place, eg. from a mapping.
+
+typedef enum
+{
+    SchemaType_I32 = 0,
+    SchemaType_U32,
+    SchemaType_F32,
+    SchemaType_F4,          // float4
+    SchemaType_Guid,
+    SchemaType_Struct,      // nested by value, described by elem
+    SchemaType_Array,       // dbytes_t of elem, or of stride bytes if elem is null
+
+    SchemaType_COUNT
+} SchemaType;
+
+typedef struct schema_s schema_t;
+
+typedef struct schemafield_s
+{
+    const char* name;
+    SchemaType type;
+    i32 offset;
+    const schema_t* elem;
+    i32 stride;
+} schemafield_t;
+
+typedef struct schema_s
+{
+    const char* name;
+    i32 version;            // bump when the meaning of a field changes
+    i32 size;
+    i32 fieldCount;
+    const schemafield_t* fields;
+} schema_t;
+
+#define SCHEMA_FIELD(T, name, type)     { #name, type, offsetof(T, name), NULL, 0 }
+#define SCHEMA_STRUCT(T, name, elem)    { #name, SchemaType_Struct, offsetof(T, name), elem, 0 }
+#define SCHEMA_ARRAY(T, name, elem)     { #name, SchemaType_Array, offsetof(T, name), elem, 0 }
+#define SCHEMA_RAW(T, name, stride)     { #name, SchemaType_Array, offsetof(T, name), NULL, stride }
+#define SCHEMA_DEF(T, version, fields)  { #T, version, sizeof(T), NELEM(fields), fields }
+
+// ----------------------------------------------------------------------------
+// json
+
+// fields missing from the text keep their value in dst. arrays are skipped.
+// float4 fields also accept the flattened "name.x" keys of older files.
+bool schema_fromjson(const schema_t* schema, const char* text, void* dst);
+// returns a perm allocation
+char* schema_tojson(const schema_t* schema, const void* src, i32* lenOut);
+
+bool schema_loadjson(const schema_t* schema, const char* path, void* dst);
+bool schema_savejson(const schema_t* schema, const char* path, const void* src);
+
+// ----------------------------------------------------------------------------
+// binary
+
+#define kSchemaAlign    16
+
+typedef struct dschema_s
+{
+    char id[4];             // "PIMS"
+    i32 version;            // schema version
+    u32 layout;             // hash of the field tables, catches unbumped edits
+    i32 size;               // whole blob
+    dbytes_t root;
+} dschema_t;
+
+typedef struct schemawriter_s
+{
+    const schema_t* schema;
+    u8* ptr;
+    i32 size;
+} schemawriter_t;
+
+u32 schema_layout(const schema_t* schema);
+
+void schema_begin(schemawriter_t* wr, const schema_t* schema);
+// appends count elements of stride bytes at kSchemaAlign
+dbytes_t schema_push(schemawriter_t* wr, const void* src, i32 count, i32 stride);
+// copies the root and returns the blob as a perm allocation of *sizeOut bytes
+void* schema_end(schemawriter_t* wr, const void* root, i32* sizeOut);
+bool schema_save(schemawriter_t* wr, const void* root, const char* path);
+
+// checks that every array reachable from the root is in bounds, aligned and
+// a whole number of elements. returns the root within blob, or null.
+const void* schema_view(const schema_t* schema, const void* blob, i32 size);
+// maps the file and views it; the root lives as long as *mapOut
+const void* schema_open(const schema_t* schema, const char* path, fmap_t* mapOut);
+
+// resolves an array of a viewed blob
+pim_inline const void* schema_at(const void* blob, dbytes_t db)
+{
+    return db.size > 0 ? (const u8*)blob + db.offset : NULL;
+}
+
+// registers ser_bench, which reads one scene as a tree, with sax and as a blob
+void schema_sys_init(void);
+
+PIM_C_END
@@ -516,66 +516,7 @@ ser_obj_t** ser_dict_values(ser_obj_t* obj, i32* lenOut)
 
 // ----------------------------------------------------------------------------
 
-typedef enum
-{
-    toktype_null = 0,
-    toktype_dict,
-    toktype_key,
-    toktype_value,
-    toktype_array,
-    toktype_element,
-    toktype_string,
-    toktype_number,
-    toktype_bool,
-    toktype_any,
-} toktype;
-
-typedef struct token_s
-{
-    const char* begin;
-    i32 len;
-    i32 id;
-} token_t;
-
-typedef struct tokarr_s
-{
-    i32 length;
-    token_t* tokens;
-} tokarr_t;
-
-static i32 PushToken(tokarr_t* arr, const char* begin, i32 tokLen, i32 id)
-{
-    i32 back = arr->length++;
-    i32 len = back + 1;
-    PermReserve(arr->tokens, len);
-    token_t token = { begin, tokLen, id };
-    arr->tokens[back] = token;
-    return back;
-}
-
-static i32 BeginToken(tokarr_t* arr, const char* begin, i32 id)
-{
-    return PushToken(arr, begin, 0, id);
-}
-
-static const char* EndToken(tokarr_t* arr, i32 mark, const char* end)
-{
-    i32 len = arr->length;
-    if (mark < len)
-    {
-        if (end)
-        {
-            token_t* token = arr->tokens + mark;
-            token->len = (i32)(end - token->begin);
-            return end;
-        }
-        else
-        {
-            arr->length = mark;
-        }
-    }
-    return NULL;
-}
+#define kSaxDepth 64
 
 static const char* SkipWhitespace(const char* text)
 {
@@ -586,541 +527,279 @@ static const char* SkipWhitespace(const char* text)
     return text;
 }
 
-static const char* ParseNumber(tokarr_t* arr, const char* text);
-static const char* ParsePair(tokarr_t* arr, const char* text, char delim, i32 id);
-static const char* ParseString(tokarr_t* arr, const char* text);
-static const char* ParseArray(tokarr_t* arr, const char* text);
-static const char* ParseNull(tokarr_t* arr, const char* text);
-static const char* ParseBool(tokarr_t* arr, const char* text);
-static const char* ParseAny(tokarr_t* arr, const char* text);
-static const char* ParseDictKey(tokarr_t* arr, const char* text);
-static const char* ParseDictValue(tokarr_t* arr, const char* text);
-static const char* ParseDict(tokarr_t* arr, const char* text);
-
-static const char* ParseNumber(tokarr_t* arr, const char* text)
+static bool SaxEvent(ser_sax_fn fn, void* usr)
 {
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_number);
-    char c = *text;
-    if (IsDigit(c) || c == '-' || c == '+')
-    {
-        ++text;
-        while (IsDigit(*text))
-        {
-            ++text;
-        }
-        c = *text;
-        if (c == 'e' || c == 'E')
-        {
-            ++text;
-            c = *text;
-            if (IsDigit(c) || c == '-' || c == '+')
-            {
-                ++text;
-                while (IsDigit(*text))
-                {
-                    ++text;
-                }
-            }
-            else
-            {
-                goto onfail;
-            }
-        }
-        else if (c == '.')
-        {
-            ++text;
-            while (IsDigit(*text))
-            {
-                ++text;
-            }
-        }
-        return EndToken(arr, mark, text);
-    }
-onfail:
-    return EndToken(arr, mark, NULL);
+    return !fn || fn(usr);
 }
 
-static const char* ParseString(tokarr_t* arr, const char* text)
+// text is on the opening quote; returns one past the closing quote
+static const char* SaxString(const char* text, const char** beginOut, i32* lenOut)
 {
     const char kDelim = '"';
     const char kEscape = '\\';
-    text = SkipWhitespace(text);
-    if (*text == kDelim)
-    {
-        // skip first quote
-        ++text;
-        i32 mark = BeginToken(arr, text, toktype_string);
-        bool escape = false;
-        while (*text)
-        {
-            char c = text[0];
-            char d = text[1];
-            if ((c == kEscape) && (d == kDelim))
-            {
-                escape = !escape;
-                ++text;
-            }
-            else if (!escape && (c == kDelim))
-            {
-                // skip last quote
-                return EndToken(arr, mark, text) + 1;
-            }
-            else
-            {
-                ++text;
-            }
-        }
-        return EndToken(arr, mark, NULL);
-    }
-    return NULL;
-}
-
-static const char* ParseArrayElem(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_element);
-    const char* elem = ParseAny(arr, text);
-    return EndToken(arr, mark, elem);
-}
-
-static const char* ParseArray(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_array);
-    if (*text == '[')
+    ASSERT(*text == kDelim);
+    ++text;
+    const char* begin = text;
+    while (*text)
     {
-        ++text;
-        while (*text)
+        char c = *text;
+        if (c == kDelim)
         {
-            text = SkipWhitespace(text);
-            if (*text == ']')
-            {
-                break;
-            }
-            const char* element = ParseArrayElem(arr, text);
-            if (!element)
-            {
-                goto onfail;
-            }
-            text = SkipWhitespace(element);
-            if (*text == ',')
-            {
-                ++text;
-            }
+            *beginOut = begin;
+            *lenOut = (i32)(text - begin);
+            return text + 1;
         }
-        if (*text == ']')
+        if ((c == kEscape) && text[1])
         {
             ++text;
-            return EndToken(arr, mark, text);
         }
+        ++text;
     }
-onfail:
-    return EndToken(arr, mark, NULL);
-}
-
-static const char* ParseNull(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_null);
-    if (!memcmp(text, "null", 4))
-    {
-        text += 4;
-        return EndToken(arr, mark, text);
-    }
-    return EndToken(arr, mark, NULL);
-}
-
-static const char* ParseBool(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_bool);
-    if (!memcmp(text, "true", 4))
-    {
-        text += 4;
-        return EndToken(arr, mark, text);
-    }
-    if (!memcmp(text, "false", 5))
-    {
-        text += 5;
-        return EndToken(arr, mark, text);
-    }
-    return EndToken(arr, mark, NULL);
+    return NULL;
 }
 
-static const char* ParseAny(tokarr_t* arr, const char* text)
+static const char* SaxScalar(const char* text, const ser_sax_t* sax)
 {
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_any);
-    const char* result = NULL;
+    void* usr = sax->usr;
     char c = *text;
-    if (c)
+    if (c == '"')
     {
-        if (c == '{')
-        {
-            result = ParseDict(arr, text);
-        }
-        else if (c == '[')
-        {
-            result = ParseArray(arr, text);
-        }
-        else if (c == '"')
+        const char* str = NULL;
+        i32 len = 0;
+        text = SaxString(text, &str, &len);
+        if (text && sax->string && !sax->string(usr, str, len))
         {
-            result = ParseString(arr, text);
+            return NULL;
         }
-        else if (IsDigit(c) || (c == '-') || (c == '+'))
+        return text;
+    }
+    if (IsDigit(c) || (c == '-') || (c == '+') || (c == '.'))
+    {
+        char* end = NULL;
+        double value = strtod(text, &end);
+        if (end == text)
         {
-            result = ParseNumber(arr, text);
+            return NULL;
         }
-        else if (c == 't' || c == 'f')
+        if (sax->number && !sax->number(usr, value))
         {
-            result = ParseBool(arr, text);
+            return NULL;
         }
-        else if (c == 'n')
+        return end;
+    }
+    if (!strncmp(text, "true", 4) || !strncmp(text, "false", 5))
+    {
+        bool value = c == 't';
+        if (sax->boolean && !sax->boolean(usr, value))
         {
-            result = ParseNull(arr, text);
+            return NULL;
         }
+        return text + (value ? 4 : 5);
     }
-    return EndToken(arr, mark, result);
-}
-
-static const char* ParseDictKey(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_key);
-    const char* key = ParseString(arr, text);
-    if (key)
+    if (!strncmp(text, "null", 4))
     {
-        key = SkipWhitespace(key);
-        if (*key == ':')
+        if (!SaxEvent(sax->null, usr))
         {
-            return EndToken(arr, mark, key);
+            return NULL;
         }
+        return text + 4;
     }
-    return EndToken(arr, mark, NULL);
+    return NULL;
 }
 
-static const char* ParseDictValue(tokarr_t* arr, const char* text)
+bool ser_sax(const char* text, const ser_sax_t* sax)
 {
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_value);
-    if (*text == ':')
+    ASSERT(sax);
+    if (!text)
     {
-        ++text;
-        return EndToken(arr, mark, ParseAny(arr, text));
+        return false;
     }
-    return EndToken(arr, mark, NULL);
-}
-
-static const char* ParseDict(tokarr_t* arr, const char* text)
-{
-    text = SkipWhitespace(text);
-    i32 mark = BeginToken(arr, text, toktype_dict);
-    const char* begin = text;
-    if (*text == '{')
+    void* usr = sax->usr;
+    // nonzero for a dict, zero for an array
+    u8 stack[kSaxDepth];
+    i32 depth = 0;
+    while (true)
     {
-        ++text;
-        while (*text)
+        text = SkipWhitespace(text);
+        const bool inDict = (depth > 0) && stack[depth - 1];
+        char c = *text;
+        if ((depth > 0) && (c == (inDict ? '}' : ']')))
         {
-            text = SkipWhitespace(text);
-            if (*text == '}')
+            ++text;
+            --depth;
+            if (!SaxEvent(inDict ? sax->endDict : sax->endArray, usr))
             {
-                break;
+                return false;
             }
-            const char* key = ParseDictKey(arr, text);
-            if (!key)
+        }
+        else
+        {
+            if (inDict)
             {
-                goto onfail;
+                if (c != '"')
+                {
+                    return false;
+                }
+                const char* key = NULL;
+                i32 len = 0;
+                text = SaxString(text, &key, &len);
+                if (!text)
+                {
+                    return false;
+                }
+                if (sax->key && !sax->key(usr, key, len))
+                {
+                    return false;
+                }
+                text = SkipWhitespace(text);
+                if (*text != ':')
+                {
+                    return false;
+                }
+                text = SkipWhitespace(text + 1);
+                c = *text;
             }
-            const char* value = ParseDictValue(arr, key);
-            if (!value)
+            if ((c == '{') || (c == '['))
             {
-                goto onfail;
+                if (depth >= kSaxDepth)
+                {
+                    return false;
+                }
+                ++text;
+                stack[depth++] = c == '{';
+                if (!SaxEvent(c == '{' ? sax->beginDict : sax->beginArray, usr))
+                {
+                    return false;
+                }
+                continue;
             }
-            text = SkipWhitespace(value);
-            if (*text == ',')
+            text = SaxScalar(text, sax);
+            if (!text)
             {
-                ++text;
+                return false;
             }
         }
-        if (*text == '}')
+
+        // a value just ended
+        if (depth == 0)
+        {
+            return true;
+        }
+        text = SkipWhitespace(text);
+        if (*text == ',')
         {
             ++text;
-            return EndToken(arr, mark, text);
         }
     }
-onfail:
-    return EndToken(arr, mark, NULL);
 }
 
 // ----------------------------------------------------------------------------
 
-static ser_obj_t* ReadToken(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadArray(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadBool(tokarr_t arr, i32* pCursor);
-static char* ReadDictKey(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadDictValue(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadDict(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadNull(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadNumber(tokarr_t arr, i32* pCursor);
-static ser_obj_t* ReadString(tokarr_t arr, i32* pCursor);
-
-static ser_obj_t* ReadArray(tokarr_t arr, i32* pCursor)
+typedef struct treebuilder_s
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
-    {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_array)
-        {
-            ++cursor;
-            ser_obj_t* parent = ser_obj_array();
-            while (cursor < arr.length)
-            {
-                token = arr.tokens[cursor];
-                if (token.id == toktype_element)
-                {
-                    ++cursor;
-                    ser_obj_t* element = ReadToken(arr, &cursor);
-                    ASSERT(element);
-                    if (element)
-                    {
-                        i32 index = ser_array_add(parent, element);
-                        ASSERT(index >= 0);
-                    }
-                }
-                else
-                {
-                    break;
-                }
-            }
-            *pCursor = cursor;
-            return parent;
-        }
-    }
-    return NULL;
-}
+    ser_obj_t* root;
+    ser_obj_t* stack[kSaxDepth];
+    i32 depth;
+    char key[PIM_PATH];
+} treebuilder_t;
 
-static ser_obj_t* ReadBool(tokarr_t arr, i32* pCursor)
+static bool TreeAdd(treebuilder_t* tb, ser_obj_t* value)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
+    if (!tb->depth)
     {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_bool)
+        // the root must be a dict
+        if (tb->root || (value->type != sertype_dict))
         {
-            ++cursor;
-            bool value = token.begin[0] == 't';
-            ser_obj_t* obj = ser_obj_bool(value);
-            *pCursor = cursor;
-            return obj;
+            ser_obj_del(value);
+            return false;
         }
+        tb->root = value;
+        return true;
     }
-    return NULL;
-}
-
-static char* ReadDictKey(tokarr_t arr, i32* pCursor)
-{
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
+    ser_obj_t* parent = tb->stack[tb->depth - 1];
+    if (parent->type == sertype_array)
     {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_key)
-        {
-            ++cursor;
-            token = arr.tokens[cursor];
-            if (token.id == toktype_string)
-            {
-                ++cursor;
-                const char* src = token.begin;
-                i32 len = token.len;
-                if (len > 0)
-                {
-                    char* key = perm_malloc(len + 1);
-                    memcpy(key, src, len);
-                    key[len] = 0;
-                    *pCursor = cursor;
-                    return key;
-                }
-            }
-        }
+        return ser_array_add(parent, value) >= 0;
     }
-    return NULL;
+    if (!ser_dict_set(parent, tb->key, value))
+    {
+        ser_obj_del(value);
+        return false;
+    }
+    tb->key[0] = 0;
+    return true;
 }
 
-static ser_obj_t* ReadDictValue(tokarr_t arr, i32* pCursor)
+static bool TreePush(treebuilder_t* tb, ser_obj_t* value)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
+    if (TreeAdd(tb, value))
     {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_value)
-        {
-            ++cursor;
-            ser_obj_t* value = ReadToken(arr, &cursor);
-            if (value)
-            {
-                *pCursor = cursor;
-                return value;
-            }
-            ASSERT(false);
-        }
+        ASSERT(tb->depth < kSaxDepth);
+        tb->stack[tb->depth++] = value;
+        return true;
     }
-    return NULL;
+    return false;
 }
 
-static ser_obj_t* ReadDict(tokarr_t arr, i32* pCursor)
+static bool TreePop(void* usr)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
-    {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_dict)
-        {
-            ++cursor;
-            ser_obj_t* parent = ser_obj_dict();
-            while (cursor < arr.length)
-            {
-                token = arr.tokens[cursor];
-                if (token.id == toktype_key)
-                {
-                    char* key = ReadDictKey(arr, &cursor);
-                    ASSERT(key);
-                    if (!key)
-                    {
-                        goto onfail;
-                    }
-                    ser_obj_t* value = ReadDictValue(arr, &cursor);
-                    ASSERT(value);
-                    if (!value)
-                    {
-                        goto onfail;
-                    }
-                    if (!ser_dict_set(parent, key, value))
-                    {
-                        ASSERT(false);
-                        goto onfail;
-                    }
-                }
-                else
-                {
-                    break;
-                }
-            }
+    treebuilder_t* tb = usr;
+    ASSERT(tb->depth > 0);
+    --tb->depth;
+    return true;
+}
 
-            *pCursor = cursor;
-            return parent;
+static bool TreeBeginDict(void* usr)
+{
+    return TreePush(usr, ser_obj_dict());
+}
 
-        onfail:
-            ser_obj_del(parent);
-            return NULL;
-        }
-    }
-    return NULL;
+static bool TreeBeginArray(void* usr)
+{
+    return TreePush(usr, ser_obj_array());
 }
 
-static ser_obj_t* ReadNull(tokarr_t arr, i32* pCursor)
+static bool TreeKey(void* usr, const char* str, i32 len)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
+    treebuilder_t* tb = usr;
+    if ((len <= 0) || (len >= NELEM(tb->key)))
     {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_null)
-        {
-            ++cursor;
-            *pCursor = cursor;
-            return ser_obj_null();
-        }
+        return false;
     }
-    return NULL;
+    memcpy(tb->key, str, len);
+    tb->key[len] = 0;
+    return true;
 }
 
-static ser_obj_t* ReadNumber(tokarr_t arr, i32* pCursor)
+static bool TreeString(void* usr, const char* str, i32 len)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
+    if (len <= 0)
     {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_number)
-        {
-            ++cursor;
-            *pCursor = cursor;
-            double value = atof(token.begin);
-            return ser_obj_num(value);
-        }
+        // strings are never empty, see ser_obj_str
+        return TreeAdd(usr, ser_obj_null());
     }
-    return NULL;
+    ser_obj_t* obj = perm_calloc(sizeof(*obj));
+    obj->type = sertype_string;
+    char* dst = perm_malloc(len + 1);
+    memcpy(dst, str, len);
+    dst[len] = 0;
+    obj->u.asString = dst;
+    return TreeAdd(usr, obj);
 }
 
-static ser_obj_t* ReadString(tokarr_t arr, i32* pCursor)
+static bool TreeNumber(void* usr, double value)
 {
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
-    {
-        token_t token = arr.tokens[cursor];
-        if (token.id == toktype_string)
-        {
-            ++cursor;
-            *pCursor = cursor;
-            const char* src = token.begin;
-            i32 len = token.len;
-            if (len > 0)
-            {
-                ser_obj_t* obj = perm_calloc(sizeof(*obj));
-                obj->type = sertype_string;
-                char* str = perm_malloc(len + 1);
-                memcpy(str, src, len);
-                str[len] = 0;
-                obj->u.asString = str;
-                return obj;
-            }
-        }
-    }
-    return NULL;
+    return TreeAdd(usr, ser_obj_num(value));
 }
 
-static ser_obj_t* ReadToken(tokarr_t arr, i32* pCursor)
+static bool TreeBool(void* usr, bool value)
 {
-    ser_obj_t* result = NULL;
-    i32 cursor = *pCursor;
-    if (cursor < arr.length)
-    {
-        token_t token = { 0 };
-    tryread:
-        token = arr.tokens[cursor];
-        switch (token.id)
-        {
-        default:
-            ASSERT(false);
-            return NULL;
-        case toktype_any:
-            ++cursor;
-            goto tryread;
-            break;
-        case toktype_dict:
-            result = ReadDict(arr, &cursor);
-            break;
-        case toktype_array:
-            result = ReadArray(arr, &cursor);
-            break;
-        case toktype_string:
-            result = ReadString(arr, &cursor);
-            break;
-        case toktype_number:
-            result = ReadNumber(arr, &cursor);
-            break;
-        case toktype_bool:
-            result = ReadBool(arr, &cursor);
-        case toktype_null:
-            result = ReadNull(arr, &cursor);
-            break;
-        }
-        if (result)
-        {
-            *pCursor = cursor;
-        }
-    }
-    return result;
+    return TreeAdd(usr, ser_obj_bool(value));
+}
+
+static bool TreeNull(void* usr)
+{
+    return TreeAdd(usr, ser_obj_null());
 }
 
 ser_obj_t* ser_read(const char* text)
@@ -1129,16 +808,30 @@ ser_obj_t* ser_read(const char* text)
     {
         return NULL;
     }
-    tokarr_t tokarr = { 0 };
-    if (ParseDict(&tokarr, text))
-    {
-        i32 cursor = 0;
-        ser_obj_t* root = ReadDict(tokarr, &cursor);
-        pim_free(tokarr.tokens);
-        memset(&tokarr, 0, sizeof(tokarr));
-        return root;
+    treebuilder_t tb;
+    tb.root = NULL;
+    tb.depth = 0;
+    tb.key[0] = 0;
+    const ser_sax_t sax =
+    {
+        .usr = &tb,
+        .beginDict = TreeBeginDict,
+        .endDict = TreePop,
+        .beginArray = TreeBeginArray,
+        .endArray = TreePop,
+        .key = TreeKey,
+        .string = TreeString,
+        .number = TreeNumber,
+        .boolean = TreeBool,
+        .null = TreeNull,
+    };
+    if (!ser_sax(text, &sax))
+    {
+        // partial trees hang off the root
+        ser_obj_del(tb.root);
+        return NULL;
     }
-    return NULL;
+    return tb.root;
 }
 
 // ----------------------------------------------------------------------------
@@ -73,6 +73,27 @@ bool ser_dict_rm(ser_obj_t* obj, const char* key, ser_obj_t** valueOut);
 const char** ser_dict_keys(ser_obj_t* obj, i32* lenOut);
 ser_obj_t** ser_dict_values(ser_obj_t* obj, i32* lenOut);
 
+// streaming reader: walks the text once, reporting each value as it is
+// reached, and allocates nothing. keys and strings point into text and are
+// not unescaped. any callback may be null; returning false stops the walk.
+typedef bool(*ser_sax_fn)(void* usr);
+typedef struct ser_sax_s
+{
+    void* usr;
+    ser_sax_fn beginDict;
+    ser_sax_fn endDict;
+    ser_sax_fn beginArray;
+    ser_sax_fn endArray;
+    bool(*key)(void* usr, const char* str, i32 len);
+    bool(*string)(void* usr, const char* str, i32 len);
+    bool(*number)(void* usr, double value);
+    bool(*boolean)(void* usr, bool value);
+    ser_sax_fn null;
+} ser_sax_t;
+
+// false if the text is malformed or a callback stopped the walk
+bool ser_sax(const char* text, const ser_sax_t* sax);
+
 ser_obj_t* ser_read(const char* text);
 char* ser_write(ser_obj_t* obj, i32* lenOut);
 
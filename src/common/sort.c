@@ -1,6 +1,13 @@
 #include "common/sort.h"
 #include "allocator/allocator.h"
+#include "common/cmd.h"
+#include "common/console.h"
+#include "common/random.h"
+#include "common/time.h"
+#include "threading/task.h"
+#include "math/scalar.h"
 #include <string.h>
+#include <stdlib.h>
 
 void pimswap(void* lhs, void* rhs, i32 stride)
 {
@@ -179,3 +186,480 @@ i32* indsort(const void* items, i32 count, i32 stride, CmpFn cmp, void* usr)
     sort_i32(indices, count, indcmp, &ctx);
     return indices;
 }
+
+// ----------------------------------------------------------------------------
+// radix
+
+#define kRadixBits      8
+#define kRadixBuckets   (1 << kRadixBits)
+// below this an insertion sort beats the histogram passes
+#define kRadixSmall     64
+// below this the passes run on the calling thread
+#define kRadixParallel  (1 << 16)
+#define kRadixMinChunk  (1 << 14)
+#define kRadixMaxChunks 64
+
+typedef struct radix_s
+{
+    void* keys[2];
+    i32* values[2];     // null when there are no values
+    i32 count;
+    i32 wide;           // u64 keys
+    i32 cur;            // which buffer holds the current order
+} radix_t;
+
+pim_inline u64 GetKey(const void* keys, i32 i, i32 wide)
+{
+    return wide ? ((const u64*)keys)[i] : ((const u32*)keys)[i];
+}
+
+pim_inline void SetKey(void* keys, i32 i, i32 wide, u64 key)
+{
+    if (wide)
+    {
+        ((u64*)keys)[i] = key;
+    }
+    else
+    {
+        ((u32*)keys)[i] = (u32)key;
+    }
+}
+
+pim_inline u32 GetDigit(u64 key, i32 shift)
+{
+    return (u32)(key >> shift) & (kRadixBuckets - 1);
+}
+
+static void InsertionSort(void* keys, i32* values, i32 count, i32 wide)
+{
+    for (i32 i = 1; i < count; ++i)
+    {
+        const u64 key = GetKey(keys, i, wide);
+        const i32 value = values ? values[i] : 0;
+        i32 j = i;
+        while ((j > 0) && (GetKey(keys, j - 1, wide) > key))
+        {
+            SetKey(keys, j, wide, GetKey(keys, j - 1, wide));
+            if (values)
+            {
+                values[j] = values[j - 1];
+            }
+            --j;
+        }
+        SetKey(keys, j, wide, key);
+        if (values)
+        {
+            values[j] = value;
+        }
+    }
+}
+
+// scatters [begin, end) of the current buffer into the other one.
+// offsets is advanced past each element written.
+pim_inline void RadixScatter(
+    const radix_t* rx,
+    i32 begin,
+    i32 end,
+    i32 shift,
+    u32* pim_noalias offsets)
+{
+    const i32 wide = rx->wide;
+    const void* srcKeys = rx->keys[rx->cur];
+    void* dstKeys = rx->keys[rx->cur ^ 1];
+    const i32* pim_noalias srcValues = rx->values[rx->cur];
+    i32* pim_noalias dstValues = rx->values[rx->cur ^ 1];
+    if (srcValues)
+    {
+        for (i32 i = begin; i < end; ++i)
+        {
+            const u64 key = GetKey(srcKeys, i, wide);
+            const u32 j = offsets[GetDigit(key, shift)]++;
+            SetKey(dstKeys, j, wide, key);
+            dstValues[j] = srcValues[i];
+        }
+    }
+    else
+    {
+        for (i32 i = begin; i < end; ++i)
+        {
+            const u64 key = GetKey(srcKeys, i, wide);
+            const u32 j = offsets[GetDigit(key, shift)]++;
+            SetKey(dstKeys, j, wide, key);
+        }
+    }
+}
+
+static void RadixSerial(radix_t* rx)
+{
+    const i32 count = rx->count;
+    const i32 wide = rx->wide;
+    const i32 passCount = wide ? 8 : 4;
+    const void* keys = rx->keys[rx->cur];
+
+    // every digit is counted in a single read. bits that no key differs
+    // from the first key in are left out of the passes.
+    u32 hist[8 * kRadixBuckets];
+    memset(hist, 0, sizeof(hist[0]) * kRadixBuckets * passCount);
+    const u64 first = GetKey(keys, 0, wide);
+    u64 varying = 0;
+    for (i32 i = 0; i < count; ++i)
+    {
+        const u64 key = GetKey(keys, i, wide);
+        varying |= key ^ first;
+        for (i32 p = 0; p < passCount; ++p)
+        {
+            ++hist[p * kRadixBuckets + GetDigit(key, p * kRadixBits)];
+        }
+    }
+
+    for (i32 p = 0; p < passCount; ++p)
+    {
+        const i32 shift = p * kRadixBits;
+        if (!GetDigit(varying, shift))
+        {
+            continue;
+        }
+        u32* pim_noalias offsets = hist + p * kRadixBuckets;
+        u32 sum = 0;
+        for (i32 b = 0; b < kRadixBuckets; ++b)
+        {
+            const u32 n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+        RadixScatter(rx, 0, count, shift, offsets);
+        rx->cur ^= 1;
+    }
+}
+
+typedef struct task_Radix
+{
+    task_t task;
+    radix_t* rx;
+    i32 chunkSize;
+    i32 shift;
+    u32* hist;          // [chunkCount][kRadixBuckets], offsets once scanned
+    u64* varying;       // [chunkCount], bits differing from the first key
+} task_Radix;
+
+pim_inline void ChunkRange(const task_Radix* task, i32 c, i32* beginOut, i32* endOut)
+{
+    const i32 begin = c * task->chunkSize;
+    *beginOut = begin;
+    *endOut = i1_min(begin + task->chunkSize, task->rx->count);
+}
+
+static void RadixVaryingFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_Radix* task = (task_Radix*)pbase;
+    const radix_t* rx = task->rx;
+    const void* keys = rx->keys[rx->cur];
+    const i32 wide = rx->wide;
+    const u64 first = GetKey(keys, 0, wide);
+    for (i32 c = begin; c < end; ++c)
+    {
+        i32 a, b;
+        ChunkRange(task, c, &a, &b);
+        u64 varying = 0;
+        for (i32 i = a; i < b; ++i)
+        {
+            varying |= GetKey(keys, i, wide) ^ first;
+        }
+        task->varying[c] = varying;
+    }
+}
+
+static void RadixCountFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_Radix* task = (task_Radix*)pbase;
+    const radix_t* rx = task->rx;
+    const void* keys = rx->keys[rx->cur];
+    const i32 wide = rx->wide;
+    const i32 shift = task->shift;
+    for (i32 c = begin; c < end; ++c)
+    {
+        i32 a, b;
+        ChunkRange(task, c, &a, &b);
+        u32* pim_noalias hist = task->hist + c * kRadixBuckets;
+        memset(hist, 0, sizeof(hist[0]) * kRadixBuckets);
+        for (i32 i = a; i < b; ++i)
+        {
+            ++hist[GetDigit(GetKey(keys, i, wide), shift)];
+        }
+    }
+}
+
+static void RadixScatterFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_Radix* task = (task_Radix*)pbase;
+    for (i32 c = begin; c < end; ++c)
+    {
+        i32 a, b;
+        ChunkRange(task, c, &a, &b);
+        RadixScatter(task->rx, a, b, task->shift, task->hist + c * kRadixBuckets);
+    }
+}
+
+// each pass counts digits per chunk, scans the counts bucket-major so that
+// chunks keep their relative order, then scatters every chunk at once.
+static void RadixParallel(radix_t* rx)
+{
+    const i32 count = rx->count;
+    const i32 passCount = rx->wide ? 8 : 4;
+    const i32 chunkCount = i1_clamp(count / kRadixMinChunk, 1, i1_min(kRadixMaxChunks, task_thread_ct() * 4));
+    const i32 chunkSize = (count + chunkCount - 1) / chunkCount;
+    u32* pim_noalias hist = tmp_malloc(sizeof(hist[0]) * kRadixBuckets * chunkCount);
+    u64* pim_noalias varying = tmp_malloc(sizeof(varying[0]) * chunkCount);
+
+    u64 varyingBits = 0;
+    {
+        task_Radix* task = tmp_calloc(sizeof(*task));
+        task->rx = rx;
+        task->chunkSize = chunkSize;
+        task->varying = varying;
+        task_run(&task->task, RadixVaryingFn, chunkCount);
+        for (i32 c = 0; c < chunkCount; ++c)
+        {
+            varyingBits |= varying[c];
+        }
+    }
+
+    for (i32 p = 0; p < passCount; ++p)
+    {
+        const i32 shift = p * kRadixBits;
+        if (!GetDigit(varyingBits, shift))
+        {
+            continue;
+        }
+
+        task_Radix* task = tmp_calloc(sizeof(*task));
+        task->rx = rx;
+        task->chunkSize = chunkSize;
+        task->shift = shift;
+        task->hist = hist;
+        task_run(&task->task, RadixCountFn, chunkCount);
+
+        u32 sum = 0;
+        for (i32 b = 0; b < kRadixBuckets; ++b)
+        {
+            for (i32 c = 0; c < chunkCount; ++c)
+            {
+                const u32 n = hist[c * kRadixBuckets + b];
+                hist[c * kRadixBuckets + b] = sum;
+                sum += n;
+            }
+        }
+
+        // tasks are not reused once run
+        task = tmp_calloc(sizeof(*task));
+        task->rx = rx;
+        task->chunkSize = chunkSize;
+        task->shift = shift;
+        task->hist = hist;
+        task_run(&task->task, RadixScatterFn, chunkCount);
+        rx->cur ^= 1;
+    }
+}
+
+static void RadixSort(void* keys, i32* values, i32 count, i32 wide)
+{
+    ASSERT(keys || !count);
+    ASSERT(count >= 0);
+    if (count <= kRadixSmall)
+    {
+        InsertionSort(keys, values, count, wide);
+        return;
+    }
+
+    const i32 keyBytes = wide ? sizeof(u64) : sizeof(u32);
+    radix_t rx = { 0 };
+    rx.count = count;
+    rx.wide = wide;
+    rx.keys[0] = keys;
+    rx.keys[1] = perm_malloc(keyBytes * count);
+    if (values)
+    {
+        rx.values[0] = values;
+        rx.values[1] = perm_malloc(sizeof(values[0]) * count);
+    }
+
+    if (count < kRadixParallel)
+    {
+        RadixSerial(&rx);
+    }
+    else
+    {
+        RadixParallel(&rx);
+    }
+
+    if (rx.cur)
+    {
+        memcpy(keys, rx.keys[1], keyBytes * count);
+        if (values)
+        {
+            memcpy(values, rx.values[1], sizeof(values[0]) * count);
+        }
+    }
+    pim_free(rx.keys[1]);
+    pim_free(rx.values[1]);
+}
+
+void sort_u32(u32* keys, i32* values, i32 count)
+{
+    RadixSort(keys, values, count, false);
+}
+
+void sort_u64(u64* keys, i32* values, i32 count)
+{
+    RadixSort(keys, values, count, true);
+}
+
+static i32* KeySort(const void* keys, i32 count, i32 wide)
+{
+    ASSERT(keys || !count);
+    const i32 keyBytes = wide ? sizeof(u64) : sizeof(u32);
+    i32* indices = tmp_malloc(sizeof(indices[0]) * count);
+    for (i32 i = 0; i < count; ++i)
+    {
+        indices[i] = i;
+    }
+    void* scratch = perm_malloc(keyBytes * count);
+    memcpy(scratch, keys, keyBytes * count);
+    RadixSort(scratch, indices, count, wide);
+    pim_free(scratch);
+    return indices;
+}
+
+i32* keysort_u32(const u32* keys, i32 count)
+{
+    return KeySort(keys, count, false);
+}
+
+i32* keysort_u64(const u64* keys, i32 count)
+{
+    return KeySort(keys, count, true);
+}
+
+void sort_permute(void* items, i32 count, i32 stride, const i32* order)
+{
+    ASSERT(items || !count);
+    ASSERT(order || !count);
+    ASSERT(stride > 0);
+    u8* pim_noalias dst = items;
+    u8* pim_noalias src = perm_malloc(stride * count);
+    memcpy(src, items, stride * count);
+    for (i32 i = 0; i < count; ++i)
+    {
+        const i32 j = order[i];
+        ASSERT((u32)j < (u32)count);
+        memcpy(dst + i * stride, src + j * stride, stride);
+    }
+    pim_free(src);
+}
+
+// ----------------------------------------------------------------------------
+// sort_bench
+
+static i32 CmpBenchKey(const void* lhs, const void* rhs, void* usr)
+{
+    const u32 a = *(const u32*)lhs;
+    const u32 b = *(const u32*)rhs;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static bool IsSorted(const u32* keys, i32 count)
+{
+    for (i32 i = 1; i < count; ++i)
+    {
+        if (keys[i - 1] > keys[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// order must be a permutation that sorts the keys, with equal keys left in
+// ascending index order
+static bool IsStableOrder(const u32* keys, const i32* order, i32 count)
+{
+    u8* seen = perm_calloc(sizeof(seen[0]) * count);
+    bool valid = true;
+    for (i32 i = 0; valid && (i < count); ++i)
+    {
+        const i32 j = order[i];
+        if (((u32)j >= (u32)count) || seen[j])
+        {
+            valid = false;
+            break;
+        }
+        seen[j] = 1;
+        if (i > 0)
+        {
+            const i32 k = order[i - 1];
+            valid = (keys[k] < keys[j]) || ((keys[k] == keys[j]) && (k < j));
+        }
+    }
+    pim_free(seen);
+    return valid;
+}
+
+// the comparator quicksort against the radix sort and the key index sort,
+// over random 32 bit keys, from 1K elements up to the given count by tens.
+// sort_bench [max]
+static cmdstat_t CmdSortBench(i32 argc, const char** argv)
+{
+    const i32 maxCount = argc > 1 ? atoi(argv[1]) : 10000000;
+    if ((maxCount < 1000) || (maxCount > (1 << 25)))
+    {
+        con_logf(LogSev_Error, "cmd", "sort_bench: count out of range");
+        return cmdstat_err;
+    }
+
+    prng_t rng = prng_get();
+    u32* keys = perm_malloc(sizeof(keys[0]) * maxCount);
+    u32* sorted = perm_malloc(sizeof(sorted[0]) * maxCount);
+    for (i32 i = 0; i < maxCount; ++i)
+    {
+        keys[i] = prng_u32(&rng);
+    }
+    prng_set(rng);
+
+    cmdstat_t status = cmdstat_ok;
+    for (i32 count = 1000; count <= maxCount; count *= 10)
+    {
+        memcpy(sorted, keys, sizeof(keys[0]) * count);
+        u64 begin = time_now();
+        pimsort(sorted, count, sizeof(sorted[0]), CmpBenchKey, NULL);
+        const double cmpMs = time_milli(time_now() - begin);
+        bool valid = IsSorted(sorted, count);
+
+        memcpy(sorted, keys, sizeof(keys[0]) * count);
+        begin = time_now();
+        sort_u32(sorted, NULL, count);
+        const double radixMs = time_milli(time_now() - begin);
+        valid &= IsSorted(sorted, count);
+
+        begin = time_now();
+        i32* order = keysort_u32(keys, count);
+        const double keyMs = time_milli(time_now() - begin);
+        valid &= IsStableOrder(keys, order, count);
+        pim_free(order);
+
+        con_logf(LogSev_Info, "cmd", "sort_bench: n=%-9d cmp %9.2f ms radix %8.2f ms keysort %8.2f ms (%.1fx)%s",
+            count, cmpMs, radixMs, keyMs, cmpMs / radixMs, valid ? "" : ", unsorted");
+        if (!valid)
+        {
+            status = cmdstat_err;
+        }
+    }
+
+    pim_free(keys);
+    pim_free(sorted);
+    return status;
+}
+
+void sort_sys_init(void)
+{
+    cmd_reg("sort_bench", CmdSortBench);
+}
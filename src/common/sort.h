@@ -13,4 +13,37 @@ void pimsort(void* pVoid, i32 count, i32 stride, CmpFn cmp, void* usr);
 void sort_i32(i32* items, i32 count, CmpFn_i32 cmp, void* usr);
 i32* indsort(const void* items, i32 count, i32 stride, CmpFn cmp, void* usr);
 
+// ----------------------------------------------------------------------------
+// radix sorts over precomputed keys. stable, ascending, and with no
+// comparator calls; large inputs run their passes on the task system.
+// the comparator sorts above remain for orders a key cannot capture.
+
+// sorts keys, moving values (may be null) along with them
+void sort_u32(u32* keys, i32* values, i32 count);
+void sort_u64(u64* keys, i32* values, i32 count);
+
+// returns a tmp allocation of indices ordering the keys, which are left as is
+i32* keysort_u32(const u32* keys, i32 count);
+i32* keysort_u64(const u64* keys, i32 count);
+
+// reorders items so that item i becomes the old item order[i]
+void sort_permute(void* items, i32 count, i32 stride, const i32* order);
+
+// keys that sort like their value; complement a key to sort descending
+pim_inline u32 sortkey_i32(i32 x)
+{
+    return (u32)x ^ 0x80000000u;
+}
+pim_inline u32 sortkey_f32(float x)
+{
+    union { float f; u32 u; } v;
+    v.f = x;
+    // negatives flip entirely, positives only flip the sign
+    const u32 mask = (u32)((i32)v.u >> 31) | 0x80000000u;
+    return v.u ^ mask;
+}
+
+// registers sort_bench, which times the comparator and radix sorts
+void sort_sys_init(void);
+
 PIM_C_END
@@ -0,0 +1,491 @@
+#include "common/stats.h"
+#include "allocator/allocator.h"
+#include "common/atomics.h"
+#include "common/cvar.h"
+#include "common/cmd.h"
+#include "common/console.h"
+#include "common/stringutil.h"
+#include "common/time.h"
+#include "common/profiler.h"
+#include "os/socket.h"
+#include "threading/task.h"
+#include "threading/thread.h"
+#include "threading/sleep.h"
+#include "math/scalar.h"
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // _MSC_VER
+
+#define kMaxStats       128
+#define kStatBuckets    64
+
+typedef enum
+{
+    StatType_Counter = 0,
+    StatType_Gauge,
+    StatType_Histogram,
+
+    StatType_COUNT
+} StatType;
+
+// one cache line per thread, so threads never share a line while recording
+typedef struct statslot_s
+{
+    i64 value;          // counter total, or histogram sample count
+    i64 sum;            // histogram sample total
+    i64 max;            // histogram largest sample
+    i64 pad[5];
+} statslot_t;
+SASSERT(sizeof(statslot_t) == 64);
+
+typedef struct stat_s
+{
+    const char* name;
+    StatType type;
+    statslot_t* slots;  // [slotCount]
+    i64* buckets;       // [slotCount][kStatBuckets], histograms only
+    u64 gauge;          // bits of a double
+} stat_t;
+
+typedef struct linebuf_s
+{
+    char* ptr;
+    i32 length;
+} linebuf_t;
+
+static cvar_t cv_stats_port = { .type = cvart_int,.name = "stats_port",.value = "0",.minInt = 0,.maxInt = 65535,.desc = "localhost tcp port serving stats as json lines, 0 disables stats" };
+static cvar_t cv_stats_period = { .type = cvart_float,.name = "stats_period",.value = "1000",.minFloat = 10.0f,.maxFloat = 60000.0f,.desc = "milliseconds between stats snapshots sent to a client" };
+
+static cmdstat_t CmdStatsDump(i32 argc, const char** argv);
+
+static stat_t ms_stats[kMaxStats];
+static i32 ms_count;
+static i32 ms_slotCount;
+static i32 ms_enabled;
+
+static socket_t ms_listener;
+static thread_t ms_thread;
+static i32 ms_serving;
+static i32 ms_periodMs;
+
+static stat_t* ms_frameUs;
+static stat_t* ms_frames;
+static stat_t* ms_permBytes;
+static stat_t* ms_permCount;
+static stat_t* ms_tempBytes;
+
+// ----------------------------------------------------------------------------
+
+static stat_t* Register(const char* name, StatType type)
+{
+    ASSERT(name);
+    ASSERT(task_thread_id() == 0);
+
+    if (!ms_slotCount)
+    {
+        // task ids stay below the hardware thread count, see task_sys_init
+        ms_slotCount = i1_clamp(thread_hardware_count(), 1, kMaxThreads);
+    }
+
+    const i32 count = ms_count;
+    for (i32 i = 0; i < count; ++i)
+    {
+        if (StrCmp(ms_stats[i].name, PIM_PATH, name) == 0)
+        {
+            ASSERT(ms_stats[i].type == type);
+            return ms_stats + i;
+        }
+    }
+    ASSERT(count < kMaxStats);
+    if (count >= kMaxStats)
+    {
+        return NULL;
+    }
+
+    stat_t* stat = ms_stats + count;
+    stat->name = StrDup(name, EAlloc_Perm);
+    stat->type = type;
+    stat->slots = perm_calloc(sizeof(stat->slots[0]) * ms_slotCount);
+    if (type == StatType_Histogram)
+    {
+        stat->buckets = perm_calloc(sizeof(stat->buckets[0]) * kStatBuckets * ms_slotCount);
+    }
+    // snapshots on the server thread see the stat once it is filled in
+    store_i32(&ms_count, count + 1, MO_Release);
+    return stat;
+}
+
+stat_t* stat_counter(const char* name)
+{
+    return Register(name, StatType_Counter);
+}
+
+stat_t* stat_gauge(const char* name)
+{
+    return Register(name, StatType_Gauge);
+}
+
+stat_t* stat_histogram(const char* name)
+{
+    return Register(name, StatType_Histogram);
+}
+
+bool stats_enabled(void)
+{
+    return load_i32(&ms_enabled, MO_Relaxed) != 0;
+}
+
+// threads outside the task system share slot 0, so slots are added to
+// atomically; on its own thread that costs an uncontended add.
+pim_inline i32 SlotIndex(void)
+{
+    const i32 tid = task_thread_id();
+    return tid < ms_slotCount ? tid : 0;
+}
+
+// bucket b holds samples below 2^b, and at or above 2^(b-1)
+pim_inline i32 StatBucket(i64 value)
+{
+    if (value <= 0)
+    {
+        return 0;
+    }
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, (u64)value);
+    return (i32)index + 1;
+#else
+    return 64 - __builtin_clzll((u64)value);
+#endif // _MSC_VER
+}
+
+void stat_add(stat_t* stat, i64 value)
+{
+    if (stats_enabled() && stat)
+    {
+        ASSERT(stat->type == StatType_Counter);
+        fetch_add_i64(&stat->slots[SlotIndex()].value, value, MO_Relaxed);
+    }
+}
+
+void stat_set(stat_t* stat, double value)
+{
+    if (stats_enabled() && stat)
+    {
+        ASSERT(stat->type == StatType_Gauge);
+        u64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        store_u64(&stat->gauge, bits, MO_Relaxed);
+    }
+}
+
+void stat_sample(stat_t* stat, i64 value)
+{
+    if (stats_enabled() && stat)
+    {
+        ASSERT(stat->type == StatType_Histogram);
+        const i32 i = SlotIndex();
+        statslot_t* slot = stat->slots + i;
+        fetch_add_i64(&slot->value, 1, MO_Relaxed);
+        fetch_add_i64(&slot->sum, value, MO_Relaxed);
+        i64 prev = load_i64(&slot->max, MO_Relaxed);
+        while ((value > prev) && !cmpex_i64(&slot->max, &prev, value, MO_Relaxed))
+        {
+            // a failed exchange reloads prev; retry while value is larger
+        }
+        const i32 b = i1_min(StatBucket(value), kStatBuckets - 1);
+        fetch_add_i64(&stat->buckets[i * kStatBuckets + b], 1, MO_Relaxed);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+static void LineCat(linebuf_t* buf, const char* str)
+{
+    const i32 len = StrLen(str);
+    const i32 back = buf->length;
+    buf->ptr = perm_realloc(buf->ptr, back + len + 1);
+    memcpy(buf->ptr + back, str, len + 1);
+    buf->length = back + len;
+}
+
+// upper bound of the bucket holding the given rank, clamped to the max
+static i64 Quantile(const i64* buckets, i64 count, i64 max, double q)
+{
+    const i64 rank = (i64)(q * (count - 1));
+    i64 seen = 0;
+    for (i32 b = 0; b < kStatBuckets; ++b)
+    {
+        seen += buckets[b];
+        if (seen > rank)
+        {
+            const i64 bound = (b > 0) ? ((b < 63) ? (1ll << b) - 1 : max) : 0;
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+static void WriteCounter(linebuf_t* buf, const stat_t* stat)
+{
+    i64 value = 0;
+    for (i32 t = 0; t < ms_slotCount; ++t)
+    {
+        value += load_i64(&stat->slots[t].value, MO_Relaxed);
+    }
+    char tmp[64];
+    SPrintf(ARGS(tmp), "%lld", value);
+    LineCat(buf, tmp);
+}
+
+static void WriteGauge(linebuf_t* buf, const stat_t* stat)
+{
+    const u64 bits = load_u64(&stat->gauge, MO_Relaxed);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    char tmp[64];
+    SPrintf(ARGS(tmp), "%.17g", value);
+    LineCat(buf, tmp);
+}
+
+static void WriteHistogram(linebuf_t* buf, const stat_t* stat)
+{
+    i64 count = 0;
+    i64 sum = 0;
+    i64 max = 0;
+    i64 buckets[kStatBuckets] = { 0 };
+    for (i32 t = 0; t < ms_slotCount; ++t)
+    {
+        const statslot_t* slot = stat->slots + t;
+        count += load_i64(&slot->value, MO_Relaxed);
+        sum += load_i64(&slot->sum, MO_Relaxed);
+        const i64 slotMax = load_i64(&slot->max, MO_Relaxed);
+        max = slotMax > max ? slotMax : max;
+        for (i32 b = 0; b < kStatBuckets; ++b)
+        {
+            buckets[b] += load_i64(&stat->buckets[t * kStatBuckets + b], MO_Relaxed);
+        }
+    }
+
+    char tmp[PIM_PATH];
+    SPrintf(ARGS(tmp), "{\"count\":%lld,\"sum\":%lld,\"max\":%lld,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"buckets\":[",
+        count, sum, max,
+        Quantile(buckets, count, max, 0.5),
+        Quantile(buckets, count, max, 0.9),
+        Quantile(buckets, count, max, 0.99));
+    LineCat(buf, tmp);
+    // trailing empty buckets are left out
+    i32 len = kStatBuckets;
+    while ((len > 0) && !buckets[len - 1])
+    {
+        --len;
+    }
+    for (i32 b = 0; b < len; ++b)
+    {
+        SPrintf(ARGS(tmp), b ? ",%lld" : "%lld", buckets[b]);
+        LineCat(buf, tmp);
+    }
+    LineCat(buf, "]}");
+}
+
+static void WriteGroup(linebuf_t* buf, const char* group, StatType type, i32 count)
+{
+    char tmp[PIM_PATH];
+    SPrintf(ARGS(tmp), ",\"%s\":{", group);
+    LineCat(buf, tmp);
+    bool first = true;
+    for (i32 i = 0; i < count; ++i)
+    {
+        const stat_t* stat = ms_stats + i;
+        if (stat->type != type)
+        {
+            continue;
+        }
+        SPrintf(ARGS(tmp), first ? "\"%s\":" : ",\"%s\":", stat->name);
+        LineCat(buf, tmp);
+        first = false;
+        switch (type)
+        {
+        default:
+            ASSERT(false);
+            break;
+        case StatType_Counter:
+            WriteCounter(buf, stat);
+            break;
+        case StatType_Gauge:
+            WriteGauge(buf, stat);
+            break;
+        case StatType_Histogram:
+            WriteHistogram(buf, stat);
+            break;
+        }
+    }
+    LineCat(buf, "}");
+}
+
+char* stats_snapshot(i32* lenOut)
+{
+    const i32 count = load_i32(&ms_count, MO_Acquire);
+    linebuf_t buf = { 0 };
+    char tmp[PIM_PATH];
+    SPrintf(ARGS(tmp), "{\"time\":%.6f", time_sec(time_now() - time_appstart()));
+    LineCat(&buf, tmp);
+    WriteGroup(&buf, "counters", StatType_Counter, count);
+    WriteGroup(&buf, "gauges", StatType_Gauge, count);
+    WriteGroup(&buf, "histograms", StatType_Histogram, count);
+    LineCat(&buf, "}\n");
+    if (lenOut)
+    {
+        *lenOut = buf.length;
+    }
+    return buf.ptr;
+}
+
+// ----------------------------------------------------------------------------
+
+// sends snapshots to one client at a time, until it hangs up
+static i32 ServerFn(void* arg)
+{
+    while (load_i32(&ms_serving, MO_Acquire))
+    {
+        u32 addr = 0;
+        socket_t client = socket_accept(ms_listener, &addr);
+        if (!socket_isopen(client))
+        {
+            // the listener was closed by stats_sys_shutdown or a port change
+            break;
+        }
+        while (load_i32(&ms_serving, MO_Acquire))
+        {
+            i32 len = 0;
+            char* line = stats_snapshot(&len);
+            const i32 sent = socket_send(client, line, len);
+            pim_free(line);
+            if (sent != len)
+            {
+                break;
+            }
+            // short naps, so that shutdown need not wait out a whole period
+            const i32 periodMs = load_i32(&ms_periodMs, MO_Relaxed);
+            for (i32 t = 0; (t < periodMs) && load_i32(&ms_serving, MO_Acquire); t += 10)
+            {
+                intrin_sleep(10);
+            }
+        }
+        socket_close(&client);
+    }
+    return 0;
+}
+
+static void StopServer(void)
+{
+    if (load_i32(&ms_serving, MO_Relaxed))
+    {
+        store_i32(&ms_enabled, 0, MO_Relaxed);
+        store_i32(&ms_serving, 0, MO_Release);
+        // wakes the server thread if it is blocked in accept
+        socket_close(&ms_listener);
+        thread_join(&ms_thread);
+    }
+}
+
+static void StartServer(i32 port)
+{
+    ASSERT(!load_i32(&ms_serving, MO_Relaxed));
+    if (port <= 0)
+    {
+        return;
+    }
+
+    u32 addr = 0;
+    if (!network_url2addr("127.0.0.1", &addr) ||
+        !socket_open(&ms_listener, SocketProto_TCP))
+    {
+        con_logf(LogSev_Error, "stats", "Failed to open a socket for port %d", port);
+        return;
+    }
+    if (!socket_bind(ms_listener, addr, (u16)port) ||
+        !socket_listen(ms_listener))
+    {
+        con_logf(LogSev_Error, "stats", "Failed to listen on port %d", port);
+        socket_close(&ms_listener);
+        return;
+    }
+
+    store_i32(&ms_serving, 1, MO_Release);
+    store_i32(&ms_enabled, 1, MO_Relaxed);
+    thread_create(&ms_thread, ServerFn, NULL);
+    con_logf(LogSev_Info, "stats", "Serving stats on 127.0.0.1:%d", port);
+}
+
+void stats_sys_init(void)
+{
+    cvar_reg(&cv_stats_port);
+    cvar_reg(&cv_stats_period);
+    cmd_reg("stats_dump", CmdStatsDump);
+
+    ms_frames = stat_counter("frame.count");
+    ms_frameUs = stat_histogram("frame.us");
+    ms_permBytes = stat_gauge("alloc.perm_bytes");
+    ms_permCount = stat_gauge("alloc.perm_count");
+    ms_tempBytes = stat_gauge("alloc.temp_bytes");
+
+    store_i32(&ms_periodMs, (i32)cvar_get_float(&cv_stats_period), MO_Relaxed);
+    StartServer(cvar_get_int(&cv_stats_port));
+}
+
+ProfileMark(pm_update, stats_sys_update)
+void stats_sys_update(void)
+{
+    if (cvar_check_dirty(&cv_stats_period))
+    {
+        store_i32(&ms_periodMs, (i32)cvar_get_float(&cv_stats_period), MO_Relaxed);
+    }
+    if (cvar_check_dirty(&cv_stats_port))
+    {
+        StopServer();
+        StartServer(cvar_get_int(&cv_stats_port));
+    }
+    if (!stats_enabled())
+    {
+        return;
+    }
+
+    ProfileBegin(pm_update);
+
+    stat_add(ms_frames, 1);
+    stat_sample(ms_frameUs, (i64)time_micro(time_dt()));
+    stat_set(ms_permBytes, (double)alloc_permbytes());
+    stat_set(ms_permCount, (double)alloc_permcount());
+    stat_set(ms_tempBytes, (double)alloc_tempbytes());
+
+    ProfileEnd(pm_update);
+}
+
+void stats_sys_shutdown(void)
+{
+    StopServer();
+}
+
+// logs the line a client of stats_port receives, cut off by the console
+// past a few kilobytes
+static cmdstat_t CmdStatsDump(i32 argc, const char** argv)
+{
+    if (!stats_enabled())
+    {
+        con_logf(LogSev_Warning, "stats", "stats are disabled, set stats_port to enable them");
+        return cmdstat_err;
+    }
+    i32 len = 0;
+    char* line = stats_snapshot(&len);
+    if (len > 0)
+    {
+        // the newline is the console's to add
+        line[len - 1] = 0;
+    }
+    con_logf(LogSev_Info, "stats", "%s", line);
+    pim_free(line);
+    return cmdstat_ok;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "common/macro.h"
+
+PIM_C_BEGIN
+
+// named runtime numbers for unattended runs. each thread accumulates into
+// its own slot, and snapshots merge the slots. while stats_port is 0 the
+// record calls return after a single load.
+//
+// counters are running totals; rates come from the difference of two
+// snapshots. gauges hold the last value set. histograms count samples in
+// power of two buckets, which merge by adding.
+//
+// with stats_port set, a localhost tcp client on that port is sent one
+// snapshot per stats_period milliseconds, each a line of json.
+
+typedef struct stat_s stat_t;
+
+// registers a stat, or returns the one already registered under name.
+// register from the main thread; the returned pointer stays valid.
+stat_t* stat_counter(const char* name);
+stat_t* stat_gauge(const char* name);
+stat_t* stat_histogram(const char* name);
+
+void stat_add(stat_t* stat, i64 value);
+void stat_set(stat_t* stat, double value);
+void stat_sample(stat_t* stat, i64 value);
+
+bool stats_enabled(void);
+
+// one line of json, newline included, as a perm allocation
+char* stats_snapshot(i32* lenOut);
+
+void stats_sys_init(void);
+void stats_sys_update(void);
+void stats_sys_shutdown(void);
+
+PIM_C_END
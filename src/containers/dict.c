@@ -1,14 +1,24 @@
 #include "containers/dict.h"
 #include "allocator/allocator.h"
 #include "containers/hash_util.h"
+#include "containers/sdict.h"
+#include "containers/hash_set.h"
+#include "containers/table.h"
 #include "common/sort.h"
+#include "common/cmd.h"
+#include "common/console.h"
+#include "common/guid.h"
+#include "common/random.h"
+#include "common/stringutil.h"
+#include "common/time.h"
 #include <string.h>
+#include <stdlib.h>
 
-static u32 HashKey(const void* key, u32 keySize)
+static u64 HashKey(const void* key, u32 keySize)
 {
     ASSERT(key);
     ASSERT(keySize);
-    return hashutil_create_hash(Fnv32Bytes(key, keySize, Fnv32Bias));
+    return hashutil_bytes(key, keySize);
 }
 
 void dict_new(dict_t* dict, u32 keySize, u32 valueSize, EAlloc allocator)
@@ -27,8 +37,9 @@ void dict_del(dict_t* dict)
 
     dict->width = 0;
     dict->count = 0;
-    pim_free(dict->hashes);
-    dict->hashes = NULL;
+    dict->tombs = 0;
+    pim_free(dict->ctrl);
+    dict->ctrl = NULL;
     pim_free(dict->keys);
     dict->keys = NULL;
     pim_free(dict->values);
@@ -39,108 +50,108 @@ void dict_clear(dict_t* dict)
 {
     ASSERT(dict);
     dict->count = 0;
+    dict->tombs = 0;
     const u32 width = dict->width;
     if (width)
     {
-        memset(dict->hashes, 0, sizeof(dict->hashes[0]) * width);
+        memset(dict->ctrl, hashutil_ctrl_empty, width + kHashGroup);
         memset(dict->keys, 0, dict->keySize * width);
         memset(dict->values, 0, dict->valueSize * width);
     }
 }
 
-void dict_reserve(dict_t* dict, i32 count)
+static void Rehash(dict_t* dict, u32 newWidth)
 {
-    ASSERT(dict);
-
-    count = count > 16 ? count : 16;
-    const u32 newWidth = NextPow2((u32)count) * 2;
-    const u32 oldWidth = dict->width;
-    if (newWidth <= oldWidth)
-    {
-        return;
-    }
-
     const u32 keySize = dict->keySize;
     const u32 valueSize = dict->valueSize;
     const EAlloc allocator = dict->allocator;
     ASSERT(keySize);
     ASSERT(valueSize);
 
-    u32* oldHashes = dict->hashes;
+    const u32 oldWidth = dict->width;
+    u8* oldCtrl = dict->ctrl;
     u8* oldKeys = dict->keys;
     u8* oldValues = dict->values;
 
-    u32* newHashes = pim_calloc(allocator, sizeof(u32) * newWidth);
+    u8* newCtrl = hashutil_ctrl_new(allocator, newWidth);
     u8* newKeys = pim_calloc(allocator, keySize * newWidth);
     u8* newValues = pim_calloc(allocator, valueSize * newWidth);
 
-    const u32 newMask = newWidth - 1u;
-    for (u32 i = 0; i < oldWidth;)
+    for (u32 i = 0; i < oldWidth; ++i)
     {
-        const u32 hash = oldHashes[i];
-        if (hashutil_valid(hash))
+        if (hashutil_ctrl_full(oldCtrl[i]))
         {
-            u32 j = hash;
-            while (true)
-            {
-                j &= newMask;
-                if (!newHashes[j])
-                {
-                    newHashes[j] = hash;
-                    memcpy(newKeys + j * keySize, oldKeys + i * keySize, keySize);
-                    memcpy(newValues + j * valueSize, oldValues + i * valueSize, valueSize);
-                    goto next;
-                }
-                ++j;
-            }
+            const u8* key = oldKeys + i * keySize;
+            const u64 hash = HashKey(key, keySize);
+            const u32 j = hashutil_find_free(newCtrl, hash, newWidth);
+            hashutil_setctrl(newCtrl, newWidth, j, hashutil_h2(hash));
+            memcpy(newKeys + j * keySize, key, keySize);
+            memcpy(newValues + j * valueSize, oldValues + i * valueSize, valueSize);
         }
-    next:
-        ++i;
     }
 
-    pim_free(oldHashes);
+    pim_free(oldCtrl);
     pim_free(oldKeys);
     pim_free(oldValues);
 
     dict->width = newWidth;
-    dict->hashes = newHashes;
+    dict->tombs = 0;
+    dict->ctrl = newCtrl;
     dict->keys = newKeys;
     dict->values = newValues;
 }
 
-i32 dict_find(const dict_t* dict, const void* key)
+void dict_reserve(dict_t* dict, i32 count)
 {
     ASSERT(dict);
-    ASSERT(key);
 
-    const u32 keySize = dict->keySize;
-    const u32 keyHash = HashKey(key, keySize);
+    const u32 newWidth = hashutil_width(count > 0 ? (u32)count : 0u);
+    if (newWidth > dict->width)
+    {
+        Rehash(dict, newWidth);
+    }
+}
+
+static i32 FindSlot(const dict_t* dict, const void* key, u64 keyHash)
+{
+    const u32 width = dict->width;
+    if (!width)
+    {
+        return -1;
+    }
 
-    u32 width = dict->width;
-    const u32 mask = width - 1u;
-    const u32* hashes = dict->hashes;
-    const u8* keys = dict->keys;
+    const u32 keySize = dict->keySize;
+    const u8* pim_noalias ctrl = dict->ctrl;
+    const u8* pim_noalias keys = dict->keys;
+    const u8 h2 = hashutil_h2(keyHash);
 
-    u32 j = keyHash;
-    while (width--)
+    hashprobe_t probe = hashutil_probe(keyHash, width);
+    while (true)
     {
-        j &= mask;
-        const u32 jHash = hashes[j];
-        if (hashutil_empty(jHash))
-        {
-            break;
-        }
-        if (jHash == keyHash)
+        const u8* group = ctrl + probe.pos;
+        u32 match = hashutil_match(group, h2);
+        while (match)
         {
+            const u32 j = (probe.pos + hashutil_lowbit(match)) & probe.mask;
             if (!memcmp(key, keys + j * keySize, keySize))
             {
                 return (i32)j;
             }
+            match &= match - 1u;
+        }
+        if (hashutil_match_empty(group))
+        {
+            return -1;
         }
-        ++j;
+        hashutil_next(&probe);
     }
+}
 
-    return -1;
+i32 dict_find(const dict_t* dict, const void* key)
+{
+    ASSERT(dict);
+    ASSERT(key);
+    return FindSlot(dict, key, HashKey(key, dict->keySize));
 }
 
 bool dict_get(const dict_t* dict, const void* key, void* valueOut)
@@ -189,35 +200,35 @@ bool dict_add(dict_t* dict, const void* key, const void* valueIn)
     ASSERT(key);
     ASSERT(valueIn);
 
-    if (dict_find(dict, key) != -1)
+    const u32 keySize = dict->keySize;
+    const u64 keyHash = HashKey(key, keySize);
+    if (FindSlot(dict, key, keyHash) != -1)
     {
         return false;
     }
-    dict_reserve(dict, dict->count + 1);
-    dict->count++;
 
-    const u32 mask = dict->width - 1u;
-    const u32 valueSize = dict->valueSize;
-    const u32 keySize = dict->keySize;
-    const u32 keyHash = HashKey(key, keySize);
+    if (!dict->width || hashutil_overloaded(dict->width, dict->count + dict->tombs + 1))
+    {
+        Rehash(dict, hashutil_grow(dict->width, dict->count));
+    }
 
-    u32* hashes = dict->hashes;
-    u8* keys = dict->keys;
-    u8* values = dict->values;
+    const u32 width = dict->width;
+    const u32 valueSize = dict->valueSize;
+    u8* pim_noalias ctrl = dict->ctrl;
+    u8* pim_noalias keys = dict->keys;
+    u8* pim_noalias values = dict->values;
 
-    u32 j = keyHash;
-    while (true)
+    const u32 j = hashutil_find_free(ctrl, keyHash, width);
+    if (ctrl[j] == hashutil_ctrl_tomb)
     {
-        j &= mask;
-        if (hashutil_empty_or_tomb(hashes[j]))
-        {
-            hashes[j] = keyHash;
-            memcpy(keys + j * keySize, key, keySize);
-            memcpy(values + j * valueSize, valueIn, valueSize);
-            return true;
-        }
-        ++j;
+        dict->tombs--;
     }
+    hashutil_setctrl(ctrl, width, j, hashutil_h2(keyHash));
+    memcpy(keys + j * keySize, key, keySize);
+    memcpy(values + j * valueSize, valueIn, valueSize);
+    dict->count++;
+
+    return true;
 }
 
 bool dict_rm(dict_t* dict, const void* key, void* valueOut)
@@ -235,7 +246,6 @@ bool dict_rm(dict_t* dict, const void* key, void* valueOut)
     const u32 keySize = dict->keySize;
     ASSERT(valueSize);
 
-    u32* hashes = dict->hashes;
     u8* keys = dict->keys;
     u8* values = dict->values;
 
@@ -244,7 +254,10 @@ bool dict_rm(dict_t* dict, const void* key, void* valueOut)
         memcpy(valueOut, values + i * valueSize, valueSize);
     }
 
-    hashes[i] |= hashutil_tomb_mask;
+    if (hashutil_erase(dict->ctrl, dict->width, (u32)i))
+    {
+        dict->tombs++;
+    }
     memset(keys + i * keySize, 0, keySize);
     memset(values + i * valueSize, 0, valueSize);
 
@@ -287,12 +300,12 @@ u32* dict_sort(const dict_t* dict, DictCmpFn cmp, void* usr)
 
     const u32 length = dict->count;
     const u32 width = dict->width;
-    const u32* hashes = dict->hashes;
+    const u8* ctrl = dict->ctrl;
     u32* indices = tmp_calloc(length * sizeof(indices[0]));
     u32 j = 0;
     for (u32 i = 0; i < width; ++i)
     {
-        if (hashutil_valid(hashes[i]))
+        if (hashutil_ctrl_full(ctrl[i]))
         {
             indices[j++] = i;
         }
@@ -310,3 +323,228 @@ u32* dict_sort(const dict_t* dict, DictCmpFn cmp, void* usr)
     pimsort(indices, length, sizeof(indices[0]), DictCmp, &ctx);
     return indices;
 }
+
+// ----------------------------------------------------------------------------
+// dict_bench
+
+typedef struct benchkeys_s
+{
+    i32 count;
+    u64* keys;      // [count * 2], the second half is never added
+    char** names;
+    guid_t* guids;
+} benchkeys_t;
+
+typedef struct benchmap_s
+{
+    dict_t dict;
+    sdict_t sdict;
+    hashset_t set;
+    table_t table;
+    genid* ids;
+} benchmap_t;
+
+typedef enum
+{
+    BenchOp_Add,
+    BenchOp_Hit,
+    BenchOp_Miss,
+    BenchOp_Rm,
+
+    BenchOp_COUNT
+} BenchOp;
+
+// one operation on key i of a container, returns whether it found the key
+typedef bool(*BenchStepFn)(benchmap_t* map, const benchkeys_t* bk, BenchOp op, i32 i);
+typedef i32(*BenchWidthFn)(const benchmap_t* map);
+
+static bool DictStep(benchmap_t* map, const benchkeys_t* bk, BenchOp op, i32 i)
+{
+    const u64* key = bk->keys + i;
+    switch (op)
+    {
+    default:
+        return dict_find(&map->dict, key) >= 0;
+    case BenchOp_Add:
+        return dict_add(&map->dict, key, &i);
+    case BenchOp_Rm:
+        return dict_rm(&map->dict, key, NULL);
+    }
+}
+
+static bool SDictStep(benchmap_t* map, const benchkeys_t* bk, BenchOp op, i32 i)
+{
+    const char* name = bk->names[i];
+    switch (op)
+    {
+    default:
+        return sdict_find(&map->sdict, name) >= 0;
+    case BenchOp_Add:
+        return sdict_add(&map->sdict, name, &i);
+    case BenchOp_Rm:
+        return sdict_rm(&map->sdict, name, NULL);
+    }
+}
+
+static bool SetStep(benchmap_t* map, const benchkeys_t* bk, BenchOp op, i32 i)
+{
+    const u64* key = bk->keys + i;
+    switch (op)
+    {
+    default:
+        return hashset_contains(&map->set, key, sizeof(*key));
+    case BenchOp_Add:
+        return hashset_add(&map->set, key, sizeof(*key));
+    case BenchOp_Rm:
+        return hashset_rm(&map->set, key, sizeof(*key));
+    }
+}
+
+static bool TableStep(benchmap_t* map, const benchkeys_t* bk, BenchOp op, i32 i)
+{
+    genid id;
+    switch (op)
+    {
+    default:
+        return table_find(&map->table, bk->guids[i], &id);
+    case BenchOp_Add:
+        return table_add(&map->table, bk->guids[i], &i, map->ids + i);
+    case BenchOp_Rm:
+        return table_release(&map->table, map->ids[i], NULL);
+    }
+}
+
+static i32 DictWidth(const benchmap_t* map)
+{
+    return map->dict.width;
+}
+
+static i32 SDictWidth(const benchmap_t* map)
+{
+    return map->sdict.width;
+}
+
+static i32 SetWidth(const benchmap_t* map)
+{
+    return map->set.width;
+}
+
+static i32 TableWidth(const benchmap_t* map)
+{
+    return map->table.lookup ? map->table.lookup->width : 0;
+}
+
+static const struct
+{
+    const char* name;
+    BenchStepFn step;
+    BenchWidthFn width;
+} kBenchMaps[] =
+{
+    { "dict", DictStep, DictWidth },
+    { "sdict", SDictStep, SDictWidth },
+    { "hashset", SetStep, SetWidth },
+    { "table", TableStep, TableWidth },
+};
+
+// times each operation over its half of the keys; returns whether every
+// add, hit and remove found what it should and every miss did not.
+static bool BenchMap(benchmap_t* map, const benchkeys_t* bk, i32 iMap)
+{
+    const BenchStepFn step = kBenchMaps[iMap].step;
+    const i32 count = bk->count;
+    i32 width = 0;
+    bool valid = true;
+    u64 ticks[BenchOp_COUNT] = { 0 };
+    for (i32 op = 0; op < BenchOp_COUNT; ++op)
+    {
+        const i32 begin = (op == BenchOp_Miss) ? count : 0;
+        const i32 expect = (op == BenchOp_Miss) ? 0 : count;
+        i32 found = 0;
+        const u64 start = time_now();
+        for (i32 i = begin; i < begin + count; ++i)
+        {
+            found += step(map, bk, op, i);
+        }
+        ticks[op] = time_now() - start;
+        valid &= found == expect;
+        if (op == BenchOp_Add)
+        {
+            width = kBenchMaps[iMap].width(map);
+        }
+    }
+
+    const double toNs = 1e6 / count;
+    con_logf(LogSev_Info, "cmd", "dict_bench: %-7s n=%-7d width=%-7d add %6.1f hit %6.1f miss %6.1f rm %6.1f ns/op%s",
+        kBenchMaps[iMap].name, count, width,
+        time_milli(ticks[BenchOp_Add]) * toNs,
+        time_milli(ticks[BenchOp_Hit]) * toNs,
+        time_milli(ticks[BenchOp_Miss]) * toNs,
+        time_milli(ticks[BenchOp_Rm]) * toNs,
+        valid ? "" : ", lookups disagree");
+    return valid;
+}
+
+// ns per operation of each hashed container, with hits and misses timed apart.
+// dict_bench [count]; counts just under and over a power of two show the
+// lightest and heaviest load the tables run at.
+static cmdstat_t CmdDictBench(i32 argc, const char** argv)
+{
+    const i32 count = argc > 1 ? atoi(argv[1]) : 1 << 16;
+    if (count < 1)
+    {
+        con_logf(LogSev_Error, "cmd", "dict_bench: count must be positive");
+        return cmdstat_err;
+    }
+
+    prng_t rng = prng_create();
+    benchkeys_t bk = { 0 };
+    bk.count = count;
+    bk.keys = perm_malloc(sizeof(bk.keys[0]) * count * 2);
+    bk.names = perm_malloc(sizeof(bk.names[0]) * count * 2);
+    bk.guids = perm_malloc(sizeof(bk.guids[0]) * count * 2);
+    for (i32 i = 0; i < count * 2; ++i)
+    {
+        // index in the low bits keeps every key unique
+        bk.keys[i] = (prng_u64(&rng) << 32) | (u32)i;
+        char name[PIM_PATH];
+        SPrintf(ARGS(name), "textures/bench_%x_%d", prng_u32(&rng), i);
+        bk.names[i] = StrDup(name, EAlloc_Perm);
+        bk.guids[i] = guid_rand(&rng);
+    }
+
+    benchmap_t map = { 0 };
+    dict_new(&map.dict, sizeof(bk.keys[0]), sizeof(i32), EAlloc_Perm);
+    sdict_new(&map.sdict, sizeof(i32), EAlloc_Perm);
+    hashset_new(&map.set, sizeof(bk.keys[0]), EAlloc_Perm);
+    table_new(&map.table, sizeof(i32));
+    map.ids = perm_malloc(sizeof(map.ids[0]) * count);
+
+    cmdstat_t status = cmdstat_ok;
+    for (i32 i = 0; i < NELEM(kBenchMaps); ++i)
+    {
+        if (!BenchMap(&map, &bk, i))
+        {
+            status = cmdstat_err;
+        }
+    }
+
+    dict_del(&map.dict);
+    sdict_del(&map.sdict);
+    hashset_del(&map.set);
+    table_del(&map.table);
+    pim_free(map.ids);
+    for (i32 i = 0; i < count * 2; ++i)
+    {
+        pim_free(bk.names[i]);
+    }
+    pim_free(bk.keys);
+    pim_free(bk.names);
+    pim_free(bk.guids);
+    return status;
+}
+
+void dict_sys_init(void)
+{
+    cmd_reg("dict_bench", CmdDictBench);
+}
@@ -6,11 +6,12 @@ PIM_C_BEGIN
 
 typedef struct dict_s
 {
-    u32* hashes;
+    u8* ctrl;           // see hash_util.h, width + kHashGroup bytes
     void* keys;
     void* values;
     u32 width;
     u32 count;
+    u32 tombs;
     u32 keySize;
     u32 valueSize;
     EAlloc allocator;
@@ -35,4 +36,7 @@ typedef i32(*DictCmpFn)(
 
 u32* dict_sort(const dict_t* dict, DictCmpFn cmp, void* usr);
 
+// registers dict_bench, which times dict, sdict, hashset and table
+void dict_sys_init(void);
+
 PIM_C_END
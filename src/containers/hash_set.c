@@ -13,103 +13,105 @@ void hashset_new(hashset_t* set, u32 keySize, EAlloc allocator)
 
 void hashset_del(hashset_t* set)
 {
-    pim_free(set->hashes);
-    set->hashes = NULL;
+    pim_free(set->ctrl);
+    set->ctrl = NULL;
     pim_free(set->keys);
     set->keys = NULL;
     set->count = 0;
+    set->tombs = 0;
     set->width = 0;
 }
 
 void hashset_clear(hashset_t* set)
 {
     set->count = 0;
-    if (set->hashes)
+    set->tombs = 0;
+    if (set->ctrl)
     {
-        memset(set->hashes, 0, sizeof(u32) * set->width);
+        memset(set->ctrl, hashutil_ctrl_empty, set->width + kHashGroup);
         memset(set->keys, 0, set->stride * set->width);
     }
 }
 
-void hashset_reserve(hashset_t* set, u32 minCount)
+static void hashset_rehash(hashset_t* set, u32 newWidth)
 {
-    const u32 newWidth = NextPow2(minCount) * 2;
-    const u32 oldWidth = set->width;
-    if (newWidth <= oldWidth)
-    {
-        return;
-    }
-
     const u32 stride = set->stride;
-    u32* newHashes = pim_calloc(set->allocator, sizeof(u32) * newWidth);
+    u8* newCtrl = hashutil_ctrl_new(set->allocator, newWidth);
     u8* newKeys = pim_calloc(set->allocator, stride * newWidth);
 
-    u32* oldHashes = set->hashes;
+    u8* oldCtrl = set->ctrl;
     u8* oldKeys = set->keys;
-    const u32 oldMask = oldWidth - 1u;
-    const u32 newMask = newWidth - 1u;
+    const u32 oldWidth = set->width;
 
     for (u32 i = 0u; i < oldWidth; ++i)
     {
-        const u32 hash = oldHashes[i];
-        if (hashutil_valid(hash))
+        if (hashutil_ctrl_full(oldCtrl[i]))
         {
-            u32 j = hash;
-            while (true)
-            {
-                j &= newMask;
-                if (!newHashes[j])
-                {
-                    newHashes[j] = hash;
-                    memcpy(newKeys + stride * j, oldKeys + stride * i, stride);
-                    break;
-                }
-                ++j;
-            }
+            const u8* key = oldKeys + stride * i;
+            const u64 hash = hashutil_bytes(key, stride);
+            const u32 j = hashutil_find_free(newCtrl, hash, newWidth);
+            hashutil_setctrl(newCtrl, newWidth, j, hashutil_h2(hash));
+            memcpy(newKeys + stride * j, key, stride);
         }
     }
 
-    set->hashes = newHashes;
+    set->ctrl = newCtrl;
     set->keys = newKeys;
     set->width = newWidth;
+    set->tombs = 0;
 
-    pim_free(oldHashes);
+    pim_free(oldCtrl);
     pim_free(oldKeys);
 }
 
-static i32 hashset_find2(const hashset_t* set, u32 keyHash, const void* key, u32 keySize)
+void hashset_reserve(hashset_t* set, u32 minCount)
+{
+    const u32 newWidth = hashutil_width(minCount);
+    if (newWidth > set->width)
+    {
+        hashset_rehash(set, newWidth);
+    }
+}
+
+static i32 hashset_find2(const hashset_t* set, u64 keyHash, const void* key, u32 keySize)
 {
-    const u32* hashes = set->hashes;
-    const u8* keys = set->keys;
+    const u8* pim_noalias ctrl = set->ctrl;
+    const u8* pim_noalias keys = set->keys;
     ASSERT(set->stride == keySize);
 
-    u32 width = set->width;
-    const u32 mask = width - 1u;
+    const u32 width = set->width;
+    if (!width)
+    {
+        return -1;
+    }
 
-    for (u32 j = keyHash; width--; ++j)
+    const u8 h2 = hashutil_h2(keyHash);
+    hashprobe_t probe = hashutil_probe(keyHash, width);
+    while (true)
     {
-        j &= mask;
-        const u32 jHash = hashes[j];
-        if (hashutil_empty(jHash))
-        {
-            break;
-        }
-        if (jHash == keyHash)
+        const u8* group = ctrl + probe.pos;
+        u32 match = hashutil_match(group, h2);
+        while (match)
         {
+            const u32 j = (probe.pos + hashutil_lowbit(match)) & probe.mask;
             const void* heldKey = keys + j * keySize;
             if (!memcmp(key, heldKey, keySize))
             {
                 return (i32)j;
             }
+            match &= match - 1u;
+        }
+        if (hashutil_match_empty(group))
+        {
+            return -1;
         }
+        hashutil_next(&probe);
     }
-
-    return -1;
 }
 
 static i32 hashset_find(const hashset_t* set, const void* key, u32 keySize)
 {
-    const u32 hash = hashutil_hash(key, keySize);
+    const u64 hash = hashutil_bytes(key, keySize);
     return hashset_find2(set, hash, key, keySize);
 }
 
@@ -120,33 +122,30 @@ bool hashset_contains(const hashset_t* set, const void* key, u32 keySize)
 
 bool hashset_add(hashset_t* set, const void* key, u32 keySize)
 {
-    const u32 keyHash = hashutil_hash(key, keySize);
+    const u64 keyHash = hashutil_bytes(key, keySize);
     if (hashset_find2(set, keyHash, key, keySize) != -1)
     {
         return false;
     }
 
-    hashset_reserve(set, set->count + 3u);
+    if (!set->width || hashutil_overloaded(set->width, set->count + set->tombs + 1u))
+    {
+        hashset_rehash(set, hashutil_grow(set->width, set->count));
+    }
 
-    u32* hashes = set->hashes;
+    u8* ctrl = set->ctrl;
     u8* keys = set->keys;
-    const u32 mask = set->width - 1u;
+    const u32 width = set->width;
 
-    u32 j = keyHash;
-    while (true)
+    const u32 j = hashutil_find_free(ctrl, keyHash, width);
+    if (ctrl[j] == hashutil_ctrl_tomb)
     {
-        j &= mask;
-        if (hashutil_empty_or_tomb(hashes[j]))
-        {
-            hashes[j] = keyHash;
-            memcpy(keys + j * keySize, key, keySize);
-            ++(set->count);
-            return true;
-        }
-        ++j;
+        --(set->tombs);
     }
-
-    return false;
+    hashutil_setctrl(ctrl, width, j, hashutil_h2(keyHash));
+    memcpy(keys + j * keySize, key, keySize);
+    ++(set->count);
+    return true;
 }
 
 bool hashset_rm(hashset_t* set, const void* key, u32 keySize)
@@ -154,7 +153,10 @@ bool hashset_rm(hashset_t* set, const void* key, u32 keySize)
     const i32 i = hashset_find(set, key, keySize);
     if (i != -1)
     {
-        set->hashes[i] = hashutil_tomb_mask;
+        if (hashutil_erase(set->ctrl, set->width, (u32)i))
+        {
+            ++(set->tombs);
+        }
         u8* keys = set->keys;
         memset(keys + keySize * i, 0, keySize);
         --(set->count);
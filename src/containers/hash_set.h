@@ -6,9 +6,10 @@ PIM_C_BEGIN
 
 typedef struct hashset_s
 {
-    u32* hashes;
+    u8* ctrl;           // see hash_util.h, width + kHashGroup bytes
     void* keys;
     u32 count;
+    u32 tombs;
     u32 width;
     u32 stride;
     EAlloc allocator;
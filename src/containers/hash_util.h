@@ -1,11 +1,24 @@
 #pragma once
 
 #include "common/macro.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define HASHUTIL_SSE2 1
+#else
+    #define HASHUTIL_SSE2 0
+#endif // SSE2
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif // _MSC_VER
 
 PIM_C_BEGIN
 
 #include "common/fnv1a.h"
 #include "common/nextpow2.h"
+#include "allocator/allocator.h"
 
 #define hashutil_tomb_mask (1u << 31u)
 #define hashutil_hash_mask (~hashutil_tomb_mask)
@@ -50,4 +63,287 @@ static u32 hashutil_hash(const void* key, i32 sizeOf)
     return hashutil_create_hash(Fnv32Bytes(key, sizeOf, Fnv32Bias));
 }
 
+// ----------------------------------------------------------------------------
+// open addressing with a control byte per slot, probed 16 at a time.
+// a full slot holds the low 7 bits of its hash, the rest pick the group.
+// the first 16 control bytes are mirrored past the end, so a group can be
+// loaded at any slot without wrapping.
+
+#define kHashGroup          16
+#define hashutil_ctrl_empty ((u8)0x80)
+#define hashutil_ctrl_tomb  ((u8)0xfe)
+
+// empty and tomb have the high bit set, full slots do not
+pim_inline bool hashutil_ctrl_full(u8 ctrl)
+{
+    return !(ctrl & 0x80);
+}
+
+pim_inline u8 hashutil_h2(u64 hash)
+{
+    return (u8)(hash & 0x7f);
+}
+
+pim_inline u32 hashutil_h1(u64 hash)
+{
+    return (u32)(hash >> 7);
+}
+
+// bitmask of the slots in the group whose control byte equals h2
+pim_inline u32 hashutil_match(const u8* ctrl, u8 h2)
+{
+#if HASHUTIL_SSE2
+    const __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < kHashGroup; ++i)
+    {
+        mask |= (ctrl[i] == h2) ? (1u << i) : 0u;
+    }
+    return mask;
+#endif // HASHUTIL_SSE2
+}
+
+pim_inline u32 hashutil_match_empty(const u8* ctrl)
+{
+    return hashutil_match(ctrl, hashutil_ctrl_empty);
+}
+
+// empty or tomb
+pim_inline u32 hashutil_match_free(const u8* ctrl)
+{
+#if HASHUTIL_SSE2
+    return (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < kHashGroup; ++i)
+    {
+        mask |= (ctrl[i] & 0x80) ? (1u << i) : 0u;
+    }
+    return mask;
+#endif // HASHUTIL_SSE2
+}
+
+pim_inline u32 hashutil_lowbit(u32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctz(mask);
+#endif // _MSC_VER
+}
+
+pim_inline u32 hashutil_highbit(u32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (u32)index;
+#else
+    return 31u - (u32)__builtin_clz(mask);
+#endif // _MSC_VER
+}
+
+pim_inline void hashutil_setctrl(u8* ctrl, u32 width, u32 slot, u8 value)
+{
+    ctrl[slot] = value;
+    if (slot < kHashGroup)
+    {
+        ctrl[width + slot] = value;
+    }
+}
+
+// width is a power of two, at least kHashGroup
+pim_inline u8* hashutil_ctrl_new(EAlloc allocator, u32 width)
+{
+    ASSERT(width >= kHashGroup);
+    u8* ctrl = pim_malloc(allocator, width + kHashGroup);
+    memset(ctrl, hashutil_ctrl_empty, width + kHashGroup);
+    return ctrl;
+}
+
+// frees a full slot. returns true if it had to leave a tomb behind:
+// a slot can only go back to empty if no 16 wide window around it was ever
+// completely full, otherwise a probe may have stepped over it.
+pim_inline bool hashutil_erase(u8* ctrl, u32 width, u32 slot)
+{
+    const u32 mask = width - 1u;
+    const u32 before = hashutil_match_empty(ctrl + ((slot - kHashGroup) & mask));
+    const u32 after = hashutil_match_empty(ctrl + slot);
+    const bool neverFull = before && after &&
+        ((hashutil_lowbit(after) + (kHashGroup - 1u - hashutil_highbit(before))) < kHashGroup);
+    hashutil_setctrl(ctrl, width, slot, neverFull ? hashutil_ctrl_empty : hashutil_ctrl_tomb);
+    return !neverFull;
+}
+
+// smallest table that holds count at a 7/8 load
+pim_inline u32 hashutil_width(u32 count)
+{
+    u32 width = NextPow2(count + (count / 7u) + 1u);
+    return width > kHashGroup ? width : kHashGroup;
+}
+
+// full and tomb slots both lengthen probes, so both count against the load
+pim_inline bool hashutil_overloaded(u32 width, u32 used)
+{
+    return used > (width - (width >> 3));
+}
+
+// width to rebuild at before adding to a table of count items.
+// tombs taking half of the load are cleared at the same width, otherwise the
+// table doubles; either way many adds pass before the next rebuild.
+pim_inline u32 hashutil_grow(u32 width, u32 count)
+{
+    if (width && ((count + 1u) <= ((width - (width >> 3)) >> 1)))
+    {
+        return width;
+    }
+    const u32 needed = hashutil_width(count + 1u);
+    return needed > (width * 2u) ? needed : (width * 2u);
+}
+
+// triangular steps of whole groups reach every group of a power of two width
+typedef struct hashprobe_s
+{
+    u32 pos;
+    u32 step;
+    u32 mask;
+} hashprobe_t;
+
+pim_inline hashprobe_t hashutil_probe(u64 hash, u32 width)
+{
+    hashprobe_t probe;
+    probe.mask = width - 1u;
+    probe.pos = hashutil_h1(hash) & probe.mask;
+    probe.step = 0;
+    return probe;
+}
+
+pim_inline void hashutil_next(hashprobe_t* probe)
+{
+    probe->step += kHashGroup;
+    probe->pos = (probe->pos + probe->step) & probe->mask;
+}
+
+// first empty or tomb slot along the probe sequence
+pim_inline u32 hashutil_find_free(const u8* ctrl, u64 hash, u32 width)
+{
+    hashprobe_t probe = hashutil_probe(hash, width);
+    while (true)
+    {
+        const u32 avail = hashutil_match_free(ctrl + probe.pos);
+        if (avail)
+        {
+            return (probe.pos + hashutil_lowbit(avail)) & probe.mask;
+        }
+        hashutil_next(&probe);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// wyhash style mixing: one 64x64->128 multiply per 16 bytes,
+// where fnv1a spends a multiply per byte
+
+#define kHashP0 0xa0761d6478bd642full
+#define kHashP1 0xe7037ed1a0b428dbull
+#define kHashP2 0x8ebc6af09c88c6e3ull
+
+pim_inline u64 hashutil_mum(u64 a, u64 b)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    u64 hi;
+    const u64 lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#elif defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)a * b;
+    return (u64)r ^ (u64)(r >> 64);
+#else
+    const u64 lo = (a & 0xffffffff) * (b & 0xffffffff);
+    const u64 mid0 = (a >> 32) * (b & 0xffffffff);
+    const u64 mid1 = (a & 0xffffffff) * (b >> 32);
+    const u64 hi = (a >> 32) * (b >> 32);
+    const u64 mid = (lo >> 32) + (mid0 & 0xffffffff) + (mid1 & 0xffffffff);
+    return ((lo & 0xffffffff) | (mid << 32)) ^ (hi + (mid0 >> 32) + (mid1 >> 32) + (mid >> 32));
+#endif // _MSC_VER && _M_X64
+}
+
+// ascii upper case to lower case, 8 bytes at a time
+pim_inline u64 hashutil_fold(u64 x)
+{
+    const u64 lo7 = x & 0x7f7f7f7f7f7f7f7full;
+    const u64 geA = lo7 + 0x3f3f3f3f3f3f3f3full;    // lo7 >= 'A'
+    const u64 gtZ = lo7 + 0x2525252525252525ull;    // lo7 > 'Z'
+    const u64 upper = geA & ~gtZ & ~x & 0x8080808080808080ull;
+    return x | (upper >> 2);
+}
+
+pim_inline u64 hashutil_read64(const u8* p, bool fold)
+{
+    u64 x;
+    memcpy(&x, p, sizeof(x));
+    return fold ? hashutil_fold(x) : x;
+}
+
+pim_inline u64 hashutil_read32(const u8* p, bool fold)
+{
+    u32 x;
+    memcpy(&x, p, sizeof(x));
+    return fold ? hashutil_fold(x) : x;
+}
+
+pim_inline u64 hashutil_mix(const void* ptr, i32 nBytes, u64 seed, bool fold)
+{
+    ASSERT(ptr || !nBytes);
+    ASSERT(nBytes >= 0);
+    const u8* p = ptr;
+    u64 h = seed ^ kHashP0;
+    i32 n = nBytes;
+    while (n > 16)
+    {
+        h = hashutil_mum(hashutil_read64(p, fold) ^ kHashP1, hashutil_read64(p + 8, fold) ^ h);
+        p += 16;
+        n -= 16;
+    }
+    // the last 1 to 16 bytes, read as two overlapping halves
+    u64 a = 0;
+    u64 b = 0;
+    if (n > 8)
+    {
+        a = hashutil_read64(p, fold);
+        b = hashutil_read64(p + n - 8, fold);
+    }
+    else if (n >= 4)
+    {
+        a = hashutil_read32(p, fold);
+        b = hashutil_read32(p + n - 4, fold);
+    }
+    else if (n > 0)
+    {
+        a = ((u64)p[0] << 16) | ((u64)p[n >> 1] << 8) | p[n - 1];
+        a = fold ? hashutil_fold(a) : a;
+    }
+    return hashutil_mum(kHashP2 ^ (u64)nBytes, hashutil_mum(a ^ kHashP1, b ^ h));
+}
+
+static u64 hashutil_bytes(const void* ptr, i32 nBytes)
+{
+    return hashutil_mix(ptr, nBytes, 0, false);
+}
+
+// case insensitive, to agree with StrCmp
+static u64 hashutil_stri(const char* str)
+{
+    ASSERT(str);
+    return hashutil_mix(str, (i32)strlen(str), 0, true);
+}
+
+// guids are hashes already, this only folds both halves into the slot bits
+pim_inline u64 hashutil_guid(u64 a, u64 b)
+{
+    return hashutil_mum(a ^ kHashP0, b ^ kHashP1);
+}
+
 PIM_C_END
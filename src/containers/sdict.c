@@ -5,10 +5,10 @@
 #include "common/sort.h"
 #include <string.h>
 
-static u32 HashKey(const char* key)
+static u64 HashKey(const char* key)
 {
     ASSERT(key);
-    return hashutil_create_hash(HashStr(key));
+    return hashutil_stri(key);
 }
 
 void sdict_new(sdict_t* dict, u32 valueSize, EAlloc allocator)
@@ -23,7 +23,7 @@ void sdict_new(sdict_t* dict, u32 valueSize, EAlloc allocator)
 void sdict_del(sdict_t* dict)
 {
     ASSERT(dict);
-    pim_free(dict->hashes);
+    pim_free(dict->ctrl);
     char** keys = dict->keys;
     const u32 width = dict->width;
     for (u32 i = 0; i < width; ++i)
@@ -40,115 +40,113 @@ void sdict_clear(sdict_t* dict)
 {
     ASSERT(dict);
     dict->count = 0;
+    dict->tombs = 0;
     const u32 width = dict->width;
-    char** keys = dict->keys;
-    for (u32 i = 0; i < width; ++i)
+    if (width)
     {
-        pim_free(keys[i]);
-        keys[i] = NULL;
+        char** keys = dict->keys;
+        for (u32 i = 0; i < width; ++i)
+        {
+            pim_free(keys[i]);
+            keys[i] = NULL;
+        }
+        memset(dict->ctrl, hashutil_ctrl_empty, width + kHashGroup);
+        memset(dict->values, 0, dict->valueSize * width);
     }
-    memset(dict->hashes, 0, sizeof(dict->hashes[0]) * width);
-    memset(dict->values, 0, dict->valueSize * width);
 }
 
-void sdict_reserve(sdict_t* dict, i32 count)
+static void Rehash(sdict_t* dict, u32 newWidth)
 {
-    ASSERT(dict);
-
-    count = count > 16 ? count : 16;
-    const u32 newWidth = NextPow2((u32)count) * 2;
-    const u32 oldWidth = dict->width;
-    if (newWidth <= oldWidth)
-    {
-        return;
-    }
-
     const u32 valueSize = dict->valueSize;
     const EAlloc allocator = dict->allocator;
     ASSERT(valueSize);
 
-    u32* oldHashes = dict->hashes;
+    const u32 oldWidth = dict->width;
+    u8* oldCtrl = dict->ctrl;
     char** oldKeys = dict->keys;
     u8* oldValues = dict->values;
 
-    u32* newHashes = pim_malloc(allocator, sizeof(newHashes[0]) * newWidth);
-    char** newKeys = pim_malloc(allocator, sizeof(newKeys[0]) * newWidth);
-    u8* newValues = pim_malloc(allocator, valueSize * newWidth);
+    u8* newCtrl = hashutil_ctrl_new(allocator, newWidth);
+    char** newKeys = pim_calloc(allocator, sizeof(newKeys[0]) * newWidth);
+    u8* newValues = pim_calloc(allocator, valueSize * newWidth);
 
-    memset(newHashes, 0, sizeof(newHashes[0]) * newWidth);
-    memset(newKeys, 0, sizeof(newKeys[0]) * newWidth);
-    memset(newValues, 0, valueSize * newWidth);
-
-    const u32 newMask = newWidth - 1u;
-    for (u32 i = 0; i < oldWidth;)
+    for (u32 i = 0; i < oldWidth; ++i)
     {
-        const u32 hash = oldHashes[i];
-        if (hashutil_valid(hash))
+        if (hashutil_ctrl_full(oldCtrl[i]))
         {
-            u32 j = hash;
-            while (true)
-            {
-                j &= newMask;
-                if (!newHashes[j])
-                {
-                    newHashes[j] = hash;
-                    newKeys[j] = oldKeys[i];
-                    oldKeys[i] = NULL;
-                    memcpy(newValues + j * valueSize, oldValues + i * valueSize, valueSize);
-                    goto next;
-                }
-                ++j;
-            }
+            const u64 hash = HashKey(oldKeys[i]);
+            const u32 j = hashutil_find_free(newCtrl, hash, newWidth);
+            hashutil_setctrl(newCtrl, newWidth, j, hashutil_h2(hash));
+            newKeys[j] = oldKeys[i];
+            oldKeys[i] = NULL;
+            memcpy(newValues + j * valueSize, oldValues + i * valueSize, valueSize);
         }
-    next:
-        ++i;
     }
 
-    pim_free(oldHashes);
+    pim_free(oldCtrl);
     pim_free(oldKeys);
     pim_free(oldValues);
 
     dict->width = newWidth;
-    dict->hashes = newHashes;
+    dict->tombs = 0;
+    dict->ctrl = newCtrl;
     dict->keys = newKeys;
     dict->values = newValues;
 }
 
-i32 sdict_find(const sdict_t* dict, const char* key)
+void sdict_reserve(sdict_t* dict, i32 count)
 {
     ASSERT(dict);
-    if (!key || !key[0])
+
+    const u32 newWidth = hashutil_width(count > 0 ? (u32)count : 0u);
+    if (newWidth > dict->width)
     {
-        return -1;
+        Rehash(dict, newWidth);
     }
+}
 
-    const u32 keyHash = HashKey(key);
+static i32 FindSlot(const sdict_t* dict, const char* key, u64 keyHash)
+{
+    const u32 width = dict->width;
+    if (!width)
+    {
+        return -1;
+    }
 
-    u32 width = dict->width;
-    const u32 mask = width - 1u;
-    const u32* hashes = dict->hashes;
+    const u8* pim_noalias ctrl = dict->ctrl;
     const char** keys = dict->keys;
+    const u8 h2 = hashutil_h2(keyHash);
 
-    u32 j = keyHash;
-    while (width--)
+    hashprobe_t probe = hashutil_probe(keyHash, width);
+    while (true)
     {
-        j &= mask;
-        const u32 jHash = hashes[j];
-        if (hashutil_empty(jHash))
-        {
-            break;
-        }
-        if (jHash == keyHash)
+        const u8* group = ctrl + probe.pos;
+        u32 match = hashutil_match(group, h2);
+        while (match)
         {
+            const u32 j = (probe.pos + hashutil_lowbit(match)) & probe.mask;
             if (StrCmp(key, PIM_PATH, keys[j]) == 0)
             {
                 return (i32)j;
             }
+            match &= match - 1u;
         }
-        ++j;
+        if (hashutil_match_empty(group))
+        {
+            return -1;
+        }
+        hashutil_next(&probe);
     }
+}
 
-    return -1;
+i32 sdict_find(const sdict_t* dict, const char* key)
+{
+    ASSERT(dict);
+    if (!key || !key[0])
+    {
+        return -1;
+    }
+    return FindSlot(dict, key, HashKey(key));
 }
 
 bool sdict_get(const sdict_t* dict, const char* key, void* valueOut)
@@ -199,35 +197,34 @@ bool sdict_add(sdict_t* dict, const char* key, const void* value)
     {
         return false;
     }
-    if (sdict_find(dict, key) != -1)
+    const u64 keyHash = HashKey(key);
+    if (FindSlot(dict, key, keyHash) != -1)
     {
         return false;
     }
 
-    sdict_reserve(dict, dict->count + 1);
-    dict->count++;
+    if (!dict->width || hashutil_overloaded(dict->width, dict->count + dict->tombs + 1))
+    {
+        Rehash(dict, hashutil_grow(dict->width, dict->count));
+    }
 
-    const u32 mask = dict->width - 1u;
+    const u32 width = dict->width;
     const u32 valueSize = dict->valueSize;
-    const u32 keyHash = HashKey(key);
-
-    u32* hashes = dict->hashes;
+    u8* pim_noalias ctrl = dict->ctrl;
     char** keys = dict->keys;
     u8* values = dict->values;
 
-    u32 j = keyHash;
-    while (true)
+    const u32 j = hashutil_find_free(ctrl, keyHash, width);
+    if (ctrl[j] == hashutil_ctrl_tomb)
     {
-        j &= mask;
-        if (hashutil_empty_or_tomb(hashes[j]))
-        {
-            hashes[j] = keyHash;
-            keys[j] = StrDup(key, dict->allocator);
-            memcpy(values + j * valueSize, value, valueSize);
-            return true;
-        }
-        ++j;
+        dict->tombs--;
     }
+    hashutil_setctrl(ctrl, width, j, hashutil_h2(keyHash));
+    keys[j] = StrDup(key, dict->allocator);
+    memcpy(values + j * valueSize, value, valueSize);
+    dict->count++;
+
+    return true;
 }
 
 bool sdict_rm(sdict_t* dict, const char* key, void* valueOut)
@@ -243,7 +240,6 @@ bool sdict_rm(sdict_t* dict, const char* key, void* valueOut)
     const u32 valueSize = dict->valueSize;
     ASSERT(valueSize);
 
-    u32* hashes = dict->hashes;
     char** keys = dict->keys;
     u8* values = dict->values;
 
@@ -252,7 +248,10 @@ bool sdict_rm(sdict_t* dict, const char* key, void* valueOut)
         memcpy(valueOut, values + i * valueSize, valueSize);
     }
 
-    hashes[i] |= hashutil_tomb_mask;
+    if (hashutil_erase(dict->ctrl, dict->width, (u32)i))
+    {
+        dict->tombs++;
+    }
     pim_free(keys[i]);
     keys[i] = NULL;
     memset(values + i * valueSize, 0, valueSize);
@@ -292,12 +291,12 @@ u32* sdict_sort(const sdict_t* dict, SDictCmpFn cmp, void* usr)
 
     const u32 length = dict->count;
     const u32 width = dict->width;
-    const u32* hashes = dict->hashes;
+    const u8* ctrl = dict->ctrl;
     u32* indices = tmp_calloc(length * sizeof(indices[0]));
     u32 j = 0;
     for (u32 i = 0; i < width; ++i)
     {
-        if (hashutil_valid(hashes[i]))
+        if (hashutil_ctrl_full(ctrl[i]))
         {
             indices[j++] = i;
         }
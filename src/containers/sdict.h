@@ -6,11 +6,12 @@ PIM_C_BEGIN
 
 typedef struct sdict_s
 {
-    u32* hashes;
-    char** keys;
+    u8* ctrl;           // see hash_util.h, width + kHashGroup bytes
+    char** keys;        // null where the slot is not full
     void* values;
     u32 width;
     u32 count;
+    u32 tombs;
     u32 valueSize;
     EAlloc allocator;
 } sdict_t;
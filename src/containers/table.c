@@ -1,81 +1,107 @@
 #include "containers/table.h"
 #include "allocator/allocator.h"
-#include "common/fnv1a.h"
+#include "containers/hash_util.h"
+#include "common/atomics.h"
+#include "common/cmd.h"
+#include "common/console.h"
 #include "common/find.h"
+#include "common/random.h"
 #include "common/stringutil.h"
+#include "common/time.h"
 #include "common/nextpow2.h"
 #include "math/int2_funcs.h"
+#include "threading/epoch.h"
+#include "threading/intrin.h"
+#include "threading/task.h"
 #include <string.h>
+#include <stdlib.h>
 
-#define kEmpty  -1
-#define kTomb   -2
+// ----------------------------------------------------------------------------
+// readers load each array once per call. writers publish a grown array
+// before storing the width or a lookup slot that refers into it, and retire
+// the old one through the epoch, so any array a reader loaded stays valid.
 
-pim_inline void LookupReserve(table_t* table, i32 capacity)
+pim_inline u64 HashName(guid_t name)
 {
-    const u32 newWidth = NextPow2(capacity) * 4;
-    const u32 oldWidth = table->lookupWidth;
-    if (newWidth <= oldWidth)
-    {
-        return;
-    }
+    return hashutil_guid(name.a, name.b);
+}
 
-    i32* pim_noalias newIndices = perm_malloc(sizeof(newIndices[0]) * newWidth);
-    i32* pim_noalias oldIndices = table->lookup;
-    const guid_t* pim_noalias names = table->names;
+static tablelookup_t* LookupNew(u32 width)
+{
+    // one allocation so readers see width, ctrl and indices together
+    const i32 bytes = sizeof(tablelookup_t) + sizeof(i32) * width + width + kHashGroup;
+    tablelookup_t* lookup = perm_malloc(bytes);
+    lookup->width = width;
+    lookup->indices = (i32*)(lookup + 1);
+    lookup->ctrl = (u8*)(lookup->indices + width);
+    memset(lookup->ctrl, hashutil_ctrl_empty, width + kHashGroup);
+    return lookup;
+}
 
-    for (u32 i = 0; i < newWidth; ++i)
-    {
-        newIndices[i] = kEmpty;
-    }
+static void LookupRehash(table_t* table, u32 newWidth)
+{
+    tablelookup_t* newLookup = LookupNew(newWidth);
+    u8* pim_noalias newCtrl = newLookup->ctrl;
+    i32* pim_noalias newIndices = newLookup->indices;
+    const guid_t* pim_noalias names = table->names;
 
-    const u32 newMask = newWidth - 1u;
-    for (u32 i = 0; i < oldWidth; ++i)
+    tablelookup_t* oldLookup = table->lookup;
+    if (oldLookup)
     {
-        i32 index = oldIndices[i];
-        if (index >= 0)
+        const u8* pim_noalias oldCtrl = oldLookup->ctrl;
+        const i32* pim_noalias oldIndices = oldLookup->indices;
+        const u32 oldWidth = oldLookup->width;
+        for (u32 i = 0; i < oldWidth; ++i)
         {
-            u32 j = guid_hashof(names[index]);
-            while (true)
+            if (hashutil_ctrl_full(oldCtrl[i]))
             {
-                j &= newMask;
-                if (newIndices[j] < 0)
-                {
-                    newIndices[j] = index;
-                    break;
-                }
-                ++j;
+                const i32 index = oldIndices[i];
+                const u64 hash = HashName(names[index]);
+                const u32 j = hashutil_find_free(newCtrl, hash, newWidth);
+                hashutil_setctrl(newCtrl, newWidth, j, hashutil_h2(hash));
+                newIndices[j] = index;
             }
         }
     }
 
-    table->lookup = newIndices;
-    table->lookupWidth = newWidth;
+    table->lookupTombs = 0;
+    StorePtr(tablelookup_t, table->lookup, newLookup, MO_Release);
+    epoch_free(oldLookup);
+}
 
-    pim_free(oldIndices);
+// control bytes are stored after the index they guard
+pim_inline void LookupSetCtrl(tablelookup_t* lookup, u32 slot, u8 value)
+{
+    store_u8(lookup->ctrl + slot, value, MO_Release);
+    if (slot < kHashGroup)
+    {
+        store_u8(lookup->ctrl + lookup->width + slot, value, MO_Release);
+    }
 }
 
 pim_inline i32 LookupInsert(table_t* table, i32 iTable, guid_t name)
 {
     ASSERT(iTable >= 0);
     ASSERT(iTable < table->width);
-    LookupReserve(table, table->itemCount + 1);
+
+    const u32 width = table->lookup ? table->lookup->width : 0u;
+    const u32 used = (u32)(table->itemCount + table->lookupTombs + 1);
+    if (!width || hashutil_overloaded(width, used))
+    {
+        LookupRehash(table, hashutil_grow(width, (u32)table->itemCount));
+    }
     table->itemCount += 1;
 
-    const u32 mask = table->lookupWidth - 1u;
-    i32* pim_noalias lookup = table->lookup;
-    u32 iLookup = guid_hashof(name);
-    while (true)
+    tablelookup_t* lookup = table->lookup;
+    const u64 hash = HashName(name);
+    const u32 iLookup = hashutil_find_free(lookup->ctrl, hash, lookup->width);
+    if (lookup->ctrl[iLookup] == hashutil_ctrl_tomb)
     {
-        iLookup &= mask;
-        // if empty or tombstone
-        if (lookup[iLookup] < 0)
-        {
-            lookup[iLookup] = iTable;
-            return (i32)iLookup;
-        }
-        ++iLookup;
+        table->lookupTombs -= 1;
     }
-    return -1;
+    lookup->indices[iLookup] = iTable;
+    LookupSetCtrl(lookup, iLookup, hashutil_h2(hash));
+    return (i32)iLookup;
 }
 
 pim_inline bool LookupFind(
@@ -89,59 +115,155 @@ pim_inline bool LookupFind(
     *iTableOut = -1;
     *iLookupOut = -1;
 
-    const u32 width = table->lookupWidth;
-    const u32 mask = width - 1u;
+    const tablelookup_t* lookup = LoadPtr(const tablelookup_t, table->lookup, MO_Acquire);
+    if (!lookup)
+    {
+        return false;
+    }
 
-    const guid_t* pim_noalias names = table->names;
-    const i32* pim_noalias lookup = table->lookup;
-    const u32 hash = guid_hashof(name);
+    const u32 width = lookup->width;
+    const u8* pim_noalias ctrl = lookup->ctrl;
+    const i32* pim_noalias indices = lookup->indices;
+    const u64 hash = HashName(name);
+    const u8 h2 = hashutil_h2(hash);
 
-    for (u32 i = 0; i < width; ++i)
+    hashprobe_t probe = hashutil_probe(hash, width);
+    while (true)
     {
-        const u32 iLookup = (hash + i) & mask;
-        const i32 iTable = lookup[iLookup];
-        // if empty
-        if (iTable == kEmpty)
+        const u8* group = ctrl + probe.pos;
+        u32 match = hashutil_match(group, h2);
+        while (match)
         {
-            break;
-        }
-        // if not a tombstone
-        if (iTable >= 0)
-        {
-            ASSERT(iTable < table->width);
+            // pairs with the release store of the control byte; the names
+            // array must be loaded after it to cover the index
+            ThreadFenceAcquire();
+            const u32 iLookup = (probe.pos + hashutil_lowbit(match)) & probe.mask;
+            const i32 iTable = indices[iLookup];
+            const guid_t* pim_noalias names = LoadPtr(const guid_t, table->names, MO_Acquire);
             if (guid_eq(name, names[iTable]))
             {
                 *iTableOut = iTable;
                 *iLookupOut = (i32)iLookup;
                 return true;
             }
+            match &= match - 1u;
+        }
+        if (hashutil_match_empty(group))
+        {
+            return false;
         }
+        hashutil_next(&probe);
     }
-
-    return false;
 }
 
 pim_inline void LookupRemove(table_t* table, i32 iTable, i32 iLookup)
 {
     if (iLookup >= 0)
     {
+        tablelookup_t* lookup = table->lookup;
         ASSERT(iTable >= 0);
-        ASSERT((u32)iLookup < table->lookupWidth);
-        table->lookup[iLookup] = kTomb;
+        ASSERT((u32)iLookup < lookup->width);
+        const u32 slot = (u32)iLookup;
+        const u32 mask = lookup->width - 1u;
+        const u32 before = hashutil_match_empty(lookup->ctrl + ((slot - kHashGroup) & mask));
+        const u32 after = hashutil_match_empty(lookup->ctrl + slot);
+        // same rule as hashutil_erase, with stores readers can race
+        const bool neverFull = before && after &&
+            ((hashutil_lowbit(after) + (kHashGroup - 1u - hashutil_highbit(before))) < kHashGroup);
+        LookupSetCtrl(lookup, slot, neverFull ? hashutil_ctrl_empty : hashutil_ctrl_tomb);
+        if (!neverFull)
+        {
+            table->lookupTombs += 1;
+        }
         table->itemCount -= 1;
     }
 }
 
 pim_inline void LookupClear(table_t* table)
 {
-    const u32 width = table->lookupWidth;
-    i32* pim_noalias lookup = table->lookup;
-    for (u32 i = 0; i < width; ++i)
+    if (table->lookup)
     {
-        lookup[i] = kEmpty;
+        // readers may be probing the current one
+        LookupRehash(table, table->lookup->width);
     }
+    table->lookupTombs = 0;
 }
 
+// ----------------------------------------------------------------------------
+
+pim_inline void* GrowArray(void* prev, i32 oldBytes, i32 newBytes)
+{
+    u8* next = perm_calloc(newBytes);
+    if (oldBytes > 0)
+    {
+        memcpy(next, prev, oldBytes);
+    }
+    return next;
+}
+
+// arrays readers see are copied rather than reallocated in place
+static void Grow(table_t* table, i32 minCapacity)
+{
+    const i32 oldCap = table->capacity;
+    if (minCapacity <= oldCap)
+    {
+        return;
+    }
+    i32 newCap = oldCap > 0 ? oldCap * 2 : 16;
+    newCap = newCap > minCapacity ? newCap : minCapacity;
+
+    const i32 stride = table->valueSize;
+    u8* versions = GrowArray(table->versions, oldCap, newCap);
+    u8* values = GrowArray(table->values, oldCap * stride, newCap * stride);
+    guid_t* names = GrowArray(table->names, oldCap * sizeof(guid_t), newCap * sizeof(guid_t));
+    u32* sequences = GrowArray(table->sequences, oldCap * sizeof(u32), newCap * sizeof(u32));
+    // only writers read refcounts
+    table->refcounts = perm_realloc(table->refcounts, sizeof(table->refcounts[0]) * newCap);
+
+    // publish before retiring, a reader must not find a retired array
+    void* oldVersions = table->versions;
+    void* oldValues = table->values;
+    void* oldNames = table->names;
+    void* oldSequences = table->sequences;
+    StorePtr(u8, table->versions, versions, MO_Release);
+    StorePtr(u8, table->values, values, MO_Release);
+    StorePtr(guid_t, table->names, names, MO_Release);
+    StorePtr(u32, table->sequences, sequences, MO_Release);
+    table->capacity = newCap;
+    epoch_free(oldVersions);
+    epoch_free(oldValues);
+    epoch_free(oldNames);
+    epoch_free(oldSequences);
+}
+
+// a seqlock per slot: odd while the writer edits it
+pim_inline void BeginWrite(table_t* table, i32 index)
+{
+    u32* sequences = table->sequences;
+    store_u32(sequences + index, sequences[index] + 1u, MO_Relaxed);
+    ThreadFenceRelease();
+}
+
+pim_inline void EndWrite(table_t* table, i32 index)
+{
+    u32* sequences = table->sequences;
+    store_u32(sequences + index, sequences[index] + 1u, MO_Release);
+}
+
+pim_inline bool Exists(const table_t* table, genid id)
+{
+    // width is stored after the arrays that cover it
+    const i32 width = load_i32(&table->width, MO_Acquire);
+    if ((i32)id.index >= width)
+    {
+        return false;
+    }
+    const u8* pim_noalias versions = LoadPtr(const u8, table->versions, MO_Acquire);
+    return load_u8(versions + id.index, MO_Relaxed) == id.version;
+}
+
+// ----------------------------------------------------------------------------
+
 void table_new(table_t* table, i32 valueSize)
 {
     ASSERT(table);
@@ -150,6 +272,7 @@ void table_new(table_t* table, i32 valueSize)
     memset(table, 0, sizeof(*table));
     table->valueSize = valueSize;
     queue_create(&table->freelist, sizeof(i32), EAlloc_Perm);
+    mutex_create(&table->writeLock);
 }
 
 void table_del(table_t* table)
@@ -157,10 +280,12 @@ void table_del(table_t* table)
     if (table)
     {
         queue_destroy(&table->freelist);
+        mutex_destroy(&table->writeLock);
         pim_free(table->versions);
         pim_free(table->values);
         pim_free(table->refcounts);
         pim_free(table->names);
+        pim_free(table->sequences);
         pim_free(table->lookup);
         memset(table, 0, sizeof(*table));
     }
@@ -168,24 +293,22 @@ void table_del(table_t* table)
 
 void table_clear(table_t* table)
 {
+    mutex_lock(&table->writeLock);
     const i32 len = table->width;
-    table->width = 0;
+    store_i32(&table->width, 0, MO_Release);
     table->itemCount = 0;
     memset(table->versions, 0, sizeof(table->versions[0]) * len);
     memset(table->refcounts, 0, sizeof(table->refcounts[0]) * len);
     memset(table->names, 0, sizeof(table->names[0]) * len);
     queue_clear(&table->freelist);
     LookupClear(table);
+    mutex_unlock(&table->writeLock);
 }
 
 bool table_exists(const table_t* table, genid id)
 {
-    const u8* pim_noalias versions = table->versions;
-    i32 index = id.index;
-    u8 version = id.version;
     ASSERT(table->valueSize > 0);
-    ASSERT(index < table->width);
-    return versions[index] == version;
+    return Exists(table, id);
 }
 
 bool table_add(table_t* table, guid_t name, const void* valueIn, genid* idOut)
@@ -201,40 +324,45 @@ bool table_add(table_t* table, guid_t name, const void* valueIn, genid* idOut)
         return false;
     }
 
+    mutex_lock(&table->writeLock);
+
     if (table_find(table, name, idOut))
     {
-        table_retain(table, *idOut);
+        table->refcounts[idOut->index] += 1;
+        mutex_unlock(&table->writeLock);
         return false;
     }
 
     const i32 stride = table->valueSize;
     i32 index = 0;
-    u8 version = 0;
-    if (!queue_trypop(&table->freelist, &index, sizeof(index)))
+    const bool reused = queue_trypop(&table->freelist, &index, sizeof(index));
+    if (!reused)
     {
-        table->width += 1;
-        const i32 len = table->width;
-        PermReserve(table->versions, len);
-        PermReserve(table->refcounts, len);
-        PermReserve(table->names, len);
-        table->values = perm_realloc(table->values, len * stride);
-
-        index = len - 1;
-        version = 1;
-        table->versions[index] = version;
+        index = table->width;
+        Grow(table, index + 1);
+        table->versions[index] = 1;
     }
     ASSERT(index >= 0);
-    ASSERT(index < table->width);
+    ASSERT(index < table->capacity);
 
-    version = table->versions[index];
+    const u8 version = table->versions[index];
     table->refcounts[index] = 1;
-    table->names[index] = name;
 
+    BeginWrite(table, index);
+    table->names[index] = name;
     u8* pValues = table->values;
     memcpy(pValues + index * stride, valueIn, stride);
+    EndWrite(table, index);
+
+    if (!reused)
+    {
+        store_i32(&table->width, index + 1, MO_Release);
+    }
 
     LookupInsert(table, index, name);
 
+    mutex_unlock(&table->writeLock);
+
     idOut->index = index;
     idOut->version = version;
 
@@ -243,21 +371,25 @@ bool table_add(table_t* table, guid_t name, const void* valueIn, genid* idOut)
 
 bool table_retain(table_t* table, genid id)
 {
-    if (table_exists(table, id))
+    bool retained = false;
+    mutex_lock(&table->writeLock);
+    if (Exists(table, id))
     {
         ASSERT(table->refcounts[id.index] > 0);
         table->refcounts[id.index] += 1;
-        return true;
+        retained = true;
     }
-    return false;
+    mutex_unlock(&table->writeLock);
+    return retained;
 }
 
 bool table_release(table_t* table, genid id, void* valueOut)
 {
-    if (table_exists(table, id))
+    bool released = false;
+    mutex_lock(&table->writeLock);
+    if (Exists(table, id))
     {
         const i32 index = id.index;
-        const i32 version = id.version;
 
         ASSERT(table->refcounts[index] > 0);
         table->refcounts[index] -= 1;
@@ -276,8 +408,9 @@ bool table_release(table_t* table, genid id, void* valueOut)
 
             LookupRemove(table, iTable, iLookup);
 
+            BeginWrite(table, index);
             table->names[index] = (guid_t) { 0 };
-            table->versions[index] += 1;
+            store_u8(table->versions + index, table->versions[index] + 1, MO_Relaxed);
             {
                 i32 stride = table->valueSize;
                 u8* pValue = table->values;
@@ -288,41 +421,79 @@ bool table_release(table_t* table, genid id, void* valueOut)
                 }
                 memset(pValue, 0, stride);
             }
+            EndWrite(table, index);
 
             queue_push(&table->freelist, &index, sizeof(index));
 
-            return true;
+            released = true;
         }
     }
-    return false;
+    mutex_unlock(&table->writeLock);
+    return released;
 }
 
 bool table_get(const table_t* table, genid id, void* valueOut)
 {
     ASSERT(valueOut);
-    if (table_exists(table, id))
+    const i32 width = load_i32(&table->width, MO_Acquire);
+    const i32 index = id.index;
+    if (index >= width)
     {
-        i32 index = id.index;
-        i32 stride = table->valueSize;
-        const u8* pValues = table->values;
-        memcpy(valueOut, pValues + stride * index, stride);
-        return true;
+        return false;
+    }
+
+    const i32 stride = table->valueSize;
+    const u8* pim_noalias versions = LoadPtr(const u8, table->versions, MO_Acquire);
+    const u8* pim_noalias values = LoadPtr(const u8, table->values, MO_Acquire);
+    const u32* pim_noalias sequences = LoadPtr(const u32, table->sequences, MO_Acquire);
+    u64 spins = 0;
+    while (true)
+    {
+        const u32 seq = load_u32(sequences + index, MO_Acquire);
+        if (seq & 1u)
+        {
+            intrin_spin(++spins);
+            continue;
+        }
+        if (load_u8(versions + index, MO_Relaxed) != id.version)
+        {
+            return false;
+        }
+        memcpy(valueOut, values + stride * index, stride);
+        ThreadFenceAcquire();
+        if (load_u32(sequences + index, MO_Relaxed) == seq)
+        {
+            return true;
+        }
     }
-    return false;
 }
 
 bool table_set(table_t* table, genid id, const void* valueIn)
+{
+    return table_swap(table, id, valueIn, NULL);
+}
+
+bool table_swap(table_t* table, genid id, const void* valueIn, void* valueOut)
 {
     ASSERT(valueIn);
-    if (table_exists(table, id))
+    bool set = false;
+    mutex_lock(&table->writeLock);
+    if (Exists(table, id))
     {
         i32 index = id.index;
         i32 stride = table->valueSize;
         u8* pValues = table->values;
+        BeginWrite(table, index);
+        if (valueOut)
+        {
+            memcpy(valueOut, pValues + stride * index, stride);
+        }
         memcpy(pValues + stride * index, valueIn, stride);
-        return true;
+        EndWrite(table, index);
+        set = true;
     }
-    return false;
+    mutex_unlock(&table->writeLock);
+    return set;
 }
 
 bool table_find(const table_t* table, guid_t name, genid* idOut)
@@ -341,8 +512,9 @@ bool table_find(const table_t* table, guid_t name, genid* idOut)
     i32 iTable, iLookup;
     if (LookupFind(table, name, &iTable, &iLookup))
     {
+        const u8* pim_noalias versions = LoadPtr(const u8, table->versions, MO_Acquire);
         idOut->index = iTable;
-        idOut->version = table->versions[iTable];
+        idOut->version = load_u8(versions + iTable, MO_Relaxed);
         return true;
     }
     return false;
@@ -353,11 +525,203 @@ bool table_getname(const table_t* table, genid id, guid_t* nameOut)
     ASSERT(nameOut);
     nameOut->a = 0;
     nameOut->b = 0;
-    if (table_exists(table, id))
+    const i32 width = load_i32(&table->width, MO_Acquire);
+    const i32 index = id.index;
+    if (index >= width)
     {
-        i32 index = id.index;
-        *nameOut = table->names[index];
-        return true;
+        return false;
     }
-    return false;
+
+    const u8* pim_noalias versions = LoadPtr(const u8, table->versions, MO_Acquire);
+    const guid_t* pim_noalias names = LoadPtr(const guid_t, table->names, MO_Acquire);
+    const u32* pim_noalias sequences = LoadPtr(const u32, table->sequences, MO_Acquire);
+    u64 spins = 0;
+    while (true)
+    {
+        const u32 seq = load_u32(sequences + index, MO_Acquire);
+        if (seq & 1u)
+        {
+            intrin_spin(++spins);
+            continue;
+        }
+        if (load_u8(versions + index, MO_Relaxed) != id.version)
+        {
+            return false;
+        }
+        *nameOut = names[index];
+        ThreadFenceAcquire();
+        if (load_u32(sequences + index, MO_Relaxed) == seq)
+        {
+            return true;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// table_bench
+
+typedef struct benchvalue_s
+{
+    u64 key;
+    u64 gen;
+    u64 check;
+} benchvalue_t;
+
+pim_inline u64 BenchCheck(u64 key, u64 gen)
+{
+    return (key ^ 0x9e3779b97f4a7c15ull) * ((gen << 1) | 1ull);
+}
+
+typedef struct task_TableRead
+{
+    task_t task;
+    const table_t* table;
+    const guid_t* names;
+    i32 nameCount;
+    i32 hits;
+    i32 torn;
+    i32 stale;
+} task_TableRead;
+
+#define kReadsPerItem 1024
+
+// what texture_get and mesh_get see from a task: a find by name, then a copy
+static void TableReadFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_TableRead* task = (task_TableRead*)pbase;
+    const table_t* table = task->table;
+    const guid_t* names = task->names;
+    const u32 nameCount = (u32)task->nameCount;
+    prng_t rng = prng_get();
+    i32 hits = 0;
+    i32 torn = 0;
+    i32 stale = 0;
+    for (i32 i = begin; i < end; ++i)
+    {
+        for (i32 j = 0; j < kReadsPerItem; ++j)
+        {
+            const guid_t name = names[prng_u32(&rng) % nameCount];
+            genid id;
+            benchvalue_t value;
+            if (table_find(table, name, &id) && table_get(table, id, &value))
+            {
+                ++hits;
+                // a torn copy mixes two writes
+                torn += value.check != BenchCheck(value.key, value.gen);
+                // only possible once the 8 bit version wraps
+                stale += value.key != name.a;
+            }
+        }
+    }
+    prng_set(rng);
+    fetch_add_i32(&task->hits, hits, MO_Relaxed);
+    fetch_add_i32(&task->torn, torn, MO_Relaxed);
+    fetch_add_i32(&task->stale, stale, MO_Relaxed);
+}
+
+// the main thread adds, replaces and releases entries until the readers finish
+static i32 TableWrite(table_t* table, const guid_t* names, genid* ids, i32 nameCount, task_TableRead* task)
+{
+    prng_t rng = prng_get();
+    i32 writes = 0;
+    while (!task_poll(task))
+    {
+        const i32 i = prng_i32(&rng) % nameCount;
+        benchvalue_t value;
+        value.key = names[i].a;
+        value.gen = prng_u64(&rng);
+        value.check = BenchCheck(value.key, value.gen);
+        if (!table_exists(table, ids[i]))
+        {
+            table_add(table, names[i], &value, ids + i);
+        }
+        else if (prng_bool(&rng))
+        {
+            table_set(table, ids[i], &value);
+        }
+        else
+        {
+            table_release(table, ids[i], NULL);
+        }
+        if ((++writes & 255) == 0)
+        {
+            // reclaim as the frame loop would
+            epoch_sys_update();
+        }
+    }
+    prng_set(rng);
+    return writes;
+}
+
+// read throughput of a shared table from every task thread, without and then
+// with the main thread writing to it; also counts torn reads, which should
+// stay at zero. table_bench [names] [items], items of 1024 reads each.
+static cmdstat_t CmdTableBench(i32 argc, const char** argv)
+{
+    const i32 nameCount = argc > 1 ? atoi(argv[1]) : 4096;
+    const i32 items = argc > 2 ? atoi(argv[2]) : 4096;
+    if ((nameCount < 1) || (items < 1))
+    {
+        con_logf(LogSev_Error, "cmd", "table_bench: counts must be positive");
+        return cmdstat_err;
+    }
+
+    prng_t rng = prng_get();
+    guid_t* names = perm_malloc(sizeof(names[0]) * nameCount);
+    genid* ids = perm_calloc(sizeof(ids[0]) * nameCount);
+    table_t table;
+    table_new(&table, sizeof(benchvalue_t));
+    for (i32 i = 0; i < nameCount; ++i)
+    {
+        names[i] = guid_rand(&rng);
+        // half start out present
+        if (i & 1)
+        {
+            benchvalue_t value = { names[i].a, 0, BenchCheck(names[i].a, 0) };
+            table_add(&table, names[i], &value, ids + i);
+        }
+    }
+    prng_set(rng);
+
+    cmdstat_t status = cmdstat_ok;
+    for (i32 pass = 0; pass < 2; ++pass)
+    {
+        const bool writing = pass == 1;
+        task_TableRead* task = tmp_calloc(sizeof(*task));
+        task->table = &table;
+        task->names = names;
+        task->nameCount = nameCount;
+
+        const u64 begin = time_now();
+        task_submit(task, TableReadFn, items);
+        task_sys_schedule();
+        const i32 writes = writing ? TableWrite(&table, names, ids, nameCount, task) : 0;
+        task_await(task);
+        const double ms = time_milli(time_now() - begin);
+
+        const double reads = (double)items * kReadsPerItem;
+        con_logf(LogSev_Info, "cmd", "table_bench: %s %d threads, %.1f M reads/s, %d%% hits, %d writes, %d torn, %d stale, %d retired pending",
+            writing ? "writer," : "readers only,",
+            task_thread_ct(),
+            (reads / ms) * 1e-3,
+            (i32)((100.0 * task->hits) / reads),
+            writes,
+            task->torn,
+            task->stale,
+            epoch_pending());
+        if (task->torn)
+        {
+            status = cmdstat_err;
+        }
+    }
+
+    table_del(&table);
+    pim_free(names);
+    pim_free(ids);
+    return status;
+}
+
+void table_sys_init(void)
+{
+    cmd_reg("table_bench", CmdTableBench);
 }
@@ -3,6 +3,7 @@
 #include "common/macro.h"
 #include "containers/queue.h"
 #include "common/guid.h"
+#include "threading/mutex.h"
 
 PIM_C_BEGIN
 
@@ -12,19 +13,35 @@ typedef struct genid_s
     u32 version : 8;
 } genid;
 
+typedef struct tablelookup_s
+{
+    u32 width;
+    u8* ctrl;           // see hash_util.h, width + kHashGroup bytes
+    i32* indices;       // table index of each full slot
+} tablelookup_t;
+
+// table_exists, table_get, table_getname and table_find take no locks and
+// may be called from tasks while one thread edits the table; they see each
+// slot either before or after an edit. memory a writer replaces is freed
+// through threading/epoch.h, so values a reader copies out stay valid until
+// the end of its task range if their owner frees them the same way.
+// the remaining functions are writes and are serialized by writeLock.
 typedef struct table_s
 {
-    i32 width;
+    i32 width;          // slots in use, stored after the arrays grow
+    i32 capacity;
     i32 valueSize;
     u8* versions;
     void* values;
     i32* refcounts;
     guid_t* names;
+    u32* sequences;     // odd while a writer edits the slot
     queue_t freelist;
+    mutex_t writeLock;
 
-    u32 lookupWidth;
     i32 itemCount;
-    i32* lookup;
+    i32 lookupTombs;
+    tablelookup_t* lookup;
 } table_t;
 
 void table_new(table_t* table, i32 valueSize);
@@ -40,8 +57,13 @@ bool table_release(table_t* table, genid id, void* valueOut);
 
 bool table_get(const table_t* table, genid id, void* valueOut);
 bool table_set(table_t* table, genid id, const void* valueIn);
+// replaces the value, copying the previous one out for the caller to free
+bool table_swap(table_t* table, genid id, const void* valueIn, void* valueOut);
 
 bool table_find(const table_t* table, guid_t name, genid* idOut);
 bool table_getname(const table_t* table, genid id, guid_t* nameOut);
 
+// registers table_bench, which reads a shared table from every task thread
+void table_sys_init(void);
+
 PIM_C_END
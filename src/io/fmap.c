@@ -1,8 +1,11 @@
 #include "io/fmap.h"
 
+#include <string.h>
+
+#if PLAT_WINDOWS
+
 #include <Windows.h>
 #include <io.h>
-#include <string.h>
 
 fmap_t fmap_create(fd_t fd, bool writable)
 {
@@ -21,18 +24,23 @@ fmap_t fmap_create(fd_t fd, bool writable)
         return result;
     }
 
-    i32 size = (i32)fd_size(fd);
-    if (size < 0)
+    i64 size = fd_size(fd);
+    if (size <= 0)
     {
-        // files bigger than 2GB are not supported
-        ASSERT(false);
+        // empty files cannot be mapped
         return result;
     }
 
     i32 flProtect = writable ? PAGE_READWRITE : PAGE_READONLY;
     i32 dwDesiredAccess = writable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ;
 
-    HANDLE fileMapping = CreateFileMappingA(hdl, NULL, flProtect, 0, size, NULL);
+    HANDLE fileMapping = CreateFileMappingA(
+        hdl,
+        NULL,
+        flProtect,
+        (DWORD)((u64)size >> 32),
+        (DWORD)((u64)size & 0xffffffff),
+        NULL);
     if (!fileMapping)
     {
         // file descriptor is probably not writable
@@ -40,7 +48,7 @@ fmap_t fmap_create(fd_t fd, bool writable)
         return result;
     }
 
-    void* map = MapViewOfFile(fileMapping, dwDesiredAccess, 0, 0, size);
+    void* map = MapViewOfFile(fileMapping, dwDesiredAccess, 0, 0, (SIZE_T)size);
     CloseHandle(fileMapping);
     fileMapping = NULL;
     if (!map)
@@ -72,10 +80,178 @@ bool fmap_flush(fmap_t fmap)
 {
     if (fmap_isopen(fmap))
     {
-        return FlushViewOfFile(fmap.ptr, fmap.size);
+        return FlushViewOfFile(fmap.ptr, (SIZE_T)fmap.size);
+    }
+    else
+    {
+        return false;
+    }
+}
+
+static bool PageRange(fmap_t map, i64 offset, i64 size, u8** beginOut, u8** endOut);
+
+void fmap_advise(fmap_t map, i64 offset, i64 size, FmapAdvice advice)
+{
+    u8* begin;
+    u8* end;
+    if (!PageRange(map, offset, size, &begin, &end))
+    {
+        return;
+    }
+    switch (advice)
+    {
+    default:
+        // read ahead behavior is chosen when the file is opened, see _O_SEQUENTIAL
+        break;
+    case FmapAdvice_WillNeed:
+    {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = begin;
+        range.NumberOfBytes = (SIZE_T)(end - begin);
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    break;
+    case FmapAdvice_DontNeed:
+        // unlocking pages that aren't locked trims them from the working set
+        VirtualUnlock(begin, (SIZE_T)(end - begin));
+        break;
+    }
+}
+
+#else
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fmap_t fmap_create(fd_t fd, bool writable)
+{
+    fmap_t result = { 0 };
+    if (!fd_isopen(fd))
+    {
+        ASSERT(false);
+        return result;
+    }
+
+    struct stat st;
+    if (fstat(fd.handle, &st))
+    {
+        // stale or closed file descriptor?
+        ASSERT(false);
+        return result;
+    }
+    i64 size = (i64)st.st_size;
+    if (size <= 0)
+    {
+        // empty files cannot be mapped
+        return result;
+    }
+
+    i32 prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    // the mapping keeps its own reference, fd may be closed afterwards
+    void* map = mmap(NULL, (size_t)size, prot, MAP_SHARED, fd.handle, 0);
+    if (map == MAP_FAILED)
+    {
+        ASSERT(false);
+        return result;
+    }
+
+    result.ptr = map;
+    result.size = size;
+    result.fd = fd;
+
+    return result;
+}
+
+void fmap_destroy(fmap_t* fmap)
+{
+    if (fmap)
+    {
+        if (fmap_isopen(*fmap))
+        {
+            munmap(fmap->ptr, (size_t)fmap->size);
+        }
+        memset(fmap, 0, sizeof(*fmap));
+    }
+}
+
+bool fmap_flush(fmap_t fmap)
+{
+    if (fmap_isopen(fmap))
+    {
+        return msync(fmap.ptr, (size_t)fmap.size, MS_SYNC) == 0;
     }
     else
     {
         return false;
     }
 }
+
+static bool PageRange(fmap_t map, i64 offset, i64 size, u8** beginOut, u8** endOut);
+
+void fmap_advise(fmap_t map, i64 offset, i64 size, FmapAdvice advice)
+{
+    u8* begin;
+    u8* end;
+    if (!PageRange(map, offset, size, &begin, &end))
+    {
+        return;
+    }
+    i32 flag = MADV_NORMAL;
+    switch (advice)
+    {
+    default:
+    case FmapAdvice_Normal:
+        flag = MADV_NORMAL;
+        break;
+    case FmapAdvice_Sequential:
+        flag = MADV_SEQUENTIAL;
+        break;
+    case FmapAdvice_Random:
+        flag = MADV_RANDOM;
+        break;
+    case FmapAdvice_WillNeed:
+        flag = MADV_WILLNEED;
+        break;
+    case FmapAdvice_DontNeed:
+        flag = MADV_DONTNEED;
+        break;
+    }
+    madvise(begin, (size_t)(end - begin), flag);
+}
+
+#endif // PLAT_WINDOWS
+
+static i64 PageSize(void)
+{
+#if PLAT_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return sysconf(_SC_PAGESIZE);
+#endif // PLAT_WINDOWS
+}
+
+// clamps the range to the mapping and rounds it out to whole pages;
+// the mapping itself starts on a page boundary
+static bool PageRange(fmap_t map, i64 offset, i64 size, u8** beginOut, u8** endOut)
+{
+    if (!fmap_isopen(map))
+    {
+        return false;
+    }
+    offset = offset > 0 ? offset : 0;
+    i64 last = offset + size;
+    last = last < map.size ? last : map.size;
+    if (last <= offset)
+    {
+        return false;
+    }
+    const i64 page = PageSize();
+    offset &= ~(page - 1);
+    last = (last + page - 1) & ~(page - 1);
+    *beginOut = (u8*)map.ptr + offset;
+    *endOut = (u8*)map.ptr + last;
+    return true;
+}
@@ -9,10 +9,19 @@ PIM_C_BEGIN
 typedef struct fmap_s
 {
     void* ptr;
-    i32 size;
+    i64 size;
     fd_t fd;
 } fmap_t;
 
+typedef enum
+{
+    FmapAdvice_Normal = 0,
+    FmapAdvice_Sequential,  // read ahead aggressively
+    FmapAdvice_Random,      // don't read ahead
+    FmapAdvice_WillNeed,    // start paging the range in now
+    FmapAdvice_DontNeed,    // the range may be dropped from memory
+} FmapAdvice;
+
 static bool fmap_isopen(fmap_t fmap) { return fmap.ptr != NULL; }
 
 // memory maps the file descriptor
@@ -24,4 +33,8 @@ void fmap_destroy(fmap_t* map);
 // writes changes in mapped memory back to source
 bool fmap_flush(fmap_t map);
 
+// hints how a byte range of the mapping will be touched, rounded out to
+// whole pages. never blocks on io.
+void fmap_advise(fmap_t map, i64 offset, i64 size, FmapAdvice advice);
+
 PIM_C_END
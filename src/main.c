@@ -15,14 +15,27 @@
 #include "common/cmd.h"
 #include "common/console.h"
 #include "editor/editor.h"
+#include "common/stringutil.h"
+#include "common/stats.h"
+#include "common/schema.h"
+#include "common/sort.h"
+#include "containers/dict.h"
+#include "containers/table.h"
 
 static void Init(void);
 static void Update(void);
 static void Shutdown(void);
 static void OnGui(void);
+static bool IsHeadless(i32 argc, char** argv);
+static i32 HeadlessMain(i32 argc, char** argv);
 
-int main()
+int main(int argc, char** argv)
 {
+    if (IsHeadless(argc, argv))
+    {
+        return HeadlessMain(argc, argv);
+    }
+
     Init();
     while (window_is_open())
     {
@@ -39,9 +52,14 @@ static void Init(void)
     window_sys_init();          // gl context, window
     cmd_sys_init();
     con_sys_init();
+    dict_sys_init();
+    table_sys_init();
+    schema_sys_init();
+    sort_sys_init();
     task_sys_init();            // enable async work
     asset_sys_init();           // means of loading data
     network_sys_init();         // setup sockets
+    stats_sys_init();           // registry and opt-in stats endpoint
     render_sys_init();          // setup rendering resources
     audio_sys_init();           // setup audio callback
     input_sys_init();           // setup glfw input callbacks
@@ -56,6 +74,7 @@ static void Shutdown(void)
     input_sys_shutdown();
     audio_sys_shutdown();
     render_sys_shutdown();
+    stats_sys_shutdown();
     network_sys_shutdown();
     asset_sys_shutdown();
     task_sys_shutdown();
@@ -93,6 +112,7 @@ static void PresentPhase(void)
     ProfileBegin(pm_present);
     render_sys_update();        // draw tasks
     audio_sys_update();         // handle audio events
+    stats_sys_update();         // record frame stats
     ProfileEnd(pm_present);
 }
 
@@ -124,3 +144,73 @@ static void OnGui(void)
     ui_sys_endframe();          // ImGui::EndFrame
     ProfileEnd(pm_gui);
 }
+
+// ----------------------------------------------------------------------------
+
+static bool IsHeadless(i32 argc, char** argv)
+{
+    for (i32 i = 1; i < argc; ++i)
+    {
+        if (StrICmp(argv[i], 16, "-headless") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// no window, vulkan or imgui.
+// each remaining argument is executed as a console command, in order.
+// eg: pim -headless "lm_density 8" "lm_bake 256 e1m1 e1m2"
+static i32 HeadlessMain(i32 argc, char** argv)
+{
+    time_sys_init();
+    alloc_sys_init();
+    cmd_sys_init();
+    con_sys_init();
+    dict_sys_init();
+    table_sys_init();
+    schema_sys_init();
+    sort_sys_init();
+    task_sys_init();
+    asset_sys_init();
+    network_sys_init();
+    stats_sys_init();
+    render_sys_headless();
+    render_sys_init();
+
+    con_exec("constdout 1");
+
+    i32 errors = 0;
+    for (i32 i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (arg[0] == '-')
+        {
+            continue;
+        }
+
+        time_sys_update();
+        alloc_sys_update();
+        cmd_sys_update();
+        // picks up a stats_port set by an earlier argument
+        stats_sys_update();
+        if (cmd_exec(arg) != cmdstat_ok)
+        {
+            ++errors;
+        }
+        task_sys_update();
+    }
+
+    render_sys_shutdown();
+    stats_sys_shutdown();
+    network_sys_shutdown();
+    asset_sys_shutdown();
+    task_sys_shutdown();
+    con_sys_shutdown();
+    cmd_sys_shutdown();
+    alloc_sys_shutdown();
+    time_sys_shutdown();
+
+    return errors > 0 ? 1 : 0;
+}
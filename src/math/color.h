@@ -41,6 +41,45 @@ pim_inline float4 VEC_CALL rgba8_f4(u32 c)
     return f4_v((r + 0.5f) * s, (g + 0.5f) * s, (b + 0.5f) * s, (a + 0.5f) * s);
 }
 
+// shared exponent hdr color: 9 bit mantissa per channel, 5 bit exponent.
+// non-negative rgb only, alpha is dropped.
+#define kRgb9e5Max 65408.0f
+
+pim_inline u32 VEC_CALL f4_rgb9e5(float4 v)
+{
+    float r = f1_clamp(v.x, 0.0f, kRgb9e5Max);
+    float g = f1_clamp(v.y, 0.0f, kRgb9e5Max);
+    float b = f1_clamp(v.z, 0.0f, kRgb9e5Max);
+    float maxc = f1_max(r, f1_max(g, b));
+
+    // maxc = m * 2^e, m in [0.5, 1)
+    i32 e = 0;
+    frexpf(maxc, &e);
+    i32 exponent = i1_max(e, -15) + 15;
+    float scale = ldexpf(1.0f, 9 - (exponent - 15));
+    if ((u32)(maxc * scale + 0.5f) == 512u)
+    {
+        scale *= 0.5f;
+        exponent += 1;
+    }
+
+    u32 rm = (u32)(r * scale + 0.5f);
+    u32 gm = (u32)(g * scale + 0.5f);
+    u32 bm = (u32)(b * scale + 0.5f);
+    u32 c = ((u32)exponent << 27) | (bm << 18) | (gm << 9) | rm;
+    return c;
+}
+
+pim_inline float4 VEC_CALL rgb9e5_f4(u32 c)
+{
+    i32 exponent = (i32)(c >> 27);
+    float scale = ldexpf(1.0f, exponent - (15 + 9));
+    u32 r = c & 0x1ff;
+    u32 g = (c >> 9) & 0x1ff;
+    u32 b = (c >> 18) & 0x1ff;
+    return f4_v(r * scale, g * scale, b * scale, 0.0f);
+}
+
 // reference sRGB -> Linear conversion (no approximation)
 pim_inline float VEC_CALL sRGBToLinear(float c)
 {
@@ -107,6 +146,42 @@ pim_inline float4 VEC_CALL ColorToDirection(u32 c)
     return f4_normalize3(f4_snorm(rgba8_f4(c)));
 }
 
+// octahedral unit vector: xyz folded onto the octahedron, then its upper
+// pyramid unfolded into the [-1, 1] square. two snorm16 in x | y << 16.
+// https://jcgt.org/published/0003/02/01/
+pim_inline u32 VEC_CALL f4_oct16(float4 dir)
+{
+    float ax = f1_abs(dir.x);
+    float ay = f1_abs(dir.y);
+    float az = f1_abs(dir.z);
+    float rcpL1 = 1.0f / f1_max(ax + ay + az, kEpsilon);
+    float x = dir.x * rcpL1;
+    float y = dir.y * rcpL1;
+    if (dir.z < 0.0f)
+    {
+        float fx = (1.0f - f1_abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - f1_abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    i32 ix = (i32)roundf(f1_clamp(x, -1.0f, 1.0f) * 32767.0f);
+    i32 iy = (i32)roundf(f1_clamp(y, -1.0f, 1.0f) * 32767.0f);
+    return ((u32)ix & 0xffff) | ((u32)iy << 16);
+}
+
+// branchless, returns a normalized direction with w = 0
+pim_inline float4 VEC_CALL oct16_f4(u32 c)
+{
+    const float s = 1.0f / 32767.0f;
+    float x = (float)(i16)(c & 0xffff) * s;
+    float y = (float)(i16)(c >> 16) * s;
+    float z = 1.0f - f1_abs(x) - f1_abs(y);
+    float t = f1_max(-z, 0.0f);
+    x -= x >= 0.0f ? t : -t;
+    y -= y >= 0.0f ? t : -t;
+    return f4_normalize3(f4_v(x, y, z, 0.0f));
+}
+
 pim_inline u32 VEC_CALL LinearToColor(float4 lin)
 {
     float4 sRGB = f4_tosrgb(lin);
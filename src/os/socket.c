@@ -142,8 +142,8 @@ static socket_t wsock_accept(socket_t sock, u32* addr)
     {
         SOCKADDR_IN saddr = { 0 };
         i32 len = sizeof(saddr);
+        // fails when the listener is closed out from under it
         SOCKET s = accept((SOCKET)sock.handle, (struct sockaddr*)&saddr, &len);
-        ASSERT(s != INVALID_SOCKET);
         if (s != INVALID_SOCKET)
         {
             *addr = saddr.sin_addr.s_addr;
@@ -175,8 +175,8 @@ static i32 wsock_send(socket_t sock, const void* src, u32 len)
     ASSERT(wsock_isopen(sock));
     if (wsock_isopen(sock))
     {
+        // fails when the peer hangs up
         rval = send((SOCKET)sock.handle, (const char*)src, len, 0x0);
-        ASSERT(rval != SOCKET_ERROR);
     }
     return rval;
 }
@@ -191,7 +191,177 @@ static i32 wsock_recv(socket_t sock, void* dst, u32 len)
     if (wsock_isopen(sock))
     {
         rval = recv((SOCKET)sock.handle, (char*)dst, len, 0x0);
-        ASSERT(rval != SOCKET_ERROR);
+    }
+    return rval;
+}
+
+#else
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <ctype.h>
+
+// fds are stored off by one, so that a zeroed socket_t is closed
+static i32 psock_fd(socket_t sock)
+{
+    return (i32)((isize)sock.handle) - 1;
+}
+
+static struct sockaddr_in ToSockAddr(u32 addr, u16 port)
+{
+    ASSERT(addr != INADDR_NONE);
+    ASSERT(port);
+
+    struct sockaddr_in name = { 0 };
+    name.sin_family = AF_INET;
+    name.sin_addr.s_addr = addr;
+    name.sin_port = htons(port);
+
+    return name;
+}
+
+static bool psock_url2addr(const char* url, u32* addr)
+{
+    if (!url)
+    {
+        return false;
+    }
+    u32 y = INADDR_NONE;
+    if (isalpha(url[0]))
+    {
+        struct hostent* h = gethostbyname(url);
+        if (h && h->h_addr_list[0])
+        {
+            memcpy(&y, h->h_addr_list[0], sizeof(y));
+        }
+    }
+    else
+    {
+        y = inet_addr(url);
+    }
+    *addr = y;
+    return y != INADDR_NONE;
+}
+
+static bool psock_isopen(socket_t sock)
+{
+    return psock_fd(sock) >= 0;
+}
+
+static bool psock_open(socket_t* sock, SocketProto proto)
+{
+    bool tcp = proto == SocketProto_TCP;
+    i32 fd = socket(
+        AF_INET,
+        tcp ? SOCK_STREAM : SOCK_DGRAM,
+        tcp ? IPPROTO_TCP : IPPROTO_UDP);
+    sock->handle = (void*)((isize)fd + 1);
+    sock->proto = proto;
+    if (fd >= 0)
+    {
+        // let a restarted listener take its port back right away
+        i32 reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+    return psock_isopen(*sock);
+}
+
+static void psock_close(socket_t* sock)
+{
+    if (psock_isopen(*sock))
+    {
+        // also wakes a thread blocked in accept or recv
+        shutdown(psock_fd(*sock), SHUT_RDWR);
+        i32 rval = close(psock_fd(*sock));
+        ASSERT(rval == 0);
+        (void)rval;
+    }
+    sock->handle = NULL;
+}
+
+static bool psock_bind(socket_t sock, u32 addr, u16 port)
+{
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        struct sockaddr_in name = ToSockAddr(addr, port);
+        i32 rval = bind(psock_fd(sock), (const struct sockaddr*)&name, sizeof(name));
+        return rval == 0;
+    }
+    return false;
+}
+
+static bool psock_listen(socket_t sock)
+{
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        i32 rval = listen(psock_fd(sock), SOMAXCONN);
+        return rval == 0;
+    }
+    return false;
+}
+
+static socket_t psock_accept(socket_t sock, u32* addr)
+{
+    ASSERT(addr);
+    socket_t result;
+    result.handle = NULL;
+    result.proto = sock.proto;
+    *addr = 0;
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        struct sockaddr_in saddr = { 0 };
+        socklen_t len = sizeof(saddr);
+        i32 fd = accept(psock_fd(sock), (struct sockaddr*)&saddr, &len);
+        if (fd >= 0)
+        {
+            *addr = saddr.sin_addr.s_addr;
+            result.handle = (void*)((isize)fd + 1);
+        }
+    }
+    return result;
+}
+
+static bool psock_connect(socket_t sock, u32 addr, u16 port)
+{
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        struct sockaddr_in name = ToSockAddr(addr, port);
+        i32 rval = connect(psock_fd(sock), (const struct sockaddr*)&name, sizeof(name));
+        return rval == 0;
+    }
+    return false;
+}
+
+static i32 psock_send(socket_t sock, const void* src, u32 len)
+{
+    i32 rval = -1;
+    ASSERT(src);
+    ASSERT(len);
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        // a hung up peer is an error return, not SIGPIPE
+        rval = (i32)send(psock_fd(sock), src, len, MSG_NOSIGNAL);
+    }
+    return rval;
+}
+
+static i32 psock_recv(socket_t sock, void* dst, u32 len)
+{
+    i32 rval = -1;
+    ASSERT(dst);
+    ASSERT(len);
+    ASSERT(psock_isopen(sock));
+    if (psock_isopen(sock))
+    {
+        rval = (i32)recv(psock_fd(sock), dst, len, 0x0);
     }
     return rval;
 }
@@ -224,6 +394,8 @@ bool network_url2addr(const char* url, u32* addrOut)
 {
 #if PLAT_WINDOWS
     return wsock_url2addr(url, addrOut);
+#else
+    return psock_url2addr(url, addrOut);
 #endif // PLAT_WINDOWS
 }
 
@@ -231,6 +403,8 @@ bool socket_open(socket_t* sock, SocketProto proto)
 {
 #if PLAT_WINDOWS
     return wsock_open(sock, proto);
+#else
+    return psock_open(sock, proto);
 #endif // PLAT_WINDOWS
 }
 
@@ -238,6 +412,8 @@ void socket_close(socket_t* sock)
 {
 #if PLAT_WINDOWS
     wsock_close(sock);
+#else
+    psock_close(sock);
 #endif // PLAT_WINDOWS
 }
 
@@ -245,6 +421,8 @@ bool socket_isopen(socket_t sock)
 {
 #if PLAT_WINDOWS
     return wsock_isopen(sock);
+#else
+    return psock_isopen(sock);
 #endif // PLAT_WINDOWS
 }
 
@@ -252,6 +430,8 @@ bool socket_bind(socket_t sock, u32 addr, u16 port)
 {
 #if PLAT_WINDOWS
     return wsock_bind(sock, addr, port);
+#else
+    return psock_bind(sock, addr, port);
 #endif // PLAT_WINDOWS
 }
 
@@ -259,6 +439,8 @@ bool socket_listen(socket_t sock)
 {
 #if PLAT_WINDOWS
     return wsock_listen(sock);
+#else
+    return psock_listen(sock);
 #endif // PLAT_WINDOWS
 }
 
@@ -266,6 +448,8 @@ socket_t socket_accept(socket_t sock, u32* addr)
 {
 #if PLAT_WINDOWS
     return wsock_accept(sock, addr);
+#else
+    return psock_accept(sock, addr);
 #endif // PLAT_WINDOWS
 }
 
@@ -273,6 +457,8 @@ bool socket_connect(socket_t sock, u32 addr, u16 port)
 {
 #if PLAT_WINDOWS
     return wsock_connect(sock, addr, port);
+#else
+    return psock_connect(sock, addr, port);
 #endif // PLAT_WINDOWS
 }
 
@@ -280,6 +466,8 @@ i32 socket_send(socket_t sock, const void* src, i32 len)
 {
 #if PLAT_WINDOWS
     return wsock_send(sock, src, len);
+#else
+    return psock_send(sock, src, len);
 #endif // PLAT_WINDOWS
 }
 
@@ -287,5 +475,7 @@ i32 socket_recv(socket_t sock, void* dst, i32 len)
 {
 #if PLAT_WINDOWS
     return wsock_recv(sock, dst, len);
+#else
+    return psock_recv(sock, dst, len);
 #endif // PLAT_WINDOWS
 }
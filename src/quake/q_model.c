@@ -4,6 +4,8 @@
 #include "math/float4_funcs.h"
 #include "common/console.h"
 #include "common/stringutil.h"
+#include "common/valist.h"
+#include "threading/task.h"
 
 #include <string.h>
 
@@ -97,6 +99,97 @@ static void SetupSubModels(
     const dheader_t* header,
     mmodel_t* model);
 
+typedef void(*LoadLumpFn)(
+    const void* buffer,
+    EAlloc allocator,
+    const dheader_t* header,
+    mmodel_t* model);
+
+// the console is not thread safe; lumps loaded on task threads keep their
+// errors here until the task completes.
+typedef struct lumplog_s
+{
+    char text[1024];
+} lumplog_t;
+
+static pim_thread_local lumplog_t* ms_lumpLog;
+
+static void LumpError(const char* fmt, ...)
+{
+    lumplog_t* log = ms_lumpLog;
+    if (log)
+    {
+        VStrCatf(ARGS(log->text), fmt, VA_START(fmt));
+        StrCatf(ARGS(log->text), "\n");
+    }
+    else
+    {
+        char msg[1024];
+        VSPrintf(ARGS(msg), fmt, VA_START(fmt));
+        con_logf(LogSev_Error, "mdl", "%s", msg);
+    }
+}
+
+typedef struct task_LoadLumps
+{
+    task_t task;
+    const LoadLumpFn* fns;
+    const void* buffer;
+    const dheader_t* header;
+    mmodel_t* model;
+    lumplog_t* logs;
+    EAlloc allocator;
+} task_LoadLumps;
+
+static void LoadLumpsFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_LoadLumps* task = (task_LoadLumps*)pbase;
+    for (i32 i = begin; i < end; ++i)
+    {
+        ms_lumpLog = &task->logs[i];
+        task->fns[i](task->buffer, task->allocator, task->header, task->model);
+        ms_lumpLog = NULL;
+    }
+}
+
+static void LoadLumps(
+    const LoadLumpFn* fns,
+    i32 count,
+    const void* buffer,
+    EAlloc allocator,
+    const dheader_t* header,
+    mmodel_t* model)
+{
+    task_LoadLumps* task = tmp_calloc(sizeof(*task));
+    task->fns = fns;
+    task->buffer = buffer;
+    task->header = header;
+    task->model = model;
+    task->logs = tmp_calloc(sizeof(task->logs[0]) * count);
+    task->allocator = allocator;
+    task_run(&task->task, LoadLumpsFn, count);
+
+    for (i32 i = 0; i < count; ++i)
+    {
+        char* line = task->logs[i].text;
+        while (line[0])
+        {
+            char* next = strchr(line, '\n');
+            if (next)
+            {
+                *next++ = 0;
+            }
+            con_logf(LogSev_Error, "mdl", "%s", line);
+            // a full log may have lost its last newline
+            if (!next)
+            {
+                break;
+            }
+            line = next;
+        }
+    }
+}
+
 mmodel_t* LoadModel(
     const char* name,
     const void* buffer,
@@ -176,20 +269,32 @@ static mmodel_t* LoadBrushModel(
     model->type = mod_brush;
     model->numframes = 2;
 
-    LoadVertices(buffer, allocator, header, model);
-    LoadEdges(buffer, allocator, header, model);
-    LoadSurfEdges(buffer, allocator, header, model);
-    LoadTextures(buffer, allocator, header, model);
-    LoadLighting(buffer, allocator, header, model);
-    LoadPlanes(buffer, allocator, header, model);
-    LoadTexInfo(buffer, allocator, header, model);
+    // lumps that only read the file, each writes its own fields of the model
+    static const LoadLumpFn kIndependent[] =
+    {
+        LoadTextures,
+        LoadLighting,
+        LoadVisibility,
+        LoadVertices,
+        LoadEdges,
+        LoadSurfEdges,
+        LoadPlanes,
+        LoadEntities,
+        LoadSubModels,
+    };
+    // lumps that link into the ones above
+    static const LoadLumpFn kDependent[] =
+    {
+        LoadTexInfo,
+        LoadClipNodes,
+    };
+    LoadLumps(kIndependent, NELEM(kIndependent), buffer, allocator, header, model);
+    LoadLumps(kDependent, NELEM(kDependent), buffer, allocator, header, model);
+
     LoadFaces(buffer, allocator, header, model);
+    // marks surfaces from several leaves, so it stays serial
     LoadMarkSurfaces(buffer, allocator, header, model);
-    LoadVisibility(buffer, allocator, header, model);
     LoadTree(buffer, allocator, header, model);
-    LoadClipNodes(buffer, allocator, header, model);
-    LoadEntities(buffer, allocator, header, model);
-    LoadSubModels(buffer, allocator, header, model);
     MakeHull0(buffer, allocator, header, model);
     SetupSubModels(buffer, allocator, header, model);
 
@@ -210,12 +315,12 @@ static void LoadVertices(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad vertex lump in %s", model->name);
+            LumpError("Bad vertex lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_VERTS)
         {
-            con_logf(LogSev_Error, "mdl", "vertex count %d exceeds limit of %d in %s", count, MAX_MAP_VERTS, model->name);
+            LumpError("vertex count %d exceeds limit of %d in %s", count, MAX_MAP_VERTS, model->name);
             return;
         }
 
@@ -246,12 +351,12 @@ static void LoadEdges(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad edge lump in %s", model->name);
+            LumpError("Bad edge lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_EDGES)
         {
-            con_logf(LogSev_Error, "mdl", "edges count %d exceeds limit of %d in %s", count, MAX_MAP_EDGES, model->name);
+            LumpError("edges count %d exceeds limit of %d in %s", count, MAX_MAP_EDGES, model->name);
             return;
         }
 
@@ -278,12 +383,12 @@ static void LoadSurfEdges(
     ASSERT(count >= 0);
     if (lump.filelen % sizeof(*src))
     {
-        con_logf(LogSev_Error, "mdl", "Bad surfedge lump in %s", model->name);
+        LumpError("Bad surfedge lump in %s", model->name);
         return;
     }
     if (count > MAX_MAP_SURFEDGES)
     {
-        con_logf(LogSev_Error, "mdl", "surfedges count %d exceeds limit of %d in %s", count, MAX_MAP_SURFEDGES, model->name);
+        LumpError("surfedges count %d exceeds limit of %d in %s", count, MAX_MAP_SURFEDGES, model->name);
         return;
     }
 
@@ -308,7 +413,7 @@ static void LoadTextures(
         ASSERT(texCount >= 0);
         if (texCount > MAX_MAP_TEXTURES)
         {
-            con_logf(LogSev_Error, "mdl", "texture count %d exceeds limit of %d in %s", texCount, MAX_MAP_TEXTURES, model->name);
+            LumpError("texture count %d exceeds limit of %d in %s", texCount, MAX_MAP_TEXTURES, model->name);
             return;
         }
 
@@ -326,7 +431,7 @@ static void LoadTextures(
             const miptex_t* mt = OffsetPtr(m, offset);
             if ((mt->width & 15) || (mt->height & 15))
             {
-                con_logf(LogSev_Error, "mdl", "Texture size is not multiple of 16: %s", mt->name);
+                LumpError("Texture size is not multiple of 16: %s", mt->name);
                 continue;
             }
 
@@ -336,7 +441,7 @@ static void LoadTextures(
             ASSERT(pixels > 0);
             if ((pixels + offset + sizeof(*mt)) > lump.filelen)
             {
-                con_logf(LogSev_Error, "mdl", "Texture extends past end of lump: %s", mt->name);
+                LumpError("Texture extends past end of lump: %s", mt->name);
                 continue;
             }
 
@@ -397,7 +502,7 @@ static void LoadTextures(
             }
             else
             {
-                con_logf(LogSev_Error, "mdl", "Bad animating texture %s", tx->name);
+                LumpError("Bad animating texture %s", tx->name);
                 continue;
             }
 
@@ -434,7 +539,7 @@ static void LoadTextures(
                 }
                 else
                 {
-                    con_logf(LogSev_Error, "mdl", "Bad animating texture: %s", tx2->name);
+                    LumpError("Bad animating texture: %s", tx2->name);
                     continue;
                 }
             }
@@ -445,7 +550,7 @@ static void LoadTextures(
                 mtexture_t* tx2 = anims[j];
                 if (!tx2)
                 {
-                    con_logf(LogSev_Error, "mdl", "Missing animtex frame %d of %s", j, tx->name);
+                    LumpError("Missing animtex frame %d of %s", j, tx->name);
                     continue;
                 }
                 tx2->anim_total = maxanim * kAnimCycle;
@@ -462,7 +567,7 @@ static void LoadTextures(
                 mtexture_t* tx2 = altanims[j];
                 if (!tx2)
                 {
-                    con_logf(LogSev_Error, "mdl", "Missing alt animtex frame %d of %s", j, tx->name);
+                    LumpError("Missing alt animtex frame %d of %s", j, tx->name);
                     continue;
                 }
                 tx2->anim_total = altmax * kAnimCycle;
@@ -489,7 +594,7 @@ static void LoadLighting(
     {
         if (lump.filelen > MAX_MAP_LIGHTING)
         {
-            con_logf(LogSev_Error, "mdl", "lighting size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_LIGHTING, model->name);
+            LumpError("lighting size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_LIGHTING, model->name);
             return;
         }
         const void* src = OffsetPtr(buffer, lump.fileofs);
@@ -514,12 +619,12 @@ static void LoadPlanes(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad plane lump in %s", model->name);
+            LumpError("Bad plane lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_PLANES)
         {
-            con_logf(LogSev_Error, "mdl", "planes count %d exceeds limit of %d in %s", count, MAX_MAP_PLANES, model->name);
+            LumpError("planes count %d exceeds limit of %d in %s", count, MAX_MAP_PLANES, model->name);
             return;
         }
 
@@ -551,12 +656,12 @@ static void LoadTexInfo(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad texinfo lump in %s", model->name);
+            LumpError("Bad texinfo lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_TEXINFO)
         {
-            con_logf(LogSev_Error, "mdl", "texinfo count %d exceeds limit of %d in %s", count, MAX_MAP_TEXINFO, model->name);
+            LumpError("texinfo count %d exceeds limit of %d in %s", count, MAX_MAP_TEXINFO, model->name);
             return;
         }
 
@@ -597,7 +702,7 @@ static void LoadTexInfo(
                 dst[i].texture = textures[miptex];
                 if (!dst[i].texture)
                 {
-                    con_logf(LogSev_Error, "mdl", "Null texture found in model '%s' at index %d", model->name, miptex);
+                    LumpError("Null texture found in model '%s' at index %d", model->name, miptex);
                 }
             }
         }
@@ -722,7 +827,7 @@ static void LoadVisibility(
     {
         if (lump.filelen > MAX_MAP_VISIBILITY)
         {
-            con_logf(LogSev_Error, "mdl", "Visibility size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_VISIBILITY, model->name);
+            LumpError("Visibility size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_VISIBILITY, model->name);
             return;
         }
         const u8* src = OffsetPtr(buffer, lump.fileofs);
@@ -889,12 +994,12 @@ static void LoadClipNodes(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad clipnode lump in %s", model->name);
+            LumpError("Bad clipnode lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_CLIPNODES)
         {
-            con_logf(LogSev_Error, "mdl", "clipnode count %d exceeds limit of %d in %s", count, MAX_MAP_CLIPNODES, model->name);
+            LumpError("clipnode count %d exceeds limit of %d in %s", count, MAX_MAP_CLIPNODES, model->name);
             return;
         }
 
@@ -944,7 +1049,7 @@ static void LoadEntities(
     {
         if (lump.filelen > MAX_MAP_ENTSTRING)
         {
-            con_logf(LogSev_Error, "mdl", "entity string size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_ENTSTRING, model->name);
+            LumpError("entity string size %d exceeds limit of %d in %s", lump.filelen, MAX_MAP_ENTSTRING, model->name);
             return;
         }
         const char* src = OffsetPtr(buffer, lump.fileofs);
@@ -970,12 +1075,12 @@ static void LoadSubModels(
         ASSERT(count >= 0);
         if (lump.filelen % sizeof(*src))
         {
-            con_logf(LogSev_Error, "mdl", "Bad submodel lump in %s", model->name);
+            LumpError("Bad submodel lump in %s", model->name);
             return;
         }
         if (count > MAX_MAP_MODELS)
         {
-            con_logf(LogSev_Error, "mdl", "submodel count %d exceeds limit of %d in %s", count, MAX_MAP_MODELS, model->name);
+            LumpError("submodel count %d exceeds limit of %d in %s", count, MAX_MAP_MODELS, model->name);
             return;
         }
 
@@ -37,6 +37,8 @@ pack_t pack_load(const char* path, EAlloc allocator)
     const u8* buffer = map.ptr;
     pack.files = (const dpackfile_t*)(buffer + header->offset);
     pack.filecount = header->length / sizeof(dpackfile_t);
+    // the directory is walked right away, asset data is touched on use
+    fmap_advise(map, header->offset, header->length, FmapAdvice_WillNeed);
 
     return pack;
 }
@@ -4,6 +4,8 @@
 #include "common/fnv1a.h"
 #include "common/guid.h"
 #include "common/profiler.h"
+#include "common/atomics.h"
+#include "common/schema.h"
 #include "math/float4x4_funcs.h"
 #include "math/frustum.h"
 #include "math/box.h"
@@ -15,13 +17,18 @@
 #include "rendering/sampler.h"
 #include "rendering/mesh.h"
 #include "rendering/material.h"
-#include "io/fstr.h"
 #include "threading/task.h"
 #include <string.h>
 
 static drawables_t ms_drawables;
+static u32 ms_version;
 drawables_t* drawables_get(void) { return &ms_drawables; }
 
+static u32 NewVersion(void)
+{
+    return inc_u32(&ms_version, MO_Relaxed) + 1u;
+}
+
 i32 drawables_add(drawables_t* dr, guid_t name)
 {
     const i32 back = dr->count;
@@ -38,6 +45,7 @@ i32 drawables_add(drawables_t* dr, guid_t name)
     PermGrow(dr->translations, len);
     PermGrow(dr->rotations, len);
     PermGrow(dr->scales, len);
+    PermGrow(dr->versions, len);
 
     dr->names[back] = name;
     dr->translations[back] = f4_0;
@@ -45,6 +53,7 @@ i32 drawables_add(drawables_t* dr, guid_t name)
     dr->rotations[back] = quat_id;
     dr->matrices[back] = f4x4_id;
     dr->invMatrices[back] = f3x3_id;
+    dr->versions[back] = NewVersion();
 
     return back;
 }
@@ -79,6 +88,7 @@ static void RemoveAtIndex(drawables_t* dr, i32 i)
     PopSwap(dr->translations, i, len);
     PopSwap(dr->rotations, i, len);
     PopSwap(dr->scales, i, len);
+    PopSwap(dr->versions, i, len);
 }
 
 bool drawables_rm(drawables_t* dr, guid_t name)
@@ -125,6 +135,7 @@ void drawables_del(drawables_t* dr)
         pim_free(dr->translations);
         pim_free(dr->rotations);
         pim_free(dr->scales);
+        pim_free(dr->versions);
         memset(dr, 0, sizeof(*dr));
     }
 }
@@ -175,11 +186,17 @@ static void UpdateTransformsFn(task_t* pbase, i32 begin, i32 end)
     const float4* pim_noalias scales = dr->scales;
     float4x4* pim_noalias matrices = dr->matrices;
     float3x3* pim_noalias invMatrices = dr->invMatrices;
+    u32* pim_noalias versions = dr->versions;
 
     for (i32 i = begin; i < end; ++i)
     {
-        matrices[i] = f4x4_trs(translations[i], rotations[i], scales[i]);
-        invMatrices[i] = f3x3_IM(matrices[i]);
+        const float4x4 M = f4x4_trs(translations[i], rotations[i], scales[i]);
+        if (memcmp(&M, matrices + i, sizeof(M)))
+        {
+            matrices[i] = M;
+            invMatrices[i] = f3x3_IM(M);
+            versions[i] = NewVersion();
+        }
     }
 }
 
@@ -210,125 +227,260 @@ box_t drawables_bounds(const drawables_t* dr)
     return box;
 }
 
+static const schemafield_t kDMaterialFields[] =
+{
+    SCHEMA_FIELD(dmaterial_t, st, SchemaType_F4),
+    SCHEMA_FIELD(dmaterial_t, albedo, SchemaType_Guid),
+    SCHEMA_FIELD(dmaterial_t, rome, SchemaType_Guid),
+    SCHEMA_FIELD(dmaterial_t, normal, SchemaType_Guid),
+    SCHEMA_FIELD(dmaterial_t, flatAlbedo, SchemaType_F4),
+    SCHEMA_FIELD(dmaterial_t, flatRome, SchemaType_F4),
+    SCHEMA_FIELD(dmaterial_t, flags, SchemaType_U32),
+    SCHEMA_FIELD(dmaterial_t, ior, SchemaType_F32),
+};
+static const schema_t kDMaterialSchema = SCHEMA_DEF(dmaterial_t, 1, kDMaterialFields);
+
+static const schemafield_t kDLmUvsFields[] =
+{
+    SCHEMA_FIELD(dlm_uvs_t, length, SchemaType_I32),
+    SCHEMA_RAW(dlm_uvs_t, uvs, sizeof(float2)),
+    SCHEMA_RAW(dlm_uvs_t, indices, sizeof(i32)),
+};
+static const schema_t kDLmUvsSchema = SCHEMA_DEF(dlm_uvs_t, 1, kDLmUvsFields);
+
+static const schemafield_t kDDrawablesFields[] =
+{
+    SCHEMA_FIELD(ddrawables_t, length, SchemaType_I32),
+    SCHEMA_RAW(ddrawables_t, names, sizeof(guid_t)),
+    SCHEMA_RAW(ddrawables_t, meshes, sizeof(dmeshid_t)),
+    SCHEMA_RAW(ddrawables_t, bounds, sizeof(box_t)),
+    SCHEMA_ARRAY(ddrawables_t, materials, &kDMaterialSchema),
+    SCHEMA_ARRAY(ddrawables_t, lmuvs, &kDLmUvsSchema),
+    SCHEMA_RAW(ddrawables_t, translations, sizeof(float4)),
+    SCHEMA_RAW(ddrawables_t, rotations, sizeof(quat)),
+    SCHEMA_RAW(ddrawables_t, scales, sizeof(float4)),
+    SCHEMA_FIELD(ddrawables_t, lmpack, SchemaType_Guid),
+};
+static const schema_t kDDrawablesSchema = SCHEMA_DEF(ddrawables_t, kDrawablesVersion, kDDrawablesFields);
+
 bool drawables_save(const drawables_t* src, guid_t name)
 {
     char filename[PIM_PATH] = "data/";
     guid_tofile(ARGS(filename), name, ".drawables");
 
-    fstr_t fd = fstr_open(filename, "wb");
-    if (fstr_isopen(fd))
+    const i32 length = src->count;
+    schemawriter_t wr;
+    schema_begin(&wr, &kDDrawablesSchema);
+
+    ddrawables_t hdr = { 0 };
+    hdr.length = length;
+    hdr.lmpack = name;
+    hdr.names = schema_push(&wr, src->names, length, sizeof(src->names[0]));
     {
-        void* scratch = NULL;
-        const i32 length = src->count;
-        i32 offset = 0;
-
-        // write header
-        ddrawables_t hdr = { 0 };
-        dbytes_new(1, sizeof(hdr), &offset);
-        hdr.version = kDrawablesVersion;
-        hdr.length = length;
-        hdr.names = dbytes_new(length, sizeof(src->names[0]), &offset);
-        hdr.meshes = dbytes_new(length, sizeof(dmeshid_t), &offset);
-        hdr.bounds = dbytes_new(length, sizeof(src->bounds[0]), &offset);
-        hdr.materials = dbytes_new(length, sizeof(dmaterial_t), &offset);
-        hdr.lmuvs = dbytes_new(length, sizeof(dlm_uvs_t), &offset);
-        hdr.translations = dbytes_new(length, sizeof(src->translations[0]), &offset);
-        hdr.rotations = dbytes_new(length, sizeof(src->rotations[0]), &offset);
-        hdr.scales = dbytes_new(length, sizeof(src->scales[0]), &offset);
-        hdr.lmpack = name;
-        ASSERT(fstr_tell(fd) == 0);
-        fstr_write(fd, &hdr, sizeof(hdr));
-
-        // write names
-        ASSERT(fstr_tell(fd) == hdr.names.offset);
-        fstr_write(fd, src->names, sizeof(src->names[0]) * length);
-
-        // write meshes
+        dmeshid_t* dmeshids = tmp_malloc(sizeof(dmeshids[0]) * length);
+        for (i32 i = 0; i < length; ++i)
         {
-            dmeshid_t* dmeshids = tmp_realloc(scratch, sizeof(dmeshids[0]) * length);
-            for (i32 i = 0; i < length; ++i)
-            {
-                mesh_save(src->meshes[i], &dmeshids[i].id);
-            }
-            ASSERT(fstr_tell(fd) == hdr.meshes.offset);
-            fstr_write(fd, dmeshids, sizeof(dmeshids[0]) * length);
-            scratch = dmeshids;
+            mesh_save(src->meshes[i], &dmeshids[i].id);
         }
-        // write bounds
-        ASSERT(fstr_tell(fd) == hdr.bounds.offset);
-        fstr_write(fd, src->bounds, sizeof(src->bounds[0]) * length);
-        // write materials
+        hdr.meshes = schema_push(&wr, dmeshids, length, sizeof(dmeshids[0]));
+    }
+    hdr.bounds = schema_push(&wr, src->bounds, length, sizeof(src->bounds[0]));
+    {
+        dmaterial_t* dmaterials = tmp_malloc(sizeof(dmaterials[0]) * length);
+        for (i32 i = 0; i < length; ++i)
         {
-            dmaterial_t* dmaterials = tmp_realloc(scratch, sizeof(dmaterials[0]) * length);
-            for (i32 i = 0; i < length; ++i)
-            {
-                const material_t mat = src->materials[i];
-                dmaterial_t dmat = { 0 };
-                dmat.st = mat.st;
-                dmat.flatAlbedo = mat.flatAlbedo;
-                dmat.flatRome = mat.flatRome;
-                dmat.flags = mat.flags;
-                dmat.ior = mat.ior;
-                texture_save(mat.albedo, &dmat.albedo.id);
-                texture_save(mat.rome, &dmat.rome.id);
-                texture_save(mat.normal, &dmat.normal.id);
-                dmaterials[i] = dmat;
-            }
-            ASSERT(fstr_tell(fd) == hdr.materials.offset);
-            fstr_write(fd, dmaterials, sizeof(dmaterials[0]) * length);
-            scratch = dmaterials;
+            const material_t mat = src->materials[i];
+            dmaterial_t dmat = { 0 };
+            dmat.st = mat.st;
+            dmat.flatAlbedo = mat.flatAlbedo;
+            dmat.flatRome = mat.flatRome;
+            dmat.flags = mat.flags;
+            dmat.ior = mat.ior;
+            texture_save(mat.albedo, &dmat.albedo.id);
+            texture_save(mat.rome, &dmat.rome.id);
+            texture_save(mat.normal, &dmat.normal.id);
+            dmaterials[i] = dmat;
         }
-        // write lightmap uv headers
-        dlm_uvs_t* dlmuvs = tmp_realloc(scratch, sizeof(dlmuvs[0]) * length);
+        hdr.materials = schema_push(&wr, dmaterials, length, sizeof(dmaterials[0]));
+    }
+    {
+        // contents first, so the headers know where they landed
+        dlm_uvs_t* dlmuvs = tmp_malloc(sizeof(dlmuvs[0]) * length);
+        for (i32 i = 0; i < length; ++i)
         {
-            for (i32 i = 0; i < length; ++i)
-            {
-                const lm_uvs_t lmuv = src->lmUvs[i];
-                dlm_uvs_t dlmuv = { 0 };
-                dlmuv.length = lmuv.length;
-                dlmuv.uvs = dbytes_new(lmuv.length, sizeof(lmuv.uvs[0]), &offset);
-                dlmuv.indices = dbytes_new(lmuv.length, sizeof(lmuv.indices[0]), &offset);
-                dlmuvs[i] = dlmuv;
-            }
-            ASSERT(fstr_tell(fd) == hdr.lmuvs.offset);
-            fstr_write(fd, dlmuvs, sizeof(dlmuvs[0]) * length);
-            scratch = NULL;
+            const lm_uvs_t lmuv = src->lmUvs[i];
+            dlm_uvs_t dlmuv = { 0 };
+            dlmuv.length = lmuv.length;
+            dlmuv.uvs = schema_push(&wr, lmuv.uvs, lmuv.length, sizeof(lmuv.uvs[0]));
+            dlmuv.indices = schema_push(&wr, lmuv.indices, lmuv.length, sizeof(lmuv.indices[0]));
+            dlmuvs[i] = dlmuv;
         }
+        hdr.lmuvs = schema_push(&wr, dlmuvs, length, sizeof(dlmuvs[0]));
+    }
+    hdr.translations = schema_push(&wr, src->translations, length, sizeof(src->translations[0]));
+    hdr.rotations = schema_push(&wr, src->rotations, length, sizeof(src->rotations[0]));
+    hdr.scales = schema_push(&wr, src->scales, length, sizeof(src->scales[0]));
 
-        // write translations
-        ASSERT(fstr_tell(fd) == hdr.translations.offset);
-        fstr_write(fd, src->translations, sizeof(src->translations[0]) * length);
+    return schema_save(&wr, &hdr, filename);
+}
 
-        // write rotations
-        ASSERT(fstr_tell(fd) == hdr.rotations.offset);
-        fstr_write(fd, src->rotations, sizeof(src->rotations[0]) * length);
+typedef enum
+{
+    StreamSlot_Mesh,
+    StreamSlot_Albedo,
+    StreamSlot_Rome,
+    StreamSlot_Normal,
+} StreamSlot;
+
+// where a streamed mesh or texture lands; drawables may have moved or been
+// removed by the time it arrives, so the name is checked before the index
+typedef struct streamtarget_s
+{
+    drawables_t* dr;
+    guid_t name;
+    i32 index;
+    StreamSlot slot;
+} streamtarget_t;
 
-        // write scales
-        ASSERT(fstr_tell(fd) == hdr.scales.offset);
-        fstr_write(fd, src->scales, sizeof(src->scales[0]) * length);
+static i32 FindTarget(const streamtarget_t* target)
+{
+    const drawables_t* dr = target->dr;
+    const i32 i = target->index;
+    if ((i < dr->count) && guid_eq(dr->names[i], target->name))
+    {
+        return i;
+    }
+    return drawables_find(dr, target->name);
+}
 
-        // write lightmap uv contents
-        for (i32 i = 0; i < length; ++i)
+static void OnStreamedMesh(meshid_t id, void* usr)
+{
+    streamtarget_t* target = usr;
+    drawables_t* dr = target->dr;
+    const i32 i = FindTarget(target);
+    if (i >= 0)
+    {
+        mesh_release(dr->meshes[i]);
+        dr->meshes[i] = id;
+        dr->versions[i] = NewVersion();
+    }
+    else
+    {
+        mesh_release(id);
+    }
+    pim_free(target);
+}
+
+static void OnStreamedTexture(textureid_t id, void* usr)
+{
+    streamtarget_t* target = usr;
+    drawables_t* dr = target->dr;
+    const i32 i = FindTarget(target);
+    if (i >= 0)
+    {
+        material_t* mat = dr->materials + i;
+        textureid_t* dst = &mat->albedo;
+        switch (target->slot)
         {
-            const lm_uvs_t lmuv = src->lmUvs[i];
-            ASSERT(lmuv.length == dlmuvs[i].length);
-            ASSERT(dlmuvs[i].uvs.size == sizeof(lmuv.uvs[0]) * lmuv.length);
-            ASSERT(dlmuvs[i].indices.size == sizeof(lmuv.indices[0]) * lmuv.length);
+        default:
+            ASSERT(false);
+            break;
+        case StreamSlot_Albedo:
+            dst = &mat->albedo;
+            break;
+        case StreamSlot_Rome:
+            dst = &mat->rome;
+            break;
+        case StreamSlot_Normal:
+            dst = &mat->normal;
+            break;
+        }
+        texture_release(*dst);
+        *dst = id;
+    }
+    else
+    {
+        texture_release(id);
+    }
+    pim_free(target);
+}
+
+static streamtarget_t* NewTarget(drawables_t* dr, i32 i, StreamSlot slot)
+{
+    streamtarget_t* target = perm_malloc(sizeof(*target));
+    target->dr = dr;
+    target->name = dr->names[i];
+    target->index = i;
+    target->slot = slot;
+    return target;
+}
 
-            ASSERT(fstr_tell(fd) == dlmuvs[i].uvs.offset);
-            fstr_write(fd, lmuv.uvs, sizeof(lmuv.uvs[0]) * lmuv.length);
+static void StreamTexture(
+    drawables_t* dr,
+    archive_t* ar,
+    i32 i,
+    StreamSlot slot,
+    guid_t name,
+    AssetPri priority,
+    textureid_t* dst)
+{
+    if (texture_loadarchive(ar, name, dst))
+    {
+        return;
+    }
+    if (!guid_isnull(name))
+    {
+        texture_loadasync(name, priority, OnStreamedTexture, NewTarget(dr, i, slot));
+    }
+}
 
-            ASSERT(fstr_tell(fd) == dlmuvs[i].indices.offset);
-            fstr_write(fd, lmuv.indices, sizeof(lmuv.indices[0]) * lmuv.length);
-        }
+bool drawables_archive(const drawables_t* src, guid_t name, ArchiveCodec textureCodec)
+{
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".archive");
 
-        fstr_close(&fd);
-        return true;
+    archivewriter_t wr;
+    if (!archive_begin(&wr, filename))
+    {
+        return false;
+    }
+    bool wrote = true;
+    const i32 length = src->count;
+    for (i32 i = 0; i < length; ++i)
+    {
+        guid_t id;
+        if (mesh_exists(src->meshes[i]))
+        {
+            wrote &= mesh_archive(src->meshes[i], &wr, &id);
+        }
+        const material_t mat = src->materials[i];
+        const textureid_t textures[] = { mat.albedo, mat.rome, mat.normal };
+        for (i32 j = 0; j < NELEM(textures); ++j)
+        {
+            if (texture_exists(textures[j]))
+            {
+                wrote &= texture_archive(textures[j], &wr, textureCodec, &id);
+            }
+        }
     }
-    return false;
+    wrote &= archive_end(&wr);
+    return wrote;
+}
+
+bool drawables_load(drawables_t* dst, guid_t name, archive_t* ar)
+{
+    bool loaded = drawables_stream(dst, name, ar);
+    asset_load_flush();
+    return loaded;
+}
+
+// every array holds one element per drawable
+static bool HasLength(dbytes_t db, i32 length, i32 stride)
+{
+    return db.size == (i64)length * stride;
 }
 
-bool drawables_load(drawables_t* dst, guid_t name)
+bool drawables_stream(drawables_t* dst, guid_t name, archive_t* ar)
 {
     ASSERT(dst);
     bool loaded = false;
@@ -337,113 +489,107 @@ bool drawables_load(drawables_t* dst, guid_t name)
     char filename[PIM_PATH] = "data/";
     guid_tofile(ARGS(filename), name, ".drawables");
 
-    fstr_t fd = fstr_open(filename, "rb");
-    if (fstr_isopen(fd))
+    fmap_t map = { 0 };
+    const ddrawables_t* hdr = schema_open(&kDDrawablesSchema, filename, &map);
+    if (!hdr || (hdr->length <= 0))
+    {
+        goto cleanup;
+    }
+    const i32 len = hdr->length;
+    if (!HasLength(hdr->names, len, sizeof(dst->names[0])) ||
+        !HasLength(hdr->meshes, len, sizeof(dmeshid_t)) ||
+        !HasLength(hdr->bounds, len, sizeof(dst->bounds[0])) ||
+        !HasLength(hdr->materials, len, sizeof(dmaterial_t)) ||
+        !HasLength(hdr->lmuvs, len, sizeof(dlm_uvs_t)) ||
+        !HasLength(hdr->translations, len, sizeof(dst->translations[0])) ||
+        !HasLength(hdr->rotations, len, sizeof(dst->rotations[0])) ||
+        !HasLength(hdr->scales, len, sizeof(dst->scales[0])))
+    {
+        INTERRUPT();
+        goto cleanup;
+    }
+
+    // read in place from the mapping
+    const void* base = map.ptr;
+    const dmeshid_t* pim_noalias dmeshids = schema_at(base, hdr->meshes);
+    const dmaterial_t* pim_noalias dmats = schema_at(base, hdr->materials);
+    const dlm_uvs_t* pim_noalias dlmuvs = schema_at(base, hdr->lmuvs);
+    for (i32 i = 0; i < len; ++i)
     {
-        ddrawables_t hdr = { 0 };
-        fstr_read(fd, &hdr, sizeof(hdr));
-        if (hdr.version == kDrawablesVersion)
+        const dlm_uvs_t dlmuv = dlmuvs[i];
+        if ((dlmuv.length < 0) ||
+            !HasLength(dlmuv.uvs, dlmuv.length, sizeof(float2)) ||
+            !HasLength(dlmuv.indices, dlmuv.length, sizeof(i32)))
         {
-            const i32 len = hdr.length;
-            void* scratch = NULL;
-            if (len > 0)
-            {
-                dbytes_check(hdr.names, sizeof(dst->names[0]));
-                dbytes_check(hdr.meshes, sizeof(dmeshid_t));
-                dbytes_check(hdr.bounds, sizeof(dst->bounds[0]));
-                dbytes_check(hdr.materials, sizeof(dmaterial_t));
-                dbytes_check(hdr.lmuvs, sizeof(dlm_uvs_t));
-                dbytes_check(hdr.translations, sizeof(dst->translations[0]));
-                dbytes_check(hdr.rotations, sizeof(dst->rotations[0]));
-                dbytes_check(hdr.scales, sizeof(dst->scales[0]));
-
-                dst->count = len;
-                dst->names = perm_calloc(sizeof(dst->names[0]) * len);
-                dst->meshes = perm_calloc(sizeof(dst->meshes[0]) * len);
-                dst->bounds = perm_calloc(sizeof(dst->bounds[0]) * len);
-                dst->materials = perm_calloc(sizeof(dst->materials[0]) * len);
-                dst->lmUvs = perm_calloc(sizeof(dst->lmUvs[0]) * len);
-                dst->matrices = perm_calloc(sizeof(dst->matrices[0]) * len);
-                dst->invMatrices = perm_calloc(sizeof(dst->invMatrices[0]) * len);
-                dst->translations = perm_calloc(sizeof(dst->translations[0]) * len);
-                dst->rotations = perm_calloc(sizeof(dst->rotations[0]) * len);
-                dst->scales = perm_calloc(sizeof(dst->scales[0]) * len);
-
-                fstr_seek(fd, hdr.names.offset);
-                fstr_read(fd, dst->names, hdr.names.size);
-                {
-                    fstr_seek(fd, hdr.meshes.offset);
-                    dmeshid_t* pim_noalias dmeshids = tmp_realloc(scratch, hdr.names.size);
-                    fstr_read(fd, dmeshids, hdr.names.size);
-                    for (i32 i = 0; i < hdr.length; ++i)
-                    {
-                        mesh_load(dmeshids[i].id, dst->meshes + i);
-                    }
-                    scratch = dmeshids;
-                }
-                fstr_seek(fd, hdr.bounds.offset);
-                fstr_read(fd, dst->bounds, hdr.bounds.size);
-                {
-                    fstr_seek(fd, hdr.materials.offset);
-                    dmaterial_t* pim_noalias dmats = tmp_realloc(scratch, hdr.materials.size);
-                    fstr_read(fd, dmats, hdr.materials.size);
-                    for (i32 i = 0; i < hdr.length; ++i)
-                    {
-                        material_t mat = { 0 };
-                        const dmaterial_t dmat = dmats[i];
-                        mat.st = dmat.st;
-                        texture_load(dmat.albedo.id, &mat.albedo);
-                        texture_load(dmat.rome.id, &mat.rome);
-                        texture_load(dmat.normal.id, &mat.normal);
-                        mat.flatAlbedo = dmat.flatAlbedo;
-                        mat.flatRome = dmat.flatRome;
-                        mat.flags = dmat.flags;
-                        mat.ior = dmat.ior;
-                        dst->materials[i] = mat;
-                    }
-                    scratch = dmats;
-                }
-                {
-                    fstr_seek(fd, hdr.lmuvs.offset);
-                    dlm_uvs_t* pim_noalias dlmuvs = tmp_realloc(scratch, hdr.lmuvs.size);
-                    fstr_read(fd, dlmuvs, hdr.lmuvs.size);
-                    for (i32 i = 0; i < hdr.length; ++i)
-                    {
-                        const dlm_uvs_t dlmuv = dlmuvs[i];
-                        lm_uvs_t lmuv = { 0 };
-                        if (dlmuv.length < 0)
-                        {
-                            goto cleanup;
-                        }
-                        dbytes_check(dlmuv.uvs, sizeof(lmuv.uvs[0]));
-                        dbytes_check(dlmuv.indices, sizeof(lmuv.indices[0]));
-                        lmuv.length = dlmuv.length;
-                        lmuv.uvs = perm_calloc(dlmuv.uvs.size);
-                        lmuv.indices = perm_calloc(dlmuv.indices.size);
-                        fstr_seek(fd, dlmuv.uvs.offset);
-                        fstr_read(fd, lmuv.uvs, dlmuv.uvs.size);
-                        fstr_seek(fd, dlmuv.indices.offset);
-                        fstr_read(fd, lmuv.indices, dlmuv.indices.size);
-                        dst->lmUvs[i] = lmuv;
-                    }
-                    scratch = dlmuvs;
-                }
-
-                fstr_seek(fd, hdr.translations.offset);
-                fstr_read(fd, dst->translations, hdr.translations.size);
-
-                fstr_seek(fd, hdr.rotations.offset);
-                fstr_read(fd, dst->rotations, hdr.rotations.size);
-
-                fstr_seek(fd, hdr.scales.offset);
-                fstr_read(fd, dst->scales, hdr.scales.size);
-
-                loaded = true;
-            }
+            INTERRUPT();
+            goto cleanup;
+        }
+    }
+
+    dst->count = len;
+    dst->names = perm_calloc(sizeof(dst->names[0]) * len);
+    dst->meshes = perm_calloc(sizeof(dst->meshes[0]) * len);
+    dst->bounds = perm_calloc(sizeof(dst->bounds[0]) * len);
+    dst->materials = perm_calloc(sizeof(dst->materials[0]) * len);
+    dst->lmUvs = perm_calloc(sizeof(dst->lmUvs[0]) * len);
+    dst->matrices = perm_calloc(sizeof(dst->matrices[0]) * len);
+    dst->invMatrices = perm_calloc(sizeof(dst->invMatrices[0]) * len);
+    dst->translations = perm_calloc(sizeof(dst->translations[0]) * len);
+    dst->rotations = perm_calloc(sizeof(dst->rotations[0]) * len);
+    dst->scales = perm_calloc(sizeof(dst->scales[0]) * len);
+    dst->versions = perm_calloc(sizeof(dst->versions[0]) * len);
+    for (i32 i = 0; i < len; ++i)
+    {
+        dst->versions[i] = NewVersion();
+    }
+
+    memcpy(dst->names, schema_at(base, hdr->names), hdr->names.size);
+    memcpy(dst->bounds, schema_at(base, hdr->bounds), hdr->bounds.size);
+    memcpy(dst->translations, schema_at(base, hdr->translations), hdr->translations.size);
+    memcpy(dst->rotations, schema_at(base, hdr->rotations), hdr->rotations.size);
+    memcpy(dst->scales, schema_at(base, hdr->scales), hdr->scales.size);
+
+    for (i32 i = 0; i < len; ++i)
+    {
+        if (mesh_loadarchive(ar, dmeshids[i].id, dst->meshes + i))
+        {
+            continue;
+        }
+        if (!guid_isnull(dmeshids[i].id))
+        {
+            mesh_loadasync(dmeshids[i].id, AssetPri_High, OnStreamedMesh, NewTarget(dst, i, StreamSlot_Mesh));
         }
     }
+    for (i32 i = 0; i < len; ++i)
+    {
+        material_t mat = { 0 };
+        const dmaterial_t dmat = dmats[i];
+        mat.st = dmat.st;
+        StreamTexture(dst, ar, i, StreamSlot_Albedo, dmat.albedo.id, AssetPri_Normal, &mat.albedo);
+        StreamTexture(dst, ar, i, StreamSlot_Rome, dmat.rome.id, AssetPri_Low, &mat.rome);
+        StreamTexture(dst, ar, i, StreamSlot_Normal, dmat.normal.id, AssetPri_Low, &mat.normal);
+        mat.flatAlbedo = dmat.flatAlbedo;
+        mat.flatRome = dmat.flatRome;
+        mat.flags = dmat.flags;
+        mat.ior = dmat.ior;
+        dst->materials[i] = mat;
+    }
+    for (i32 i = 0; i < len; ++i)
+    {
+        const dlm_uvs_t dlmuv = dlmuvs[i];
+        lm_uvs_t lmuv = { 0 };
+        lmuv.length = dlmuv.length;
+        lmuv.uvs = perm_malloc(dlmuv.uvs.size);
+        lmuv.indices = perm_malloc(dlmuv.indices.size);
+        memcpy(lmuv.uvs, schema_at(base, dlmuv.uvs), dlmuv.uvs.size);
+        memcpy(lmuv.indices, schema_at(base, dlmuv.indices), dlmuv.indices.size);
+        dst->lmUvs[i] = lmuv;
+    }
+
+    loaded = true;
+
 cleanup:
-    fstr_close(&fd);
+    fmap_destroy(&map);
     if (!loaded)
     {
         drawables_del(dst);
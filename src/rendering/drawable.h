@@ -4,6 +4,7 @@
 #include "common/dbytes.h"
 #include "common/guid.h"
 #include "math/types.h"
+#include "assets/archive.h"
 
 PIM_C_BEGIN
 
@@ -24,12 +25,13 @@ typedef struct drawables_s
     float4* pim_noalias translations;
     quat* pim_noalias rotations;
     float4* pim_noalias scales;
+    u32* pim_noalias versions;          // unique stamp, renewed when added or its matrix changes
 } drawables_t;
 
-#define kDrawablesVersion 2
+// root of a schema blob, see drawables_save
+#define kDrawablesVersion 3
 typedef struct ddrawables_s
 {
-    i32 version;
     i32 length;
     dbytes_t names;
     dbytes_t meshes;    // dmeshid_t
@@ -55,6 +57,13 @@ void drawables_updatetransforms(drawables_t* dr);
 box_t drawables_bounds(const drawables_t* dr);
 
 bool drawables_save(const drawables_t* src, guid_t name);
-bool drawables_load(drawables_t* dst, guid_t name);
+// writes the meshes and textures of src into one cooked archive
+bool drawables_archive(const drawables_t* src, guid_t name, ArchiveCodec textureCodec);
+// meshes and textures found in ar are referenced in place, the rest are
+// read from their own files. ar may be null.
+bool drawables_load(drawables_t* dst, guid_t name, archive_t* ar);
+// returns once the drawables exist; meshes and textures missing from ar
+// arrive over the following frames from asset_sys_update
+bool drawables_stream(drawables_t* dst, guid_t name, archive_t* ar);
 
 PIM_C_END
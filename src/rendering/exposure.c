@@ -116,92 +116,79 @@ static float AdaptLuminance(
     return f1_lerp(lum0, lum1, f1_sat(t));
 }
 
-typedef struct task_ToLum
+// log2 of the luminance at the center of a bin's linear range
+static float BinToLog2(i32 bin)
 {
-    task_t task;
-    const float4* light;
-    i32 lenPerJob;
-    float averages[kMaxThreads];
-} task_ToLum;
+    const i32 bias = (127 + kExposureMinLog2) * kExposureBinsPerEV;
+    union { i32 i; float f; } u = { ((bin + bias) << (23 - 2)) | (1 << (23 - 3)) };
+    return log2f(u.f);
+}
 
-static void CalcAverageFn(task_t* pbase, i32 begin, i32 end)
+// geometric mean luminance of the [minProb, maxProb] range of the cdf.
+// clipping the tails keeps fireflies and small dark regions from
+// pulling the exposure around.
+static float MeterHistogram(
+    const exphist_t* hist,
+    float minProb,
+    float maxProb,
+    float prevLum)
 {
-    task_ToLum* task = (task_ToLum*)pbase;
-    float* pim_noalias averages = task->averages;
-    const float4* pim_noalias light = task->light;
-    const i32 lenPerJob = task->lenPerJob;
-    const float weight = 1.0f / lenPerJob;
-    for (i32 i = begin; i < end; ++i)
+    const float* pim_noalias bins = hist->bins;
+    float total = 0.0f;
+    for (i32 i = 0; i < kExposureBins; ++i)
     {
-        const float4* pim_noalias jobLight = light + lenPerJob * i;
-        float sum = 0.0f;
-        for (i32 j = 0; j < lenPerJob; ++j)
-        {
-            float lum = f4_perlum(jobLight[j]);
-            sum = weight * lum + sum;
-        }
-        averages[i] = sum;
+        total += bins[i];
     }
-}
-
-static float CalcAverage(const float4* light, int2 size)
-{
-    const i32 numthreads = task_thread_ct();
-    const i32 lenPerJob = (size.x * size.y) / numthreads;
-    task_ToLum* task = tmp_calloc(sizeof(*task));
-    task->light = light;
-    task->lenPerJob = lenPerJob;
-    task_run(&task->task, CalcAverageFn, numthreads);
-    const float* pim_noalias averages = task->averages;
-    float sum = 0.0f;
-    const float weight = 1.0f / numthreads;
-    for (i32 i = 0; i < numthreads; ++i)
+    if (total <= 0.0f)
     {
-        sum = weight * averages[i] + sum;
+        return prevLum;
     }
-    return sum;
-}
-
-typedef struct task_Expose
-{
-    task_t task;
-    float4* light;
-    float exposure;
-} task_Expose;
 
-static void ExposeFn(task_t* pbase, i32 begin, i32 end)
-{
-    task_Expose* task = (task_Expose*)pbase;
-    float4* pim_noalias light = task->light;
-    const float exposure = task->exposure;
-
-    for (i32 i = begin; i < end; ++i)
+    const float lo = f1_sat(minProb) * total;
+    const float hi = f1_max(lo, f1_sat(maxProb) * total);
+    float cdf = 0.0f;
+    float logSum = 0.0f;
+    float weightSum = 0.0f;
+    i32 loBin = kExposureBins - 1;
+    for (i32 i = 0; i < kExposureBins; ++i)
     {
-        light[i] = f4_mulvs(light[i], exposure);
+        float a = f1_max(cdf, lo);
+        cdf += bins[i];
+        float b = f1_min(cdf, hi);
+        if ((cdf >= lo) && (loBin > i))
+        {
+            loBin = i;
+        }
+        if (b > a)
+        {
+            float log2Lum = BinToLog2(i);
+            logSum = (b - a) * log2Lum + logSum;
+            weightSum += b - a;
+        }
     }
+
+    // an empty range degenerates to the minProb percentile
+    float log2Lum = (weightSum > 0.0f) ? (logSum / weightSum) : BinToLog2(loBin);
+    return exp2f(log2Lum);
 }
 
-ProfileMark(pm_exposeimg, ExposeImage)
-void ExposeImage(
-    int2 size,
-    float4* pim_noalias light,
-    exposure_t* parameters)
+ProfileMark(pm_UpdateExposure, UpdateExposure)
+float UpdateExposure(exposure_t* parameters, const exphist_t* hist)
 {
-    ProfileBegin(pm_exposeimg);
-
-    float avgLum = CalcAverage(light, size);
-    avgLum = AdaptLuminance(
+    ProfileBegin(pm_UpdateExposure);
+
+    parameters->frameLum = MeterHistogram(
+        hist,
+        parameters->histMinProb,
+        parameters->histMaxProb,
+        parameters->frameLum);
+    parameters->avgLum = AdaptLuminance(
         parameters->avgLum,
-        avgLum,
+        parameters->frameLum,
         parameters->deltaTime,
         parameters->adaptRate);
-    parameters->avgLum = avgLum;
     float exposure = CalcExposure(*parameters);
 
-    task_Expose* task = tmp_calloc(sizeof(*task));
-    task->light = light;
-    task->exposure = exposure;
-    task_run(&task->task, ExposeFn, size.x * size.y);
-
-    ProfileEnd(pm_exposeimg);
+    ProfileEnd(pm_UpdateExposure);
+    return exposure;
 }
@@ -6,6 +6,16 @@
 
 PIM_C_BEGIN
 
+// log2 luminance histogram, 4 bins per EV over [2^-16, 2^16)
+#define kExposureBinsPerEV  4
+#define kExposureMinLog2    -16
+#define kExposureBins       128
+
+typedef struct exphist_s
+{
+    float bins[kExposureBins];
+} exphist_t;
+
 typedef struct exposure_s
 {
     // manual: ev100 is based on camera parameters
@@ -19,6 +29,8 @@ typedef struct exposure_s
     float ISO;
 
     float avgLum;
+    // luminance metered from the last resolve's histogram, before exposure
+    float frameLum;
     float deltaTime;
     float adaptRate;
 
@@ -27,8 +39,31 @@ typedef struct exposure_s
     // range of the cdf to consider
     float histMinProb;
     float histMaxProb;
+    // metering weight of the image center over its corners, in [0, 1]
+    float centerWeight;
+    // meters every meterStride'th row of the light buffer
+    i32 meterStride;
 } exposure_t;
 
-void ExposeImage(int2 size, float4* pim_noalias light, exposure_t* parameters);
+// piecewise linear log2 from the exponent and top mantissa bits of lum;
+// bins span equal linear ranges within an octave. lum must be non-negative.
+pim_inline i32 VEC_CALL Exposure_LumToBin(float lum)
+{
+    union { float f; i32 i; } u = { lum };
+    const i32 bias = (127 + kExposureMinLog2) * kExposureBinsPerEV;
+    i32 bin = (u.i >> (23 - 2)) - bias;
+    return i1_clamp(bin, 0, kExposureBins - 1);
+}
+
+// metering weight of a texel at ndc (x, y), falling off toward the corners
+pim_inline float VEC_CALL Exposure_Weight(float centerWeight, float x, float y)
+{
+    return 1.0f - centerWeight * 0.5f * (x * x + y * y);
+}
+
+// meters hist into frameLum, adapts avgLum toward it and returns the scale
+// to apply to the light buffer. the resolve applies it and fills the next
+// frame's histogram in the same pass.
+float UpdateExposure(exposure_t* parameters, const exphist_t* hist);
 
 PIM_C_END
@@ -24,6 +24,16 @@ void framebuf_destroy(framebuf_t* buf)
     buf->color = NULL;
 }
 
+void framebuf_resize(framebuf_t* buf, i32 width, i32 height)
+{
+    ASSERT(buf);
+    if ((buf->width != width) || (buf->height != height))
+    {
+        framebuf_destroy(buf);
+        framebuf_create(buf, width, height);
+    }
+}
+
 i32 framebuf_color_bytes(framebuf_t buf)
 {
     return buf.width * buf.height * sizeof(buf.color[0]);
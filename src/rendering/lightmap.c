@@ -7,6 +7,7 @@
 #include "math/float4x4_funcs.h"
 #include "math/sdf.h"
 #include "math/area.h"
+#include "math/box.h"
 #include "math/sampling.h"
 #include "math/sh.h"
 #include "math/sphgauss.h"
@@ -22,6 +23,7 @@
 #include "common/profiler.h"
 #include "common/cmd.h"
 #include "common/atomics.h"
+#include "common/stats.h"
 #include "io/fstr.h"
 #include <stb/stb_image_write.h>
 #include <string.h>
@@ -39,10 +41,14 @@ typedef enum
     LmChannel_COUNT
 } LmChannel;
 
+// 1 bit per texel, rows padded to whole words
 typedef struct mask_s
 {
     int2 size;
-    u8* ptr;
+    i32 stride;         // words per row
+    u64* ptr;
+    i32* rowCounts;     // set bits per row
+    int2* rowRanges;    // first and last set column per row, x > y when empty
 } mask_t;
 
 typedef struct chartnode_s
@@ -73,9 +79,15 @@ typedef struct atlas_s
 
 static lmpack_t ms_pack;
 static bool ms_once;
+static stat_t* ms_bakeSamples;
 
 static cmdstat_t CmdPrintLm(i32 argc, const char** argv);
 
+void lightmap_sys_init(void)
+{
+    ms_bakeSamples = stat_counter("lm.bake_samples");
+}
+
 lmpack_t* lmpack_get(void) { return &ms_pack; }
 
 void lightmap_new(lightmap_t* lm, i32 size)
@@ -137,21 +149,69 @@ pim_inline void chartnode_sort(chartnode_t* nodes, i32 count)
     pimsort(nodes, count, sizeof(nodes[0]), chartnode_cmp, NULL);
 }
 
+pim_inline i32 popcnt64(u64 x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (i32)((x * 0x0101010101010101ull) >> 56);
+}
+
 pim_inline mask_t VEC_CALL mask_new(int2 size)
 {
-    i32 len = size.x * size.y;
     mask_t mask;
     mask.size = size;
-    mask.ptr = perm_calloc(sizeof(u8) * len);
+    mask.stride = (size.x + 63) >> 6;
+    mask.ptr = perm_calloc(sizeof(mask.ptr[0]) * mask.stride * size.y);
+    mask.rowCounts = perm_calloc(sizeof(mask.rowCounts[0]) * size.y);
+    mask.rowRanges = perm_malloc(sizeof(mask.rowRanges[0]) * size.y);
+    for (i32 y = 0; y < size.y; ++y)
+    {
+        mask.rowRanges[y] = i2_v(size.x, -1);
+    }
     return mask;
 }
 
 pim_inline void VEC_CALL mask_del(mask_t* mask)
 {
     pim_free(mask->ptr);
-    mask->ptr = NULL;
-    mask->size.x = 0;
-    mask->size.y = 0;
+    pim_free(mask->rowCounts);
+    pim_free(mask->rowRanges);
+    memset(mask, 0, sizeof(*mask));
+}
+
+pim_inline void VEC_CALL mask_set(mask_t mask, i32 x, i32 y)
+{
+    ASSERT((u32)x < (u32)mask.size.x);
+    ASSERT((u32)y < (u32)mask.size.y);
+    u64* pim_noalias row = mask.ptr + y * mask.stride;
+    const u64 bit = 1ull << (x & 63);
+    if (!(row[x >> 6] & bit))
+    {
+        row[x >> 6] |= bit;
+        mask.rowCounts[y] += 1;
+        int2 range = mask.rowRanges[y];
+        range.x = i1_min(range.x, x);
+        range.y = i1_max(range.y, x);
+        mask.rowRanges[y] = range;
+    }
+}
+
+// word k of a row after shifting it left by (64 * base + shift) bits
+pim_inline u64 VEC_CALL mask_shifted(const u64* pim_noalias row, i32 stride, i32 k, i32 base, i32 shift)
+{
+    i32 i = k - base;
+    u64 word = ((u32)i < (u32)stride) ? (row[i] << shift) : 0;
+    if (shift && ((u32)(i - 1) < (u32)stride))
+    {
+        word |= row[i - 1] >> (64 - shift);
+    }
+    return word;
+}
+
+pim_inline i32 VEC_CALL mask_wordbase(i32 x)
+{
+    return (x >= 0) ? (x >> 6) : -((63 - x) >> 6);
 }
 
 pim_inline float4 VEC_CALL norm_blend(float4 A, float4 B, float4 C, float4 wuv)
@@ -167,30 +227,36 @@ pim_inline float2 VEC_CALL lm_blend(float3 a, float3 b, float3 c, float4 wuv)
     return lm;
 }
 
+// tests 64 texels per word; cheap enough to run over every candidate
 pim_inline bool VEC_CALL mask_fits(mask_t a, mask_t b, int2 tr)
 {
+    const i32 base = mask_wordbase(tr.x);
+    const i32 shift = tr.x - base * 64;
     for (i32 by = 0; by < b.size.y; ++by)
     {
-        for (i32 bx = 0; bx < b.size.x; ++bx)
+        if (!b.rowCounts[by])
         {
-            i32 bi = bx + by * b.size.x;
-            if (b.ptr[bi])
+            continue;
+        }
+        i32 ay = by + tr.y;
+        if ((u32)ay >= (u32)a.size.y)
+        {
+            return false;
+        }
+        int2 range = b.rowRanges[by];
+        i32 lo = range.x + tr.x;
+        i32 hi = range.y + tr.x;
+        if ((lo < 0) || (hi >= a.size.x))
+        {
+            return false;
+        }
+        const u64* pim_noalias arow = a.ptr + ay * a.stride;
+        const u64* pim_noalias brow = b.ptr + by * b.stride;
+        for (i32 k = lo >> 6; k <= (hi >> 6); ++k)
+        {
+            if (arow[k] & mask_shifted(brow, b.stride, k, base, shift))
             {
-                i32 ax = bx + tr.x;
-                i32 ay = by + tr.y;
-                if (ax < 0 || ay < 0)
-                {
-                    return false;
-                }
-                if (ax >= a.size.x || ay >= a.size.y)
-                {
-                    return false;
-                }
-                i32 ai = ax + ay * a.size.x;
-                if (a.ptr[ai])
-                {
-                    return false;
-                }
+                return false;
             }
         }
     }
@@ -199,24 +265,34 @@ pim_inline bool VEC_CALL mask_fits(mask_t a, mask_t b, int2 tr)
 
 pim_inline void VEC_CALL mask_write(mask_t a, mask_t b, int2 tr)
 {
+    const i32 base = mask_wordbase(tr.x);
+    const i32 shift = tr.x - base * 64;
     for (i32 by = 0; by < b.size.y; ++by)
     {
-        for (i32 bx = 0; bx < b.size.x; ++bx)
+        if (!b.rowCounts[by])
         {
-            i32 bi = bx + by * b.size.x;
-            if (b.ptr[bi])
-            {
-                i32 ax = bx + tr.x;
-                i32 ay = by + tr.y;
-                i32 ai = ax + ay * a.size.x;
-                ASSERT(ax >= 0);
-                ASSERT(ay >= 0);
-                ASSERT(ax < a.size.x);
-                ASSERT(ay < a.size.y);
-                ASSERT(!a.ptr[ai]);
-                a.ptr[ai] = b.ptr[bi];
-            }
+            continue;
         }
+        i32 ay = by + tr.y;
+        int2 range = b.rowRanges[by];
+        i32 lo = range.x + tr.x;
+        i32 hi = range.y + tr.x;
+        ASSERT((u32)ay < (u32)a.size.y);
+        ASSERT(lo >= 0);
+        ASSERT(hi < a.size.x);
+        u64* pim_noalias arow = a.ptr + ay * a.stride;
+        const u64* pim_noalias brow = b.ptr + by * b.stride;
+        for (i32 k = lo >> 6; k <= (hi >> 6); ++k)
+        {
+            u64 word = mask_shifted(brow, b.stride, k, base, shift);
+            ASSERT(!(arow[k] & word));
+            arow[k] |= word;
+        }
+        a.rowCounts[ay] += b.rowCounts[by];
+        int2 arange = a.rowRanges[ay];
+        arange.x = i1_min(arange.x, lo);
+        arange.y = i1_max(arange.y, hi);
+        a.rowRanges[ay] = arange;
     }
 }
 
@@ -259,7 +335,7 @@ pim_inline void VEC_CALL mask_tri(mask_t mask, tri2d_t tri)
             float2 pt = { (float)x, (float)y };
             if (TriTest(tri, pt))
             {
-                mask.ptr[i] = 0xff;
+                mask_set(mask, x, y);
             }
         }
     }
@@ -275,18 +351,55 @@ pim_inline mask_t VEC_CALL mask_fromtri(tri2d_t tri)
     return mask;
 }
 
+// rejects a row offset when any atlas row has fewer free texels than needed
+pim_inline bool VEC_CALL mask_rowsfit(mask_t atlas, mask_t item, i32 y)
+{
+    for (i32 by = 0; by < item.size.y; ++by)
+    {
+        i32 count = item.rowCounts[by];
+        if (count && ((atlas.size.x - atlas.rowCounts[by + y]) < count))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 pim_inline bool VEC_CALL mask_find(mask_t atlas, mask_t item, int2* trOut, i32 prevRow)
 {
-    int2 lo = i2_addvs(i2_neg(item.size), 1);
-    int2 hi = i2_subvs(atlas.size, 1);
+    // bounds of the set texels
+    int2 lo = item.size;
+    int2 hi = { -1, -1 };
+    for (i32 y = 0; y < item.size.y; ++y)
+    {
+        if (item.rowCounts[y])
+        {
+            int2 range = item.rowRanges[y];
+            lo = i2_min(lo, i2_v(range.x, y));
+            hi = i2_max(hi, i2_v(range.y, y));
+        }
+    }
+    if (hi.y < 0)
+    {
+        *trOut = i2_0;
+        return true;
+    }
+
+    // only offsets that keep the set texels inside the atlas
+    lo = i2_neg(lo);
+    hi = i2_sub(i2_subvs(atlas.size, 1), hi);
     i32 y = lo.y;
     if (prevRow != ROW_RESET)
     {
-        y = prevRow;
+        y = i1_max(y, prevRow);
     }
-    for (; y < hi.y; ++y)
+    for (; y <= hi.y; ++y)
     {
-        for (i32 x = lo.x; x < hi.x; ++x)
+        if (!mask_rowsfit(atlas, item, y))
+        {
+            continue;
+        }
+        for (i32 x = lo.x; x <= hi.x; ++x)
         {
             int2 tr = { x, y };
             if (mask_fits(atlas, item, tr))
@@ -664,22 +777,16 @@ static chart_t* chart_group(
     return charts;
 }
 
-pim_inline i32 chart_cmp(const void* plhs, const void* prhs, void* usr)
+// largest area first
+pim_inline void chart_sort(chart_t* charts, i32 chartCount)
 {
-    const chart_t* lhs = plhs;
-    const chart_t* rhs = prhs;
-    float a = lhs->area;
-    float b = rhs->area;
-    if (a != b)
+    u32* keys = tmp_malloc(sizeof(keys[0]) * chartCount);
+    for (i32 i = 0; i < chartCount; ++i)
     {
-        return a > b ? -1 : 1;
+        keys[i] = ~sortkey_f32(charts[i].area);
     }
-    return 0;
-}
-
-pim_inline void chart_sort(chart_t* charts, i32 chartCount)
-{
-    pimsort(charts, chartCount, sizeof(charts[0]), chart_cmp, NULL);
+    i32* order = keysort_u32(keys, chartCount);
+    sort_permute(charts, chartCount, sizeof(charts[0]), order);
 }
 
 pim_inline atlas_t atlas_new(i32 size)
@@ -867,8 +974,11 @@ pim_inline i32 atlas_estimate(i32 atlasSize, const chart_t* charts, i32 chartCou
     return i1_max(1, atlasCount);
 }
 
+ProfileMark(pm_AtlasesCreate, atlases_create)
 static i32 atlases_create(i32 atlasSize, chart_t* charts, i32 chartCount)
 {
+    ProfileBegin(pm_AtlasesCreate);
+
     i32 atlasCount = atlas_estimate(atlasSize, charts, chartCount);
     atlas_t* atlases = perm_calloc(sizeof(atlases[0]) * atlasCount);
     for (i32 i = 0; i < atlasCount; ++i)
@@ -885,16 +995,26 @@ static i32 atlases_create(i32 atlasSize, chart_t* charts, i32 chartCount)
     task_run(&task->task, AtlasFn, chartCount);
 
     i32 usedAtlases = 0;
+    i64 usedTexels = 0;
     for (i32 i = 0; i < atlasCount; ++i)
     {
         if (atlases[i].chartCount > 0)
         {
             ++usedAtlases;
+            for (i32 y = 0; y < atlasSize; ++y)
+            {
+                usedTexels += atlases[i].mask.rowCounts[y];
+            }
         }
         atlas_del(atlases + i);
     }
     pim_free(atlases);
 
+    const double totalTexels = (double)i1_max(1, usedAtlases) * atlasSize * atlasSize;
+    con_logf(LogSev_Info, "LM", "Packed %d charts into %d atlases, %.1f%% occupied",
+        chartCount, usedAtlases, 100.0 * usedTexels / totalTexels);
+
+    ProfileEnd(pm_AtlasesCreate);
     return usedAtlases;
 }
 
@@ -950,291 +1070,277 @@ static void chartnodes_assign(
     }
 }
 
-typedef struct quadtree_s
-{
-    i32 maxDepth;
-    i32 nodeCount;
-    box2d_t* pim_noalias boxes;         // bounding box of node
-    i32* pim_noalias listLens;          // number of triangles in this node
-    tri2d_t** pim_noalias triLists;     // lightmap UV
-    int2** pim_noalias indexLists;      // iDrawable, iVert
-} quadtree_t;
+#define kEmbedTileSize 16
 
-pim_inline i32 CalcNodeCount(i32 maxDepth)
+typedef struct embedtri_s
 {
-    i32 nodeCount = 0;
-    for (i32 i = 0; i < maxDepth; ++i)
-    {
-        nodeCount += 1 << (2 * i);
-    }
-    return nodeCount;
-}
+    tri2d_t tri;    // lightmap UV
+    i32 iDrawable;
+    i32 iVert;
+} embedtri_t;
 
-pim_inline i32 GetChild(i32 parent, i32 i)
+// triangles binned by the lightmap tiles their search region overlaps,
+// flattened so each tile's list is contiguous
+typedef struct embedbins_s
 {
-    return (parent << 2) | (i + 1);
-}
+    i32 tilesPerSide;
+    i32 tilesPerMap;
+    i32* pim_noalias offsets;       // [lmCount * tilesPerMap + 1]
+    i32* pim_noalias triIndices;
+    embedtri_t* pim_noalias tris;
+    i32 triCount;
+} embedbins_t;
 
-pim_inline i32 GetParent(i32 c)
+pim_inline void VEC_CALL TriTileRange(
+    tri2d_t tri,
+    i32 lmSize,
+    float limit,
+    int2* pim_noalias loOut,
+    int2* pim_noalias hiOut)
 {
-    return (c - 1) >> 2;
+    float2 lo = f2_min(f2_min(tri.a, tri.b), tri.c);
+    float2 hi = f2_max(f2_max(tri.a, tri.b), tri.c);
+    lo = f2_mulvs(f2_subvs(lo, limit), (float)lmSize);
+    hi = f2_mulvs(f2_addvs(hi, limit), (float)lmSize);
+    int2 texelLo = i2_clamp(f2_i2(f2_floor(lo)), i2_0, i2_s(lmSize - 1));
+    int2 texelHi = i2_clamp(f2_i2(f2_ceil(hi)), i2_0, i2_s(lmSize - 1));
+    *loOut = i2_divvs(texelLo, kEmbedTileSize);
+    *hiOut = i2_divvs(texelHi, kEmbedTileSize);
 }
 
-static void SetupBounds(box2d_t* pim_noalias boxes, i32 p, i32 nodeCount)
+static void embedbins_new(embedbins_t* bins, i32 lmCount, i32 lmSize, float limit)
 {
-    const i32 c0 = GetChild(p, 0);
-    if ((c0 + 4) <= nodeCount)
+    memset(bins, 0, sizeof(*bins));
+    const i32 tilesPerSide = (lmSize + kEmbedTileSize - 1) / kEmbedTileSize;
+    const i32 tilesPerMap = tilesPerSide * tilesPerSide;
+    const i32 tileCount = tilesPerMap * lmCount;
+    bins->tilesPerSide = tilesPerSide;
+    bins->tilesPerMap = tilesPerMap;
+
+    const drawables_t* drawables = drawables_get();
+    const i32 dwCount = drawables->count;
+    const meshid_t* pim_noalias meshids = drawables->meshes;
+    const lm_uvs_t* pim_noalias uvArray = drawables->lmUvs;
+
+    // gather mapped triangles
+    i32 triCount = 0;
+    for (i32 iDraw = 0; iDraw < dwCount; ++iDraw)
     {
+        triCount += uvArray[iDraw].length / 3;
+    }
+    embedtri_t* pim_noalias tris = perm_malloc(sizeof(tris[0]) * i1_max(1, triCount));
+    triCount = 0;
+    for (i32 iDraw = 0; iDraw < dwCount; ++iDraw)
+    {
+        const lm_uvs_t lmUvs = uvArray[iDraw];
+        if (!lmUvs.length)
         {
-            float2 pcenter = f2_lerp(boxes[p].lo, boxes[p].hi, 0.5f);
-            float2 pextents = f2_sub(boxes[p].hi, pcenter);
-            float2 cextents = f2_mulvs(pextents, 0.5f);
-            for (i32 i = 0; i < 4; ++i)
-            {
-                float2 sign;
-                sign.x = (i & 1) ? -1.0f : 1.0f;
-                sign.y = (i & 2) ? -1.0f : 1.0f;
-                float2 ccenter = f2_add(pcenter, f2_mul(sign, cextents));
-                boxes[c0 + i].lo = f2_sub(ccenter, cextents);
-                boxes[c0 + i].hi = f2_add(ccenter, cextents);
-            }
+            continue;
         }
-        for (i32 i = 0; i < 4; ++i)
+        mesh_t mesh;
+        if (!mesh_get(meshids[iDraw], &mesh))
         {
-            SetupBounds(boxes, c0 + i, nodeCount);
+            continue;
         }
-    }
-}
-
-pim_inline void quadtree_new(quadtree_t* qt, i32 maxDepth, box2d_t bounds)
-{
-    i32 len = CalcNodeCount(maxDepth);
-    qt->maxDepth = maxDepth;
-    qt->nodeCount = len;
-    qt->boxes = perm_calloc(sizeof(qt->boxes[0]) * len);
-    qt->listLens = perm_calloc(sizeof(qt->listLens[0]) * len);
-    qt->triLists = perm_calloc(sizeof(qt->triLists[0]) * len);
-    qt->indexLists = perm_calloc(sizeof(qt->indexLists[0]) * len);
-    if (len > 0)
-    {
-        qt->boxes[0] = bounds;
-        SetupBounds(qt->boxes, 0, len);
-    }
-}
-
-pim_inline void quadtree_del(quadtree_t* qt)
-{
-    if (qt)
-    {
-        pim_free(qt->boxes);
-        pim_free(qt->listLens);
-        i32 len = qt->nodeCount;
-        for (i32 i = 0; i < len; ++i)
+        for (i32 iVert = 0; (iVert + 3) <= mesh.length; iVert += 3)
         {
-            pim_free(qt->triLists[i]);
-            pim_free(qt->indexLists[i]);
+            ASSERT((iVert + 2) < lmUvs.length);
+            const i32 iMap = lmUvs.indices[iVert / 3];
+            if ((iMap >= 0) && (iMap < lmCount))
+            {
+                embedtri_t et;
+                et.tri.a = lmUvs.uvs[iVert + 0];
+                et.tri.b = lmUvs.uvs[iVert + 1];
+                et.tri.c = lmUvs.uvs[iVert + 2];
+                et.iDrawable = iDraw;
+                et.iVert = iVert;
+                tris[triCount++] = et;
+            }
         }
-        pim_free(qt->triLists);
-        pim_free(qt->indexLists);
-        memset(qt, 0, sizeof(*qt));
     }
-}
-
-pim_inline bool VEC_CALL BoxHoldsTri(box2d_t box, tri2d_t tri)
-{
-    float2 lo = box.lo;
-    float2 hi = box.hi;
-    bool2 a = b2_and(b2_and(f2_gteq(tri.a, lo), f2_gteq(tri.b, lo)), f2_gteq(tri.c, lo));
-    bool2 b = b2_and(b2_and(f2_lteq(tri.a, hi), f2_lteq(tri.b, hi)), f2_lteq(tri.c, hi));
-    return b2_all(b2_and(a, b));
-}
-
-pim_inline bool VEC_CALL BoxHoldsPt(box2d_t box, float2 pt)
-{
-    return b2_all(b2_and(f2_gteq(pt, box.lo), f2_lteq(pt, box.hi)));
-}
 
-static bool quadtree_insert(quadtree_t* pim_noalias qt, i32 n, tri2d_t tri, i32 iDrawable, i32 iVert)
-{
-    if (n < qt->nodeCount)
+    // count, prefix sum, then fill
+    i32* pim_noalias offsets = perm_calloc(sizeof(offsets[0]) * (tileCount + 1));
+    for (i32 i = 0; i < triCount; ++i)
     {
-        if (BoxHoldsTri(qt->boxes[n], tri))
+        const embedtri_t et = tris[i];
+        const i32 iMap = uvArray[et.iDrawable].indices[et.iVert / 3];
+        int2 lo, hi;
+        TriTileRange(et.tri, lmSize, limit, &lo, &hi);
+        for (i32 y = lo.y; y <= hi.y; ++y)
         {
-            for (i32 i = 0; i < 4; ++i)
+            for (i32 x = lo.x; x <= hi.x; ++x)
             {
-                if (quadtree_insert(qt, GetChild(n, i), tri, iDrawable, iVert))
-                {
-                    return true;
-                }
+                offsets[iMap * tilesPerMap + x + y * tilesPerSide + 1] += 1;
             }
-            i32 len = qt->listLens[n] + 1;
-            qt->listLens[n] = len;
-            PermReserve(qt->triLists[n], len);
-            qt->triLists[n][len - 1] = tri;
-            PermReserve(qt->indexLists[n], len);
-            qt->indexLists[n][len - 1] = i2_v(iDrawable, iVert);
-            return true;
         }
     }
-    return false;
-}
-
-static float quadtree_find(
-    const quadtree_t* qt,
-    i32 n,
-    float2 pt,
-    float limit,
-    int2* pim_noalias indOut)
-{
-    if (n < qt->nodeCount)
+    for (i32 i = 0; i < tileCount; ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    i32* pim_noalias heads = tmp_malloc(sizeof(heads[0]) * i1_max(1, tileCount));
+    memcpy(heads, offsets, sizeof(heads[0]) * tileCount);
+    i32* pim_noalias triIndices = perm_malloc(sizeof(triIndices[0]) * i1_max(1, offsets[tileCount]));
+    for (i32 i = 0; i < triCount; ++i)
     {
-        if (BoxHoldsPt(qt->boxes[n], pt))
+        const embedtri_t et = tris[i];
+        const i32 iMap = uvArray[et.iDrawable].indices[et.iVert / 3];
+        int2 lo, hi;
+        TriTileRange(et.tri, lmSize, limit, &lo, &hi);
+        for (i32 y = lo.y; y <= hi.y; ++y)
         {
-            i32 chosen = -1;
-            float chosenDist = limit;
-            i32 len = qt->listLens[n];
-            const tri2d_t* triList = qt->triLists[n];
-            for (i32 i = 0; i < len; ++i)
+            for (i32 x = lo.x; x <= hi.x; ++x)
             {
-                tri2d_t tri = triList[i];
-                float dist = sdTriangle2D(tri.a, tri.b, tri.c, pt);
-                if (dist < chosenDist)
-                {
-                    chosenDist = dist;
-                    chosen = i;
-                }
+                triIndices[heads[iMap * tilesPerMap + x + y * tilesPerSide]++] = i;
             }
+        }
+    }
 
-            int2 ind = { -1, -1 };
-            if (chosenDist < limit)
-            {
-                limit = chosenDist;
-                ind = qt->indexLists[n][chosen];
-            }
+    bins->offsets = offsets;
+    bins->triIndices = triIndices;
+    bins->tris = tris;
+    bins->triCount = triCount;
+}
 
-            for (i32 i = 0; i < 4; ++i)
-            {
-                int2 childInd = { -1, -1 };
-                float childDist = quadtree_find(qt, GetChild(n, i), pt, limit, &childInd);
-                if (childDist < limit)
-                {
-                    limit = childDist;
-                    ind = childInd;
-                }
-            }
-            *indOut = ind;
-        }
+static void embedbins_del(embedbins_t* bins)
+{
+    if (bins)
+    {
+        pim_free(bins->offsets);
+        pim_free(bins->triIndices);
+        pim_free(bins->tris);
+        memset(bins, 0, sizeof(*bins));
     }
-    return limit;
 }
 
 typedef struct embed_s
 {
     task_t task;
     lightmap_t* lightmaps;
-    const quadtree_t* trees;
+    const embedbins_t* bins;
     i32 lmCount;
     float texelsPerMeter;
     const pt_scene_t* scene;
 } embed_t;
 
+static void EmbedTexel(lightmap_t lightmap, i32 iLightmap, i32 iTexel, float2 uv, embedtri_t et)
+{
+    const drawables_t* drawables = drawables_get();
+    const i32 iDraw = et.iDrawable;
+    const i32 iVert = et.iVert;
+
+    const lm_uvs_t lmUvs = drawables->lmUvs[iDraw];
+    if (!lmUvs.length)
+    {
+        return;
+    }
+
+    mesh_t mesh;
+    if (!mesh_get(drawables->meshes[iDraw], &mesh))
+    {
+        return;
+    }
+
+    const i32 a = iVert + 0;
+    const i32 b = iVert + 1;
+    const i32 c = iVert + 2;
+    ASSERT(c < lmUvs.length);
+    ASSERT(lmUvs.indices[iVert / 3] == iLightmap);
+
+    float2 LMA = lmUvs.uvs[a];
+    float2 LMB = lmUvs.uvs[b];
+    float2 LMC = lmUvs.uvs[c];
+    float area = sdEdge2D(LMA, LMB, LMC);
+    if (area <= 0.0f)
+    {
+        return;
+    }
+
+    const float rcpArea = 1.0f / area;
+    float4 wuv = bary2D(LMA, LMB, LMC, rcpArea, uv);
+    wuv = f4_clampvs(wuv, 0.0f, 1.0f);
+    wuv = f4_divvs(wuv, f4_sum3(wuv));
+
+    const float4x4 M = drawables->matrices[iDraw];
+    const float3x3 IM = drawables->invMatrices[iDraw];
+
+    float4 A = f4x4_mul_pt(M, mesh.positions[a]);
+    float4 B = f4x4_mul_pt(M, mesh.positions[b]);
+    float4 C = f4x4_mul_pt(M, mesh.positions[c]);
+    float4 P = f4_blend(A, B, C, wuv);
+
+    float4 NA = f3x3_mul_col(IM, oct16_f4(mesh.normals[a]));
+    float4 NB = f3x3_mul_col(IM, oct16_f4(mesh.normals[b]));
+    float4 NC = f3x3_mul_col(IM, oct16_f4(mesh.normals[c]));
+
+    NA = f4_normalize3(NA);
+    NB = f4_normalize3(NB);
+    NC = f4_normalize3(NC);
+    float4 N = f4_blend(NA, NB, NC, wuv);
+    N = f4_normalize3(N);
+
+    lightmap.position[iTexel] = f4_f3(P);
+    lightmap.normal[iTexel] = f4_oct16(N);
+    lightmap.sampleCounts[iTexel] = 1.0f;
+}
+
+// one tile per work item: the tile's texels only test the triangles binned to it
 static void EmbedAttributesFn(task_t* pbase, i32 begin, i32 end)
 {
     embed_t* task = (embed_t*)pbase;
     lightmap_t* pim_noalias lightmaps = task->lightmaps;
-    const quadtree_t* pim_noalias trees = task->trees;
-    const pt_scene_t* scene = task->scene;
-    const i32 lmCount = task->lmCount;
-    const float texelsPerMeter = task->texelsPerMeter;
-    const float metersPerTexel = 1.0f / texelsPerMeter;
+    const embedbins_t* bins = task->bins;
     const i32 lmSize = lightmaps[0].size;
-    const i32 lmLen = lmSize * lmSize;
     const int2 size = { lmSize, lmSize };
     const float limit = 4.0f / lmSize;
-
-    const drawables_t* drawables = drawables_get();
-    const i32 drawablesCount = drawables->count;
-    const meshid_t* pim_noalias meshids = drawables->meshes;
-    const float4x4* pim_noalias matrices = drawables->matrices;
-    const float3x3* pim_noalias invMatrices = drawables->invMatrices;
-    const lm_uvs_t* pim_noalias uvArray = drawables->lmUvs;
+    const i32 tilesPerSide = bins->tilesPerSide;
+    const i32 tilesPerMap = bins->tilesPerMap;
+    const embedtri_t* pim_noalias tris = bins->tris;
 
     for (i32 iWork = begin; iWork < end; ++iWork)
     {
-        const i32 iLightmap = iWork / lmLen;
-        const i32 iTexel = iWork % lmLen;
-        const i32 x = iTexel % lmSize;
-        const i32 y = iTexel / lmSize;
-        const float2 uv = CoordToUv(size, i2_v(x, y));
+        const i32 iLightmap = iWork / tilesPerMap;
+        const i32 iTile = iWork % tilesPerMap;
+        const i32 x0 = (iTile % tilesPerSide) * kEmbedTileSize;
+        const i32 y0 = (iTile / tilesPerSide) * kEmbedTileSize;
+        const i32 x1 = i1_min(x0 + kEmbedTileSize, lmSize);
+        const i32 y1 = i1_min(y0 + kEmbedTileSize, lmSize);
+        const i32* pim_noalias triList = bins->triIndices + bins->offsets[iWork];
+        const i32 triCount = bins->offsets[iWork + 1] - bins->offsets[iWork];
         lightmap_t lightmap = lightmaps[iLightmap];
-        const quadtree_t* qt = trees + iLightmap;
 
-        lightmap.sampleCounts[iTexel] = 0.0f;
-
-        int2 ind;
-        float dist = quadtree_find(qt, 0, uv, limit, &ind);
-        if ((dist < limit) && (ind.x != -1) && (ind.y != -1))
+        for (i32 y = y0; y < y1; ++y)
         {
-            i32 iDraw = ind.x;
-            i32 iVert = ind.y;
-
-            const lm_uvs_t lmUvs = uvArray[iDraw];
-            if (!lmUvs.length)
+            for (i32 x = x0; x < x1; ++x)
             {
-                continue;
-            }
+                const i32 iTexel = x + y * lmSize;
+                const float2 uv = CoordToUv(size, i2_v(x, y));
+                lightmap.sampleCounts[iTexel] = 0.0f;
 
-            mesh_t mesh;
-            if (!mesh_get(meshids[iDraw], &mesh))
-            {
-                continue;
-            }
+                i32 chosen = -1;
+                float chosenDist = limit;
+                for (i32 i = 0; i < triCount; ++i)
+                {
+                    tri2d_t tri = tris[triList[i]].tri;
+                    float dist = sdTriangle2D(tri.a, tri.b, tri.c, uv);
+                    if (dist < chosenDist)
+                    {
+                        chosenDist = dist;
+                        chosen = triList[i];
+                    }
+                }
 
-            const i32 a = iVert + 0;
-            const i32 b = iVert + 1;
-            const i32 c = iVert + 2;
-            ASSERT(c < lmUvs.length);
-            ASSERT(lmUvs.indices[iVert / 3] == iLightmap);
-
-            float2 LMA = lmUvs.uvs[a];
-            float2 LMB = lmUvs.uvs[b];
-            float2 LMC = lmUvs.uvs[c];
-            float area = sdEdge2D(LMA, LMB, LMC);
-            if (area <= 0.0f)
-            {
-                continue;
+                if (chosen >= 0)
+                {
+                    EmbedTexel(lightmap, iLightmap, iTexel, uv, tris[chosen]);
+                }
             }
-
-            const float rcpArea = 1.0f / area;
-            float4 wuv = bary2D(LMA, LMB, LMC, rcpArea, uv);
-            wuv = f4_clampvs(wuv, 0.0f, 1.0f);
-            wuv = f4_divvs(wuv, f4_sum3(wuv));
-
-            const float4x4 M = matrices[iDraw];
-            const float3x3 IM = invMatrices[iDraw];
-
-            float4 A = f4x4_mul_pt(M, mesh.positions[a]);
-            float4 B = f4x4_mul_pt(M, mesh.positions[b]);
-            float4 C = f4x4_mul_pt(M, mesh.positions[c]);
-            float4 P = f4_blend(A, B, C, wuv);
-
-            float4 NA = f3x3_mul_col(IM, mesh.normals[a]);
-            float4 NB = f3x3_mul_col(IM, mesh.normals[a]);
-            float4 NC = f3x3_mul_col(IM, mesh.normals[a]);
-
-            NA = f4_normalize3(NA);
-            NB = f4_normalize3(NB);
-            NC = f4_normalize3(NC);
-            float4 N = f4_blend(NA, NB, NC, wuv);
-            N = f4_normalize3(N);
-
-            lightmap.position[iTexel] = f4_f3(P);
-            lightmap.normal[iTexel] = f4_f3(N);
-            lightmap.sampleCounts[iTexel] = 1.0f;
         }
     }
 }
 
+ProfileMark(pm_EmbedAttributes, EmbedAttributes)
 static void EmbedAttributes(
     const pt_scene_t* scene,
     lightmap_t* lightmaps,
@@ -1243,65 +1349,23 @@ static void EmbedAttributes(
 {
     if (lmCount > 0)
     {
-        quadtree_t* trees = tmp_calloc(sizeof(trees[0]) * lmCount);
-        {
-            const float eps = 0.01f;
-            box2d_t bounds = { f2_s(0.0f - eps), f2_s(1.0f + eps) };
-            for (i32 i = 0; i < lmCount; ++i)
-            {
-                quadtree_new(trees + i, 5, bounds);
-            }
-        }
+        ProfileBegin(pm_EmbedAttributes);
 
-        {
-            const drawables_t* drawables = drawables_get();
-            const i32 dwCount = drawables->count;
-            const meshid_t* pim_noalias meshids = drawables->meshes;
-            const lm_uvs_t* pim_noalias uvArray = drawables->lmUvs;
-            for (i32 iDraw = 0; iDraw < dwCount; ++iDraw)
-            {
-                const lm_uvs_t lmUvs = uvArray[iDraw];
-                if (!lmUvs.length)
-                {
-                    continue;
-                }
-                mesh_t mesh;
-                if (!mesh_get(meshids[iDraw], &mesh))
-                {
-                    continue;
-                }
-                for (i32 iVert = 0; (iVert + 3) <= mesh.length; iVert += 3)
-                {
-                    const i32 iFace = iVert / 3;
-                    ASSERT(iFace < lmUvs.length);
-                    ASSERT((iVert + 2) < lmUvs.length);
-                    const i32 iMap = lmUvs.indices[iFace];
-                    if ((iMap >= 0) && (iMap < lmCount))
-                    {
-                        float2 A = lmUvs.uvs[iVert + 0];
-                        float2 B = lmUvs.uvs[iVert + 1];
-                        float2 C = lmUvs.uvs[iVert + 2];
-                        tri2d_t tri = { A, B, C };
-                        quadtree_t* tree = trees + iMap;
-                        bool inserted = quadtree_insert(tree, 0, tri, iDraw, iVert);
-                        ASSERT(inserted);
-                    }
-                }
-            }
-        }
+        const i32 lmSize = lightmaps[0].size;
+        embedbins_t bins;
+        embedbins_new(&bins, lmCount, lmSize, 4.0f / lmSize);
 
         embed_t* task = tmp_calloc(sizeof(*task));
         task->lightmaps = lightmaps;
-        task->trees = trees;
+        task->bins = &bins;
         task->lmCount = lmCount;
         task->texelsPerMeter = texelsPerMeter;
         task->scene = scene;
-        task_run(&task->task, EmbedAttributesFn, TexelCount(lightmaps, lmCount));
+        task_run(&task->task, EmbedAttributesFn, bins.tilesPerMap * lmCount);
 
-        for (i32 i = 0; i < lmCount; ++i)
-        {
-            quadtree_del(trees + i);
-        }
+        embedbins_del(&bins);
+
+        ProfileEnd(pm_EmbedAttributes);
     }
 }
 
@@ -1369,6 +1433,7 @@ void lmpack_del(lmpack_t* pack)
             lightmap_del(pack->lightmaps + i);
         }
         pim_free(pack->lightmaps);
+        fmap_destroy(&pack->cookedMap);
         memset(pack, 0, sizeof(*pack));
     }
 }
@@ -1394,6 +1459,7 @@ static void BakeFn(task_t* pbase, i32 begin, i32 end)
     const float rcpSize = 1.0f / lmSize;
     const int2 size = { lmSize, lmSize };
 
+    i32 samples = 0;
     pt_sampler_t sampler = pt_sampler_get();
     for (i32 iWork = begin; iWork < end; ++iWork)
     {
@@ -1415,10 +1481,9 @@ static void BakeFn(task_t* pbase, i32 begin, i32 end)
         }
 
         float3 P3 = lightmap.position[iTexel];
-        float3 N3 = lightmap.normal[iTexel];
 
         float4 P = f3_f4(P3, 1.0f);
-        float4 N = f4_normalize3(f3_f4(N3, 0.0f));
+        float4 N = oct16_f4(lightmap.normal[iTexel]);
         P = f4_add(P, f4_mulvs(N, kMilli));
 
         const float3x3 TBN = NormalToTBN(N);
@@ -1445,8 +1510,10 @@ static void BakeFn(task_t* pbase, i32 begin, i32 end)
             lightmap.probes[i][iTexel] = probe[i];
         }
         lightmap.sampleCounts[iTexel] = sampleCount + 1.0f;
+        ++samples;
     }
     pt_sampler_set(sampler);
+    stat_add(ms_bakeSamples, samples);
 }
 
 ProfileMark(pm_Bake, lmpack_bake)
@@ -1456,10 +1523,12 @@ void lmpack_bake(pt_scene_t* scene, float timeSlice)
     ASSERT(scene);
 
     const lmpack_t* pack = lmpack_get();
-    i32 texelCount = TexelCount(pack->lightmaps, pack->lmCount);
+    // cooked packs have no bake channels, repack first
+    ASSERT(!lmpack_iscooked(pack));
+    i32 texelCount = lmpack_iscooked(pack) ? 0 : TexelCount(pack->lightmaps, pack->lmCount);
     if (texelCount > 0)
     {
-        bake_t* task = perm_calloc(sizeof(*task));
+        bake_t* task = tmp_calloc(sizeof(*task));
         task->scene = scene;
         task->timeSlice = timeSlice;
         task_run(&task->task, BakeFn, texelCount);
@@ -1468,9 +1537,192 @@ void lmpack_bake(pt_scene_t* scene, float timeSlice)
     ProfileEnd(pm_Bake);
 }
 
+#define kInvalidateRays         8
+#define kInvalidateMinAngle     0.01f   // steradians
+#define kInvalidateMoveDist     0.01f   // meters
+
+typedef struct invalidate_s
+{
+    task_t task;
+    const pt_scene_t* scene;
+    const lightmap_t* embedded;
+    box_t region;
+    i32 resetCount;
+} invalidate_t;
+
+// coarse test: can P see any part of the region above its surface plane?
+pim_inline bool VEC_CALL CanSeeRegion(
+    const pt_scene_t* scene,
+    pt_sampler_t* sampler,
+    float4 P,
+    float4 N,
+    box_t region)
+{
+    float4 center = box_center(region);
+    float4 extents = box_extents(region);
+    float radius = f4_length3(extents);
+    float4 toCenter = f4_sub(center, P);
+    float dist = f4_length3(toCenter);
+    if (dist <= radius)
+    {
+        return true;
+    }
+    // region is below the horizon, or too small to matter
+    if (f4_dot3(toCenter, N) < -radius)
+    {
+        return false;
+    }
+    float solidAngle = kPi * (radius * radius) / (dist * dist);
+    if (solidAngle < kInvalidateMinAngle)
+    {
+        return false;
+    }
+
+    P = f4_add(P, f4_mulvs(N, kMilli));
+    for (i32 i = 0; i < kInvalidateRays; ++i)
+    {
+        float4 target = center;
+        if (i > 0)
+        {
+            float4 Xi = f4_v(pt_sample_1d(sampler), pt_sample_1d(sampler), pt_sample_1d(sampler), 0.0f);
+            target = f4_lerp(region.lo, region.hi, Xi);
+        }
+        float4 rd = f4_sub(target, P);
+        float t = f4_length3(rd);
+        if ((t <= kMilli) || (f4_dot3(rd, N) <= 0.0f))
+        {
+            continue;
+        }
+        rd = f4_divvs(rd, t);
+        ray_t ray = { P, rd };
+        rayhit_t hit = pt_intersect(scene, ray, 0.0f, t);
+        if (hit.type == hit_nothing)
+        {
+            return true;
+        }
+        float4 hitPt = f4_add(P, f4_mulvs(rd, hit.wuvt.w));
+        if (box_contains(region, hitPt))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void InvalidateFn(task_t* pbase, i32 begin, i32 end)
+{
+    invalidate_t* task = (invalidate_t*)pbase;
+    const pt_scene_t* scene = task->scene;
+    const lightmap_t* embedded = task->embedded;
+    const box_t region = task->region;
+    const bool hasRegion = b4_all(f4_lteq(region.lo, region.hi));
+    const float minCosTheta = 0.999f;
+
+    lmpack_t* pack = lmpack_get();
+    const i32 lmSize = pack->lmSize;
+    const i32 lmLen = lmSize * lmSize;
+
+    i32 resetCount = 0;
+    pt_sampler_t sampler = pt_sampler_get();
+    for (i32 iWork = begin; iWork < end; ++iWork)
+    {
+        const i32 iLightmap = iWork / lmLen;
+        const i32 iTexel = iWork % lmLen;
+        lightmap_t lightmap = pack->lightmaps[iLightmap];
+        const lightmap_t fresh = embedded[iLightmap];
+
+        const float oldCount = lightmap.sampleCounts[iTexel];
+        const float newCount = fresh.sampleCounts[iTexel];
+        if ((oldCount == 0.0f) && (newCount == 0.0f))
+        {
+            continue;
+        }
+
+        const float4 P = f3_f4(fresh.position[iTexel], 1.0f);
+        const float4 N = oct16_f4(fresh.normal[iTexel]);
+        bool dirty = (oldCount == 0.0f) != (newCount == 0.0f);
+        if (!dirty)
+        {
+            // the texel's own surface moved
+            const float4 oldP = f3_f4(lightmap.position[iTexel], 1.0f);
+            const float4 oldN = oct16_f4(lightmap.normal[iTexel]);
+            dirty = f4_distance3(P, oldP) > kInvalidateMoveDist;
+            dirty |= f4_dot3(N, oldN) < minCosTheta;
+        }
+        if (!dirty && hasRegion)
+        {
+            dirty = CanSeeRegion(scene, &sampler, P, N, region);
+        }
+
+        if (dirty)
+        {
+            // a count of 1 restarts accumulation and doubles the bake rate
+            lightmap.position[iTexel] = fresh.position[iTexel];
+            lightmap.normal[iTexel] = fresh.normal[iTexel];
+            lightmap.sampleCounts[iTexel] = newCount;
+            for (i32 i = 0; i < kGiDirections; ++i)
+            {
+                lightmap.probes[i][iTexel] = f4_0;
+            }
+            ++resetCount;
+        }
+    }
+    pt_sampler_set(sampler);
+
+    fetch_add_i32(&task->resetCount, resetCount, MO_Relaxed);
+}
+
+ProfileMark(pm_Invalidate, lmpack_invalidate)
+i32 lmpack_invalidate(const pt_scene_t* scene, box_t region)
+{
+    ASSERT(scene);
+
+    lmpack_t* pack = lmpack_get();
+    const i32 lmCount = pack->lmCount;
+    if ((lmCount <= 0) || lmpack_iscooked(pack))
+    {
+        return 0;
+    }
+
+    ProfileBegin(pm_Invalidate);
+
+    // re-embed into scratch lightmaps to find texels whose surface changed
+    const i32 lmSize = pack->lmSize;
+    const i32 lmLen = lmSize * lmSize;
+    lightmap_t* embedded = tmp_calloc(sizeof(embedded[0]) * lmCount);
+    for (i32 i = 0; i < lmCount; ++i)
+    {
+        embedded[i].size = lmSize;
+        embedded[i].position = perm_calloc(sizeof(embedded[i].position[0]) * lmLen);
+        embedded[i].normal = perm_calloc(sizeof(embedded[i].normal[0]) * lmLen);
+        embedded[i].sampleCounts = perm_calloc(sizeof(embedded[i].sampleCounts[0]) * lmLen);
+    }
+    EmbedAttributes(scene, embedded, lmCount, pack->texelsPerMeter);
+
+    invalidate_t* task = tmp_calloc(sizeof(*task));
+    task->scene = scene;
+    task->embedded = embedded;
+    task->region = region;
+    task_run(&task->task, InvalidateFn, lmCount * lmLen);
+
+    for (i32 i = 0; i < lmCount; ++i)
+    {
+        lightmap_del(embedded + i);
+    }
+
+    ProfileEnd(pm_Invalidate);
+
+    return task->resetCount;
+}
+
 bool lmpack_save(const lmpack_t* pack, guid_t name)
 {
     ASSERT(pack);
+    if (lmpack_iscooked(pack))
+    {
+        return false;
+    }
+
     char filename[PIM_PATH] = "data/";
     guid_tofile(ARGS(filename), name, ".lmpack");
 
@@ -1625,6 +1877,125 @@ cleanup:
     return loaded;
 }
 
+bool lmpack_cook(const lmpack_t* pack, guid_t name)
+{
+    ASSERT(pack);
+    if (lmpack_iscooked(pack))
+    {
+        return false;
+    }
+
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".lmcook");
+
+    fstr_t fd = fstr_open(filename, "wb");
+    if (fstr_isopen(fd))
+    {
+        const i32 lmcount = pack->lmCount;
+        const i32 texelcount = pack->lmSize * pack->lmSize;
+        i32 offset = 0;
+
+        dlmcook_t dcook = { 0 };
+        dbytes_new(1, sizeof(dcook), &offset);
+        dcook.version = kLmCookVersion;
+        dcook.directions = kGiDirections;
+        dcook.lmCount = lmcount;
+        dcook.lmSize = pack->lmSize;
+        dcook.texelsPerMeter = pack->texelsPerMeter;
+        memcpy(dcook.axii, pack->axii, sizeof(pack->axii));
+        dcook.probes = dbytes_new(lmcount * kGiDirections * texelcount, sizeof(u32), &offset);
+        i32 wrote = fstr_write(fd, &dcook, sizeof(dcook));
+        ASSERT(wrote == sizeof(dcook));
+
+        u32* buffer = tmp_malloc(sizeof(buffer[0]) * texelcount);
+        for (i32 i = 0; i < lmcount; ++i)
+        {
+            const lightmap_t lm = pack->lightmaps[i];
+            ASSERT(lm.size == pack->lmSize);
+            for (i32 j = 0; j < kGiDirections; ++j)
+            {
+                const float4* pim_noalias probes = lm.probes[j];
+                for (i32 k = 0; k < texelcount; ++k)
+                {
+                    buffer[k] = f4_rgb9e5(probes[k]);
+                }
+                wrote = fstr_write(fd, buffer, sizeof(buffer[0]) * texelcount);
+                ASSERT(wrote == sizeof(buffer[0]) * texelcount);
+            }
+        }
+        ASSERT(fstr_tell(fd) == offset);
+
+        fstr_close(&fd);
+        return true;
+    }
+    return false;
+}
+
+bool lmpack_loadcooked(lmpack_t* pack, guid_t name)
+{
+    bool loaded = false;
+
+    ASSERT(pack);
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".lmcook");
+
+    lmpack_del(pack);
+
+    fmap_t map = { 0 };
+    fd_t fd = fd_open(filename, false);
+    if (fd_isopen(fd))
+    {
+        map = fmap_create(fd, false);
+        fd_close(&fd);
+    }
+    if (fmap_isopen(map) && (map.size >= sizeof(dlmcook_t)))
+    {
+        const u8* base = map.ptr;
+        dlmcook_t dcook;
+        memcpy(&dcook, base, sizeof(dcook));
+        const i32 texelcount = dcook.lmSize * dcook.lmSize;
+        const i32 probeBytes = sizeof(u32) * kGiDirections * texelcount * dcook.lmCount;
+        if ((dcook.version == kLmCookVersion) &&
+            (dcook.directions == kGiDirections) &&
+            (dcook.lmCount >= 0) &&
+            (dcook.probes.size == probeBytes) &&
+            (dcook.probes.offset >= sizeof(dcook)) &&
+            ((dcook.probes.offset & (sizeof(u32) - 1)) == 0) &&
+            ((dcook.probes.offset + dcook.probes.size) <= map.size))
+        {
+            const i32 lmcount = dcook.lmCount;
+            pack->lmCount = lmcount;
+            pack->lmSize = dcook.lmSize;
+            pack->texelsPerMeter = dcook.texelsPerMeter;
+            memcpy(pack->axii, dcook.axii, sizeof(dcook.axii));
+            pack->lightmaps = perm_calloc(sizeof(pack->lightmaps[0]) * lmcount);
+
+            // lightmaps point directly into the mapping
+            const u32* probes = (const u32*)(base + dcook.probes.offset);
+            for (i32 i = 0; i < lmcount; ++i)
+            {
+                lightmap_t* lm = pack->lightmaps + i;
+                lm->size = dcook.lmSize;
+                for (i32 j = 0; j < kGiDirections; ++j)
+                {
+                    lm->cooked[j] = probes;
+                    probes += texelcount;
+                }
+            }
+
+            pack->cookedMap = map;
+            loaded = true;
+        }
+    }
+
+    if (!loaded)
+    {
+        fmap_destroy(&map);
+        lmpack_del(pack);
+    }
+    return loaded;
+}
+
 static cmdstat_t CmdPrintLm(i32 argc, const char** argv)
 {
     char filename[PIM_PATH] = { 0 };
@@ -1663,6 +2034,11 @@ static cmdstat_t CmdPrintLm(i32 argc, const char** argv)
     for (i32 i = 0; i < pack->lmCount; ++i)
     {
         const lightmap_t lm = pack->lightmaps[i];
+        if (!lm.position)
+        {
+            con_logf(LogSev_Error, "LM", "Cooked lightmaps have no bake channels to print");
+            return cmdstat_err;
+        }
         const i32 len = lm.size * lm.size;
         buffer = tmp_realloc(buffer, sizeof(buffer[0]) * len);
 
@@ -1673,9 +2049,6 @@ static cmdstat_t CmdPrintLm(i32 argc, const char** argv)
         case LmChannel_Position:
             srcBuffer = lm.position;
             break;
-        case LmChannel_Normal:
-            srcBuffer = lm.normal;
-            break;
         }
 
         if ((channel == LmChannel_Color) || (channel == LmChannel_Denoised))
@@ -1703,10 +2076,10 @@ static cmdstat_t CmdPrintLm(i32 argc, const char** argv)
         {
             for (i32 j = 0; j < len; ++j)
             {
-                float3 norm = srcBuffer[j];
-                norm = f3_mulvs(norm, 0.5f);
-                norm = f3_addvs(norm, 0.5f);
-                u32 color = f4_rgba8(f3_f4(norm, 1.0f));
+                float4 norm = oct16_f4(lm.normal[j]);
+                norm = f4_addvs(f4_mulvs(norm, 0.5f), 0.5f);
+                norm.w = 1.0f;
+                u32 color = f4_rgba8(norm);
                 color |= 0xff << 24;
                 buffer[j] = color;
             }
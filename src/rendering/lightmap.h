@@ -4,11 +4,13 @@
 #include "common/dbytes.h"
 #include "math/types.h"
 #include "common/guid.h"
+#include "io/fmap.h"
 
 PIM_C_BEGIN
 
-#define kLightmapVersion    1
+#define kLightmapVersion    2
 #define kLmPackVersion      1
+#define kLmCookVersion      1
 #define kGiDirections       5
 
 typedef struct task_s task_t;
@@ -17,8 +19,11 @@ typedef struct pt_scene_s pt_scene_t;
 typedef struct lightmap_s
 {
     float4* pim_noalias probes[kGiDirections];
+    // rgb9e5 probes, mapped read-only from a cooked pack.
+    // a cooked lightmap has no probes, position, normal or sampleCounts.
+    const u32* pim_noalias cooked[kGiDirections];
     float3* pim_noalias position;
-    float3* pim_noalias normal;
+    u32* pim_noalias normal; // octahedral, see f4_oct16
     float* pim_noalias sampleCounts;
     i32 size;
 } lightmap_t;
@@ -41,6 +46,7 @@ typedef struct lmpack_s
     i32 lmCount;
     i32 lmSize;
     float texelsPerMeter;
+    fmap_t cookedMap;
 } lmpack_t;
 
 typedef struct dlmpack_s
@@ -53,6 +59,18 @@ typedef struct dlmpack_s
     float texelsPerMeter;
 } dlmpack_t;
 
+// runtime format; lightmaps are contiguous so the file can be mapped in place
+typedef struct dlmcook_s
+{
+    i32 version;
+    i32 directions;
+    i32 lmCount;
+    i32 lmSize;
+    float4 axii[kGiDirections];
+    float texelsPerMeter;
+    dbytes_t probes; // u32 rgb9e5 [lmCount][kGiDirections][lmSize * lmSize]
+} dlmcook_t;
+
 typedef struct lm_uvs_s
 {
     i32 length;
@@ -67,6 +85,8 @@ typedef struct dlm_uvs_s
     dbytes_t indices;
 } dlm_uvs_t;
 
+void lightmap_sys_init(void);
+
 void lightmap_new(lightmap_t* lm, i32 size);
 void lightmap_del(lightmap_t* lm);
 
@@ -81,9 +101,18 @@ void lmpack_del(lmpack_t* pack);
 
 void lmpack_bake(pt_scene_t* scene, float timeSlice);
 
+// resets texels whose surface changed or that can see the region in the
+// updated scene, keeping converged data elsewhere. returns texels reset.
+i32 lmpack_invalidate(const pt_scene_t* scene, box_t region);
+
 bool lmpack_save(const lmpack_t* src, guid_t name);
 bool lmpack_load(lmpack_t* dst, guid_t name);
 
+// compressed, read-only variant of the pack for runtime use
+bool lmpack_cook(const lmpack_t* src, guid_t name);
+bool lmpack_loadcooked(lmpack_t* dst, guid_t name);
+pim_inline bool lmpack_iscooked(const lmpack_t* pack) { return fmap_isopen(pack->cookedMap); }
+
 void lm_uvs_new(lm_uvs_t* uvs, i32 length);
 void lm_uvs_del(lm_uvs_t* uvs);
 
@@ -7,10 +7,13 @@
 #include "containers/table.h"
 #include "math/float4_funcs.h"
 #include "math/box.h"
+#include "math/color.h"
 #include "ui/cimgui.h"
 #include "ui/cimgui_ext.h"
 #include "io/fstr.h"
 #include "rendering/vulkan/vkr_mesh.h"
+#include "assets/archive.h"
+#include "threading/epoch.h"
 
 #include <string.h>
 
@@ -37,11 +40,24 @@ static bool IsCurrent(meshid_t id)
     return table_exists(&ms_table, ToGenId(id));
 }
 
+static void ReleaseArchive(void* ptr)
+{
+    archive_release(ptr);
+}
+
+// tasks may still be reading a copy of mesh, see threading/epoch.h
 static void FreeMesh(mesh_t* mesh)
 {
-    pim_free(mesh->positions);
-    pim_free(mesh->normals);
-    pim_free(mesh->uvs);
+    if (mesh->archive)
+    {
+        epoch_defer(ReleaseArchive, mesh->archive);
+    }
+    else
+    {
+        epoch_free(mesh->positions);
+        epoch_free(mesh->normals);
+        epoch_free(mesh->uvs);
+    }
     if (g_vkr.inst)
     {
         vkrMesh_Del(&mesh->vkrmesh);
@@ -101,7 +117,13 @@ bool mesh_new(mesh_t* mesh, guid_t name, meshid_t* idOut)
     {
         if (g_vkr.inst)
         {
-            added = vkrMesh_New(&mesh->vkrmesh, mesh->length, mesh->positions, mesh->normals, mesh->uvs, 0, NULL);
+            // the vertex shader takes full precision normals
+            float4* pim_noalias normals = tmp_malloc(sizeof(normals[0]) * mesh->length);
+            for (i32 i = 0; i < mesh->length; ++i)
+            {
+                normals[i] = oct16_f4(mesh->normals[i]);
+            }
+            added = vkrMesh_New(&mesh->vkrmesh, mesh->length, mesh->positions, normals, mesh->uvs, 0, NULL);
             ASSERT(added);
         }
         added = table_add(&ms_table, name, mesh, &id);
@@ -144,11 +166,10 @@ bool mesh_get(meshid_t id, mesh_t* dst)
 bool mesh_set(meshid_t id, mesh_t* src)
 {
     ASSERT(src);
-    if (IsCurrent(id))
+    mesh_t prev = { 0 };
+    if (table_swap(&ms_table, ToGenId(id), src, &prev))
     {
-        mesh_t* meshes = ms_table.values;
-        i32 index = id.index;
-        memcpy(&meshes[index], src, sizeof(meshes[0]));
+        FreeMesh(&prev);
         memset(src, 0, sizeof(*src));
         return true;
     }
@@ -183,6 +204,27 @@ box_t mesh_calcbounds(meshid_t id)
     return bounds;
 }
 
+// arrays are ordered widest first so each stays 16 byte aligned in an archive
+static u8* MeshToBytes(const mesh_t* mesh, i32* sizeOut)
+{
+    i32 offset = 0;
+    dmesh_t dmesh = { 0 };
+    dbytes_new(1, sizeof(dmesh), &offset);
+    dmesh.version = kMeshVersion;
+    dmesh.length = mesh->length;
+    dmesh.positions = dbytes_new(mesh->length, sizeof(mesh->positions[0]), &offset);
+    dmesh.uvs = dbytes_new(mesh->length, sizeof(mesh->uvs[0]), &offset);
+    dmesh.normals = dbytes_new(mesh->length, sizeof(mesh->normals[0]), &offset);
+
+    u8* bytes = tmp_malloc(offset);
+    memcpy(bytes, &dmesh, sizeof(dmesh));
+    memcpy(bytes + dmesh.positions.offset, mesh->positions, dmesh.positions.size);
+    memcpy(bytes + dmesh.uvs.offset, mesh->uvs, dmesh.uvs.size);
+    memcpy(bytes + dmesh.normals.offset, mesh->normals, dmesh.normals.size);
+    *sizeOut = offset;
+    return bytes;
+}
+
 bool mesh_save(meshid_t id, guid_t* dst)
 {
     if (mesh_getname(id, dst))
@@ -193,74 +235,213 @@ bool mesh_save(meshid_t id, guid_t* dst)
         if (fstr_isopen(fd))
         {
             const mesh_t* meshes = ms_table.values;
-            const mesh_t mesh = meshes[id.index];
-            i32 offset = 0;
-            dmesh_t dmesh = { 0 };
-            dbytes_new(1, sizeof(dmesh), &offset);
-            dmesh.version = kMeshVersion;
-            dmesh.length = mesh.length;
-            dmesh.positions = dbytes_new(mesh.length, sizeof(mesh.positions[0]), &offset);
-            dmesh.normals = dbytes_new(mesh.length, sizeof(mesh.normals[0]), &offset);
-            dmesh.uvs = dbytes_new(mesh.length, sizeof(mesh.uvs[0]), &offset);
-            fstr_write(fd, &dmesh, sizeof(dmesh));
-
-            ASSERT(fstr_tell(fd) == dmesh.positions.offset);
-            fstr_write(fd, mesh.positions, sizeof(mesh.positions[0]) * mesh.length);
-            ASSERT(fstr_tell(fd) == dmesh.normals.offset);
-            fstr_write(fd, mesh.normals, sizeof(mesh.normals[0]) * mesh.length);
-            ASSERT(fstr_tell(fd) == dmesh.uvs.offset);
-            fstr_write(fd, mesh.uvs, sizeof(mesh.uvs[0]) * mesh.length);
-
+            i32 size = 0;
+            const u8* bytes = MeshToBytes(meshes + id.index, &size);
+            const i32 wrote = fstr_write(fd, bytes, size);
             fstr_close(&fd);
+            return wrote == size;
+        }
+    }
+    return false;
+}
+
+bool mesh_archive(meshid_t id, archivewriter_t* wr, guid_t* dst)
+{
+    ASSERT(wr);
+    if (mesh_getname(id, dst))
+    {
+        if (archive_contains(wr, *dst))
+        {
             return true;
         }
+        const mesh_t* meshes = ms_table.values;
+        i32 size = 0;
+        const u8* bytes = MeshToBytes(meshes + id.index, &size);
+        // vertices are referenced in place, never compressed
+        return archive_add(wr, *dst, bytes, size, ArchiveCodec_None);
     }
     return false;
 }
 
-bool mesh_load(guid_t name, meshid_t* dst)
+typedef struct meshload_s
+{
+    guid_t name;
+    mesh_onload_fn onLoad;
+    void* usr;
+} meshload_t;
+
+static bool InFile(const assetload_t* load, dbytes_t db)
+{
+    return (db.offset >= 0) && (db.size >= 0) && (db.offset <= load->size - db.size);
+}
+
+// task worker: copies the file into a mesh_t
+static void DecodeMesh(assetload_t* load)
 {
-    bool loaded = false;
+    mesh_t* mesh = NULL;
+    if (load->size < (i32)sizeof(dmesh_t))
+    {
+        goto cleanup;
+    }
+    const u8* bytes = load->data;
+    dmesh_t dmesh;
+    memcpy(&dmesh, bytes, sizeof(dmesh));
+    if ((dmesh.version != kMeshVersion) || (dmesh.length <= 0))
+    {
+        goto cleanup;
+    }
+    dbytes_check(dmesh.positions, sizeof(mesh->positions[0]));
+    dbytes_check(dmesh.normals, sizeof(mesh->normals[0]));
+    dbytes_check(dmesh.uvs, sizeof(mesh->uvs[0]));
+    const i32 len = dmesh.length;
+    if ((dmesh.positions.size != sizeof(mesh->positions[0]) * len) ||
+        (dmesh.normals.size != sizeof(mesh->normals[0]) * len) ||
+        (dmesh.uvs.size != sizeof(mesh->uvs[0]) * len) ||
+        !InFile(load, dmesh.positions) ||
+        !InFile(load, dmesh.normals) ||
+        !InFile(load, dmesh.uvs))
+    {
+        INTERRUPT();
+        goto cleanup;
+    }
+
+    mesh = perm_calloc(sizeof(*mesh));
+    mesh->length = len;
+    mesh->positions = perm_malloc(dmesh.positions.size);
+    mesh->normals = perm_malloc(dmesh.normals.size);
+    mesh->uvs = perm_malloc(dmesh.uvs.size);
+    memcpy(mesh->positions, bytes + dmesh.positions.offset, dmesh.positions.size);
+    memcpy(mesh->normals, bytes + dmesh.normals.offset, dmesh.normals.size);
+    memcpy(mesh->uvs, bytes + dmesh.uvs.offset, dmesh.uvs.size);
+cleanup:
+    load->result = mesh;
+}
 
+// main thread: uploads the mesh, or retains the copy a previous request made
+static void OnMeshLoaded(assetload_t* load, void* usr)
+{
+    meshload_t* req = usr;
+    meshid_t id = { 0 };
+    mesh_t* mesh = load->result;
+    load->result = NULL;
+    if (mesh_find(req->name, &id))
+    {
+        mesh_retain(id);
+        if (mesh)
+        {
+            FreeMesh(mesh);
+        }
+    }
+    else if (!mesh || !mesh_new(mesh, req->name, &id))
+    {
+        id = (meshid_t) { 0 };
+    }
+    pim_free(mesh);
+    if (req->onLoad)
+    {
+        req->onLoad(id, req->usr);
+    }
+    pim_free(req);
+}
+
+assetfuture_t mesh_loadasync(
+    guid_t name,
+    AssetPri priority,
+    mesh_onload_fn onLoad,
+    void* usr)
+{
     char filename[PIM_PATH] = "data/";
     guid_tofile(ARGS(filename), name, ".mesh");
-    fstr_t fd = fstr_open(filename, "rb");
-    mesh_t mesh = { 0 };
-    if (fstr_isopen(fd))
+
+    meshload_t* req = perm_malloc(sizeof(*req));
+    req->name = name;
+    req->onLoad = onLoad;
+    req->usr = usr;
+    return asset_load_async(filename, priority, DecodeMesh, OnMeshLoaded, req);
+}
+
+static void OnMeshLoadedSync(meshid_t id, void* usr)
+{
+    *(meshid_t*)usr = id;
+}
+
+bool mesh_load(guid_t name, meshid_t* dst)
+{
+    ASSERT(dst);
+    *dst = (meshid_t) { 0 };
+    asset_load_await(mesh_loadasync(name, AssetPri_High, OnMeshLoadedSync, dst));
+    return mesh_exists(*dst);
+}
+
+// points the mesh at the archive mapping when the layout allows it,
+// otherwise decodes a private copy
+bool mesh_loadarchive(archive_t* ar, guid_t name, meshid_t* dst)
+{
+    ASSERT(dst);
+    *dst = (meshid_t) { 0 };
+    if (mesh_find(name, dst))
     {
-        dmesh_t dmesh = { 0 };
-        fstr_read(fd, &dmesh, sizeof(dmesh));
-        if (dmesh.version == kMeshVersion)
-        {
-            dbytes_check(dmesh.positions, sizeof(mesh.positions[0]));
-            dbytes_check(dmesh.normals, sizeof(mesh.normals[0]));
-            dbytes_check(dmesh.uvs, sizeof(mesh.uvs[0]));
+        mesh_retain(*dst);
+        return true;
+    }
+    archiveblob_t blob;
+    if (!archive_find(ar, name, &blob))
+    {
+        return false;
+    }
 
-            mesh.length = dmesh.length;
-            if (mesh.length > 0)
-            {
-                mesh.positions = perm_malloc(sizeof(mesh.positions[0]) * mesh.length);
-                mesh.normals = perm_malloc(sizeof(mesh.normals[0]) * mesh.length);
-                mesh.uvs = perm_malloc(sizeof(mesh.uvs[0]) * mesh.length);
-
-                ASSERT(fstr_tell(fd) == dmesh.positions.offset);
-                fstr_read(fd, mesh.positions, sizeof(mesh.positions[0]) * mesh.length);
-                ASSERT(fstr_tell(fd) == dmesh.normals.offset);
-                fstr_read(fd, mesh.normals, sizeof(mesh.normals[0]) * mesh.length);
-                ASSERT(fstr_tell(fd) == dmesh.uvs.offset);
-                fstr_read(fd, mesh.uvs, sizeof(mesh.uvs[0]) * mesh.length);
-
-                loaded = mesh_new(&mesh, name, dst);
-            }
-        }
+    assetload_t load = { 0 };
+    load.data = (void*)blob.ptr;
+    load.size = blob.size;
+    void* decoded = NULL;
+    if (blob.codec != ArchiveCodec_None)
+    {
+        decoded = archive_decode(blob);
+        load.data = decoded;
+        load.size = decoded ? blob.rawSize : 0;
     }
-cleanup:
-    fstr_close(&fd);
-    if (!loaded)
+
+    mesh_t mesh = { 0 };
+    dmesh_t dmesh = { 0 };
+    if (!decoded && (load.size >= (i32)sizeof(dmesh)))
     {
-        FreeMesh(&mesh);
+        memcpy(&dmesh, load.data, sizeof(dmesh));
+    }
+    const bool inPlace =
+        !decoded &&
+        (dmesh.version == kMeshVersion) &&
+        (dmesh.length > 0) &&
+        (dmesh.positions.size == sizeof(mesh.positions[0]) * dmesh.length) &&
+        (dmesh.normals.size == sizeof(mesh.normals[0]) * dmesh.length) &&
+        (dmesh.uvs.size == sizeof(mesh.uvs[0]) * dmesh.length) &&
+        InFile(&load, dmesh.positions) &&
+        InFile(&load, dmesh.normals) &&
+        InFile(&load, dmesh.uvs) &&
+        !(((isize)blob.ptr + dmesh.positions.offset) & 15) &&
+        !(((isize)blob.ptr + dmesh.uvs.offset) & 15) &&
+        !(((isize)blob.ptr + dmesh.normals.offset) & 3);
+    if (inPlace)
+    {
+        const u8* bytes = blob.ptr;
+        mesh.length = dmesh.length;
+        mesh.positions = (float4*)(bytes + dmesh.positions.offset);
+        mesh.normals = (u32*)(bytes + dmesh.normals.offset);
+        mesh.uvs = (float4*)(bytes + dmesh.uvs.offset);
+        mesh.archive = ar;
+        archive_retain(ar);
     }
-    return loaded;
+    else if (load.data)
+    {
+        DecodeMesh(&load);
+        if (load.result)
+        {
+            mesh = *(mesh_t*)load.result;
+            pim_free(load.result);
+        }
+    }
+    pim_free(decoded);
+
+    return (mesh.length > 0) && mesh_new(&mesh, name, dst);
 }
 
 // ----------------------------------------------------------------------------
@@ -310,6 +491,27 @@ static i32 CmpSlotFn(i32 ilhs, i32 irhs, void* usr)
     return 0;
 }
 
+i64 mesh_sys_bytes(void)
+{
+    const i32 width = ms_table.width;
+    const guid_t* names = ms_table.names;
+    const mesh_t* meshes = ms_table.values;
+
+    i64 bytesUsed = 0;
+    for (i32 i = 0; i < width; ++i)
+    {
+        if (!guid_isnull(names[i]))
+        {
+            i64 length = meshes[i].length;
+            bytesUsed += sizeof(meshes[0]);
+            bytesUsed += length * sizeof(meshes[0].positions[0]);
+            bytesUsed += length * sizeof(meshes[0].normals[0]);
+            bytesUsed += length * sizeof(meshes[0].uvs[0]);
+        }
+    }
+    return bytesUsed;
+}
+
 ProfileMark(pm_OnGui, mesh_sys_gui)
 void mesh_sys_gui(bool* pEnabled)
 {
@@ -323,20 +525,7 @@ void mesh_sys_gui(bool* pEnabled)
         const mesh_t* meshes = ms_table.values;
         const i32* refcounts = ms_table.refcounts;
 
-        i32 bytesUsed = 0;
-        for (i32 i = 0; i < width; ++i)
-        {
-            if (!guid_isnull(names[i]))
-            {
-                i32 length = meshes[i].length;
-                bytesUsed += sizeof(meshes[0]);
-                bytesUsed += length * sizeof(meshes[0].positions[0]);
-                bytesUsed += length * sizeof(meshes[0].normals[0]);
-                bytesUsed += length * sizeof(meshes[0].uvs[0]);
-            }
-        }
-
-        igText("Bytes Used: %d", bytesUsed);
+        igText("Bytes Used: %lld", mesh_sys_bytes());
 
         if (igButton("Clear Selection"))
         {
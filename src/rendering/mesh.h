@@ -5,9 +5,13 @@
 #include "common/guid.h"
 #include "common/dbytes.h"
 #include "rendering/vulkan/vkr.h"
+#include "assets/asset_system.h"
 
 PIM_C_BEGIN
 
+typedef struct archive_s archive_t;
+typedef struct archivewriter_s archivewriter_t;
+
 typedef struct meshid_s
 {
     u32 index : 24;
@@ -22,13 +26,15 @@ typedef struct dmeshid_s
 typedef struct mesh_s
 {
     float4* positions;
-    float4* normals;
+    u32* normals;       // octahedral, see f4_oct16
     float4* uvs;
     i32 length;
     vkrMesh vkrmesh;
+    // when set, the arrays are read-only views into this archive
+    archive_t* archive;
 } mesh_t;
 
-#define kMeshVersion 3
+#define kMeshVersion 4
 typedef struct dmesh_s
 {
     i32 version;
@@ -43,6 +49,8 @@ void mesh_sys_update(void);
 void mesh_sys_shutdown(void);
 void mesh_sys_vkfree(void);
 void mesh_sys_gui(bool* pEnabled);
+// cpu side vertex data of every live mesh
+i64 mesh_sys_bytes(void);
 
 bool mesh_new(mesh_t* mesh, guid_t name, meshid_t* idOut);
 
@@ -62,4 +70,17 @@ box_t mesh_calcbounds(meshid_t id);
 bool mesh_save(meshid_t id, guid_t* dst);
 bool mesh_load(guid_t name, meshid_t* dst);
 
+// adds the mesh to an archive, once per name
+bool mesh_archive(meshid_t id, archivewriter_t* wr, guid_t* dst);
+// references the mesh in place from a mapped archive
+bool mesh_loadarchive(archive_t* ar, guid_t name, meshid_t* dst);
+
+// called on the main thread with a retained id, or a null id on failure
+typedef void(PIM_CDECL *mesh_onload_fn)(meshid_t id, void* usr);
+assetfuture_t mesh_loadasync(
+    guid_t name,
+    AssetPri priority,
+    mesh_onload_fn onLoad,
+    void* usr);
+
 PIM_C_END
@@ -19,6 +19,7 @@
 #include "common/stringutil.h"
 #include "common/console.h"
 #include "common/sort.h"
+#include "threading/task.h"
 #include "io/fd.h"
 #include "logic/progs.h"
 #include "rendering/camera.h"
@@ -392,22 +393,23 @@ static material_t GenMaterial(const mtexture_t* mtex, const msurface_t* surf)
     return material;
 }
 
-static mesh_t VEC_CALL TrisToMesh(
+// writes at most vertCount vertices, returns the count after dropping
+// degenerate triangles
+static i32 VEC_CALL TrisToMesh(
     const mmodel_t* model,
     float4x4 M,
     const msurface_t* surface,
     const i32* pim_noalias inds,
-    i32 vertCount)
+    i32 vertCount,
+    float4* pim_noalias positions,
+    u32* pim_noalias normals,
+    float4* pim_noalias uvs)
 {
     ASSERT((vertCount % 3) == 0);
 
     const i32 numverts = model->numvertices;
     const float4* pim_noalias verts = model->vertices;
 
-    float4* pim_noalias positions = perm_malloc(sizeof(positions[0]) * vertCount);
-    float4* pim_noalias normals = perm_malloc(sizeof(normals[0]) * vertCount);
-    float4* pim_noalias uvs = perm_malloc(sizeof(uvs[0]) * vertCount);
-
     float4 s = f4_0;
     float4 t = f4_0;
     float2 uvScale = f2_0;
@@ -464,9 +466,10 @@ static mesh_t VEC_CALL TrisToMesh(
         positions[b] = B;
         positions[c] = C;
 
-        normals[a] = N;
-        normals[b] = N;
-        normals[c] = N;
+        const u32 octN = f4_oct16(N);
+        normals[a] = octN;
+        normals[b] = octN;
+        normals[c] = octN;
 
         float2 uva = f2_mul(CalcUv(s, t, A0), uvScale);
         float2 uvb = f2_mul(CalcUv(s, t, B0), uvScale);
@@ -478,34 +481,19 @@ static mesh_t VEC_CALL TrisToMesh(
         vertsEmit += 3;
     }
 
-    mesh_t mesh = { 0 };
-    if (vertsEmit > 0)
-    {
-        ASSERT(vertsEmit <= vertCount);
-        mesh.length = vertsEmit;
-        mesh.positions = positions;
-        mesh.normals = normals;
-        mesh.uvs = uvs;
-    }
-    else
-    {
-        pim_free(positions);
-        pim_free(normals);
-        pim_free(uvs);
-    }
-
-    return mesh;
+    ASSERT(vertsEmit <= vertCount);
+    return vertsEmit;
 }
 
 static void FixZFighting(mesh_t mesh)
 {
     const i32 len = mesh.length;
-    const float4* pim_noalias normals = mesh.normals;
+    const u32* pim_noalias normals = mesh.normals;
     float4* pim_noalias positions = mesh.positions;
     for (i32 i = 0; i < len; ++i)
     {
         float4 P = positions[i];
-        float4 N = normals[i];
+        float4 N = oct16_f4(normals[i]);
         P = f4_add(P, f4_mulvs(N, kMilli * 0.5f));
         positions[i] = P;
     }
@@ -640,120 +628,154 @@ static float4x4 QuakeToRhsMeters(void)
     return M;
 }
 
+static bool IsDrawnSurface(const mmodel_t* model, const batch_t* batch, i32 j)
+{
+    const msurface_t* surface = batch->surfaces + j;
+    const i32 numedges = surface->numedges;
+    const i32 firstedge = surface->firstedge;
+    if ((numedges <= 0) || (firstedge < 0))
+    {
+        return false;
+    }
+    if ((firstedge + numedges) > model->numsurfedges)
+    {
+        return false;
+    }
+    if (StrIStr(batch->texnames[j], 16, "trigger"))
+    {
+        return false;
+    }
+    return true;
+}
+
+typedef struct task_FlattenBatches
+{
+    task_t task;
+    float4x4 M;
+    const mmodel_t* model;
+    const batch_t* batch;
+    // sorted index of the first surface in each batch, plus one past the last
+    const i32* starts;
+    mesh_t* meshes;
+} task_FlattenBatches;
+
+static void FlattenBatchesFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_FlattenBatches* task = (task_FlattenBatches*)pbase;
+    const float4x4 M = task->M;
+    const mmodel_t* model = task->model;
+    const batch_t* batch = task->batch;
+    const i32* pim_noalias starts = task->starts;
+    mesh_t* pim_noalias meshes = task->meshes;
+
+    i32* polygon = NULL;
+    i32* tris = NULL;
+    for (i32 b = begin; b < end; ++b)
+    {
+        mesh_t mesh = meshes[b];
+        i32 length = 0;
+        for (i32 i = starts[b]; i < starts[b + 1]; ++i)
+        {
+            const i32 j = batch->indices[i];
+            if (!IsDrawnSurface(model, batch, j))
+            {
+                continue;
+            }
+            const msurface_t* surface = batch->surfaces + j;
+            i32 vertCount = FlattenSurface(model, surface, &tris, &polygon);
+            ASSERT((length + vertCount) <= mesh.length);
+            length += TrisToMesh(
+                model,
+                M,
+                surface,
+                tris,
+                vertCount,
+                mesh.positions + length,
+                mesh.normals + length,
+                mesh.uvs + length);
+        }
+        mesh.length = length;
+
+        // every surface of a batch shares its texture name
+        const char* texname = batch->texnames[batch->indices[starts[b]]];
+        if ((texname[0] == '*') || (texname[0] == '+'))
+        {
+            FixZFighting(mesh);
+        }
+        meshes[b] = mesh;
+    }
+}
+
 void ModelToDrawables(const mmodel_t* model)
 {
     ASSERT(model);
     ASSERT(model->vertices);
 
-    const float4x4 M = QuakeToRhsMeters();
-
-    const char* name = model->name;
-    const i32 numsurfaces = model->numsurfaces;
-    const msurface_t* surfaces = model->surfaces;
-    const i32 numsurfedges = model->numsurfedges;
-    const float4* vertices = model->vertices;
-
     drawables_t* dr = drawables_get();
     batch_t batch = ModelToBatch(model);
+    if (batch.length <= 0)
+    {
+        return;
+    }
 
-    i32* polygon = NULL;
-    i32* tris = NULL;
+    // batch ids increase along the sorted order, so each batch is a range
+    const i32 batchCount = batch.batchids[batch.indices[batch.length - 1]] + 1;
+    i32* starts = tmp_calloc(sizeof(starts[0]) * (batchCount + 1));
+    mesh_t* meshes = tmp_calloc(sizeof(meshes[0]) * batchCount);
 
-    const mtexture_t* batchtex = NULL;
-    const msurface_t* batchsurf = NULL;
-    i32 curbatch = -1;
-    mesh_t mesh = { 0 };
+    // size each batch for the full triangle fan of its surfaces;
+    // degenerate triangles only shorten the final length
     for (i32 i = 0; i < batch.length; ++i)
     {
         const i32 j = batch.indices[i];
-
-        const msurface_t* surface = batch.surfaces + j;
-        const i32 numedges = surface->numedges;
-        const i32 firstedge = surface->firstedge;
-        const mtexinfo_t* texinfo = batch.texinfos[j];
-        const mtexture_t* mtex = batch.textures[j];
-        const char* texname = batch.texnames[j];
-        const i32 batchid = batch.batchids[j];
-
-        if (batchid != curbatch)
-        {
-            if (mesh.length > 0)
-            {
-                char name[PIM_PATH];
-                SPrintf(ARGS(name), "%s_batch_%d", model->name, curbatch);
-                guid_t guid = guid_str(name, guid_seed);
-                meshid_t meshid;
-                if (mesh_new(&mesh, guid, &meshid))
-                {
-                    i32 c = drawables_add(dr, guid);
-                    dr->meshes[c] = meshid;
-                    dr->materials[c] = GenMaterial(batchtex, batchsurf);
-                    dr->translations[c] = f4_0;
-                    dr->scales[c] = f4_1;
-                    dr->rotations[c] = quat_id;
-                    dr->matrices[c] = f4x4_id;
-                }
-                else
-                {
-                    ASSERT(false);
-                }
-            }
-            memset(&mesh, 0, sizeof(mesh));
-            curbatch = batchid;
-            batchtex = mtex;
-            batchsurf = surface;
-        }
-
-        if ((numedges <= 0) || (firstedge < 0))
+        const i32 b = batch.batchids[j];
+        starts[b + 1] = i + 1;
+        if (IsDrawnSurface(model, &batch, j))
         {
-            continue;
+            meshes[b].length += i1_max(0, batch.surfaces[j].numedges - 2) * 3;
         }
-        if ((firstedge + numedges) > numsurfedges)
-        {
-            continue;
-        }
-        if (StrIStr(texname, 16, "trigger"))
+    }
+    for (i32 b = 0; b < batchCount; ++b)
+    {
+        const i32 capacity = meshes[b].length;
+        if (capacity > 0)
         {
-            continue;
+            meshes[b].positions = perm_malloc(sizeof(meshes[b].positions[0]) * capacity);
+            meshes[b].normals = perm_malloc(sizeof(meshes[b].normals[0]) * capacity);
+            meshes[b].uvs = perm_malloc(sizeof(meshes[b].uvs[0]) * capacity);
         }
+    }
 
-        i32 vertCount = FlattenSurface(model, surface, &tris, &polygon);
-        mesh_t submesh = TrisToMesh(model, M, surface, tris, vertCount);
-        if ((texname[0] == '*') || (texname[0] == '+'))
-        {
-            FixZFighting(submesh);
-        }
+    task_FlattenBatches* task = tmp_calloc(sizeof(*task));
+    task->M = QuakeToRhsMeters();
+    task->model = model;
+    task->batch = &batch;
+    task->starts = starts;
+    task->meshes = meshes;
+    task_run(&task->task, FlattenBatchesFn, batchCount);
 
-        const i32 addlen = submesh.length;
-        const i32 back = mesh.length;
-        const i32 newlen = back + addlen;
-        mesh.length = newlen;
-        PermReserve(mesh.positions, newlen);
-        PermReserve(mesh.normals, newlen);
-        PermReserve(mesh.uvs, newlen);
-        for (i32 i = 0; i < addlen; ++i)
+    // registration stays on this thread, in batch order
+    for (i32 b = 0; b < batchCount; ++b)
+    {
+        mesh_t mesh = meshes[b];
+        if (mesh.length <= 0)
         {
-            mesh.positions[back + i] = submesh.positions[i];
-            mesh.normals[back + i] = submesh.normals[i];
-            mesh.uvs[back + i] = submesh.uvs[i];
+            pim_free(mesh.positions);
+            pim_free(mesh.normals);
+            pim_free(mesh.uvs);
+            continue;
         }
-        pim_free(submesh.positions);
-        pim_free(submesh.normals);
-        pim_free(submesh.uvs);
-        memset(&submesh, 0, sizeof(submesh));
-    }
 
-    if (mesh.length > 0)
-    {
+        const i32 first = batch.indices[starts[b]];
         char name[PIM_PATH];
-        SPrintf(ARGS(name), "%s_batch_%d", model->name, curbatch);
+        SPrintf(ARGS(name), "%s_batch_%d", model->name, b);
         guid_t guid = guid_str(name, guid_seed);
         meshid_t meshid;
         if (mesh_new(&mesh, guid, &meshid))
         {
             i32 c = drawables_add(dr, guid);
             dr->meshes[c] = meshid;
-            dr->materials[c] = GenMaterial(batchtex, batchsurf);
+            dr->materials[c] = GenMaterial(batch.textures[first], batch.surfaces + first);
             dr->translations[c] = f4_0;
             dr->scales[c] = f4_1;
             dr->rotations[c] = quat_id;
@@ -764,7 +786,6 @@ void ModelToDrawables(const mmodel_t* model)
             ASSERT(false);
         }
     }
-    memset(&mesh, 0, sizeof(mesh));
 }
 
 void LoadProgs(const mmodel_t* model, bool loadlights)
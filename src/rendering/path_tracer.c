@@ -29,9 +29,11 @@
 #include "common/random.h"
 #include "common/profiler.h"
 #include "common/console.h"
+#include "common/atomics.h"
 #include "common/cvar.h"
 #include "common/stringutil.h"
-#include "common/serialize.h"
+#include "common/schema.h"
+#include "common/stats.h"
 #include "ui/cimgui.h"
 
 #include "stb/stb_perlin_fork.h"
@@ -108,9 +110,9 @@ typedef struct pt_scene_s
     //   w: 1
     // [vertCount]
     float4* pim_noalias positions;
-    // xyz: vertex normal
+    // octahedral vertex normal, see f4_oct16
     // [vertCount]
-    float4* pim_noalias normals;
+    u32* pim_noalias normals;
     //  xy: texture coordinate
     // [vertCount]
     float2* pim_noalias uvs;
@@ -151,6 +153,7 @@ static cvar_t cv_pt_nee = { .type = cvart_float,.name = "pt_nee",.value = "1",.m
 
 static void OnRtcError(void* user, RTCError error, const char* msg);
 static bool InitRTC(void);
+static bool OnRtcMemory(void* ptr, ssize_t bytes, bool post);
 static void InitSamplers(void);
 static void InitPixelDist(void);
 static void ShutdownPixelDist(void);
@@ -180,6 +183,10 @@ pim_inline float2 VEC_CALL GetVert2(
     const float2* vertices,
     i32 iVert,
     float4 wuv);
+pim_inline float4 VEC_CALL GetNormal(
+    const u32* normals,
+    i32 iVert,
+    float4 wuv);
 pim_inline float VEC_CALL GetArea(const pt_scene_t* scene, i32 iLight);
 pim_inline const material_t* VEC_CALL GetMaterial(
     const pt_scene_t* scene,
@@ -293,6 +300,7 @@ pim_inline void VEC_CALL SetSampler(pt_sampler_t sampler);
 // ----------------------------------------------------------------------------
 
 static cvar_t* cv_pt_lgrid_mpc;
+static stat_t* ms_cameraRays;
 
 static RTCDevice ms_device;
 static dist1d_t ms_pixeldist;
@@ -309,6 +317,14 @@ static void OnRtcError(void* user, RTCError error, const char* msg)
     }
 }
 
+static i64 ms_rtcBytes;
+
+static bool OnRtcMemory(void* ptr, ssize_t bytes, bool post)
+{
+    fetch_add_i64(&ms_rtcBytes, bytes, MO_Relaxed);
+    return true;
+}
+
 static bool InitRTC(void)
 {
     if (!rtc_init())
@@ -322,6 +338,7 @@ static bool InitRTC(void)
         return false;
     }
     rtc.SetDeviceErrorFunction(ms_device, OnRtcError, NULL);
+    rtc.SetDeviceMemoryMonitorFunction(ms_device, OnRtcMemory, NULL);
     return true;
 }
 
@@ -361,6 +378,7 @@ void pt_sys_init(void)
 {
     cvar_reg(&cv_pt_nee);
     cv_pt_lgrid_mpc = cvar_find("pt_lgrid_mpc");
+    ms_cameraRays = stat_counter("pt.camera_rays");
 
     InitRTC();
     InitSamplers();
@@ -436,25 +454,16 @@ static RTCScene RtcNewScene(const pt_scene_t* scene)
 
     if (vertCount > 0)
     {
-        float3* pim_noalias dstPositions = rtc.SetNewGeometryBuffer(
+        // read in place with a float4 stride, the scene outlives rtcScene
+        rtc.SetSharedGeometryBuffer(
             geom,
             RTC_BUFFER_TYPE_VERTEX,
             0,
             RTC_FORMAT_FLOAT3,
-            sizeof(float3),
+            scene->positions,
+            0,
+            sizeof(scene->positions[0]),
             vertCount);
-        if (!dstPositions)
-        {
-            ASSERT(false);
-            rtc.ReleaseGeometry(geom);
-            rtc.ReleaseScene(rtcScene);
-            return NULL;
-        }
-        const float4* pim_noalias srcPositions = scene->positions;
-        for (i32 i = 0; i < vertCount; ++i)
-        {
-            dstPositions[i] = f4_f3(srcPositions[i]);
-        }
     }
 
     if (triCount > 0)
@@ -500,7 +509,7 @@ static void FlattenDrawables(pt_scene_t* scene)
 
     i32 vertCount = 0;
     float4* positions = NULL;
-    float4* normals = NULL;
+    u32* normals = NULL;
     float2* uvs = NULL;
     i32* matIds = NULL;
 
@@ -536,7 +545,8 @@ static void FlattenDrawables(pt_scene_t* scene)
 
             for (i32 j = 0; j < mesh.length; ++j)
             {
-                normals[vertBack + j] = f4_normalize3(f3x3_mul_col(IM, mesh.normals[j]));
+                float4 N = f3x3_mul_col(IM, oct16_f4(mesh.normals[j]));
+                normals[vertBack + j] = f4_oct16(f4_normalize3(N));
             }
 
             for (i32 j = 0; (j + 3) <= mesh.length; j += 3)
@@ -799,6 +809,20 @@ pt_scene_t* pt_scene_new(void)
     return scene;
 }
 
+i64 pt_scene_bytes(const pt_scene_t* scene)
+{
+    i64 bytes = load_i64(&ms_rtcBytes, MO_Relaxed);
+    if (scene)
+    {
+        const i64 vertCount = scene->vertCount;
+        bytes += vertCount * sizeof(scene->positions[0]);
+        bytes += vertCount * sizeof(scene->normals[0]);
+        bytes += vertCount * sizeof(scene->uvs[0]);
+        bytes += vertCount * sizeof(scene->matIds[0]);
+    }
+    return bytes;
+}
+
 void pt_scene_del(pt_scene_t* scene)
 {
     if (scene)
@@ -933,6 +957,18 @@ pim_inline float4 VEC_CALL GetVert4(
         wuv);
 }
 
+pim_inline float4 VEC_CALL GetNormal(
+    const u32* normals,
+    i32 iVert,
+    float4 wuv)
+{
+    return f4_normalize3(f4_blend(
+        oct16_f4(normals[iVert + 0]),
+        oct16_f4(normals[iVert + 1]),
+        oct16_f4(normals[iVert + 2]),
+        wuv));
+}
+
 pim_inline float2 VEC_CALL GetVert2(
     const float2* vertices,
     i32 iVert,
@@ -987,7 +1023,7 @@ pim_inline surfhit_t VEC_CALL GetSurface(
     surf.flags = mat->flags;
     surf.ior = mat->ior;
     float2 uv = GetVert2(scene->uvs, hit.index, hit.wuvt);
-    surf.M = f4_normalize3(GetVert4(scene->normals, hit.index, hit.wuvt));
+    surf.M = GetNormal(scene->normals, hit.index, hit.wuvt);
     surf.N = surf.M;
     surf.P = f4_add(rin.ro, f4_mulvs(rin.rd, hit.wuvt.w));
     surf.P = f4_add(surf.P, f4_mulvs(surf.M, kMilli));
@@ -1366,7 +1402,7 @@ pim_inline lightsample_t VEC_CALL LightSample(
     sample.direction = rd;
     sample.wuvt = wuv;
 
-    float4 N = f4_normalize3(GetVert4(scene->normals, iLight, wuv));
+    float4 N = GetNormal(scene->normals, iLight, wuv);
     float VoNl = f4_dot3(f4_neg(rd), N);
     if (VoNl > 0.0f)
     {
@@ -1555,6 +1591,25 @@ static void media_desc_update(media_desc_t* desc)
     desc->noiseRange = range;
 }
 
+// derived fields are left out, see media_desc_update
+static const schemafield_t kMediaDescFields[] =
+{
+    SCHEMA_FIELD(media_desc_t, constantAlbedo, SchemaType_F4),
+    SCHEMA_FIELD(media_desc_t, noiseAlbedo, SchemaType_F4),
+    SCHEMA_FIELD(media_desc_t, absorption, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, constantAmt, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseAmt, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseOctaves, SchemaType_I32),
+    SCHEMA_FIELD(media_desc_t, noiseGain, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseLacunarity, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseFreq, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseScale, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, noiseHeight, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, amtMie, SchemaType_F32),
+    SCHEMA_FIELD(media_desc_t, amtRayleigh, SchemaType_F32),
+};
+static const schema_t kMediaDescSchema = SCHEMA_DEF(media_desc_t, 1, kMediaDescFields);
+
 static void media_desc_load(media_desc_t* desc, const char* name)
 {
     if (!desc || !name)
@@ -1564,28 +1619,10 @@ static void media_desc_load(media_desc_t* desc, const char* name)
     memset(desc, 0, sizeof(*desc));
     char filename[PIM_PATH];
     SPrintf(ARGS(filename), "%s.json", name);
-    ser_obj_t* root = ser_fromfile(filename);
-    if (root)
-    {
-        ser_getfield_f4(desc, root, constantAlbedo);
-        ser_getfield_f4(desc, root, noiseAlbedo);
-        ser_getfield_f32(desc, root, absorption);
-        ser_getfield_f32(desc, root, constantAmt);
-        ser_getfield_f32(desc, root, noiseAmt);
-        ser_getfield_i32(desc, root, noiseOctaves);
-        ser_getfield_f32(desc, root, noiseGain);
-        ser_getfield_f32(desc, root, noiseLacunarity);
-        ser_getfield_f32(desc, root, noiseFreq);
-        ser_getfield_f32(desc, root, noiseScale);
-        ser_getfield_f32(desc, root, noiseHeight);
-        ser_getfield_f32(desc, root, amtMie);
-        ser_getfield_f32(desc, root, amtRayleigh);
-    }
-    else
+    if (!schema_loadjson(&kMediaDescSchema, filename, desc))
     {
         con_logf(LogSev_Error, "pt", "Failed to load media desc '%s'", filename);
     }
-    ser_obj_del(root);
 }
 
 static void media_desc_save(const media_desc_t* desc, const char* name)
@@ -1596,27 +1633,9 @@ static void media_desc_save(const media_desc_t* desc, const char* name)
     }
     char filename[PIM_PATH];
     SPrintf(ARGS(filename), "%s.json", name);
-    ser_obj_t* root = ser_obj_dict();
-    if (root)
-    {
-        ser_setfield_f4(desc, root, constantAlbedo);
-        ser_setfield_f4(desc, root, noiseAlbedo);
-        ser_setfield_f32(desc, root, absorption);
-        ser_setfield_f32(desc, root, constantAmt);
-        ser_setfield_f32(desc, root, noiseAmt);
-        ser_setfield_i32(desc, root, noiseOctaves);
-        ser_setfield_f32(desc, root, noiseGain);
-        ser_setfield_f32(desc, root, noiseLacunarity);
-        ser_setfield_f32(desc, root, noiseFreq);
-        ser_setfield_f32(desc, root, noiseScale);
-        ser_setfield_f32(desc, root, noiseHeight);
-        ser_setfield_f32(desc, root, amtMie);
-        ser_setfield_f32(desc, root, amtRayleigh);
-        if (!ser_tofile(filename, root))
-        {
-            con_logf(LogSev_Error, "pt", "Failed to save media desc '%s'", filename);
-        }
-        ser_obj_del(root);
+    if (!schema_savejson(&kMediaDescSchema, filename, desc))
+    {
+        con_logf(LogSev_Error, "pt", "Failed to save media desc '%s'", filename);
     }
 }
 
@@ -2112,6 +2131,7 @@ void pt_trace(pt_trace_t* desc)
 
     const i32 workSize = desc->imageSize.x * desc->imageSize.y;
     task_run(&task->task, TraceFn, workSize);
+    stat_add(ms_cameraRays, workSize);
 
     ProfileEnd(pm_trace);
 }
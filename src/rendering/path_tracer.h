@@ -79,6 +79,8 @@ float VEC_CALL pt_sample_1d(pt_sampler_t* sampler);
 
 pt_scene_t* pt_scene_new(void);
 void pt_scene_del(pt_scene_t* scene);
+// flattened scene attributes plus everything embree allocated for path tracing
+i64 pt_scene_bytes(const pt_scene_t* scene);
 void pt_scene_gui(pt_scene_t* scene);
 
 void pt_trace_new(pt_trace_t* trace, pt_scene_t* scene, const camera_t* camera, int2 imageSize);
@@ -69,8 +69,13 @@ static cvar_t cv_lm_gen = { .type = cvart_bool,.name = "lm_gen",.value = "0",.de
 static cvar_t cv_cm_gen = { .type = cvart_bool,.name = "cm_gen",.value = "0",.desc = "enable cubemap generation" };
 
 static cvar_t cv_r_sw = { .type = cvart_bool,.name = "r_sw",.value = "1",.desc = "use software renderer" };
+static cvar_t cv_r_dynres = { .type = cvart_bool,.name = "r_dynres",.value = "1",.desc = "scale the render resolution to hold r_dynres_ms" };
+static cvar_t cv_r_dynres_ms = { .type = cvart_float,.name = "r_dynres_ms",.value = "33.3",.minFloat = 1.0f,.maxFloat = 1000.0f,.desc = "target milliseconds to render and resolve a frame" };
+static cvar_t cv_r_dynres_min = { .type = cvart_float,.name = "r_dynres_min",.value = "0.5",.minFloat = 0.1f,.maxFloat = 1.0f,.desc = "minimum render resolution scale" };
 
 static cvar_t cv_lm_density = { .type = cvart_float,.name = "lm_density",.value = "8",.minFloat = 0.1f,.maxFloat = 32.0f,.desc = "lightmap texels per unit" };
+static cvar_t cv_lm_incremental = { .type = cvart_bool,.name = "lm_incremental",.value = "1",.desc = "on scene edits, rebake only the lightmap texels that can see the change" };
+static cvar_t cv_lm_cooked = { .type = cvart_bool,.name = "lm_cooked",.value = "1",.desc = "load compressed read-only lightmaps when available" };
 static cvar_t cv_lm_timeslice = { .type = cvart_int,.name = "lm_timeslice",.value = "3",.minInt = 0,.maxInt = 60,.desc = "number of frames required to add 1 lighting sample to all lightmap texels" };
 
 static cvar_t cv_r_sun_dir = { .type = cvart_vector,.name = "r_sun_dir",.value = "0.0 0.968 0.253 0.0",.desc = "Sun Direction" };
@@ -78,10 +83,16 @@ static cvar_t cv_r_sun_col = { .type = cvart_color,.name = "r_sun_col",.value =
 static cvar_t cv_r_sun_lum = { .type = cvart_float,.name = "r_sun_lum",.value = "12.0",.minFloat = -20.0f,.maxFloat = 20.0f,.desc = "Log2 Sun Luminance" };
 
 static cvar_t cv_r_qlights = { .type = cvart_bool,.name = "r_qlights",.value = "0",.desc = "Load quake light entities" };
+static cvar_t cv_r_stream = { .type = cvart_bool,.name = "r_stream",.value = "1",.desc = "Stream map meshes and textures in over several frames" };
+static cvar_t cv_r_archive = { .type = cvart_bool,.name = "r_archive",.value = "1",.desc = "Map meshes and textures in place from the map's cooked archive, when present" };
+static cvar_t cv_r_archive_deflate = { .type = cvart_bool,.name = "r_archive_deflate",.value = "0",.desc = "Compress textures written by mapsave into the cooked archive" };
 
 static void RegCVars(void)
 {
     cvar_reg(&cv_r_sw);
+    cvar_reg(&cv_r_dynres);
+    cvar_reg(&cv_r_dynres_ms);
+    cvar_reg(&cv_r_dynres_min);
 
     cvar_reg(&cv_pt_trace);
     cvar_reg(&cv_pt_denoise);
@@ -92,6 +103,8 @@ static void RegCVars(void)
     cvar_reg(&cv_lm_gen);
     cvar_reg(&cv_lm_density);
     cvar_reg(&cv_lm_timeslice);
+    cvar_reg(&cv_lm_cooked);
+    cvar_reg(&cv_lm_incremental);
 
     cvar_reg(&cv_cm_gen);
 
@@ -100,6 +113,9 @@ static void RegCVars(void)
     cvar_reg(&cv_r_sun_lum);
 
     cvar_reg(&cv_r_qlights);
+    cvar_reg(&cv_r_stream);
+    cvar_reg(&cv_r_archive);
+    cvar_reg(&cv_r_archive_deflate);
 }
 
 // ----------------------------------------------------------------------------
@@ -111,13 +127,20 @@ static cmdstat_t CmdLookat(i32 argc, const char** argv);
 static cmdstat_t CmdPtTest(i32 argc, const char** argv);
 static cmdstat_t CmdPtStdDev(i32 argc, const char** argv);
 static cmdstat_t CmdLoadTest(i32 argc, const char** argv);
+static cmdstat_t CmdGeomMem(i32 argc, const char** argv);
 static cmdstat_t CmdLoadMap(i32 argc, const char** argv);
 static cmdstat_t CmdSaveMap(i32 argc, const char** argv);
+static cmdstat_t CmdBakeMaps(i32 argc, const char** argv);
+static void BakeSky(void);
 
 // ----------------------------------------------------------------------------
 
 static framebuf_t ms_buffers[2];
 static i32 ms_iFrame;
+static i32 ms_rasterFrame = -2;
+static float ms_drawScale = 1.0f;
+static float ms_renderMs; // smoothed time to draw and resolve a frame
+static bool ms_headless;
 
 static TonemapId ms_tonemapper = TMap_ACES;
 static float4 ms_toneParams;
@@ -133,10 +156,28 @@ static exposure_t ms_exposure =
 
     .adaptRate = 1.0f,
     .offsetEV = 0.0f,
+    .histMinProb = 0.1f,
+    .histMaxProb = 0.9f,
+    .centerWeight = 0.5f,
+    .meterStride = 2,
 };
+static exphist_t ms_exphist;
 
 static camera_t ms_ptcam;
 static pt_scene_t* ms_ptscene;
+static guid_t ms_mapGuid;
+
+// drawables as of the last pt scene build, to find what an edit touched
+typedef struct scenesnap_s
+{
+    i32 count;
+    guid_t* names;
+    u32* versions;
+    float4x4* matrices;
+    material_t* materials;
+    box_t* bounds;  // world space
+} scenesnap_t;
+static scenesnap_t ms_snap;
 static pt_trace_t ms_trace;
 
 static i32 ms_lmSampleCount;
@@ -162,6 +203,52 @@ static void SwapBuffers(void)
     ++ms_iFrame;
 }
 
+static void ResizeDrawBuffers(i32 width, i32 height)
+{
+    framebuf_t* frontBuf = GetFrontBuf();
+    if ((frontBuf->width == width) && (frontBuf->height == height))
+    {
+        return;
+    }
+    framebuf_resize(frontBuf, width, height);
+    framebuf_resize(GetBackBuf(), width, height);
+    // the back buffer no longer holds the last frame
+    ms_rasterFrame = -2;
+    // restarts accumulation at the new size
+    pt_trace_del(&ms_trace);
+    ms_ptSampleCount = 0;
+}
+
+// steers the render resolution toward the target frame cost.
+// cost is roughly proportional to pixel count, so the scale along each
+// axis moves by the square root of the error.
+static void UpdateDrawScale(void)
+{
+    const float targetMs = cvar_get_float(&cv_r_dynres_ms);
+    float scale = 1.0f;
+    if (cvar_get_bool(&cv_r_dynres) && (ms_renderMs > 0.0f))
+    {
+        scale = ms_drawScale;
+        const float error = targetMs / ms_renderMs;
+        // dead band, so the size does not flip back and forth every frame
+        if ((error < 0.9f) || (error > 1.1f))
+        {
+            scale *= f1_lerp(1.0f, sqrtf(error), 0.25f);
+        }
+        scale = f1_clamp(scale, cvar_get_float(&cv_r_dynres_min), 1.0f);
+    }
+    ms_drawScale = scale;
+
+    // multiples of 8 keep the resolve on its 8 wide path
+    const i32 width = i1_clamp((i32)(kDrawWidth * scale + 4.0f) & ~7, 8, kDrawWidth);
+    const i32 height = i1_clamp((i32)(width / kDrawAspect + 0.5f), 1, kDrawHeight);
+    ResizeDrawBuffers(width, height);
+
+    profile_value("r_dynres target ms", targetMs);
+    profile_value("r_dynres actual ms", ms_renderMs);
+    profile_value("r_dynres scale", (float)width / kDrawWidth);
+}
+
 framebuf_t* render_sys_frontbuf(void)
 {
     return GetFrontBuf();
@@ -172,10 +259,110 @@ framebuf_t* render_sys_backbuf(void)
     return GetBackBuf();
 }
 
+static void SceneSnap_Del(scenesnap_t* snap)
+{
+    pim_free(snap->names);
+    pim_free(snap->versions);
+    pim_free(snap->matrices);
+    pim_free(snap->materials);
+    pim_free(snap->bounds);
+    memset(snap, 0, sizeof(*snap));
+}
+
+static void SceneSnap_Take(scenesnap_t* snap)
+{
+    SceneSnap_Del(snap);
+    const drawables_t* dr = drawables_get();
+    const i32 len = dr->count;
+    snap->count = len;
+    snap->names = perm_malloc(sizeof(snap->names[0]) * len);
+    snap->versions = perm_malloc(sizeof(snap->versions[0]) * len);
+    snap->matrices = perm_malloc(sizeof(snap->matrices[0]) * len);
+    snap->materials = perm_malloc(sizeof(snap->materials[0]) * len);
+    snap->bounds = perm_malloc(sizeof(snap->bounds[0]) * len);
+    for (i32 i = 0; i < len; ++i)
+    {
+        snap->names[i] = dr->names[i];
+        snap->versions[i] = dr->versions[i];
+        snap->matrices[i] = dr->matrices[i];
+        snap->materials[i] = dr->materials[i];
+        snap->bounds[i] = box_transform(dr->matrices[i], dr->bounds[i]);
+    }
+}
+
+// returns true and the world space region covering every added, removed,
+// moved or re-materialed drawable since the snapshot
+static bool SceneSnap_Diff(const scenesnap_t* snap, box_t* regionOut)
+{
+    const drawables_t* dr = drawables_get();
+    const i32 len = dr->count;
+
+    // this runs every frame. a drawable gets a new version when added,
+    // loaded or moved, and keeps it when others are removed, so only
+    // material edits need comparing before the full match below.
+    bool same = len == snap->count;
+    if (same && (len > 0))
+    {
+        same = !memcmp(snap->versions, dr->versions, sizeof(dr->versions[0]) * len) &&
+            !memcmp(snap->materials, dr->materials, sizeof(dr->materials[0]) * len);
+    }
+    if (same)
+    {
+        *regionOut = box_empty();
+        return false;
+    }
+
+    bool* pim_noalias found = tmp_calloc(sizeof(found[0]) * i1_max(1, snap->count));
+    bool changed = false;
+    box_t region = box_empty();
+    for (i32 i = 0; i < len; ++i)
+    {
+        i32 j = i;
+        if ((j >= snap->count) || !guid_eq(snap->names[j], dr->names[i]))
+        {
+            j = -1;
+            for (i32 k = 0; k < snap->count; ++k)
+            {
+                if (guid_eq(snap->names[k], dr->names[i]))
+                {
+                    j = k;
+                    break;
+                }
+            }
+        }
+        const box_t bounds = box_transform(dr->matrices[i], dr->bounds[i]);
+        if (j < 0)
+        {
+            changed = true;
+            region = box_union(region, bounds);
+            continue;
+        }
+        found[j] = true;
+        bool edited = memcmp(snap->matrices + j, dr->matrices + i, sizeof(dr->matrices[0])) != 0;
+        edited |= memcmp(snap->materials + j, dr->materials + i, sizeof(dr->materials[0])) != 0;
+        if (edited)
+        {
+            changed = true;
+            region = box_union(region, box_union(snap->bounds[j], bounds));
+        }
+    }
+    for (i32 j = 0; j < snap->count; ++j)
+    {
+        if (!found[j])
+        {
+            changed = true;
+            region = box_union(region, snap->bounds[j]);
+        }
+    }
+    *regionOut = region;
+    return changed;
+}
+
 static void EnsurePtScene(void)
 {
     if (!ms_ptscene)
     {
+        SceneSnap_Take(&ms_snap);
         ms_ptscene = pt_scene_new();
         ms_ptSampleCount = 0;
         ms_acSampleCount = 0;
@@ -190,6 +377,7 @@ static void ShutdownPtScene(void)
     {
         pt_scene_del(ms_ptscene);
         ms_ptscene = NULL;
+        SceneSnap_Del(&ms_snap);
         pt_trace_del(&ms_trace);
     }
 }
@@ -246,16 +434,166 @@ static cmdstat_t CmdPtStdDev(i32 argc, const char** argv)
     return cmdstat_err;
 }
 
+// resolves the front buffer repeatedly with each tonemapper
+static cmdstat_t CmdTonemapBench(i32 argc, const char** argv)
+{
+    i32 iterations = 100;
+    if (argc > 1)
+    {
+        iterations = i1_max(1, atoi(argv[1]));
+    }
+
+    framebuf_t* buf = GetFrontBuf();
+    const i32 pixels = buf->width * buf->height;
+    const char* const* names = Tonemap_Names();
+    exphist_t hist;
+    for (i32 id = 0; id < TMap_COUNT; ++id)
+    {
+        const u64 begin = time_now();
+        for (i32 i = 0; i < iterations; ++i)
+        {
+            ResolveTile(buf, id, ms_toneParams, 1.0f, &ms_exposure, &hist);
+        }
+        const double ns = time_sec(time_now() - begin) * 1e9;
+        con_logf(LogSev_Info, "cmd", "tmap_bench %s: %.3f pixels/ns (%dx%d, %d iterations)",
+            names[id], ((double)pixels * iterations) / ns, buf->width, buf->height, iterations);
+    }
+    return cmdstat_ok;
+}
+
+// mean squared error of light tonemapped to [0, 1], as psnr in dB
+static float CalcPsnr(const float4* pim_noalias test, const float4* pim_noalias ref, i32 len)
+{
+    const float weight = 1.0f / (3 * len);
+    float mse = 0.0f;
+    for (i32 i = 0; i < len; ++i)
+    {
+        float4 a = f4_tosrgb(tmap4_reinhard(test[i]));
+        float4 b = f4_tosrgb(tmap4_reinhard(ref[i]));
+        float4 d = f4_sub(a, b);
+        mse = weight * f4_sum3(f4_mul(d, d)) + mse;
+    }
+    return 10.0f * log10f(1.0f / f1_max(mse, 1e-10f));
+}
+
+// pans the camera, drawing each frame with r_temporal and again without it
+static cmdstat_t CmdTemporalBench(i32 argc, const char** argv)
+{
+    i32 frames = 60;
+    i32 mode = 1;
+    if (argc > 1)
+    {
+        frames = i1_max(2, atoi(argv[1]));
+    }
+    if (argc > 2)
+    {
+        mode = i1_clamp(atoi(argv[2]), 1, 2);
+    }
+    cvar_t* cvTemporal = cvar_find("r_temporal");
+    cvar_t* cvVisbuf = cvar_find("r_visbuf");
+    if (!cvTemporal || !cvVisbuf)
+    {
+        return cmdstat_err;
+    }
+    const i32 prevTemporal = cvar_get_int(cvTemporal);
+    const bool prevVisbuf = cvar_get_bool(cvVisbuf);
+    cvar_set_bool(cvVisbuf, true);
+
+    framebuf_t bufs[2];
+    framebuf_t ref;
+    framebuf_create(&bufs[0], kDrawWidth, kDrawHeight);
+    framebuf_create(&bufs[1], kDrawWidth, kDrawHeight);
+    framebuf_create(&ref, kDrawWidth, kDrawHeight);
+
+    camera_t camera;
+    camera_get(&camera);
+    const quat rot0 = camera.rotation;
+    const float4 up = quat_up(rot0);
+
+    double temporalMs = 0.0;
+    double fullMs = 0.0;
+    float psnrSum = 0.0f;
+    float psnrMin = 1e10f;
+    for (i32 i = 0; i < frames; ++i)
+    {
+        const float yaw = f1_radians(0.25f * i);
+        camera.rotation = quat_mul(quat_angleaxis(yaw, up), rot0);
+        framebuf_t* cur = &bufs[i & 1];
+        const framebuf_t* prev = (i > 0) ? &bufs[(i + 1) & 1] : NULL;
+
+        cvar_set_int(cvTemporal, mode);
+        u64 begin = time_now();
+        RtcDraw(cur, prev, &camera);
+        temporalMs += time_milli(time_now() - begin);
+
+        cvar_set_int(cvTemporal, 0);
+        begin = time_now();
+        RtcDraw(&ref, NULL, &camera);
+        fullMs += time_milli(time_now() - begin);
+
+        float psnr = CalcPsnr(cur->light, ref.light, kDrawPixels);
+        psnrSum += psnr;
+        psnrMin = f1_min(psnrMin, psnr);
+    }
+
+    framebuf_destroy(&bufs[0]);
+    framebuf_destroy(&bufs[1]);
+    framebuf_destroy(&ref);
+    cvar_set_int(cvTemporal, prevTemporal);
+    cvar_set_bool(cvVisbuf, prevVisbuf);
+
+    con_logf(LogSev_Info, "cmd", "temporal_bench mode %d: %.3f ms vs %.3f ms full, psnr avg %.2f dB min %.2f dB (%dx%d, %d frames)",
+        mode, temporalMs / frames, fullMs / frames, psnrSum / frames, psnrMin, kDrawWidth, kDrawHeight, frames);
+    return cmdstat_ok;
+}
+
+// resident geometry: mesh vertices plus what each ray tracer holds
+static i64 LogGeometryBytes(const char* label)
+{
+    const double kMB = 1.0 / (1 << 20);
+    const i64 meshBytes = mesh_sys_bytes();
+    const i64 rtcBytes = RtcDrawBytes();
+    const i64 ptBytes = ms_ptscene ? pt_scene_bytes(ms_ptscene) : 0;
+    const i64 total = meshBytes + rtcBytes + ptBytes;
+    con_logf(LogSev_Info, "cmd", "%s: geometry %.2f MB (meshes %.2f MB, rtcdraw %.2f MB, path tracer %.2f MB)",
+        label, total * kMB, meshBytes * kMB, rtcBytes * kMB, ptBytes * kMB);
+    return total;
+}
+
+static cmdstat_t CmdGeomMem(i32 argc, const char** argv)
+{
+    LogGeometryBytes("geom_mem");
+    return cmdstat_ok;
+}
+
+// hitch: time mapload blocks the frame; total: until every asset is in
 static cmdstat_t CmdLoadTest(i32 argc, const char** argv)
 {
     char cmd[PIM_PATH];
+    i64 peakBytes = 0;
+    double hitchSum = 0.0;
+    double hitchMax = 0.0;
+    double totalSum = 0.0;
+    i32 mapCount = 0;
     con_exec("mapload start");
+    asset_load_flush();
+    texture_unpalette_flush();
+    const texunpalstats_t unpalBegin = texture_unpalette_stats();
     for (i32 e = 1; ; ++e)
     {
         for (i32 m = 1; ; ++m)
         {
             SPrintf(ARGS(cmd), "mapload e%dm%d", e, m);
+            char next[PIM_PATH];
+            SPrintf(ARGS(next), "maps/e%dm%d.bsp", e, m + 1);
+            const u64 begin = time_now();
+            // the next map is the only upcoming request the test knows of
+            asset_prefetch(next);
             cmdstat_t status = cmd_exec(cmd);
+            const u64 loaded = time_now();
+            asset_load_flush();
+            texture_unpalette_flush();
+            const u64 streamed = time_now();
             if (status != cmdstat_ok)
             {
                 if (m == 1)
@@ -264,9 +602,36 @@ static cmdstat_t CmdLoadTest(i32 argc, const char** argv)
                 }
                 break;
             }
+            const double hitchMs = time_milli(loaded - begin);
+            const double totalMs = time_milli(streamed - begin);
+            con_logf(LogSev_Info, "cmd", "%s: hitch %.2f ms, total %.2f ms", cmd, hitchMs, totalMs);
+            hitchSum += hitchMs;
+            hitchMax = hitchMs > hitchMax ? hitchMs : hitchMax;
+            totalSum += totalMs;
+            ++mapCount;
+            // builds the rtcdraw scene so its memory is counted
+            camera_t camera;
+            camera_get(&camera);
+            RtcDraw(GetFrontBuf(), NULL, &camera);
+            const i64 bytes = LogGeometryBytes(cmd);
+            peakBytes = bytes > peakBytes ? bytes : peakBytes;
         }
     }
 end:
+    con_logf(LogSev_Info, "cmd", "loadtest: %d maps (%s, %s), hitch %.2f ms avg %.2f ms max, total %.2f ms",
+        mapCount,
+        cvar_get_bool(&cv_r_stream) ? "streamed" : "blocking",
+        cvar_get_bool(&cv_r_archive) ? "archive" : "file per asset",
+        mapCount > 0 ? hitchSum / mapCount : 0.0,
+        hitchMax,
+        totalSum);
+    const texunpalstats_t unpalEnd = texture_unpalette_stats();
+    con_logf(LogSev_Info, "cmd", "loadtest: unpalette %d in memory, %d from disk, %d generated, %.2f ms task time",
+        unpalEnd.memHits - unpalBegin.memHits,
+        unpalEnd.diskHits - unpalBegin.diskHits,
+        unpalEnd.generated - unpalBegin.generated,
+        unpalEnd.cpuMs - unpalBegin.cpuMs);
+    con_logf(LogSev_Info, "cmd", "loadtest: peak geometry %.2f MB", peakBytes / (double)(1 << 20));
     con_exec("mapload end");
     con_exec("mapload start");
     return cmdstat_ok;
@@ -280,8 +645,33 @@ static void Lightmap_Trace(void)
         ProfileBegin(pm_Lightmap_Trace);
         EnsurePtScene();
 
+        if (lmpack_iscooked(lmpack_get()))
+        {
+            // resume from the bake data, if any
+            lmpack_load(lmpack_get(), ms_mapGuid);
+        }
+
         bool dirty = lmpack_get()->lmCount == 0;
         dirty |= cvar_check_dirty(&cv_lm_density);
+
+        box_t region;
+        if (!dirty && SceneSnap_Diff(&ms_snap, &region))
+        {
+            // the pt scene is a snapshot too; rebuild it before retracing
+            ShutdownPtScene();
+            EnsurePtScene();
+            if (cvar_get_bool(&cv_lm_incremental))
+            {
+                const u64 begin = time_now();
+                i32 resetCount = lmpack_invalidate(ms_ptscene, region);
+                con_logf(LogSev_Info, "LM", "Scene edit reset %d lightmap texels in %.2f ms",
+                    resetCount, time_milli(time_now() - begin));
+            }
+            else
+            {
+                dirty = true;
+            }
+        }
         if (dirty)
         {
             LightmapRepack();
@@ -351,7 +741,7 @@ static bool PathTrace(void)
             }
         }
 
-        const int2 size = { kDrawWidth, kDrawHeight };
+        const int2 size = { GetFrontBuf()->width, GetFrontBuf()->height };
         ms_trace.sampleWeight = 1.0f / ++ms_ptSampleCount;
         if (!ms_trace.color)
         {
@@ -362,7 +752,7 @@ static bool PathTrace(void)
         float3* pim_noalias output3 = ms_trace.color;
         if (cvar_get_bool(&cv_pt_denoise))
         {
-            output3 = tmp_malloc(sizeof(output3[0]) * kDrawPixels);
+            output3 = tmp_malloc(sizeof(output3[0]) * size.x * size.y);
 
             bool denoised = Denoise(
                 DenoiseType_Image,
@@ -421,7 +811,10 @@ static void Rasterize(void)
         camera_t camera;
         camera_get(&camera);
 
-        RtcDraw(frontBuf, &camera);
+        // the back buffer holds the last frame's light if it was rasterized
+        const bool hasHistory = ms_rasterFrame == (ms_iFrame - 1);
+        RtcDraw(frontBuf, hasHistory ? backBuf : NULL, &camera);
+        ms_rasterFrame = ms_iFrame;
 
         ProfileEnd(pm_Rasterize);
     }
@@ -498,16 +891,45 @@ static bool Present(void)
         ProfileBegin(pm_Present);
         sw_present = true;
         framebuf_t* frontBuf = GetFrontBuf();
-        int2 size = { frontBuf->width, frontBuf->height };
         ms_exposure.deltaTime = (float)time_dtf();
-        ExposeImage(size, frontBuf->light, &ms_exposure);
-        ResolveTile(frontBuf, ms_tonemapper, ms_toneParams);
+        float exposure = UpdateExposure(&ms_exposure, &ms_exphist);
+        ResolveTile(frontBuf, ms_tonemapper, ms_toneParams, exposure, &ms_exposure, &ms_exphist);
         TakeScreenshot();
         ProfileEnd(pm_Present);
     }
     return sw_present;
 }
 
+static i32 LightmapBytes(const lmpack_t* pack)
+{
+    if (lmpack_iscooked(pack))
+    {
+        return (i32)pack->cookedMap.size;
+    }
+    const i32 texelBytes =
+        sizeof(float4) * kGiDirections +
+        sizeof(float3) * 2 +
+        sizeof(float);
+    return pack->lmCount * pack->lmSize * pack->lmSize * texelBytes;
+}
+
+static void LoadLightmaps(guid_t guid)
+{
+    lmpack_t* pack = lmpack_get();
+    const u64 begin = time_now();
+    bool cooked = cvar_get_bool(&cv_lm_cooked) && lmpack_loadcooked(pack, guid);
+    bool loaded = cooked || lmpack_load(pack, guid);
+    const double ms = time_milli(time_now() - begin);
+    if (loaded)
+    {
+        con_logf(LogSev_Info, "cmd", "mapload loaded %d %s lightmaps in %.2f ms (%d KB)",
+            pack->lmCount,
+            cooked ? "cooked" : "baked",
+            ms,
+            LightmapBytes(pack) >> 10);
+    }
+}
+
 static cmdstat_t CmdLoadMap(i32 argc, const char** argv)
 {
     if (argc != 2)
@@ -522,6 +944,11 @@ static cmdstat_t CmdLoadMap(i32 argc, const char** argv)
         return cmdstat_err;
     }
 
+    char mapname[PIM_PATH] = { 0 };
+    SPrintf(ARGS(mapname), "maps/%s.bsp", name);
+    // pages the bsp in while the previous map is torn down
+    asset_prefetch(mapname);
+
     con_logf(LogSev_Info, "cmd", "mapload is clearing drawables.");
     drawables_clear(drawables_get());
     ShutdownPtScene();
@@ -529,26 +956,41 @@ static cmdstat_t CmdLoadMap(i32 argc, const char** argv)
     camera_reset();
     vkr_onunload();
 
-    char mapname[PIM_PATH] = { 0 };
-    SPrintf(ARGS(mapname), "maps/%s.bsp", name);
     con_logf(LogSev_Info, "cmd", "mapload is loading '%s'.", mapname);
 
     bool loadlights = cvar_get_bool(&cv_r_qlights);
     guid_t guid = guid_str(mapname, guid_seed);
 
-    bool loaded = drawables_load(drawables_get(), guid);
+    ms_mapGuid = guid;
+    archive_t* archive = NULL;
+    if (cvar_get_bool(&cv_r_archive))
+    {
+        char archivename[PIM_PATH] = "data/";
+        guid_tofile(ARGS(archivename), guid, ".archive");
+        archive = archive_open(archivename);
+    }
+    bool streamed = cvar_get_bool(&cv_r_stream);
+    bool loaded = streamed ?
+        drawables_stream(drawables_get(), guid, archive) :
+        drawables_load(drawables_get(), guid, archive);
+    // assets mapped from the archive hold their own references
+    archive_release(archive);
     if (loaded)
     {
-        lmpack_load(lmpack_get(), guid);
+        // saved bounds are kept, meshes may still be in flight
+        LoadLightmaps(guid);
     }
     else
     {
         loaded = LoadModelAsDrawables(mapname, loadlights);
+        if (loaded)
+        {
+            drawables_updatebounds(drawables_get());
+        }
     }
     if (loaded)
     {
         drawables_updatetransforms(drawables_get());
-        drawables_updatebounds(drawables_get());
         vkr_onload();
         con_logf(LogSev_Info, "cmd", "mapload loaded '%s'.", mapname);
         return cmdstat_ok;
@@ -581,19 +1023,28 @@ static cmdstat_t CmdSaveMap(i32 argc, const char** argv)
 
     guid_t guid = guid_str(mapname, guid_seed);
 
+    // placeholders must not be written in place of the real texels
+    asset_load_flush();
+    texture_unpalette_flush();
     bool saved = drawables_save(drawables_get(), guid);
     if (saved)
     {
         con_logf(LogSev_Info, "cmd", "mapsave saved '%s' drawables.", mapname);
+        const ArchiveCodec codec = cvar_get_bool(&cv_r_archive_deflate) ? ArchiveCodec_Deflate : ArchiveCodec_None;
+        if (!drawables_archive(drawables_get(), guid, codec))
+        {
+            con_logf(LogSev_Warning, "cmd", "mapsave failed to archive '%s' meshes and textures.", mapname);
+        }
     }
     else
     {
         con_logf(LogSev_Error, "cmd", "mapsave failed to saved '%s' drawables.", mapname);
     }
 
-    if (saved)
+    // cooked lightmaps are already on disk and cannot be re-saved
+    if (saved && !lmpack_iscooked(lmpack_get()))
     {
-        saved = lmpack_save(lmpack_get(), guid);
+        saved = lmpack_save(lmpack_get(), guid) && lmpack_cook(lmpack_get(), guid);
         if (saved)
         {
             con_logf(LogSev_Info, "cmd", "mapsave saved '%s' lightmaps.", mapname);
@@ -607,6 +1058,97 @@ static cmdstat_t CmdSaveMap(i32 argc, const char** argv)
     return saved ? cmdstat_ok : cmdstat_err;
 }
 
+static i32 CountBakedTexels(const lmpack_t* pack)
+{
+    i32 texelCount = 0;
+    for (i32 i = 0; i < pack->lmCount; ++i)
+    {
+        const lightmap_t lm = pack->lightmaps[i];
+        const i32 len = lm.size * lm.size;
+        for (i32 j = 0; j < len; ++j)
+        {
+            if (lm.sampleCounts[j] > 0.0f)
+            {
+                ++texelCount;
+            }
+        }
+    }
+    return texelCount;
+}
+
+// packs and bakes the lightmaps of each map to a fixed sample count,
+// without frame pacing, then saves them alongside the drawables.
+// usable from the headless build: pim -headless "lm_bake 256 e1m1 e1m2"
+ProfileMark(pm_BakeMaps, CmdBakeMaps)
+static cmdstat_t CmdBakeMaps(i32 argc, const char** argv)
+{
+    if (argc < 3)
+    {
+        con_logf(LogSev_Error, "cmd", "usage: lm_bake <samples per texel> <map name> [map names...]");
+        return cmdstat_err;
+    }
+    const i32 samples = atoi(argv[1]);
+    if (samples <= 0)
+    {
+        con_logf(LogSev_Error, "cmd", "lm_bake: sample count must be positive, got '%s'.", argv[1]);
+        return cmdstat_err;
+    }
+
+    ProfileBegin(pm_BakeMaps);
+
+    cmdstat_t status = cmdstat_ok;
+    char cmd[PIM_PATH];
+    for (i32 iMap = 2; iMap < argc; ++iMap)
+    {
+        const char* name = argv[iMap];
+
+        SPrintf(ARGS(cmd), "mapload %s", name);
+        if (cmd_exec(cmd) != cmdstat_ok)
+        {
+            status = cmdstat_err;
+            continue;
+        }
+        asset_load_flush();
+        texture_unpalette_flush();
+
+        BakeSky();
+
+        const u64 packBegin = time_now();
+        ShutdownPtScene();
+        EnsurePtScene();
+        LightmapRepack();
+        const double packSeconds = time_sec(time_now() - packBegin);
+
+        // a timeslice of 1 adds one sample to every texel per pass
+        const i32 texelCount = CountBakedTexels(lmpack_get());
+        const u64 bakeBegin = time_now();
+        for (i32 i = 0; i < samples; ++i)
+        {
+            lmpack_bake(ms_ptscene, 1.0f);
+        }
+        const double bakeSeconds = time_sec(time_now() - bakeBegin);
+        const double texelSamples = (double)texelCount * samples;
+        const double samplesPerSecond = bakeSeconds > 0.0 ? texelSamples / bakeSeconds : 0.0;
+
+        con_logf(LogSev_Info, "lm", "'%s': %d lightmaps, %d texels, pack %.2fs, bake %.2fs, %.2f Msamples/s",
+            name,
+            lmpack_get()->lmCount,
+            texelCount,
+            packSeconds,
+            bakeSeconds,
+            samplesPerSecond * 1e-6);
+
+        SPrintf(ARGS(cmd), "mapsave %s", name);
+        if (cmd_exec(cmd) != cmdstat_ok)
+        {
+            status = cmdstat_err;
+        }
+    }
+
+    ProfileEnd(pm_BakeMaps);
+    return status;
+}
+
 typedef struct task_BakeSky
 {
     task_t task;
@@ -688,8 +1230,15 @@ void render_sys_init(void)
     cmd_reg("pt_test", CmdPtTest);
     cmd_reg("pt_stddev", CmdPtStdDev);
     cmd_reg("loadtest", CmdLoadTest);
+    cmd_reg("geom_mem", CmdGeomMem);
+    cmd_reg("lm_bake", CmdBakeMaps);
+    cmd_reg("tmap_bench", CmdTonemapBench);
+    cmd_reg("temporal_bench", CmdTemporalBench);
 
-    vkr_init(1920, 1080);
+    if (!ms_headless)
+    {
+        vkr_init(1920, 1080);
+    }
 
     texture_sys_init();
     mesh_sys_init();
@@ -697,6 +1246,7 @@ void render_sys_init(void)
     framebuf_create(GetFrontBuf(), kDrawWidth, kDrawHeight);
     framebuf_create(GetBackBuf(), kDrawWidth, kDrawHeight);
     pt_sys_init();
+    lightmap_sys_init();
     RtcDrawInit();
 
     ms_toneParams.x = 0.3f; // shoulder
@@ -705,7 +1255,15 @@ void render_sys_init(void)
     ms_toneParams.w = 0.3f; // toe
     ms_clearColor = f4_v(0.01f, 0.012f, 0.022f, 0.0f);
 
-    con_exec("mapload start");
+    if (!ms_headless)
+    {
+        con_exec("mapload start");
+    }
+}
+
+void render_sys_headless(void)
+{
+    ms_headless = true;
 }
 
 ProfileMark(pm_update, render_sys_update)
@@ -732,11 +1290,15 @@ void render_sys_update(void)
     BakeSky();
     Lightmap_Trace();
     Cubemap_Trace();
+
+    UpdateDrawScale();
+    const u64 renderBegin = time_now();
     if (!PathTrace())
     {
         Rasterize();
     }
     Present();
+    ms_renderMs = time_avgms(renderBegin, ms_renderMs, 0.25f);
 
     vkr_update();
 
@@ -747,6 +1309,8 @@ void render_sys_update(void)
 
 void render_sys_shutdown(void)
 {
+    // streamed meshes and textures land in the tables torn down below
+    asset_load_flush();
     RtcDrawShutdown();
 
     ShutdownPtScene();
@@ -815,6 +1379,9 @@ void render_sys_gui(bool* pEnabled)
                 igSliderFloat("Adapt Rate", &ms_exposure.adaptRate, 0.1f, 10.0f);
                 igSliderFloat("Hist Cdf Min", &ms_exposure.histMinProb, 0.0f, ms_exposure.histMaxProb);
                 igSliderFloat("Hist Cdf Max", &ms_exposure.histMaxProb, ms_exposure.histMinProb, 1.0f);
+                igSliderFloat("Center Weight", &ms_exposure.centerWeight, 0.0f, 1.0f);
+                igSliderInt("Meter Stride", &ms_exposure.meterStride, 1, 8, "%d");
+                igText("Metered Luminance: %f", ms_exposure.frameLum);
             }
             igUnindent(0.0f);
         }
@@ -873,7 +1440,7 @@ static meshid_t GenSphereMesh(i32 steps)
     const i32 maxlen = 6 * vsteps * hsteps;
     i32 length = 0;
     float4* pim_noalias positions = perm_malloc(sizeof(*positions) * maxlen);
-    float4* pim_noalias normals = perm_malloc(sizeof(*normals) * maxlen);
+    u32* pim_noalias normals = perm_malloc(sizeof(*normals) * maxlen);
     float4* pim_noalias uvs = perm_malloc(sizeof(*uvs) * maxlen);
 
     for (i32 v = 0; v < vsteps; ++v)
@@ -916,6 +1483,11 @@ static meshid_t GenSphereMesh(i32 steps)
             float4 v3 = f4_mulvs(n3, r);
             float4 v4 = f4_mulvs(n4, r);
 
+            const u32 o1 = f4_oct16(n1);
+            const u32 o2 = f4_oct16(n2);
+            const u32 o3 = f4_oct16(n3);
+            const u32 o4 = f4_oct16(n4);
+
             const i32 back = length;
             if (v == 0)
             {
@@ -926,9 +1498,9 @@ static meshid_t GenSphereMesh(i32 steps)
                 positions[back + 1] = v3;
                 positions[back + 2] = v4;
 
-                normals[back + 0] = n1;
-                normals[back + 1] = n3;
-                normals[back + 2] = n4;
+                normals[back + 0] = o1;
+                normals[back + 1] = o3;
+                normals[back + 2] = o4;
 
                 uvs[back + 0] = u1;
                 uvs[back + 1] = u3;
@@ -943,9 +1515,9 @@ static meshid_t GenSphereMesh(i32 steps)
                 positions[back + 1] = v1;
                 positions[back + 2] = v2;
 
-                normals[back + 0] = n3;
-                normals[back + 1] = n1;
-                normals[back + 2] = n2;
+                normals[back + 0] = o3;
+                normals[back + 1] = o1;
+                normals[back + 2] = o2;
 
                 uvs[back + 0] = u3;
                 uvs[back + 1] = u1;
@@ -960,9 +1532,9 @@ static meshid_t GenSphereMesh(i32 steps)
                 positions[back + 1] = v2;
                 positions[back + 2] = v4;
 
-                normals[back + 0] = n1;
-                normals[back + 1] = n2;
-                normals[back + 2] = n4;
+                normals[back + 0] = o1;
+                normals[back + 1] = o2;
+                normals[back + 2] = o4;
 
                 uvs[back + 0] = u1;
                 uvs[back + 1] = u2;
@@ -972,9 +1544,9 @@ static meshid_t GenSphereMesh(i32 steps)
                 positions[back + 4] = v3;
                 positions[back + 5] = v4;
 
-                normals[back + 3] = n2;
-                normals[back + 4] = n3;
-                normals[back + 5] = n4;
+                normals[back + 3] = o2;
+                normals[back + 4] = o3;
+                normals[back + 5] = o4;
 
                 uvs[back + 3] = u2;
                 uvs[back + 4] = u3;
@@ -1014,7 +1586,7 @@ static meshid_t GenQuadMesh(void)
 
     const i32 length = 6;
     float4* positions = perm_malloc(sizeof(positions[0]) * length);
-    float4* normals = perm_malloc(sizeof(normals[0]) * length);
+    u32* normals = perm_malloc(sizeof(normals[0]) * length);
     float4* uvs = perm_malloc(sizeof(uvs[0]) * length);
 
     // counter clockwise
@@ -1026,7 +1598,7 @@ static meshid_t GenQuadMesh(void)
     positions[5] = br; uvs[5] = f4_v(1.0f, 0.0f, 0.0f, 0.0f);
     for (i32 i = 0; i < length; ++i)
     {
-        normals[i] = N;
+        normals[i] = f4_oct16(N);
     }
 
     mesh_t mesh = { 0 };
@@ -6,6 +6,9 @@ PIM_C_BEGIN
 
 typedef struct framebuf_s framebuf_t;
 
+// skips the window and vulkan device; call before render_sys_init
+void render_sys_headless(void);
+
 void render_sys_init(void);
 void render_sys_update(void);
 void render_sys_shutdown(void);
@@ -1,4 +1,5 @@
 #include "rendering/resolve_tile.h"
+#include "rendering/exposure.h"
 #include "threading/task.h"
 #include "rendering/framebuffer.h"
 #include "rendering/sampler.h"
@@ -8,12 +9,26 @@
 #include "common/profiler.h"
 #include "allocator/allocator.h"
 
+// the project builds with /arch:AVX2, so the 8-wide path is chosen at
+// compile time; the scalar resolvers handle other targets and the tails.
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define RESOLVE_AVX2 1
+#else
+    #define RESOLVE_AVX2 0
+#endif // __AVX2__
+
 typedef struct resolve_s
 {
     task_t task;
     float4 toneParams;
     framebuf_t* target;
     TonemapId tmapId;
+    float exposure;
+    float centerWeight;
+    i32 meterStride;
+    u32 frame;
+    float* hists; // [numthreads][kExposureBins]
 } resolve_t;
 
 pim_inline u32 VEC_CALL ToColor(prng_t* rng, float4 linear)
@@ -26,27 +41,30 @@ pim_inline u32 VEC_CALL ToColor(prng_t* rng, float4 linear)
 }
 
 static void VEC_CALL ResolveReinhard(
-    i32 begin, i32 end, framebuf_t* target)
+    i32 begin, i32 end, framebuf_t* target, float exposure)
 {
-    float4* pim_noalias light = target->light;
+    const float4* pim_noalias light = target->light;
     u32* pim_noalias color = target->color;
     prng_t rng = prng_get();
     for (i32 i = begin; i < end; ++i)
     {
-        color[i] = ToColor(&rng, tmap4_reinhard(light[i]));
+        float4 hdr = light[i];
+        hdr = f4_mulvs(hdr, exposure);
+        color[i] = ToColor(&rng, tmap4_reinhard(hdr));
     }
     prng_set(rng);
 }
 
 static void VEC_CALL ResolveUncharted2(
-    i32 begin, i32 end, framebuf_t* target)
+    i32 begin, i32 end, framebuf_t* target, float exposure)
 {
-    float4* pim_noalias light = target->light;
+    const float4* pim_noalias light = target->light;
     u32* pim_noalias color = target->color;
     prng_t rng = prng_get();
     for (i32 i = begin; i < end; ++i)
     {
         float4 hdr = light[i];
+        hdr = f4_mulvs(hdr, exposure);
         hdr.w = 1.0f;
         color[i] = ToColor(&rng, tmap4_uchart2(hdr));
     }
@@ -54,14 +72,15 @@ static void VEC_CALL ResolveUncharted2(
 }
 
 static void VEC_CALL ResolveHable(
-    i32 begin, i32 end, framebuf_t* target, float4 params)
+    i32 begin, i32 end, framebuf_t* target, float exposure, float4 params)
 {
-    float4* pim_noalias light = target->light;
+    const float4* pim_noalias light = target->light;
     u32* pim_noalias color = target->color;
     prng_t rng = prng_get();
     for (i32 i = begin; i < end; ++i)
     {
         float4 hdr = light[i];
+        hdr = f4_mulvs(hdr, exposure);
         hdr.w = 1.0f;
         color[i] = ToColor(&rng, tmap4_hable(hdr, params));
     }
@@ -69,72 +88,386 @@ static void VEC_CALL ResolveHable(
 }
 
 static void VEC_CALL ResolveFilmic(
-    i32 begin, i32 end, framebuf_t* target)
+    i32 begin, i32 end, framebuf_t* target, float exposure)
 {
-    float4* pim_noalias light = target->light;
+    const float4* pim_noalias light = target->light;
     u32* pim_noalias color = target->color;
     prng_t rng = prng_get();
     for (i32 i = begin; i < end; ++i)
     {
-        color[i] = ToColor(&rng, tmap4_filmic(light[i]));
+        float4 hdr = light[i];
+        hdr = f4_mulvs(hdr, exposure);
+        color[i] = ToColor(&rng, tmap4_filmic(hdr));
     }
     prng_set(rng);
 }
 
 static void VEC_CALL ResolveACES(
-    i32 begin, i32 end, framebuf_t* target)
+    i32 begin, i32 end, framebuf_t* target, float exposure)
 {
-    float4* pim_noalias light = target->light;
+    const float4* pim_noalias light = target->light;
     u32* pim_noalias color = target->color;
     prng_t rng = prng_get();
     for (i32 i = begin; i < end; ++i)
     {
-        color[i] = ToColor(&rng, tmap4_aces(light[i]));
+        float4 hdr = light[i];
+        hdr = f4_mulvs(hdr, exposure);
+        color[i] = ToColor(&rng, tmap4_aces(hdr));
     }
     prng_set(rng);
 }
 
-pim_optimize
-static void ResolveTileFn(task_t* task, i32 begin, i32 end)
+#if RESOLVE_AVX2
+
+// every operator as y = ((x(Ax + B) + C) / (x(Dx + E) + F) + bias) * scale,
+// applied to max(0, x - toe)
+typedef struct tmap8_s
 {
-    resolve_t* resolve = (resolve_t*)task;
+    float A, B, C, D, E, F;
+    float bias;
+    float scale;
+    float toe;
+    const float* lut;   // kTmapLutSize entries over [0, 1], replaces sRGB encode
+} tmap8_t;
 
-    framebuf_t* target = resolve->target;
-    const float4 params = resolve->toneParams;
-    const TonemapId id = resolve->tmapId;
+#define kTmapLutSize 1024
 
+// filmic output is display referred; encode pow(y, 2.2) to sRGB via table
+static float ms_filmicLut[kTmapLutSize + 1];
+
+static void FilmicLut_Init(void)
+{
+    if (ms_filmicLut[kTmapLutSize] == 0.0f)
+    {
+        for (i32 i = 0; i <= kTmapLutSize; ++i)
+        {
+            float y = (float)i / kTmapLutSize;
+            ms_filmicLut[i] = f1_tosrgb(powf(y, 2.2f));
+        }
+    }
+}
+
+static tmap8_t Tmap8_Get(TonemapId id, float4 params)
+{
+    tmap8_t tm = { 0 };
+    tm.scale = 1.0f;
     switch (id)
     {
     default:
     case TMap_Reinhard:
-        ResolveReinhard(begin, end, target);
+        tm.B = 1.0f;
+        tm.E = 1.0f;
+        tm.F = 1.0f;
         break;
-    case TMap_Uncharted2:
-        ResolveUncharted2(begin, end, target);
-        break;
-    case TMap_Hable:
-        ResolveHable(begin, end, target, params);
+    case TMap_ACES:
+        tm.A = 2.51f;
+        tm.B = 0.03f;
+        tm.D = 2.43f;
+        tm.E = 0.59f;
+        tm.F = 0.14f;
         break;
     case TMap_Filmic:
-        ResolveFilmic(begin, end, target);
+        tm.A = 6.2f;
+        tm.B = 0.5f;
+        tm.D = 6.2f;
+        tm.E = 1.7f;
+        tm.F = 0.06f;
+        tm.toe = 0.004f;
+        tm.lut = ms_filmicLut;
         break;
-    case TMap_ACES:
-        ResolveACES(begin, end, target);
+    case TMap_Uncharted2:
+        params = f4_v(0.15f, 0.5f, 0.1f, 0.2f);
+        // fallthrough
+    case TMap_Hable:
+        tm.A = params.x;
+        tm.B = params.z * params.y;
+        tm.C = params.w * 0.02f;
+        tm.D = params.x;
+        tm.E = params.y;
+        tm.F = params.w * 0.3f;
+        tm.bias = -0.02f / 0.3f;
+        // white point of 1, as hdr.w = 1 in the scalar path
+        tm.scale = 1.0f / tmap1_hable(1.0f, params);
         break;
     }
+    return tm;
+}
+
+// cubic root fit, same as f4_tosrgb
+pim_inline __m256 VEC_CALL ToSrgb8(__m256 c)
+{
+    __m256 s1 = _mm256_sqrt_ps(c);
+    __m256 s2 = _mm256_sqrt_ps(s1);
+    __m256 s3 = _mm256_sqrt_ps(s2);
+    __m256 y = _mm256_mul_ps(s1, _mm256_set1_ps(0.658444f));
+    y = _mm256_fmadd_ps(s2, _mm256_set1_ps(0.643378f), y);
+    y = _mm256_fmadd_ps(s3, _mm256_set1_ps(-0.298148f), y);
+    return y;
+}
+
+pim_inline __m256 VEC_CALL Tmap8(__m256 x, const tmap8_t* tm)
+{
+    x = _mm256_max_ps(_mm256_sub_ps(x, _mm256_set1_ps(tm->toe)), _mm256_setzero_ps());
+    __m256 num = _mm256_fmadd_ps(_mm256_set1_ps(tm->A), x, _mm256_set1_ps(tm->B));
+    num = _mm256_fmadd_ps(num, x, _mm256_set1_ps(tm->C));
+    __m256 den = _mm256_fmadd_ps(_mm256_set1_ps(tm->D), x, _mm256_set1_ps(tm->E));
+    den = _mm256_fmadd_ps(den, x, _mm256_set1_ps(tm->F));
+    __m256 y = _mm256_div_ps(num, den);
+    y = _mm256_mul_ps(_mm256_add_ps(y, _mm256_set1_ps(tm->bias)), _mm256_set1_ps(tm->scale));
+    y = _mm256_max_ps(y, _mm256_setzero_ps());
+    if (tm->lut)
+    {
+        // linear filtered table lookup
+        __m256 t = _mm256_min_ps(y, _mm256_set1_ps(1.0f));
+        t = _mm256_mul_ps(t, _mm256_set1_ps((float)kTmapLutSize));
+        __m256 fl = _mm256_min_ps(_mm256_floor_ps(t), _mm256_set1_ps(kTmapLutSize - 1.0f));
+        __m256i i0 = _mm256_cvttps_epi32(fl);
+        __m256 a = _mm256_i32gather_ps(tm->lut, i0, 4);
+        __m256 b = _mm256_i32gather_ps(tm->lut + 1, i0, 4);
+        y = _mm256_fmadd_ps(_mm256_sub_ps(b, a), _mm256_sub_ps(t, fl), a);
+    }
+    else
+    {
+        y = ToSrgb8(y);
+    }
+    return y;
+}
+
+// interleaved gradient noise, offset per frame
+pim_inline __m256 VEC_CALL Dither8(__m256 x, __m256 y, u32 frame)
+{
+    x = _mm256_add_ps(x, _mm256_set1_ps(5.588238f * (frame & 63)));
+    __m256 t = _mm256_fmadd_ps(x, _mm256_set1_ps(0.06711056f), _mm256_mul_ps(y, _mm256_set1_ps(0.00583715f)));
+    t = _mm256_sub_ps(t, _mm256_floor_ps(t));
+    t = _mm256_mul_ps(t, _mm256_set1_ps(52.9829189f));
+    return _mm256_sub_ps(t, _mm256_floor_ps(t));
+}
+
+pim_inline __m256i VEC_CALL ToUnorm8(__m256 x, __m256 noise)
+{
+    const __m256 kWeight = _mm256_set1_ps(1.0f / 255.0f);
+    x = _mm256_fmadd_ps(_mm256_sub_ps(noise, x), kWeight, x);
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    x = _mm256_fmadd_ps(x, _mm256_set1_ps(255.0f), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(x);
+}
+
+// 8 pixels per iteration over the row starting at begin;
+// (end - begin) must be a multiple of 8.
+// lanes hold pixels 0,2,4,6,1,3,5,7 after the AoS -> SoA transpose.
+// meters the pixels into hist when it is non-null.
+static void ResolveAvx2(
+    i32 begin,
+    i32 end,
+    i32 y,
+    framebuf_t* target,
+    const tmap8_t* tm,
+    float exposure,
+    u32 frame,
+    float* pim_noalias hist,
+    float centerWeight,
+    float ndcY)
+{
+    ASSERT(((end - begin) & 7) == 0);
+    const float* pim_noalias light = (const float*)target->light;
+    u32* pim_noalias color = target->color;
+    const __m256 kExposure = _mm256_set1_ps(exposure);
+    const __m256 kLumR = _mm256_set1_ps(0.2126f);
+    const __m256 kLumG = _mm256_set1_ps(0.7152f);
+    const __m256 kLumB = _mm256_set1_ps(0.0722f);
+    const __m256i kLaneX = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i kAlpha = _mm256_set1_epi32(0xff << 24);
+    const __m256i kUnpermute = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256 kY = _mm256_set1_ps((float)y);
+
+    // Exposure_Weight, split into per row and per column terms
+    const float dx = 2.0f / target->width;
+    const __m256 kNdcScale = _mm256_set1_ps(dx);
+    const __m256 kNdcBias = _mm256_set1_ps(0.5f * dx - 1.0f);
+    const __m256 kWeightX = _mm256_set1_ps(centerWeight * 0.5f);
+    const __m256 kWeightY = _mm256_set1_ps(Exposure_Weight(centerWeight, 0.0f, ndcY));
+    const __m256i kBinBias = _mm256_set1_epi32((127 + kExposureMinLog2) * kExposureBinsPerEV);
+    const __m256i kBinMax = _mm256_set1_epi32(kExposureBins - 1);
+
+    for (i32 i = begin; i < end; i += 8)
+    {
+        const float* pim_noalias src = light + i * 4;
+        __m256 p01 = _mm256_loadu_ps(src + 0);
+        __m256 p23 = _mm256_loadu_ps(src + 8);
+        __m256 p45 = _mm256_loadu_ps(src + 16);
+        __m256 p67 = _mm256_loadu_ps(src + 24);
+        __m256 t0 = _mm256_unpacklo_ps(p01, p23);
+        __m256 t1 = _mm256_unpackhi_ps(p01, p23);
+        __m256 t2 = _mm256_unpacklo_ps(p45, p67);
+        __m256 t3 = _mm256_unpackhi_ps(p45, p67);
+        __m256 r = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 g = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 b = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i - begin), kLaneX));
+
+        if (hist)
+        {
+            __m256 lum = _mm256_mul_ps(r, kLumR);
+            lum = _mm256_fmadd_ps(g, kLumG, lum);
+            lum = _mm256_fmadd_ps(b, kLumB, lum);
+            // Exposure_LumToBin
+            __m256i bin = _mm256_srai_epi32(_mm256_castps_si256(lum), 23 - 2);
+            bin = _mm256_sub_epi32(bin, kBinBias);
+            bin = _mm256_min_epi32(_mm256_max_epi32(bin, _mm256_setzero_si256()), kBinMax);
+            __m256 ndcX = _mm256_fmadd_ps(x, kNdcScale, kNdcBias);
+            __m256 weight = _mm256_fnmadd_ps(_mm256_mul_ps(ndcX, ndcX), kWeightX, kWeightY);
+
+            i32 bins[8];
+            float weights[8];
+            _mm256_storeu_si256((__m256i*)bins, bin);
+            _mm256_storeu_ps(weights, weight);
+            for (i32 j = 0; j < 8; ++j)
+            {
+                hist[bins[j]] += weights[j];
+            }
+        }
+
+        r = Tmap8(_mm256_mul_ps(r, kExposure), tm);
+        g = Tmap8(_mm256_mul_ps(g, kExposure), tm);
+        b = Tmap8(_mm256_mul_ps(b, kExposure), tm);
+
+        __m256 noise = Dither8(x, kY, frame);
+        __m256i c = _mm256_or_si256(kAlpha, ToUnorm8(r, noise));
+        c = _mm256_or_si256(c, _mm256_slli_epi32(ToUnorm8(g, noise), 8));
+        c = _mm256_or_si256(c, _mm256_slli_epi32(ToUnorm8(b, noise), 16));
+        c = _mm256_permutevar8x32_epi32(c, kUnpermute);
+        _mm256_storeu_si256((__m256i*)(color + i), c);
+    }
+}
+
+#endif // RESOLVE_AVX2
+
+// meters light[begin, end) of the row starting at rowBegin into hist
+static void VEC_CALL MeterRow(
+    i32 rowBegin,
+    i32 begin,
+    i32 end,
+    const framebuf_t* target,
+    float* pim_noalias hist,
+    float centerWeight,
+    float ndcY)
+{
+    const float4* pim_noalias light = target->light;
+    const float dx = 2.0f / target->width;
+    for (i32 i = begin; i < end; ++i)
+    {
+        float ndcX = (i - rowBegin + 0.5f) * dx - 1.0f;
+        i32 bin = Exposure_LumToBin(f4_perlum(light[i]));
+        hist[bin] += Exposure_Weight(centerWeight, ndcX, ndcY);
+    }
 }
 
+pim_optimize
+static void ResolveTileFn(task_t* task, i32 begin, i32 end)
+{
+    resolve_t* resolve = (resolve_t*)task;
+
+    framebuf_t* target = resolve->target;
+    const float4 params = resolve->toneParams;
+    const TonemapId id = resolve->tmapId;
+    const float exposure = resolve->exposure;
+    const float centerWeight = resolve->centerWeight;
+    const i32 meterStride = resolve->meterStride;
+    const i32 width = target->width;
+    const i32 height = target->height;
+    float* pim_noalias hist = resolve->hists + kExposureBins * task_thread_id();
+#if RESOLVE_AVX2
+    const tmap8_t tm = Tmap8_Get(id, params);
+#endif // RESOLVE_AVX2
+
+    for (i32 y = begin; y < end; ++y)
+    {
+        const i32 rowBegin = y * width;
+        const i32 rowEnd = rowBegin + width;
+        const bool meter = (y % meterStride) == 0;
+        const float ndcY = (y + 0.5f) * (2.0f / height) - 1.0f;
+
+        i32 i = rowBegin;
+#if RESOLVE_AVX2
+        i = rowBegin + (width & ~7);
+        ResolveAvx2(
+            rowBegin, i, y, target, &tm, exposure, resolve->frame,
+            meter ? hist : NULL, centerWeight, ndcY);
+#endif // RESOLVE_AVX2
+
+        switch (id)
+        {
+        default:
+        case TMap_Reinhard:
+            ResolveReinhard(i, rowEnd, target, exposure);
+            break;
+        case TMap_Uncharted2:
+            ResolveUncharted2(i, rowEnd, target, exposure);
+            break;
+        case TMap_Hable:
+            ResolveHable(i, rowEnd, target, exposure, params);
+            break;
+        case TMap_Filmic:
+            ResolveFilmic(i, rowEnd, target, exposure);
+            break;
+        case TMap_ACES:
+            ResolveACES(i, rowEnd, target, exposure);
+            break;
+        }
+
+        if (meter)
+        {
+            MeterRow(rowBegin, i, rowEnd, target, hist, centerWeight, ndcY);
+        }
+    }
+}
+
+static u32 ms_frame;
+
 ProfileMark(pm_ResolveTile, ResolveTile)
-void ResolveTile(framebuf_t* target, TonemapId tmapId, float4 toneParams)
+void ResolveTile(
+    framebuf_t* target,
+    TonemapId tmapId,
+    float4 toneParams,
+    float exposure,
+    const exposure_t* meter,
+    exphist_t* hist)
 {
     ProfileBegin(pm_ResolveTile);
 
     ASSERT(target);
+    ASSERT(meter);
+    ASSERT(hist);
+    const i32 numthreads = task_thread_ct();
     resolve_t* task = tmp_calloc(sizeof(*task));
     task->target = target;
     task->tmapId = tmapId;
     task->toneParams = toneParams;
-    task_run(&task->task, ResolveTileFn, target->width * target->height);
+    task->exposure = exposure;
+    task->centerWeight = f1_sat(meter->centerWeight);
+    task->meterStride = i1_max(1, meter->meterStride);
+    task->frame = ms_frame++;
+    task->hists = tmp_calloc(sizeof(task->hists[0]) * kExposureBins * numthreads);
+#if RESOLVE_AVX2
+    FilmicLut_Init();
+#endif // RESOLVE_AVX2
+    task_run(&task->task, ResolveTileFn, target->height);
+
+    // merge the per thread histograms
+    float* pim_noalias dst = hist->bins;
+    const float* pim_noalias hists = task->hists;
+    for (i32 i = 0; i < kExposureBins; ++i)
+    {
+        dst[i] = 0.0f;
+    }
+    for (i32 t = 0; t < numthreads; ++t)
+    {
+        const float* pim_noalias src = hists + kExposureBins * t;
+        for (i32 i = 0; i < kExposureBins; ++i)
+        {
+            dst[i] += src[i];
+        }
+    }
 
     ProfileEnd(pm_ResolveTile);
 }
@@ -7,7 +7,17 @@
 PIM_C_BEGIN
 
 typedef struct framebuf_s framebuf_t;
+typedef struct exposure_s exposure_t;
+typedef struct exphist_s exphist_t;
 
-void ResolveTile(framebuf_t* target, TonemapId tonemapper, float4 toneParams);
+// exposes, tonemaps and dithers light into color in a single read of light.
+// meters light into hist along the way, for the next frame's exposure.
+void ResolveTile(
+    framebuf_t* target,
+    TonemapId tonemapper,
+    float4 toneParams,
+    float exposure,
+    const exposure_t* meter,
+    exphist_t* hist);
 
 PIM_C_END
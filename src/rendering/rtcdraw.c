@@ -13,6 +13,7 @@
 #include "math/sdf.h"
 #include "math/box.h"
 
+#include "rendering/constants.h"
 #include "rendering/framebuffer.h"
 #include "rendering/sampler.h"
 #include "rendering/camera.h"
@@ -28,17 +29,37 @@
 #include "common/console.h"
 #include "common/fnv1a.h"
 #include "common/profiler.h"
+#include "common/cmd.h"
+#include "common/random.h"
+#include "common/time.h"
+#include "common/atomics.h"
 
 #include "threading/task.h"
 #include "allocator/allocator.h"
 
 #include <string.h>
+#include <stdlib.h>
 
 #define kFroxelResX     16
 #define kFroxelResY     8
 #define kFroxelResZ     32
 #define kFroxelCount    (kFroxelResX*kFroxelResY*kFroxelResZ)
 
+// visibility pass ray packets, in texels
+#define kPacketX        4
+#define kPacketY        2
+#define kPacketLen      (kPacketX*kPacketY)
+
+// shading pass bins texels by drawable within tiles of this size
+#define kVisTileSize    16
+#define kVisTileLen     (kVisTileSize*kVisTileSize)
+
+// reprojection rejects history whose distance differs by more than this ratio
+#define kReprojDepthTol 0.02f
+
+static cvar_t cv_r_visbuf = { .type = cvart_bool,.name = "r_visbuf",.value = "1",.desc = "trace a visibility buffer with ray packets, then shade it binned by drawable" };
+static cvar_t cv_r_temporal = { .type = cvart_int,.name = "r_temporal",.value = "0",.minInt = 0,.maxInt = 2,.desc = "reproject the previous frame, shading 0: all texels, 1: a checkerboard half, 2: a rotating quarter. requires r_visbuf" };
+
 typedef struct lightlist_s
 {
     i32* pim_noalias ptr;
@@ -49,60 +70,107 @@ typedef struct froxels_s
 {
     frusbasis_t basis;
     lightlist_t lights[kFroxelCount];
+    // froxel bounds, rebuilt when the basis changes
+    frus_t* frus;
+    // light bitmasks per froxel, and the lists they compact into
+    u64* masks;
+    i32 maskLen;
+    i32* indices;
+    i32 indexLen;
 } froxels_t;
 
-typedef struct drawhash_s
+// what a primary ray hit; iGeom is the embree geometry id, or -1 for a miss
+typedef struct vistexel_s
 {
-    u64 meshes;
-    u64 materials;
-    u64 translations;
-    u64 rotations;
-    u64 scales;
-} drawhash_t;
+    i32 iGeom;
+    i32 iPrim;
+    float u;
+    float v;
+    float t;
+} vistexel_t;
+
+// object space bvh of a mesh, instanced by every drawable using it.
+// vertices are read in place from the mesh, no copy is made.
+typedef struct meshscene_s
+{
+    meshid_t id;
+    const float4* positions;
+    RTCScene scene;
+} meshscene_t;
 
 typedef struct world_s
 {
     RTCDevice device;
     RTCScene scene;
+    // indexed by meshid_t.index
+    meshscene_t* meshScenes;
+    i32 meshSceneCount;
+    // 0, 1, 2, ... shared as the index buffer of every mesh
+    u32* seqIndices;
+    i32 seqLength;
+    // bytes allocated by embree on this device
+    i64 rtcBytes;
     i32 numDrawables;
     i32 numLights;
-    drawhash_t drawablesHash;
+    // mesh and drawables_t version each geometry was built from
+    meshid_t* geomMeshes;
+    u32* geomVersions;
+    // set once drawables move, switching embree to its two level builder
+    bool dynamic;
+    u64 materialHash;
     u64 lightHash;
     cubemap_t* sky;
     froxels_t froxels;
+    vistexel_t* visbuf;
+    vistexel_t* prevVisbuf;
+    i32 visLen;
+    // last frame drawn with a visibility buffer, for reprojection
+    frusbasis_t prevBasis;
+    bool prevValid;
+    u32 prevSceneVersion;
+    u32 sceneVersion;
+    u32 temporalFrame;
 } world_t;
 
 static world_t ms_world;
 
-static drawhash_t HashDrawables(void);
+static bool OnRtcMemory(void* ptr, ssize_t bytes, bool post);
+static void ReleaseMeshScenes(world_t* world);
 static void CreateScene(world_t* world);
 static void DestroyScene(world_t* world);
 static void UpdateScene(world_t* world);
-static bool AddDrawable(
-    world_t* world,
-    u32 geomId,
-    meshid_t meshid,
-    material_t mat,
-    float4 translation,
-    quat rotation,
-    float4 scale);
+static bool AddDrawable(world_t* world, u32 geomId, meshid_t meshid, float4x4 M);
+static bool UpdateDrawable(world_t* world, u32 geomId, float4x4 M);
 static bool AddLight(world_t* world, u32 geomId, float4 center, float radius);
 static void UpdateLights(world_t* world);
 static void DrawScene(
     world_t* world,
     framebuf_t* target,
+    const framebuf_t* history,
     const camera_t* camera);
 static void ClusterLights(
     world_t* world,
-    framebuf_t* target,
-    const camera_t* camera);
+    const camera_t* camera,
+    i32 width,
+    i32 height);
+static void FreeFroxels(froxels_t* froxels);
+static cmdstat_t CmdClusterBench(i32 argc, const char** argv);
+static cmdstat_t CmdSceneBench(i32 argc, const char** argv);
 
 void RtcDrawInit(void)
 {
+    cvar_reg(&cv_r_visbuf);
+    cvar_reg(&cv_r_temporal);
+    cmd_reg("cluster_bench", CmdClusterBench);
+    cmd_reg("scene_bench", CmdSceneBench);
     if (rtc_init())
     {
         ms_world.device = rtc.NewDevice(NULL);
         ASSERT(ms_world.device);
+        if (ms_world.device)
+        {
+            rtc.SetDeviceMemoryMonitorFunction(ms_world.device, OnRtcMemory, &ms_world);
+        }
     }
 }
 
@@ -111,13 +179,28 @@ void RtcDrawShutdown(void)
     if (ms_world.device)
     {
         DestroyScene(&ms_world);
+        ReleaseMeshScenes(&ms_world);
         rtc.ReleaseDevice(ms_world.device);
         ms_world.device = NULL;
     }
+    pim_free(ms_world.visbuf);
+    pim_free(ms_world.prevVisbuf);
+    ms_world.visbuf = NULL;
+    ms_world.prevVisbuf = NULL;
+    ms_world.visLen = 0;
+    ms_world.prevValid = false;
+    pim_free(ms_world.geomMeshes);
+    pim_free(ms_world.geomVersions);
+    pim_free(ms_world.seqIndices);
+    ms_world.geomMeshes = NULL;
+    ms_world.geomVersions = NULL;
+    ms_world.seqIndices = NULL;
+    ms_world.seqLength = 0;
+    FreeFroxels(&ms_world.froxels);
 }
 
 ProfileMark(pm_rtcdraw, RtcDraw)
-void RtcDraw(framebuf_t* target, const camera_t* camera)
+void RtcDraw(framebuf_t* target, const framebuf_t* history, const camera_t* camera)
 {
     world_t* world = &ms_world;
     if (!world->device)
@@ -126,27 +209,148 @@ void RtcDraw(framebuf_t* target, const camera_t* camera)
     }
     ProfileBegin(pm_rtcdraw);
     UpdateScene(world);
-    DrawScene(world, target, camera);
+    DrawScene(world, target, history, camera);
     ProfileEnd(pm_rtcdraw);
 }
 
-static drawhash_t HashDrawables(void)
+i64 RtcDrawBytes(void)
 {
-    const drawables_t* drawables = drawables_get();
+    const world_t* world = &ms_world;
+    i64 bytes = load_i64(&world->rtcBytes, MO_Relaxed);
+    bytes += sizeof(world->seqIndices[0]) * world->seqLength;
+    bytes += sizeof(world->meshScenes[0]) * world->meshSceneCount;
+    return bytes;
+}
+
+static bool OnRtcMemory(void* ptr, ssize_t bytes, bool post)
+{
+    world_t* world = ptr;
+    fetch_add_i64(&world->rtcBytes, bytes, MO_Relaxed);
+    return true;
+}
+
+static void ReleaseMeshScenes(world_t* world)
+{
+    const i32 len = world->meshSceneCount;
+    meshscene_t* meshScenes = world->meshScenes;
+    for (i32 i = 0; i < len; ++i)
+    {
+        if (meshScenes[i].scene)
+        {
+            rtc.ReleaseScene(meshScenes[i].scene);
+        }
+    }
+    pim_free(meshScenes);
+    world->meshScenes = NULL;
+    world->meshSceneCount = 0;
+}
+
+// the shared index buffer must cover the largest mesh.
+// growing it invalidates every mesh scene, so only do so between scenes.
+static void ReserveSeqIndices(world_t* world, i32 length)
+{
+    ASSERT(!world->scene);
+    if (length > world->seqLength)
+    {
+        ReleaseMeshScenes(world);
+        length = i1_max(length, world->seqLength * 2);
+        pim_free(world->seqIndices);
+        world->seqIndices = perm_malloc(sizeof(world->seqIndices[0]) * length);
+        for (i32 i = 0; i < length; ++i)
+        {
+            world->seqIndices[i] = i;
+        }
+        world->seqLength = length;
+    }
+}
+
+static i32 MaxMeshLength(const drawables_t* drawables)
+{
+    i32 maxLength = 0;
     const i32 count = drawables->count;
-    const meshid_t* meshes = drawables->meshes;
-    const material_t* materials = drawables->materials;
-    const float4* translations = drawables->translations;
-    const quat* rotations = drawables->rotations;
-    const float4* scales = drawables->scales;
+    for (i32 i = 0; i < count; ++i)
+    {
+        mesh_t mesh;
+        if (mesh_get(drawables->meshes[i], &mesh))
+        {
+            maxLength = i1_max(maxLength, mesh.length);
+        }
+    }
+    return maxLength;
+}
+
+static RTCScene GetMeshScene(world_t* world, meshid_t meshid)
+{
+    mesh_t mesh = { 0 };
+    if (!mesh_get(meshid, &mesh) || (mesh.length > world->seqLength))
+    {
+        return NULL;
+    }
+
+    const i32 index = meshid.index;
+    if (index >= world->meshSceneCount)
+    {
+        PermGrow(world->meshScenes, index + 1);
+        for (i32 i = world->meshSceneCount; i <= index; ++i)
+        {
+            memset(world->meshScenes + i, 0, sizeof(world->meshScenes[0]));
+        }
+        world->meshSceneCount = index + 1;
+    }
+
+    meshscene_t* ms = world->meshScenes + index;
+    if (ms->scene &&
+        !memcmp(&ms->id, &meshid, sizeof(meshid)) &&
+        (ms->positions == mesh.positions))
+    {
+        return ms->scene;
+    }
+    if (ms->scene)
+    {
+        rtc.ReleaseScene(ms->scene);
+        ms->scene = NULL;
+    }
 
-    drawhash_t hash = { 0 };
-    hash.meshes = Fnv64Bytes(meshes, sizeof(meshes[0]) * count, Fnv64Bias);
-    hash.materials = Fnv64Bytes(materials, sizeof(materials[0]) * count, Fnv64Bias);
-    hash.translations = Fnv64Bytes(translations, sizeof(translations[0]) * count, Fnv64Bias);
-    hash.rotations = Fnv64Bytes(rotations, sizeof(rotations[0]) * count, Fnv64Bias);
-    hash.scales = Fnv64Bytes(scales, sizeof(scales[0]) * count, Fnv64Bias);
-    return hash;
+    RTCGeometry geom = rtc.NewGeometry(world->device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    ASSERT(geom);
+    if (!geom)
+    {
+        return NULL;
+    }
+    // embree reads xyz with a float4 stride, w is ignored
+    rtc.SetSharedGeometryBuffer(
+        geom,
+        RTC_BUFFER_TYPE_VERTEX,
+        0,
+        RTC_FORMAT_FLOAT3,
+        mesh.positions,
+        0,
+        sizeof(mesh.positions[0]),
+        mesh.length);
+    rtc.SetSharedGeometryBuffer(
+        geom,
+        RTC_BUFFER_TYPE_INDEX,
+        0,
+        RTC_FORMAT_UINT3,
+        world->seqIndices,
+        0,
+        sizeof(world->seqIndices[0]) * 3,
+        mesh.length / 3);
+    rtc.CommitGeometry(geom);
+
+    RTCScene scene = rtc.NewScene(world->device);
+    ASSERT(scene);
+    if (scene)
+    {
+        rtc.AttachGeometry(scene, geom);
+        rtc.CommitScene(scene);
+    }
+    rtc.ReleaseGeometry(geom);
+
+    ms->id = meshid;
+    ms->positions = mesh.positions;
+    ms->scene = scene;
+    return scene;
 }
 
 static void CreateDrawables(world_t* world)
@@ -157,24 +361,20 @@ static void CreateDrawables(world_t* world)
     const i32 numDrawables = drawables->count;
     const meshid_t* meshes = drawables->meshes;
     const material_t* materials = drawables->materials;
-    const float4* translations = drawables->translations;
-    const quat* rotations = drawables->rotations;
-    const float4* scales = drawables->scales;
+    const float4x4* matrices = drawables->matrices;
 
+    PermReserve(world->geomMeshes, numDrawables);
+    PermReserve(world->geomVersions, numDrawables);
     for (i32 i = 0; i < numDrawables; ++i)
     {
-        AddDrawable(
-            world,
-            i,
-            meshes[i],
-            materials[i],
-            translations[i],
-            rotations[i],
-            scales[i]);
+        // versions start at 1, so a failed add is retried next update
+        bool added = AddDrawable(world, i, meshes[i], matrices[i]);
+        world->geomMeshes[i] = meshes[i];
+        world->geomVersions[i] = added ? drawables->versions[i] : 0;
     }
 
     world->numDrawables = numDrawables;
-    world->drawablesHash = HashDrawables();
+    world->materialHash = Fnv64Bytes(materials, sizeof(materials[0]) * numDrawables, Fnv64Bias);
 }
 
 static u64 HashLights(void)
@@ -227,14 +427,18 @@ static void CreateScene(world_t* world)
 {
     ASSERT(world->device);
 
+    ReserveSeqIndices(world, MaxMeshLength(drawables_get()));
+
     RTCScene scene = rtc.NewScene(world->device);
     world->scene = scene;
+    world->dynamic = false;
     ASSERT(scene);
 
     CreateDrawables(world);
     CreateLights(world);
 
     rtc.CommitScene(scene);
+    world->sceneVersion++;
 }
 
 static void DestroyScene(world_t* world)
@@ -246,18 +450,127 @@ static void DestroyScene(world_t* world)
     }
 }
 
+static void DetachGeometry(RTCScene scene, u32 geomId)
+{
+    RTCGeometry geom = rtc.GetGeometry(scene, geomId);
+    if (geom)
+    {
+        rtc.DetachGeometry(scene, geomId);
+    }
+}
+
+// rebuilds only the instances of drawables that were added, removed, changed
+// mesh or moved since the last frame, then recommits the scene.
+// moved drawables only update their instance transform.
+static void UpdateDrawables(world_t* world)
+{
+    ASSERT(world->scene);
+
+    RTCScene scene = world->scene;
+    const drawables_t* drawables = drawables_get();
+    const i32 oldCount = world->numDrawables;
+    const i32 newCount = drawables->count;
+    const meshid_t* meshes = drawables->meshes;
+    const u32* versions = drawables->versions;
+
+    // a mesh larger than the shared index buffer needs a full rebuild
+    for (i32 i = 0; i < newCount; ++i)
+    {
+        if ((i >= oldCount) || (world->geomVersions[i] != versions[i]))
+        {
+            mesh_t mesh;
+            if (mesh_get(meshes[i], &mesh) && (mesh.length > world->seqLength))
+            {
+                DestroyScene(world);
+                CreateScene(world);
+                return;
+            }
+        }
+    }
+
+    bool dirty = false;
+    bool moved = false;
+    if (oldCount != newCount)
+    {
+        // light ids follow the drawables, clear them out of the way
+        DestroyLights(world);
+        world->numLights = 0;
+        world->lightHash = 0;
+        dirty = true;
+    }
+
+    for (i32 i = newCount; i < oldCount; ++i)
+    {
+        DetachGeometry(scene, i);
+    }
+
+    PermReserve(world->geomMeshes, newCount);
+    PermReserve(world->geomVersions, newCount);
+    for (i32 i = 0; i < newCount; ++i)
+    {
+        if ((i < oldCount) && (world->geomVersions[i] == versions[i]))
+        {
+            continue;
+        }
+        const meshid_t meshid = meshes[i];
+        const bool sameMesh = (i < oldCount) &&
+            !memcmp(&world->geomMeshes[i], &meshid, sizeof(meshid));
+        bool added = true;
+        if (sameMesh && UpdateDrawable(world, i, drawables->matrices[i]))
+        {
+            moved = true;
+        }
+        else
+        {
+            if (i < oldCount)
+            {
+                DetachGeometry(scene, i);
+            }
+            added = AddDrawable(world, i, meshid, drawables->matrices[i]);
+        }
+        world->geomMeshes[i] = meshid;
+        world->geomVersions[i] = added ? versions[i] : 0;
+        dirty = true;
+    }
+    world->numDrawables = newCount;
+
+    // materials don't touch embree, but shading reused by reprojection
+    // must be discarded when they change
+    const u64 materialHash = Fnv64Bytes(
+        drawables->materials,
+        sizeof(drawables->materials[0]) * newCount,
+        Fnv64Bias);
+    if (materialHash != world->materialHash)
+    {
+        world->materialHash = materialHash;
+        world->sceneVersion++;
+    }
+
+    if (moved && !world->dynamic)
+    {
+        world->dynamic = true;
+        rtc.SetSceneFlags(scene, RTC_SCENE_FLAG_DYNAMIC);
+    }
+    if (dirty)
+    {
+        rtc.CommitScene(scene);
+        world->sceneVersion++;
+    }
+}
+
 ProfileMark(pm_updatescene, UpdateScene)
 static void UpdateScene(world_t* world)
 {
     ProfileBegin(pm_updatescene);
 
-    drawhash_t drawHash = HashDrawables();
-    if (memcmp(&world->drawablesHash, &drawHash, sizeof(drawHash)))
+    if (!world->scene)
     {
-        world->drawablesHash = drawHash;
-        DestroyScene(world);
         CreateScene(world);
     }
+    else
+    {
+        UpdateDrawables(world);
+    }
 
     UpdateLights(world);
 
@@ -276,86 +589,43 @@ static void UpdateScene(world_t* world)
     ProfileEnd(pm_updatescene);
 }
 
-static bool AddDrawable(
-    world_t* world,
-    u32 geomId,
-    meshid_t meshid,
-    material_t mat,
-    float4 translation,
-    quat rotation,
-    float4 scale)
+static bool AddDrawable(world_t* world, u32 geomId, meshid_t meshid, float4x4 M)
 {
     ASSERT(world->device);
     ASSERT(world->scene);
 
-    RTCGeometry geom = NULL;
-
-    mesh_t mesh = { 0 };
-    if (!mesh_get(meshid, &mesh))
+    RTCScene meshScene = GetMeshScene(world, meshid);
+    if (!meshScene)
     {
-        goto onfail;
+        return false;
     }
 
-    geom = rtc.NewGeometry(world->device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    RTCGeometry geom = rtc.NewGeometry(world->device, RTC_GEOMETRY_TYPE_INSTANCE);
     ASSERT(geom);
     if (!geom)
     {
-        goto onfail;
-    }
-
-    const i32 vertCount = mesh.length;
-    const i32 triCount = vertCount / 3;
-
-    float3* dstPositions = rtc.SetNewGeometryBuffer(
-        geom,
-        RTC_BUFFER_TYPE_VERTEX,
-        0,
-        RTC_FORMAT_FLOAT3,
-        sizeof(float3),
-        vertCount);
-    ASSERT(dstPositions);
-    if (!dstPositions)
-    {
-        goto onfail;
-    }
-
-    float4x4 M = f4x4_trs(translation, rotation, scale);
-    const float4* srcPositions = mesh.positions;
-    for (i32 i = 0; i < vertCount; ++i)
-    {
-        float4 position = f4x4_mul_pt(M, srcPositions[i]);
-        dstPositions[i] = f4_f3(position);
-    }
-
-    // kind of wasteful
-    i32* dstIndices = rtc.SetNewGeometryBuffer(
-        geom,
-        RTC_BUFFER_TYPE_INDEX,
-        0,
-        RTC_FORMAT_UINT3,
-        sizeof(i32) * 3,
-        triCount);
-    ASSERT(dstIndices);
-    if (!dstIndices)
-    {
-        goto onfail;
-    }
-    for (i32 i = 0; i < vertCount; ++i)
-    {
-        dstIndices[i] = i;
+        return false;
     }
-
+    rtc.SetGeometryInstancedScene(geom, meshScene);
+    rtc.SetGeometryTransform(geom, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, &M);
     rtc.CommitGeometry(geom);
     rtc.AttachGeometryByID(world->scene, geom, geomId);
     rtc.ReleaseGeometry(geom);
     return true;
+}
 
-onfail:
-    if (geom)
+static bool UpdateDrawable(world_t* world, u32 geomId, float4x4 M)
+{
+    ASSERT(world->scene);
+
+    RTCGeometry geom = rtc.GetGeometry(world->scene, geomId);
+    if (!geom)
     {
-        rtc.ReleaseGeometry(geom);
+        return false;
     }
-    return false;
+    rtc.SetGeometryTransform(geom, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR, &M);
+    rtc.CommitGeometry(geom);
+    return true;
 }
 
 static bool AddLight(world_t* world, u32 geomId, float4 center, float radius)
@@ -410,6 +680,7 @@ static void UpdateLights(world_t* world)
         DestroyLights(world);
         CreateLights(world);
         rtc.CommitScene(world->scene);
+        world->sceneVersion++;
     }
 }
 
@@ -467,6 +738,12 @@ static struct RTCRayHit VEC_CALL RtcIntersect(
     return rayHit;
 }
 
+// drawables are instances of their mesh, lights are attached directly
+pim_inline u32 HitGeomId(u32 geomID, u32 instID)
+{
+    return (instID != RTC_INVALID_GEOMETRY_ID) ? instID : geomID;
+}
+
 static rayhit_t VEC_CALL TraceRay(
     world_t* world,
     float4 ro,
@@ -482,6 +759,7 @@ static rayhit_t VEC_CALL TraceRay(
     bool hitNothing =
         (rtcHit.hit.geomID == RTC_INVALID_GEOMETRY_ID) ||
         (rtcHit.ray.tfar <= 0.0f);
+    const u32 geomId = HitGeomId(rtcHit.hit.geomID, rtcHit.hit.instID[0]);
 
     if (hitNothing)
     {
@@ -502,17 +780,17 @@ static rayhit_t VEC_CALL TraceRay(
     hit.wuvt = f4_v(w, u, v, t);
 
     const u32 numDrawables = world->numDrawables;
-    if (rtcHit.hit.geomID >= numDrawables)
+    if (geomId >= numDrawables)
     {
         hit.type = hit_light;
-        hit.iDrawable = rtcHit.hit.geomID - numDrawables;
+        hit.iDrawable = geomId - numDrawables;
         hit.iVert = rtcHit.hit.primID;
         ASSERT(hit.iDrawable < world->numLights);
     }
     else
     {
         hit.type = hit_triangle;
-        hit.iDrawable = rtcHit.hit.geomID;
+        hit.iDrawable = geomId;
         hit.iVert = rtcHit.hit.primID * 3;
         ASSERT((u32)hit.iDrawable < numDrawables);
     }
@@ -522,15 +800,35 @@ static rayhit_t VEC_CALL TraceRay(
     return hit;
 }
 
+pim_inline frusbasis_t VEC_CALL CameraToBasis(const camera_t* camera, i32 width, i32 height)
+{
+    frusbasis_t basis;
+    basis.eye = camera->position;
+    quat rot = camera->rotation;
+    basis.right = quat_right(rot);
+    basis.up = quat_up(rot);
+    basis.fwd = quat_fwd(rot);
+    basis.slope = proj_slope(f1_radians(camera->fovy), (float)width / (float)height);
+    basis.zNear = camera->zNear;
+    basis.zFar = camera->zFar;
+    return basis;
+}
+
+// xy is perspective divided to match the planar froxel sides, z is radial
 pim_inline i32 VEC_CALL PositionToFroxel(frusbasis_t basis, float4 P)
 {
-    float3 coord = unproj_pt(basis.eye, basis.right, basis.up, basis.fwd, basis.slope, P);
-    coord.x = f1_unorm(coord.x) * kFroxelResX;
-    coord.y = f1_unorm(coord.y) * kFroxelResY;
-    coord.z = UnlerpZ(basis.zNear, basis.zFar, coord.z)  * kFroxelResZ;
-    i32 x = i1_clamp((i32)coord.x, 0, kFroxelResX - 1);
-    i32 y = i1_clamp((i32)coord.y, 0, kFroxelResY - 1);
-    i32 z = i1_clamp((i32)coord.z, 0, kFroxelResZ - 1);
+    const float4 d = f4_sub(P, basis.eye);
+    const float vz = f1_max(f4_dot3(d, basis.fwd), kEpsilon);
+    float3 coord;
+    coord.x = f4_dot3(d, basis.right) / (vz * basis.slope.x);
+    coord.y = f4_dot3(d, basis.up) / (vz * basis.slope.y);
+    coord.z = UnlerpZ(basis.zNear, basis.zFar, f1_max(f4_length3(d), basis.zNear));
+    coord.x = f1_clamp(f1_unorm(coord.x) * kFroxelResX, 0.0f, kFroxelResX - 1.0f);
+    coord.y = f1_clamp(f1_unorm(coord.y) * kFroxelResY, 0.0f, kFroxelResY - 1.0f);
+    coord.z = f1_clamp(coord.z * kFroxelResZ, 0.0f, kFroxelResZ - 1.0f);
+    i32 x = (i32)coord.x;
+    i32 y = (i32)coord.y;
+    i32 z = (i32)coord.z;
     i32 i = x + y * kFroxelResX + z * kFroxelResX * kFroxelResY;
     return i;
 }
@@ -541,34 +839,217 @@ pim_inline lightlist_t VEC_CALL GetLightList(const froxels_t* froxels, float4 P)
     return froxels->lights[i];
 }
 
+// per drawable shading inputs, fetched once per bin of texels
+typedef struct drawstate_s
+{
+    i32 iDrawable;
+    material_t material;
+    mesh_t mesh;
+    float3x3 invMatrix;
+    lm_uvs_t lmUvs;
+    texture_t albedo;
+    texture_t rome;
+    texture_t normal;
+    bool hasMesh;
+    bool hasAlbedo;
+    bool hasRome;
+    bool hasNormal;
+} drawstate_t;
+
+static void LoadDrawState(drawstate_t* ds, i32 iDrawable)
+{
+    const drawables_t* drawables = drawables_get();
+    ASSERT(iDrawable >= 0);
+    ASSERT(iDrawable < drawables->count);
+    ds->iDrawable = iDrawable;
+    ds->material = drawables->materials[iDrawable];
+    ds->invMatrix = drawables->invMatrices[iDrawable];
+    ds->lmUvs = drawables->lmUvs[iDrawable];
+    ds->hasMesh = mesh_get(drawables->meshes[iDrawable], &ds->mesh);
+    ds->hasAlbedo = texture_get(ds->material.albedo, &ds->albedo);
+    ds->hasRome = texture_get(ds->material.rome, &ds->rome);
+    ds->hasNormal = texture_get(ds->material.normal, &ds->normal);
+}
+
+typedef struct shadectx_s
+{
+    const froxels_t* froxels;
+    const cubemap_t* sky;
+    const pt_light_t* lights;
+    const lmpack_t* lmpack;
+    float4 ro;
+} shadectx_t;
+
+static shadectx_t GetShadeCtx(const world_t* world, const camera_t* camera)
+{
+    shadectx_t ctx;
+    ctx.froxels = &world->froxels;
+    ctx.sky = world->sky;
+    ctx.lights = lights_get()->ptLights;
+    ctx.lmpack = lmpack_get();
+    ctx.ro = camera->position;
+    return ctx;
+}
+
+static float4 VEC_CALL ShadeHit(
+    const shadectx_t* ctx,
+    const drawstate_t* ds,
+    const rayhit_t* hit,
+    float4 rd)
+{
+    if (hit->type == hit_nothing)
+    {
+        return f4_0;
+    }
+
+    if (hit->type == hit_light)
+    {
+        pt_light_t light = ctx->lights[hit->iDrawable];
+        float VoN = f4_dotsat(f4_neg(rd), hit->normal);
+        return f4_mulvs(light.rad, VoN);
+    }
+
+    ASSERT(ds->iDrawable == hit->iDrawable);
+    const material_t material = ds->material;
+    if (material.flags & matflag_sky)
+    {
+        if (ctx->sky)
+        {
+            float3 atmos = Cubemap_ReadColor(ctx->sky, rd);
+            return f3_f4(atmos, 0.0f);
+        }
+        return f4_0;
+    }
+
+    if (!ds->hasMesh)
+    {
+        return f4_0;
+    }
+    const mesh_t mesh = ds->mesh;
+
+    ASSERT(hit->iVert >= 0);
+    ASSERT(hit->iVert < mesh.length);
+
+    const i32 a = hit->iVert + 0;
+    const i32 b = hit->iVert + 1;
+    const i32 c = hit->iVert + 2;
+    const float4 wuvt = hit->wuvt;
+
+    const float4 V = f4_neg(rd);
+    const float3x3 IM = ds->invMatrix;
+    // blend in object space, IM is linear so one transform suffices
+    const float4 N0 = f4_normalize3(f3x3_mul_col(IM, f4_blend(
+        oct16_f4(mesh.normals[a]),
+        oct16_f4(mesh.normals[b]),
+        oct16_f4(mesh.normals[c]),
+        wuvt)));
+    const float3x3 TBN = NormalToTBN(N0);
+    const float4 P = f4_add(f4_add(ctx->ro, f4_mulvs(rd, wuvt.w)), f4_mulvs(N0, kMilli));
+    const float4 uv01 = f4_blend(mesh.uvs[a], mesh.uvs[b], mesh.uvs[c], wuvt);
+    const float2 uv = f2_v(uv01.x, uv01.y);
+
+    float4 albedo = material.flatAlbedo;
+    if (ds->hasAlbedo)
+    {
+        albedo = f4_mul(albedo, UvBilinearWrap_c32(ds->albedo.texels, ds->albedo.size, uv));
+    }
+    float4 rome = material.flatRome;
+    if (ds->hasRome)
+    {
+        rome = f4_mul(rome, UvBilinearWrap_c32(ds->rome.texels, ds->rome.size, uv));
+    }
+    float4 N = N0;
+    if (ds->hasNormal)
+    {
+        float4 Nts = UvBilinearWrap_dir8(ds->normal.texels, ds->normal.size, uv);
+        N = TbnToWorld(TBN, Nts);
+    }
+
+    float4 lighting = f4_0;
+
+    // emission
+    lighting = f4_add(lighting, UnpackEmission(albedo, rome.w));
+
+    // direct light
+    const pt_light_t* pim_noalias lights = ctx->lights;
+    const lightlist_t llist = GetLightList(ctx->froxels, P);
+    for (i32 iList = 0; iList < llist.len; ++iList)
+    {
+        i32 iLight = llist.ptr[iList];
+        pt_light_t light = lights[iLight];
+        float4 direct = EvalPointLight(V, P, N, albedo, rome.x, rome.z, light.pos, light.rad);
+        lighting = f4_add(lighting, direct);
+    }
+
+    // indirect light
+    const lm_uvs_t lmUvs = ds->lmUvs;
+    if (lmUvs.length > c)
+    {
+        i32 lmIndex = lmUvs.indices[a / 3];
+        if (lmIndex >= 0)
+        {
+            const lmpack_t* lmpack = ctx->lmpack;
+            ASSERT(lmIndex < lmpack->lmCount);
+            const lightmap_t lmap = lmpack->lightmaps[lmIndex];
+            float2 lmUv = f2_blend(
+                lmUvs.uvs[a],
+                lmUvs.uvs[b],
+                lmUvs.uvs[c],
+                wuvt);
+            lmUv = f2_subvs(lmUv, 0.5f / lmap.size);
+            const int2 lmSize = i2_s(lmap.size);
+            float4 probe[kGiDirections];
+            float4 axii[kGiDirections];
+            for (i32 i = 0; i < kGiDirections; ++i)
+            {
+                probe[i] = lmap.cooked[i] ?
+                    UvBilinearClamp_rgb9e5(lmap.cooked[i], lmSize, lmUv) :
+                    UvBilinearClamp_f4(lmap.probes[i], lmSize, lmUv);
+                float4 ax = lmpack->axii[i];
+                float sharpness = ax.w;
+                ax = TbnToWorld(TBN, ax);
+                ax.w = sharpness;
+                axii[i] = ax;
+            }
+            float4 R = f4_normalize3(f4_reflect3(rd, N));
+            float4 diffuseGI = SGv_Irradiance(kGiDirections, axii, probe, N);
+            float4 specularGI = SGv_Eval(kGiDirections, axii, probe, R);
+            float4 indirect = IndirectBRDF(
+                V,
+                N,
+                diffuseGI,
+                specularGI,
+                albedo,
+                rome.x,
+                rome.z,
+                rome.y);
+            lighting = f4_add(lighting, indirect);
+        }
+    }
+
+    return lighting;
+}
+
 typedef struct task_DrawScene
 {
     task_t task;
     framebuf_t* target;
     const camera_t* camera;
     world_t* world;
+    // temporal reuse, visibility buffer only. history is null when disabled.
+    const float4* history;
+    i32 temporalMode;
+    u32 temporalFrame;
 } task_DrawScene;
 
+// one full trace and shade per texel, without a visibility buffer
 static void DrawSceneFn(task_t* pbase, i32 begin, i32 end)
 {
     task_DrawScene* task = (task_DrawScene*)pbase;
     framebuf_t* target = task->target;
     const camera_t* camera = task->camera;
     world_t* world = task->world;
-    RTCScene scene = world->scene;
-    const cubemap_t* pim_noalias sky = world->sky;
-    const froxels_t* pim_noalias froxels = &world->froxels;
-
-    const drawables_t* drawables = drawables_get();
-    const i32 drawableCount = drawables->count;
-    const meshid_t* pim_noalias meshids = drawables->meshes;
-    const material_t* pim_noalias materials = drawables->materials;
-    const float4x4* pim_noalias matrices = drawables->matrices;
-    const float3x3* pim_noalias invMatrices = drawables->invMatrices;
-    const lm_uvs_t* pim_noalias lmUvList = drawables->lmUvs;
-    const pt_light_t* pim_noalias lights = lights_get()->ptLights;
-
-    const lmpack_t* lmpack = lmpack_get();
+    const shadectx_t ctx = GetShadeCtx(world, camera);
 
     const int2 size = { target->width, target->height };
     const float2 rcpSize = { 1.0f / size.x, 1.0f / size.y };
@@ -586,11 +1067,9 @@ static void DrawSceneFn(task_t* pbase, i32 begin, i32 end)
 
     float4* pim_noalias dstLight = target->light;
 
-    prng_t rng = prng_get();
+    drawstate_t ds = { .iDrawable = -1 };
     for (i32 iTexel = begin; iTexel < end; ++iTexel)
     {
-        dstLight[iTexel] = f4_0;
-
         const i32 x = iTexel % size.x;
         const i32 y = iTexel / size.x;
         float2 coord = { (x + 0.5f) * rcpSize.x, (y + 0.5f) * rcpSize.y };
@@ -598,172 +1077,446 @@ static void DrawSceneFn(task_t* pbase, i32 begin, i32 end)
         const float4 rd = proj_dir(right, up, fwd, slope, coord);
 
         const rayhit_t hit = TraceRay(world, ro, rd, tNear, tFar);
-        if (hit.type == hit_nothing)
+        if (hit.type == hit_triangle)
         {
-            continue;
+            LoadDrawState(&ds, hit.iDrawable);
         }
+        dstLight[iTexel] = ShadeHit(&ctx, &ds, &hit, rd);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// visibility buffer
+
+typedef struct task_Visibility
+{
+    task_t task;
+    const camera_t* camera;
+    world_t* world;
+    int2 size;
+} task_Visibility;
+
+// traces 4x2 texel packets, storing only what was hit
+static void VisibilityFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_Visibility* task = (task_Visibility*)pbase;
+    const camera_t* camera = task->camera;
+    world_t* world = task->world;
+    RTCScene scene = world->scene;
+    vistexel_t* pim_noalias visbuf = world->visbuf;
 
-        if (hit.type == hit_light)
+    const int2 size = task->size;
+    const i32 packetsX = (size.x + kPacketX - 1) / kPacketX;
+    const float2 rcpSize = { 1.0f / size.x, 1.0f / size.y };
+    const float aspect = (float)size.x / size.y;
+    const float fov = f1_radians(camera->fovy);
+    const float tNear = camera->zNear;
+    const float tFar = camera->zFar;
+
+    const float4 ro = camera->position;
+    const quat rotation = camera->rotation;
+    const float4 right = quat_right(rotation);
+    const float4 up = quat_up(rotation);
+    const float4 fwd = quat_fwd(rotation);
+    const float2 slope = proj_slope(fov, aspect);
+
+    struct RTCIntersectContext ctx;
+    rtcInitIntersectContext(&ctx);
+    ctx.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    for (i32 iPacket = begin; iPacket < end; ++iPacket)
+    {
+        const i32 x0 = (iPacket % packetsX) * kPacketX;
+        const i32 y0 = (iPacket / packetsX) * kPacketY;
+
+        struct RTCRayHit8 rayHit;
+        // embree loads the mask with an aligned 8-wide load
+        pim_alignas(32) i32 valid[kPacketLen];
+        for (i32 i = 0; i < kPacketLen; ++i)
         {
-            pt_light_t light = lights_get_pt(hit.iVert);
-            float VoN = f4_dotsat(f4_neg(rd), hit.normal);
-            float4 rad = f4_mulvs(light.rad, VoN);
-            dstLight[iTexel] = rad;
-            continue;
+            const i32 x = x0 + (i % kPacketX);
+            const i32 y = y0 + (i / kPacketX);
+            valid[i] = ((x < size.x) && (y < size.y)) ? -1 : 0;
+            float2 coord = { (x + 0.5f) * rcpSize.x, (y + 0.5f) * rcpSize.y };
+            coord = f2_snorm(coord);
+            const float4 rd = proj_dir(right, up, fwd, slope, coord);
+            rayHit.ray.org_x[i] = ro.x;
+            rayHit.ray.org_y[i] = ro.y;
+            rayHit.ray.org_z[i] = ro.z;
+            rayHit.ray.tnear[i] = tNear;
+            rayHit.ray.dir_x[i] = rd.x;
+            rayHit.ray.dir_y[i] = rd.y;
+            rayHit.ray.dir_z[i] = rd.z;
+            rayHit.ray.time[i] = 0.0f;
+            rayHit.ray.tfar[i] = tFar;
+            rayHit.ray.mask[i] = -1;
+            rayHit.ray.id[i] = i;
+            rayHit.ray.flags[i] = 0;
+            rayHit.hit.primID[i] = RTC_INVALID_GEOMETRY_ID;
+            rayHit.hit.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+            rayHit.hit.instID[0][i] = RTC_INVALID_GEOMETRY_ID;
         }
 
-        const material_t material = materials[hit.iDrawable];
-        if (material.flags & matflag_sky)
+        rtc.Intersect8(valid, scene, &ctx, &rayHit);
+
+        for (i32 i = 0; i < kPacketLen; ++i)
         {
-            if (sky)
+            if (!valid[i])
             {
-                float3 atmos = Cubemap_ReadColor(sky, rd);
-                dstLight[iTexel] = f3_f4(atmos, 0.0f);
+                continue;
             }
-            continue;
+            const i32 x = x0 + (i % kPacketX);
+            const i32 y = y0 + (i / kPacketX);
+            vistexel_t vis;
+            bool hitNothing =
+                (rayHit.hit.geomID[i] == RTC_INVALID_GEOMETRY_ID) ||
+                (rayHit.ray.tfar[i] <= 0.0f);
+            if (hitNothing)
+            {
+                vis.iGeom = -1;
+                vis.iPrim = -1;
+                vis.u = 0.0f;
+                vis.v = 0.0f;
+                vis.t = tFar;
+            }
+            else
+            {
+                vis.iGeom = HitGeomId(rayHit.hit.geomID[i], rayHit.hit.instID[0][i]);
+                vis.iPrim = rayHit.hit.primID[i];
+                vis.u = f1_saturate(rayHit.hit.u[i]);
+                vis.v = f1_saturate(rayHit.hit.v[i]);
+                vis.t = rayHit.ray.tfar[i];
+            }
+            visbuf[x + y * size.x] = vis;
         }
+    }
+}
+
+pim_inline rayhit_t VEC_CALL VisToHit(
+    const world_t* world,
+    const shadectx_t* ctx,
+    vistexel_t vis,
+    float4 rd)
+{
+    rayhit_t hit = { 0 };
+    hit.wuvt = f4_v(f1_saturate(1.0f - (vis.u + vis.v)), vis.u, vis.v, vis.t);
+    if (vis.iGeom < 0)
+    {
+        hit.type = hit_nothing;
+        hit.iDrawable = -1;
+        hit.iVert = -1;
+    }
+    else if (vis.iGeom >= world->numDrawables)
+    {
+        hit.type = hit_light;
+        hit.iDrawable = vis.iGeom - world->numDrawables;
+        hit.iVert = vis.iPrim;
+        ASSERT(hit.iDrawable < world->numLights);
+        float4 P = f4_add(ctx->ro, f4_mulvs(rd, vis.t));
+        hit.normal = f4_normalize3(f4_sub(P, ctx->lights[hit.iDrawable].pos));
+    }
+    else
+    {
+        hit.type = hit_triangle;
+        hit.iDrawable = vis.iGeom;
+        hit.iVert = vis.iPrim * 3;
+    }
+    return hit;
+}
 
-        mesh_t mesh = { 0 };
-        if (!mesh_get(meshids[hit.iDrawable], &mesh))
+// lsd radix sort of bin keys, skipping bytes that are the same in every key.
+// the low byte holds the texel index within the tile and is not sorted.
+// returns whichever of keys or tmp holds the result.
+static const u32* SortBins(u32* pim_noalias keys, u32* pim_noalias tmp, i32 count)
+{
+    u32 keyAnd = 0xffffffff;
+    u32 keyOr = 0;
+    for (i32 i = 0; i < count; ++i)
+    {
+        keyAnd &= keys[i];
+        keyOr |= keys[i];
+    }
+    const u32 varying = keyAnd ^ keyOr;
+    for (i32 shift = 8; shift < 32; shift += 8)
+    {
+        if (((varying >> shift) & 0xff) == 0)
         {
             continue;
         }
-
-        ASSERT(hit.iVert >= 0);
-        ASSERT(hit.iVert < mesh.length);
-
-        const i32 a = hit.iVert + 0;
-        const i32 b = hit.iVert + 1;
-        const i32 c = hit.iVert + 2;
-
-        const float4 V = f4_neg(rd);
-        const float3x3 IM = invMatrices[hit.iDrawable];
-        const float4 N0 = f4_normalize3(f4_blend(
-            f3x3_mul_col(IM, mesh.normals[a]),
-            f3x3_mul_col(IM, mesh.normals[b]),
-            f3x3_mul_col(IM, mesh.normals[c]),
-            hit.wuvt));
-        const float3x3 TBN = NormalToTBN(N0);
-        const float4 P = f4_add(f4_add(ro, f4_mulvs(rd, hit.wuvt.w)), f4_mulvs(N0, kMilli));
-        const float4 uv01 = f4_blend(mesh.uvs[a], mesh.uvs[b], mesh.uvs[c], hit.wuvt);
-        const float2 uv = f2_v(uv01.x, uv01.y);
-
-        float4 albedo = material.flatAlbedo;
-        texture_t tex;
-        if (texture_get(material.albedo, &tex))
+        i32 offsets[256] = { 0 };
+        for (i32 i = 0; i < count; ++i)
         {
-            albedo = f4_mul(albedo, UvBilinearWrap_c32(tex.texels, tex.size, uv));
+            offsets[(keys[i] >> shift) & 0xff]++;
         }
-        float4 rome = material.flatRome;
-        if (texture_get(material.rome, &tex))
+        i32 sum = 0;
+        for (i32 i = 0; i < 256; ++i)
         {
-            rome = f4_mul(rome, UvBilinearWrap_c32(tex.texels, tex.size, uv));
+            i32 n = offsets[i];
+            offsets[i] = sum;
+            sum += n;
         }
-        float4 N = N0;
-        if (texture_get(material.normal, &tex))
+        for (i32 i = 0; i < count; ++i)
         {
-            float4 Nts = UvBilinearWrap_dir8(tex.texels, tex.size, uv);
-            N = TbnToWorld(TBN, Nts);
+            tmp[offsets[(keys[i] >> shift) & 0xff]++] = keys[i];
         }
+        u32* swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+    return keys;
+}
 
-        float4 lighting = f4_0;
+// whether a texel is shaded this frame in the given r_temporal mode.
+// the rest reuse the previous frame where it can be reprojected.
+pim_inline bool VEC_CALL IsFresh(i32 x, i32 y, i32 mode, u32 frame)
+{
+    // visits a 2x2 quad diagonally first
+    const i32 kQuadOrder[] = { 0, 3, 1, 2 };
+    switch (mode)
+    {
+    default:
+        return true;
+    case 1:
+        return ((x + y + frame) & 1) == 0;
+    case 2:
+        return ((x & 1) | ((y & 1) << 1)) == kQuadOrder[frame & 3];
+    }
+}
 
-        // emission
-        lighting = f4_add(lighting, UnpackEmission(albedo, rome.w));
+// finds the texel that saw the surface at P in the previous frame.
+// returns -1 if it was off screen or covered by something else.
+pim_inline i32 VEC_CALL Reproject(
+    const frusbasis_t* pim_noalias prev,
+    const vistexel_t* pim_noalias prevVisbuf,
+    int2 size,
+    i32 iGeom,
+    float4 P)
+{
+    const float4 d = f4_sub(P, prev->eye);
+    const float z = f4_dot3(d, prev->fwd);
+    if (z <= prev->zNear)
+    {
+        return -1;
+    }
+    float2 coord = f2_v(
+        f4_dot3(d, prev->right) / (z * prev->slope.x),
+        f4_dot3(d, prev->up) / (z * prev->slope.y));
+    coord = f2_unorm(coord);
+    const i32 x = (i32)floorf(coord.x * size.x);
+    const i32 y = (i32)floorf(coord.y * size.y);
+    if ((x < 0) || (y < 0) || (x >= size.x) || (y >= size.y))
+    {
+        return -1;
+    }
+    const i32 i = x + y * size.x;
+    const vistexel_t pv = prevVisbuf[i];
+    if (pv.iGeom != iGeom)
+    {
+        return -1;
+    }
+    const float dist = f4_length3(d);
+    if (f1_abs(pv.t - dist) > dist * kReprojDepthTol)
+    {
+        return -1;
+    }
+    return i;
+}
 
-        // direct light
-        const lightlist_t llist = GetLightList(froxels, P);
-        for (i32 iList = 0; iList < llist.len; ++iList)
-        {
-            i32 iLight = llist.ptr[iList];
-            pt_light_t light = lights[iLight];
-            float4 direct = EvalPointLight(V, P, N, albedo, rome.x, rome.z, light.pos, light.rad);
-            lighting = f4_add(lighting, direct);
-        }
+// shades a tile of the visibility buffer at a time, ordered by drawable
+// so each mesh, material and texture set is fetched once per tile
+static void ShadeVisibilityFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_DrawScene* task = (task_DrawScene*)pbase;
+    framebuf_t* target = task->target;
+    const camera_t* camera = task->camera;
+    world_t* world = task->world;
+    const shadectx_t ctx = GetShadeCtx(world, camera);
+    const vistexel_t* pim_noalias visbuf = world->visbuf;
+    const vistexel_t* pim_noalias prevVisbuf = world->prevVisbuf;
+    const frusbasis_t prevBasis = world->prevBasis;
+    const float4* pim_noalias history = task->history;
+    const i32 temporalMode = task->temporalMode;
+    const u32 temporalFrame = task->temporalFrame;
+    const i32 numDrawables = world->numDrawables;
+    const material_t* pim_noalias materials = drawables_get()->materials;
+
+    const int2 size = { target->width, target->height };
+    const i32 tilesX = (size.x + kVisTileSize - 1) / kVisTileSize;
+    const float2 rcpSize = { 1.0f / size.x, 1.0f / size.y };
+    const float aspect = (float)size.x / size.y;
+    const float fov = f1_radians(camera->fovy);
 
-        // indirect light
+    const quat rotation = camera->rotation;
+    const float4 right = quat_right(rotation);
+    const float4 up = quat_up(rotation);
+    const float4 fwd = quat_fwd(rotation);
+    const float2 slope = proj_slope(fov, aspect);
+
+    float4* pim_noalias dstLight = target->light;
+
+    u32 keys[kVisTileLen];
+    u32 tmp[kVisTileLen];
+    drawstate_t ds = { .iDrawable = -1 };
+    for (i32 iTile = begin; iTile < end; ++iTile)
+    {
+        const i32 x0 = (iTile % tilesX) * kVisTileSize;
+        const i32 y0 = (iTile / tilesX) * kVisTileSize;
+        const i32 x1 = i1_min(x0 + kVisTileSize, size.x);
+        const i32 y1 = i1_min(y0 + kVisTileSize, size.y);
+
+        i32 count = 0;
+        for (i32 y = y0; y < y1; ++y)
         {
-            const lm_uvs_t lmUvs = lmUvList[hit.iDrawable];
-            if (lmUvs.length > c)
+            for (i32 x = x0; x < x1; ++x)
             {
-                i32 lmIndex = lmUvs.indices[a / 3];
-                if (lmIndex >= 0)
+                const i32 iTexel = x + y * size.x;
+                const vistexel_t vis = visbuf[iTexel];
+                // sky and lights are cheap and view dependent; always shade
+                bool reuse =
+                    history &&
+                    (vis.iGeom >= 0) &&
+                    (vis.iGeom < numDrawables) &&
+                    !(materials[vis.iGeom].flags & matflag_sky) &&
+                    !IsFresh(x, y, temporalMode, temporalFrame);
+                if (reuse)
                 {
-                    ASSERT(lmIndex < lmpack->lmCount);
-                    const lightmap_t lmap = lmpack->lightmaps[lmIndex];
-                    float2 lmUv = f2_blend(
-                        lmUvs.uvs[a],
-                        lmUvs.uvs[b],
-                        lmUvs.uvs[c],
-                        hit.wuvt);
-                    lmUv = f2_subvs(lmUv, 0.5f / lmap.size);
-                    float4 probe[kGiDirections];
-                    float4 axii[kGiDirections];
-                    for (i32 i = 0; i < kGiDirections; ++i)
+                    float2 coord = { (x + 0.5f) * rcpSize.x, (y + 0.5f) * rcpSize.y };
+                    coord = f2_snorm(coord);
+                    const float4 rd = proj_dir(right, up, fwd, slope, coord);
+                    const float4 P = f4_add(ctx.ro, f4_mulvs(rd, vis.t));
+                    i32 iPrev = Reproject(&prevBasis, prevVisbuf, size, vis.iGeom, P);
+                    if (iPrev >= 0)
                     {
-                        probe[i] = UvBilinearClamp_f4(lmap.probes[i], i2_s(lmap.size), lmUv);
-                        float4 ax = lmpack->axii[i];
-                        float sharpness = ax.w;
-                        ax = TbnToWorld(TBN, ax);
-                        ax.w = sharpness;
-                        axii[i] = ax;
+                        dstLight[iTexel] = history[iPrev];
+                        continue;
                     }
-                    float4 R = f4_normalize3(f4_reflect3(rd, N));
-                    float4 diffuseGI = SGv_Irradiance(kGiDirections, axii, probe, N);
-                    float4 specularGI = SGv_Eval(kGiDirections, axii, probe, R);
-                    float4 indirect = IndirectBRDF(
-                        V,
-                        N,
-                        diffuseGI,
-                        specularGI,
-                        albedo,
-                        rome.x,
-                        rome.z,
-                        rome.y);
-                    lighting = f4_add(lighting, indirect);
                 }
+                u32 local = (x - x0) + (y - y0) * kVisTileSize;
+                u32 bin = (u32)(vis.iGeom + 1);
+                keys[count++] = (bin << 8) | local;
             }
         }
+        const u32* pim_noalias sorted = SortBins(keys, tmp, count);
+
+        for (i32 i = 0; i < count; ++i)
+        {
+            const u32 local = sorted[i] & 0xff;
+            const i32 x = x0 + (local % kVisTileSize);
+            const i32 y = y0 + (local / kVisTileSize);
+            const i32 iTexel = x + y * size.x;
 
-        dstLight[iTexel] = lighting;
+            float2 coord = { (x + 0.5f) * rcpSize.x, (y + 0.5f) * rcpSize.y };
+            coord = f2_snorm(coord);
+            const float4 rd = proj_dir(right, up, fwd, slope, coord);
+
+            const rayhit_t hit = VisToHit(world, &ctx, visbuf[iTexel], rd);
+            if ((hit.type == hit_triangle) && (hit.iDrawable != ds.iDrawable))
+            {
+                LoadDrawState(&ds, hit.iDrawable);
+            }
+            dstLight[iTexel] = ShadeHit(&ctx, &ds, &hit, rd);
+        }
     }
-    prng_set(rng);
 }
 
+// swaps in this frame's visibility buffer, keeping the last as prevVisbuf
+static void SwapVisbuf(world_t* world, i32 width, i32 height)
+{
+    const i32 len = width * height;
+    if (world->visLen != len)
+    {
+        pim_free(world->visbuf);
+        pim_free(world->prevVisbuf);
+        world->visbuf = perm_malloc(sizeof(world->visbuf[0]) * len);
+        world->prevVisbuf = perm_malloc(sizeof(world->prevVisbuf[0]) * len);
+        world->visLen = len;
+        world->prevValid = false;
+    }
+    vistexel_t* tmp = world->visbuf;
+    world->visbuf = world->prevVisbuf;
+    world->prevVisbuf = tmp;
+}
+
+ProfileMark(pm_visibility, Visibility)
+ProfileMark(pm_shadevis, ShadeVisibility)
 ProfileMark(pm_drawscene, DrawScene)
 static void DrawScene(
     world_t* world,
     framebuf_t* target,
+    const framebuf_t* history,
     const camera_t* camera)
 {
-    ClusterLights(world, target, camera);
+    ClusterLights(world, camera, target->width, target->height);
 
     ProfileBegin(pm_drawscene);
-    task_DrawScene* task = tmp_calloc(sizeof(*task));
-    task->target = target;
-    task->camera = camera;
-    task->world = world;
-    task_run(&task->task, DrawSceneFn, target->width * target->height);
+    const i32 width = target->width;
+    const i32 height = target->height;
+    if (cvar_get_bool(&cv_r_visbuf))
+    {
+        SwapVisbuf(world, width, height);
+
+        ProfileBegin(pm_visibility);
+        task_Visibility* vis = tmp_calloc(sizeof(*vis));
+        vis->camera = camera;
+        vis->world = world;
+        vis->size = i2_v(width, height);
+        const i32 packetsX = (width + kPacketX - 1) / kPacketX;
+        const i32 packetsY = (height + kPacketY - 1) / kPacketY;
+        task_run(&vis->task, VisibilityFn, packetsX * packetsY);
+        ProfileEnd(pm_visibility);
+
+        ProfileBegin(pm_shadevis);
+        task_DrawScene* task = tmp_calloc(sizeof(*task));
+        task->target = target;
+        task->camera = camera;
+        task->world = world;
+        const i32 temporalMode = cvar_get_int(&cv_r_temporal);
+        const bool reuse =
+            (temporalMode > 0) &&
+            history &&
+            (history->width == width) &&
+            (history->height == height) &&
+            world->prevValid &&
+            (world->prevSceneVersion == world->sceneVersion);
+        if (reuse)
+        {
+            task->history = history->light;
+            task->temporalMode = temporalMode;
+            task->temporalFrame = world->temporalFrame++;
+        }
+        const i32 tilesX = (width + kVisTileSize - 1) / kVisTileSize;
+        const i32 tilesY = (height + kVisTileSize - 1) / kVisTileSize;
+        task_run(&task->task, ShadeVisibilityFn, tilesX * tilesY);
+        ProfileEnd(pm_shadevis);
+
+        world->prevBasis = CameraToBasis(camera, width, height);
+        world->prevValid = true;
+        world->prevSceneVersion = world->sceneVersion;
+    }
+    else
+    {
+        world->prevValid = false;
+        task_DrawScene* task = tmp_calloc(sizeof(*task));
+        task->target = target;
+        task->camera = camera;
+        task->world = world;
+        task_run(&task->task, DrawSceneFn, width * height);
+    }
     ProfileEnd(pm_drawscene);
 }
 
-typedef struct task_ClusterLights
+typedef struct task_FroxelFrus
 {
     task_t task;
-    camera_t camera;
-    froxels_t* froxels;
-    const lights_t* lights;
-} task_ClusterLights;
+    frusbasis_t basis;
+    frus_t* frus;
+} task_FroxelFrus;
 
-static void ClusterLightsFn(task_t* pbase, i32 begin, i32 end)
+static void FroxelFrusFn(task_t* pbase, i32 begin, i32 end)
 {
-    task_ClusterLights* task = (task_ClusterLights*)pbase;
-    froxels_t* pim_noalias froxels = task->froxels;
-    const lights_t* pim_noalias lights = task->lights;
-    const pt_light_t* pim_noalias ptLights = lights->ptLights;
-    const i32 ptCount = lights->ptCount;
-    const camera_t camera = task->camera;
-    const frusbasis_t basis = froxels->basis;
+    task_FroxelFrus* task = (task_FroxelFrus*)pbase;
+    frus_t* pim_noalias frus = task->frus;
+    const frusbasis_t basis = task->basis;
 
     const float rcpResX = 1.0f / kFroxelResX;
     const float rcpResY = 1.0f / kFroxelResY;
@@ -780,61 +1533,377 @@ static void ClusterLightsFn(task_t* pbase, i32 begin, i32 end)
         hi = f2_snorm(hi);
         float zNear = LerpZ(basis.zNear, basis.zFar, (z + 0) * rcpResZ);
         float zFar = LerpZ(basis.zNear, basis.zFar, (z + 1) * rcpResZ);
-        frus_t frus;
-        camera_subfrustum(&camera, &frus, lo, hi, zNear, zFar);
+        frus[iFroxel] = frus_new(
+            basis.eye,
+            basis.right,
+            basis.up,
+            basis.fwd,
+            lo,
+            hi,
+            basis.slope,
+            zNear,
+            zFar);
+    }
+}
 
-        lightlist_t list = { 0 };
-        for (i32 iLight = 0; iLight < ptCount; ++iLight)
+// inclusive range of froxel columns between the two tangents of a circle
+// at view space (x, z), on an axis with the given slope and resolution.
+// spheres touching the eye plane span the whole axis.
+pim_inline int2 VEC_CALL TangentRange(float x, float z, float r, float slope, i32 res)
+{
+    int2 range = { 0, res - 1 };
+    const float zr = z * z - r * r;
+    if ((z > r) && (zr > 0.0f))
+    {
+        const float s = r * sqrtf(x * x + zr);
+        float lo = ((x * z - s) / zr) / slope;
+        float hi = ((x * z + s) / zr) / slope;
+        lo = f1_clamp(f1_unorm(lo) * res, 0.0f, res - 1.0f);
+        hi = f1_clamp(f1_unorm(hi) * res, 0.0f, res - 1.0f);
+        range.x = (i32)lo;
+        range.y = (i32)hi;
+    }
+    return range;
+}
+
+pim_inline i32 VEC_CALL DistanceToSlice(frusbasis_t basis, float z)
+{
+    z = f1_max(z, basis.zNear);
+    float t = f1_clamp(UnlerpZ(basis.zNear, basis.zFar, z) * kFroxelResZ, 0.0f, kFroxelResZ - 1.0f);
+    return (i32)t;
+}
+
+typedef struct task_ClusterLights
+{
+    task_t task;
+    frusbasis_t basis;
+    const frus_t* frus;
+    const pt_light_t* lights;
+    i32 lightCount;
+    i32 wordCount;
+    // [kFroxelCount][wordCount], one bit per light
+    u64* masks;
+    i32* offsets;
+    i32* indices;
+    froxels_t* froxels;
+} task_ClusterLights;
+
+// each work item owns 64 lights, so their bits land in one word per froxel
+// and need no synchronization with other threads.
+static void ClusterLightsFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_ClusterLights* task = (task_ClusterLights*)pbase;
+    const frusbasis_t basis = task->basis;
+    const frus_t* pim_noalias frus = task->frus;
+    const pt_light_t* pim_noalias lights = task->lights;
+    const i32 lightCount = task->lightCount;
+    const i32 wordCount = task->wordCount;
+    u64* pim_noalias masks = task->masks;
+
+    for (i32 iWord = begin; iWord < end; ++iWord)
+    {
+        const i32 iLast = i1_min(lightCount, (iWord + 1) * 64);
+        for (i32 iLight = iWord * 64; iLight < iLast; ++iLight)
         {
-            const sphere_t sph = { ptLights[iLight].pos };
-            bool overlaps = false;
-            if (sdFrusSph(frus, sph) <= 0.0f)
+            const sphere_t sph = { lights[iLight].pos };
+            const float r = sph.value.w;
+            const float4 d = f4_sub(sph.value, basis.eye);
+            const float dist = f4_length3(d);
+            const float vx = f4_dot3(d, basis.right);
+            const float vy = f4_dot3(d, basis.up);
+            const float vz = f4_dot3(d, basis.fwd);
+
+            // lookup uses radial distance while slices are bounded by planes,
+            // pad by a slice on each side to cover the difference.
+            const i32 z0 = i1_max(0, DistanceToSlice(basis, dist - r) - 1);
+            const i32 z1 = i1_min(kFroxelResZ - 1, DistanceToSlice(basis, dist + r) + 1);
+            const int2 xr = TangentRange(vx, vz, r, basis.slope.x, kFroxelResX);
+            const int2 yr = TangentRange(vy, vz, r, basis.slope.y, kFroxelResY);
+
+            const u64 bit = 1ull << (iLight & 63);
+            for (i32 z = z0; z <= z1; ++z)
             {
-                list.len++;
-                list.ptr = tmp_realloc(list.ptr, sizeof(list.ptr[0]) * list.len);
-                list.ptr[list.len - 1] = iLight;
+                for (i32 y = yr.x; y <= yr.y; ++y)
+                {
+                    for (i32 x = xr.x; x <= xr.y; ++x)
+                    {
+                        i32 iFroxel = x + y * kFroxelResX + z * kFroxelResX * kFroxelResY;
+                        if (sdFrusSph(frus[iFroxel], sph) <= 0.0f)
+                        {
+                            masks[iFroxel * wordCount + iWord] |= bit;
+                        }
+                    }
+                }
             }
         }
-        froxels->lights[iFroxel] = list;
     }
 }
 
-pim_inline frusbasis_t VEC_CALL CameraToBasis(const camera_t* camera, i32 width, i32 height)
+pim_inline i32 PopCnt64(u64 x)
 {
-    frusbasis_t basis;
-    basis.eye = camera->position;
-    quat rot = camera->rotation;
-    basis.right = quat_right(rot);
-    basis.up = quat_up(rot);
-    basis.fwd = quat_fwd(rot);
-    basis.slope = proj_slope(f1_radians(camera->fovy), (float)width / (float)height);
-    basis.zNear = camera->zNear;
-    basis.zFar = camera->zFar;
-    return basis;
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (i32)((x * 0x0101010101010101ull) >> 56);
+}
+
+static void CountLightsFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_ClusterLights* task = (task_ClusterLights*)pbase;
+    const i32 wordCount = task->wordCount;
+    const u64* pim_noalias masks = task->masks;
+    i32* pim_noalias offsets = task->offsets;
+
+    for (i32 iFroxel = begin; iFroxel < end; ++iFroxel)
+    {
+        const u64* pim_noalias row = masks + iFroxel * wordCount;
+        i32 count = 0;
+        for (i32 iWord = 0; iWord < wordCount; ++iWord)
+        {
+            count += PopCnt64(row[iWord]);
+        }
+        offsets[iFroxel] = count;
+    }
+}
+
+// writes each froxel's lights in ascending order into its slice of
+// the shared index array.
+static void FillLightsFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_ClusterLights* task = (task_ClusterLights*)pbase;
+    const i32 wordCount = task->wordCount;
+    const u64* pim_noalias masks = task->masks;
+    const i32* pim_noalias offsets = task->offsets;
+    i32* pim_noalias indices = task->indices;
+    froxels_t* pim_noalias froxels = task->froxels;
+
+    for (i32 iFroxel = begin; iFroxel < end; ++iFroxel)
+    {
+        const u64* pim_noalias row = masks + iFroxel * wordCount;
+        i32* pim_noalias dst = indices + offsets[iFroxel];
+        i32 len = 0;
+        for (i32 iWord = 0; iWord < wordCount; ++iWord)
+        {
+            u64 word = row[iWord];
+            while (word)
+            {
+                // bits below the lowest set bit count its position
+                dst[len++] = iWord * 64 + PopCnt64((word & (~word + 1ull)) - 1ull);
+                word &= word - 1ull;
+            }
+        }
+        lightlist_t list = { 0 };
+        if (len > 0)
+        {
+            list.ptr = dst;
+            list.len = len;
+        }
+        froxels->lights[iFroxel] = list;
+    }
 }
 
 ProfileMark(pm_ClusterLights, ClusterLights)
 static void ClusterLights(
     world_t* world,
-    framebuf_t* target,
-    const camera_t* camera)
+    const camera_t* camera,
+    i32 width,
+    i32 height)
 {
     ProfileBegin(pm_ClusterLights);
 
     froxels_t* froxels = &world->froxels;
-    memset(froxels, 0, sizeof(*froxels));
-    froxels->basis = CameraToBasis(camera, target->width, target->height);
+    const frusbasis_t basis = CameraToBasis(camera, width, height);
+    if (!froxels->frus || memcmp(&froxels->basis, &basis, sizeof(basis)))
+    {
+        if (!froxels->frus)
+        {
+            froxels->frus = perm_malloc(sizeof(froxels->frus[0]) * kFroxelCount);
+        }
+        task_FroxelFrus* task = tmp_calloc(sizeof(*task));
+        task->basis = basis;
+        task->frus = froxels->frus;
+        task_run(&task->task, FroxelFrusFn, kFroxelCount);
+    }
+    froxels->basis = basis;
+    memset(froxels->lights, 0, sizeof(froxels->lights));
 
     const lights_t* pim_noalias lights = lights_get();
     const i32 ptCount = lights->ptCount;
     if (ptCount > 0)
     {
+        const i32 wordCount = (ptCount + 63) >> 6;
+        const i32 maskLen = kFroxelCount * wordCount;
+        if (maskLen > froxels->maskLen)
+        {
+            froxels->maskLen = maskLen;
+            pim_free(froxels->masks);
+            froxels->masks = perm_malloc(sizeof(froxels->masks[0]) * maskLen);
+        }
+        memset(froxels->masks, 0, sizeof(froxels->masks[0]) * maskLen);
+
+        // tasks are not reused once run, so each pass gets a copy
+        task_ClusterLights desc = { 0 };
+        desc.basis = basis;
+        desc.frus = froxels->frus;
+        desc.lights = lights->ptLights;
+        desc.lightCount = ptCount;
+        desc.wordCount = wordCount;
+        desc.masks = froxels->masks;
+        desc.offsets = tmp_malloc(sizeof(desc.offsets[0]) * kFroxelCount);
+        desc.froxels = froxels;
+
         task_ClusterLights* task = tmp_calloc(sizeof(*task));
-        task->camera = *camera;
-        task->froxels = &world->froxels;
-        task->lights = lights;
-        task_run(&task->task, ClusterLightsFn, kFroxelCount);
+        *task = desc;
+        task_run(&task->task, ClusterLightsFn, wordCount);
+
+        task = tmp_calloc(sizeof(*task));
+        *task = desc;
+        task_run(&task->task, CountLightsFn, kFroxelCount);
+
+        i32* pim_noalias offsets = desc.offsets;
+        i32 total = 0;
+        for (i32 i = 0; i < kFroxelCount; ++i)
+        {
+            i32 count = offsets[i];
+            offsets[i] = total;
+            total += count;
+        }
+        if (total > froxels->indexLen)
+        {
+            froxels->indexLen = total;
+            pim_free(froxels->indices);
+            froxels->indices = perm_malloc(sizeof(froxels->indices[0]) * total);
+        }
+
+        task = tmp_calloc(sizeof(*task));
+        *task = desc;
+        task->indices = froxels->indices;
+        task_run(&task->task, FillLightsFn, kFroxelCount);
     }
 
     ProfileEnd(pm_ClusterLights);
 }
+
+static void FreeFroxels(froxels_t* froxels)
+{
+    pim_free(froxels->frus);
+    pim_free(froxels->masks);
+    pim_free(froxels->indices);
+    memset(froxels, 0, sizeof(*froxels));
+}
+
+// cluster_bench [lights] [iterations]
+// spawns point lights around the camera and times ClusterLights
+static cmdstat_t CmdClusterBench(i32 argc, const char** argv)
+{
+    i32 count = 1000;
+    i32 iterations = 100;
+    if (argc > 1 && argv[1])
+    {
+        count = i1_clamp(atoi(argv[1]), 1, 1 << 20);
+    }
+    if (argc > 2 && argv[2])
+    {
+        iterations = i1_clamp(atoi(argv[2]), 1, 10000);
+    }
+
+    camera_t camera;
+    camera_get(&camera);
+    const float extent = f1_min(camera.zFar, 50.0f);
+
+    const i32 first = lights_pt_count();
+    prng_t rng = prng_get();
+    for (i32 i = 0; i < count; ++i)
+    {
+        pt_light_t light = { 0 };
+        light.pos = f4_v(prng_f32(&rng), prng_f32(&rng), prng_f32(&rng), 0.0f);
+        light.pos = f4_add(camera.position, f4_mulvs(f4_snorm(light.pos), extent));
+        light.pos.w = f1_lerp(0.5f, 4.0f, prng_f32(&rng));
+        light.rad = f4_s(1.0f);
+        lights_add_pt(light);
+    }
+    prng_set(rng);
+
+    world_t* world = &ms_world;
+    u64 begin = time_now();
+    for (i32 i = 0; i < iterations; ++i)
+    {
+        ClusterLights(world, &camera, kDrawWidth, kDrawHeight);
+    }
+    double ms = time_milli(time_now() - begin) / iterations;
+
+    i64 refs = 0;
+    i32 maxLen = 0;
+    for (i32 i = 0; i < kFroxelCount; ++i)
+    {
+        refs += world->froxels.lights[i].len;
+        maxLen = i1_max(maxLen, world->froxels.lights[i].len);
+    }
+
+    for (i32 i = lights_pt_count() - 1; i >= first; --i)
+    {
+        lights_rm_pt(i);
+    }
+    // leave the froxels valid for the remaining lights
+    ClusterLights(world, &camera, kDrawWidth, kDrawHeight);
+
+    con_logf(LogSev_Info, "cmd", "cluster_bench: %d lights, %.3f ms per cluster, %.1f avg %d max lights per froxel",
+        count, ms, (double)refs / kFroxelCount, maxLen);
+    return cmdstat_ok;
+}
+
+// scene_bench [drawable] [iterations]
+// slides one drawable back and forth like a door or an editor drag,
+// timing the incremental scene update against a full rebuild
+static cmdstat_t CmdSceneBench(i32 argc, const char** argv)
+{
+    world_t* world = &ms_world;
+    drawables_t* drawables = drawables_get();
+    if (!world->device || drawables->count <= 0)
+    {
+        con_logf(LogSev_Error, "cmd", "scene_bench: no scene loaded");
+        return cmdstat_err;
+    }
+    if (!world->scene)
+    {
+        UpdateScene(world);
+    }
+
+    i32 iDrawable = 0;
+    i32 iterations = 60;
+    if (argc > 1 && argv[1])
+    {
+        iDrawable = i1_clamp(atoi(argv[1]), 0, drawables->count - 1);
+    }
+    if (argc > 2 && argv[2])
+    {
+        iterations = i1_clamp(atoi(argv[2]), 1, 10000);
+    }
+
+    const float4 origin = drawables->translations[iDrawable];
+    u64 begin = time_now();
+    for (i32 i = 0; i < iterations; ++i)
+    {
+        float t = sinf((i + 1) * (kTau / 60.0f));
+        drawables->translations[iDrawable] = f4_add(origin, f4_v(t, 0.0f, 0.0f, 0.0f));
+        drawables_updatetransforms(drawables);
+        UpdateScene(world);
+    }
+    double incMs = time_milli(time_now() - begin) / iterations;
+
+    begin = time_now();
+    for (i32 i = 0; i < iterations; ++i)
+    {
+        DestroyScene(world);
+        CreateScene(world);
+    }
+    double fullMs = time_milli(time_now() - begin) / iterations;
+
+    drawables->translations[iDrawable] = origin;
+    drawables_updatetransforms(drawables);
+    UpdateScene(world);
+
+    con_logf(LogSev_Info, "cmd", "scene_bench: %d drawables, %.3f ms incremental, %.3f ms full rebuild",
+        drawables->count, incMs, fullMs);
+    return cmdstat_ok;
+}
@@ -10,6 +10,11 @@ typedef struct camera_s camera_t;
 void RtcDrawInit(void);
 void RtcDrawShutdown(void);
 
-void RtcDraw(framebuf_t* target, const camera_t* camera);
+// history: the light of the previous RtcDraw at the same size, or NULL.
+// reprojected into target when r_temporal is enabled.
+void RtcDraw(framebuf_t* target, const framebuf_t* history, const camera_t* camera);
+
+// bytes of geometry and acceleration structures held by embree for RtcDraw
+i64 RtcDrawBytes(void);
 
 PIM_C_END
@@ -161,6 +161,11 @@ pim_inline float4 VEC_CALL UvWrap_c32(const u32* buffer, int2 size, float2 uv)
     float4 linear = ColorToLinear(color);
     return linear;
 }
+pim_inline float4 VEC_CALL Clamp_rgb9e5(const u32* buffer, int2 size, int2 coord)
+{
+    i32 index = Clamp(size, coord);
+    return rgb9e5_f4(buffer[index]);
+}
 pim_inline float4 VEC_CALL UvWrap_dir8(const u32* buffer, int2 size, float2 uv)
 {
     i32 index = UvWrap(size, uv);
@@ -324,6 +329,15 @@ pim_inline float4 VEC_CALL BilinearWrap_c32(const u32* pim_noalias buffer, int2
     return BilinearBlend_f4(a, b, c, d, bi.frac);
 }
 
+pim_inline float4 VEC_CALL BilinearClamp_rgb9e5(const u32* pim_noalias buffer, int2 size, bilinear_t bi)
+{
+    float4 a = Clamp_rgb9e5(buffer, size, bi.a);
+    float4 b = Clamp_rgb9e5(buffer, size, bi.b);
+    float4 c = Clamp_rgb9e5(buffer, size, bi.c);
+    float4 d = Clamp_rgb9e5(buffer, size, bi.d);
+    return BilinearBlend_f4(a, b, c, d, bi.frac);
+}
+
 pim_inline float4 VEC_CALL UvBilinearClamp_f4(const float4* pim_noalias buffer, int2 size, float2 uv)
 {
     bilinear_t bi = Bilinear(size, uv);
@@ -337,6 +351,13 @@ pim_inline float4 VEC_CALL UvBilinearWrap_f4(const float4* pim_noalias buffer, i
     return value;
 }
 
+pim_inline float4 VEC_CALL UvBilinearClamp_rgb9e5(const u32* pim_noalias buffer, int2 size, float2 uv)
+{
+    bilinear_t bi = Bilinear(size, uv);
+    float4 value = BilinearClamp_rgb9e5(buffer, size, bi);
+    return value;
+}
+
 pim_inline float3 VEC_CALL UvBilinearClamp_f3(const float3* pim_noalias buffer, int2 size, float2 uv)
 {
     bilinear_t bi = Bilinear(size, uv);
@@ -32,6 +32,8 @@ static const float2 kScreenMesh[] =
 static vkrBuffer ms_blitMesh;
 static vkrBuffer ms_stageBuf;
 static vkrPipeline ms_blitProgram;
+// sized for kDrawWidth x kDrawHeight; smaller frames use the top left
+// region and are stretched to the swapchain by the linear filtered blit
 static vkrImage ms_image;
 
 // ----------------------------------------------------------------------------
@@ -127,7 +129,9 @@ void screenblit_blit(
     // copy input data to stage buffer
     {
         const i32 bytes = width * height * sizeof(texels[0]);
-        ASSERT(bytes == ms_stageBuf.size);
+        ASSERT(width <= kDrawWidth);
+        ASSERT(height <= kDrawHeight);
+        ASSERT(bytes <= ms_stageBuf.size);
         void* dst = vkrBuffer_Map(&ms_stageBuf);
         ASSERT(dst);
         if (dst)
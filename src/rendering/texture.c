@@ -13,15 +13,35 @@
 #include "ui/cimgui_ext.h"
 #include "common/sort.h"
 #include "common/profiler.h"
+#include "common/fnv1a.h"
+#include "common/time.h"
 #include "io/fstr.h"
 #include "threading/task.h"
+#include "threading/epoch.h"
 #include "rendering/vulkan/vkr_texture.h"
+#include "assets/archive.h"
 #include <glad/glad.h>
 #include <string.h>
 
 static table_t ms_table;
 static u8 ms_palette[256 * 3];
 
+typedef struct unpaljob_s unpaljob_t;
+typedef struct task_UnpalBatch task_UnpalBatch;
+// jobs whose placeholders are still waiting for texels. queued jobs go out
+// together as one task, the task queues are too short for one per texture.
+static unpaljob_t** ms_unpalQueue;
+static i32 ms_unpalQueueCount;
+static task_UnpalBatch* ms_unpalBatch;
+// one reference on every unpalette output, so maps loaded later find them
+// by content rather than decoding again. quake textures are small enough to
+// keep for the whole session.
+static textureid_t* ms_unpalCache;
+static i32 ms_unpalCacheCount;
+static texunpalstats_t ms_unpalStats;
+
+static void UpdateUnpalJobs(void);
+
 pim_inline genid ToGenId(textureid_t tid)
 {
     genid gid;
@@ -43,9 +63,22 @@ static bool IsCurrent(textureid_t id)
     return table_exists(&ms_table, ToGenId(id));
 }
 
+static void ReleaseArchive(void* ptr)
+{
+    archive_release(ptr);
+}
+
+// tasks may still be sampling a copy of tex, see threading/epoch.h
 static void FreeTexture(texture_t* tex)
 {
-    pim_free(tex->texels);
+    if (tex->archive)
+    {
+        epoch_defer(ReleaseArchive, tex->archive);
+    }
+    else
+    {
+        epoch_free(tex->texels);
+    }
     if (g_vkr.inst)
     {
         vkrTexture2D_Del(&tex->vkrtex);
@@ -73,11 +106,16 @@ void texture_sys_init(void)
 
 void texture_sys_update(void)
 {
-
+    UpdateUnpalJobs();
 }
 
 void texture_sys_shutdown(void)
 {
+    texture_unpalette_flush();
+    pim_free(ms_unpalCache);
+    ms_unpalCache = NULL;
+    ms_unpalCacheCount = 0;
+
     texture_t* pim_noalias textures = ms_table.values;
     const i32 width = ms_table.width;
     for (i32 i = 0; i < width; ++i)
@@ -121,6 +159,25 @@ bool texture_loadat(const char* path, VkFormat format, textureid_t* idOut)
     return false;
 }
 
+static void UploadTexture(texture_t* tex, VkFormat format)
+{
+    i32 width = tex->size.x;
+    i32 height = tex->size.y;
+    i32 bytes = sizeof(tex->texels[0]) * width * height;
+    ASSERT(bytes > 0);
+    if (g_vkr.inst)
+    {
+        bool added = vkrTexture2D_New(
+            &tex->vkrtex,
+            width,
+            height,
+            format,
+            tex->texels,
+            bytes);
+        ASSERT(added);
+    }
+}
+
 bool texture_new(texture_t* tex, VkFormat format, guid_t name, textureid_t* idOut)
 {
     ASSERT(tex);
@@ -139,21 +196,7 @@ bool texture_new(texture_t* tex, VkFormat format, guid_t name, textureid_t* idOu
         }
         else
         {
-            i32 width = tex->size.x;
-            i32 height = tex->size.y;
-            i32 bytes = sizeof(tex->texels[0]) * width * height;
-            ASSERT(bytes > 0);
-            if (g_vkr.inst)
-            {
-                added = vkrTexture2D_New(
-                    &tex->vkrtex,
-                    width,
-                    height,
-                    format,
-                    tex->texels,
-                    bytes);
-                ASSERT(added);
-            }
+            UploadTexture(tex, format);
             added = table_add(&ms_table, name, tex, &id);
             ASSERT(added);
         }
@@ -193,12 +236,10 @@ bool texture_get(textureid_t id, texture_t* dst)
 bool texture_set(textureid_t id, texture_t* src)
 {
     ASSERT(src);
-    if (IsCurrent(id))
+    texture_t prev = { 0 };
+    if (table_swap(&ms_table, ToGenId(id), src, &prev))
     {
-        texture_t* textures = ms_table.values;
-        i32 index = id.index;
-        FreeTexture(&textures[index]);
-        memcpy(&textures[index], src, sizeof(textures[0]));
+        FreeTexture(&prev);
         memset(src, 0, sizeof(*src));
         return true;
     }
@@ -220,6 +261,24 @@ bool texture_getname(textureid_t tid, guid_t* nameOut)
     return table_getname(&ms_table, gid, nameOut);
 }
 
+static u8* TextureToBytes(const texture_t* texture, VkFormat format, i32* sizeOut)
+{
+    const i32 len = texture->size.x * texture->size.y;
+    i32 offset = 0;
+    dtexture_t dtexture = { 0 };
+    dbytes_new(1, sizeof(dtexture), &offset);
+    dtexture.version = kTextureVersion;
+    dtexture.format = format;
+    dtexture.size = texture->size;
+    dtexture.texels = dbytes_new(len, sizeof(texture->texels[0]), &offset);
+
+    u8* bytes = tmp_malloc(offset);
+    memcpy(bytes, &dtexture, sizeof(dtexture));
+    memcpy(bytes + dtexture.texels.offset, texture->texels, dtexture.texels.size);
+    *sizeOut = offset;
+    return bytes;
+}
+
 bool texture_save(textureid_t tid, guid_t* dst)
 {
     if (texture_getname(tid, dst))
@@ -230,63 +289,195 @@ bool texture_save(textureid_t tid, guid_t* dst)
         if (fstr_isopen(fd))
         {
             const texture_t* textures = ms_table.values;
-            const texture_t texture = textures[tid.index];
-            const i32 len = texture.size.x * texture.size.y;
-
-            i32 offset = 0;
-            dtexture_t dtexture = { 0 };
-            dbytes_new(1, sizeof(dtexture), &offset);
-            dtexture.version = kTextureVersion;
-            dtexture.format = texture.vkrtex.format;
-            dtexture.size = texture.size;
-            dtexture.texels = dbytes_new(len, sizeof(texture.texels[0]), &offset);
-            fstr_write(fd, &dtexture, sizeof(dtexture));
-
-            ASSERT(fstr_tell(fd) == dtexture.texels.offset);
-            fstr_write(fd, texture.texels, sizeof(texture.texels[0]) * len);
-
+            i32 size = 0;
+            const u8* bytes = TextureToBytes(textures + tid.index, textures[tid.index].vkrtex.format, &size);
+            const i32 wrote = fstr_write(fd, bytes, size);
             fstr_close(&fd);
+            return wrote == size;
+        }
+    }
+    return false;
+}
+
+bool texture_archive(textureid_t tid, archivewriter_t* wr, ArchiveCodec codec, guid_t* dst)
+{
+    ASSERT(wr);
+    if (texture_getname(tid, dst))
+    {
+        if (archive_contains(wr, *dst))
+        {
             return true;
         }
+        const texture_t* textures = ms_table.values;
+        i32 size = 0;
+        const u8* bytes = TextureToBytes(textures + tid.index, textures[tid.index].vkrtex.format, &size);
+        return archive_add(wr, *dst, bytes, size, codec);
     }
     return false;
 }
 
-bool texture_load(guid_t name, textureid_t* dst)
+typedef struct textureload_s
 {
-    bool loaded = false;
+    guid_t name;
+    texture_onload_fn onLoad;
+    void* usr;
+} textureload_t;
 
-    char filename[PIM_PATH] = "data/";
-    guid_tofile(ARGS(filename), name, ".texture");
-    fstr_t fd = fstr_open(filename, "rb");
-    texture_t texture = { 0 };
-    dtexture_t dtexture = { 0 };
-    if (fstr_isopen(fd))
+typedef struct dectexture_s
+{
+    texture_t texture;
+    VkFormat format;
+} dectexture_t;
+
+// validates the header and the texel range of a cooked texture
+static bool ParseTexture(const assetload_t* load, dtexture_t* dtexture)
+{
+    if (load->size < (i32)sizeof(*dtexture))
+    {
+        return false;
+    }
+    memcpy(dtexture, load->data, sizeof(*dtexture));
+    if ((dtexture->version != kTextureVersion) ||
+        (dtexture->size.x <= 0) ||
+        (dtexture->size.y <= 0))
+    {
+        return false;
+    }
+    const i32 len = dtexture->size.x * dtexture->size.y;
+    const dbytes_t texels = dtexture->texels;
+    if ((texels.offset < 0) ||
+        (texels.size != (i32)sizeof(u32) * len) ||
+        (texels.offset > load->size - texels.size))
+    {
+        INTERRUPT();
+        return false;
+    }
+    return true;
+}
+
+// task worker: copies the file into a texture_t
+static void DecodeTexture(assetload_t* load)
+{
+    dectexture_t* dec = NULL;
+    dtexture_t dtexture;
+    if (ParseTexture(load, &dtexture))
+    {
+        const dbytes_t texels = dtexture.texels;
+        dec = perm_calloc(sizeof(*dec));
+        dec->format = dtexture.format;
+        dec->texture.size = dtexture.size;
+        dec->texture.texels = perm_malloc(texels.size);
+        memcpy(dec->texture.texels, (const u8*)load->data + texels.offset, texels.size);
+    }
+    load->result = dec;
+}
+
+// main thread: uploads the texture, or retains the copy a previous request made
+static void OnTextureLoaded(assetload_t* load, void* usr)
+{
+    textureload_t* req = usr;
+    textureid_t id = { 0 };
+    dectexture_t* dec = load->result;
+    load->result = NULL;
+    if (texture_find(req->name, &id))
     {
-        fstr_read(fd, &dtexture, sizeof(dtexture));
-        if (dtexture.version == kTextureVersion)
+        texture_retain(id);
+        if (dec)
         {
-            dbytes_check(dtexture.texels, sizeof(texture.texels[0]));
+            FreeTexture(&dec->texture);
+        }
+    }
+    else if (!dec || !texture_new(&dec->texture, dec->format, req->name, &id))
+    {
+        id = (textureid_t) { 0 };
+    }
+    pim_free(dec);
+    if (req->onLoad)
+    {
+        req->onLoad(id, req->usr);
+    }
+    pim_free(req);
+}
 
-            texture.size = dtexture.size;
-            if ((texture.size.x > 0) && (texture.size.y > 0))
-            {
-                const i32 len = texture.size.x * texture.size.y;
-                texture.texels = perm_malloc(sizeof(texture.texels[0]) * len);
+assetfuture_t texture_loadasync(
+    guid_t name,
+    AssetPri priority,
+    texture_onload_fn onLoad,
+    void* usr)
+{
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".texture");
 
-                ASSERT(fstr_tell(fd) == dtexture.texels.offset);
-                fstr_read(fd, texture.texels, sizeof(texture.texels[0]) * len);
+    textureload_t* req = perm_malloc(sizeof(*req));
+    req->name = name;
+    req->onLoad = onLoad;
+    req->usr = usr;
+    return asset_load_async(filename, priority, DecodeTexture, OnTextureLoaded, req);
+}
 
-                loaded = texture_new(&texture, dtexture.format, name, dst);
-            }
-        }
+static void OnTextureLoadedSync(textureid_t id, void* usr)
+{
+    *(textureid_t*)usr = id;
+}
+
+bool texture_load(guid_t name, textureid_t* dst)
+{
+    ASSERT(dst);
+    *dst = (textureid_t) { 0 };
+    asset_load_await(texture_loadasync(name, AssetPri_High, OnTextureLoadedSync, dst));
+    return texture_exists(*dst);
+}
+
+// points the texels at the archive mapping when stored uncompressed,
+// otherwise decodes a private copy
+bool texture_loadarchive(archive_t* ar, guid_t name, textureid_t* dst)
+{
+    ASSERT(dst);
+    *dst = (textureid_t) { 0 };
+    if (texture_find(name, dst))
+    {
+        texture_retain(*dst);
+        return true;
     }
-cleanup:
-    fstr_close(&fd);
-    if (!loaded)
+    archiveblob_t blob;
+    if (!archive_find(ar, name, &blob))
+    {
+        return false;
+    }
+
+    assetload_t load = { 0 };
+    load.data = (void*)blob.ptr;
+    load.size = blob.size;
+    void* decoded = NULL;
+    if (blob.codec != ArchiveCodec_None)
+    {
+        decoded = archive_decode(blob);
+        load.data = decoded;
+        load.size = decoded ? blob.rawSize : 0;
+    }
+
+    bool loaded = false;
+    dtexture_t dtexture;
+    if (!decoded && ParseTexture(&load, &dtexture) && !(((isize)blob.ptr + dtexture.texels.offset) & 3))
+    {
+        texture_t texture = { 0 };
+        texture.size = dtexture.size;
+        texture.texels = (u32*)((const u8*)blob.ptr + dtexture.texels.offset);
+        texture.archive = ar;
+        archive_retain(ar);
+        loaded = texture_new(&texture, dtexture.format, name, dst);
+    }
+    else if (load.data)
     {
-        FreeTexture(&texture);
+        DecodeTexture(&load);
+        dectexture_t* dec = load.result;
+        if (dec)
+        {
+            loaded = texture_new(&dec->texture, dec->format, name, dst);
+            pim_free(dec);
+        }
     }
+    pim_free(decoded);
     return loaded;
 }
 
@@ -464,7 +655,259 @@ static void UnpaletteStep3Fn(task_t* pbase, i32 begin, i32 end)
     }
 }
 
+// seeds every unpalette output name. bump it whenever the UnpaletteStep
+// functions change their output, or data/<guid>.texture files written by
+// the old math keep being loaded.
+#define kUnpalVersion 1
+
+typedef enum
+{
+    UnpalSlot_Albedo,
+    UnpalSlot_Rome,
+    UnpalSlot_Normal,
+
+    UnpalSlot_COUNT
+} UnpalSlot;
+
+static const char* const kUnpalSuffixes[UnpalSlot_COUNT] =
+{
+    "_albedo",
+    "_rome",
+    "_normal",
+};
+static const VkFormat kUnpalFormats[UnpalSlot_COUNT] =
+{
+    VK_FORMAT_R8G8B8A8_SRGB,
+    VK_FORMAT_R8G8B8A8_SRGB,
+    VK_FORMAT_R8G8B8A8_UNORM,
+};
+
+typedef struct unpaljob_s
+{
+    int2 size;
+    u8* bytes;              // private copy, the model is freed after load
+    bool fullEmit;
+    bool isLight;
+    bool owned[UnpalSlot_COUNT];
+    guid_t names[UnpalSlot_COUNT];
+    textureid_t ids[UnpalSlot_COUNT];
+    texture_t results[UnpalSlot_COUNT];
+    bool fromDisk;
+    u64 ticks;
+} unpaljob_t;
+
+struct task_UnpalBatch
+{
+    task_t task;
+    unpaljob_t** jobs;
+    i32 count;
+};
+
+static bool ReadCachedTexture(guid_t name, VkFormat format, texture_t* dst)
+{
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".texture");
+    fstr_t fd = fstr_open(filename, "rb");
+    if (!fstr_isopen(fd))
+    {
+        return false;
+    }
+
+    assetload_t load = { 0 };
+    const i64 size = fstr_size(fd);
+    if ((size > 0) && (size < 0x7fffffff))
+    {
+        load.data = perm_malloc((i32)size);
+        load.size = fstr_read(fd, load.data, (i32)size);
+    }
+    fstr_close(&fd);
+
+    bool loaded = false;
+    dtexture_t dtexture;
+    if (ParseTexture(&load, &dtexture) && (dtexture.format == format))
+    {
+        DecodeTexture(&load);
+        dectexture_t* dec = load.result;
+        *dst = dec->texture;
+        pim_free(dec);
+        loaded = true;
+    }
+    pim_free(load.data);
+    return loaded;
+}
+
+static void WriteCachedTexture(guid_t name, VkFormat format, const texture_t* texture)
+{
+    char filename[PIM_PATH] = "data/";
+    guid_tofile(ARGS(filename), name, ".texture");
+    fstr_t fd = fstr_open(filename, "wb");
+    if (fstr_isopen(fd))
+    {
+        i32 size = 0;
+        const u8* bytes = TextureToBytes(texture, format, &size);
+        fstr_write(fd, bytes, size);
+        fstr_close(&fd);
+    }
+}
+
+// task worker: reads the outputs back from disk, or unpalettes and saves them
+static void RunUnpalJob(unpaljob_t* job)
+{
+    const u64 start = time_now();
+
+    job->fromDisk = true;
+    for (i32 i = 0; i < UnpalSlot_COUNT; ++i)
+    {
+        if (job->owned[i] && !ReadCachedTexture(job->names[i], kUnpalFormats[i], job->results + i))
+        {
+            job->fromDisk = false;
+            break;
+        }
+    }
+
+    if (!job->fromDisk)
+    {
+        for (i32 i = 0; i < UnpalSlot_COUNT; ++i)
+        {
+            FreeTexture(job->results + i);
+        }
+
+        const int2 size = job->size;
+        const i32 len = size.x * size.y;
+        task_Unpalette unpal = { 0 };
+        unpal.size = size;
+        unpal.min = f2_1;
+        unpal.max = f2_0;
+        unpal.bytes = job->bytes;
+        unpal.albedo = perm_malloc(len * sizeof(unpal.albedo[0]));
+        unpal.rome = perm_malloc(len * sizeof(unpal.rome[0]));
+        unpal.normal = perm_malloc(len * sizeof(unpal.normal[0]));
+        unpal.gray = perm_malloc(len * sizeof(unpal.gray[0]));
+        unpal.fullEmit = job->fullEmit;
+        unpal.isLight = job->isLight;
+
+        // textures run in parallel with each other, not within one
+        UnpaletteStep1Fn(&unpal.task, 0, len);
+        UnpaletteStep2Fn(&unpal.task);
+        UnpaletteStep3Fn(&unpal.task, 0, len);
+        pim_free(unpal.gray);
+
+        u32* texels[UnpalSlot_COUNT] = { unpal.albedo, unpal.rome, unpal.normal };
+        for (i32 i = 0; i < UnpalSlot_COUNT; ++i)
+        {
+            job->results[i].size = size;
+            job->results[i].texels = texels[i];
+            if (job->owned[i])
+            {
+                WriteCachedTexture(job->names[i], kUnpalFormats[i], job->results + i);
+            }
+        }
+    }
+
+    job->ticks = time_now() - start;
+}
+
+static void UnpalBatchFn(task_t* pbase, i32 begin, i32 end)
+{
+    task_UnpalBatch* batch = (task_UnpalBatch*)pbase;
+    for (i32 i = begin; i < end; ++i)
+    {
+        RunUnpalJob(batch->jobs[i]);
+    }
+}
+
+static void RetireUnpalJob(unpaljob_t* job)
+{
+    for (i32 i = 0; i < UnpalSlot_COUNT; ++i)
+    {
+        texture_t* result = job->results + i;
+        if (job->owned[i] && result->texels && IsCurrent(job->ids[i]))
+        {
+            UploadTexture(result, kUnpalFormats[i]);
+            texture_set(job->ids[i], result);
+        }
+        FreeTexture(result);
+    }
+
+    ms_unpalStats.cpuMs += time_milli(job->ticks);
+    if (job->fromDisk)
+    {
+        ms_unpalStats.diskHits += 1;
+    }
+    else
+    {
+        ms_unpalStats.generated += 1;
+    }
+    pim_free(job->bytes);
+    pim_free(job);
+}
+
+static void UpdateUnpalJobs(void)
+{
+    task_UnpalBatch* batch = ms_unpalBatch;
+    if (batch && (task_stat(batch) == TaskStatus_Complete))
+    {
+        for (i32 i = 0; i < batch->count; ++i)
+        {
+            RetireUnpalJob(batch->jobs[i]);
+        }
+        pim_free(batch->jobs);
+        pim_free(batch);
+        batch = NULL;
+        ms_unpalBatch = NULL;
+    }
+    if (!batch && (ms_unpalQueueCount > 0))
+    {
+        batch = perm_calloc(sizeof(*batch));
+        batch->jobs = ms_unpalQueue;
+        batch->count = ms_unpalQueueCount;
+        ms_unpalQueue = NULL;
+        ms_unpalQueueCount = 0;
+        ms_unpalBatch = batch;
+        task_submit(batch, UnpalBatchFn, batch->count);
+    }
+}
+
+void texture_unpalette_flush(void)
+{
+    UpdateUnpalJobs();
+    while (ms_unpalBatch)
+    {
+        task_await(ms_unpalBatch);
+        UpdateUnpalJobs();
+    }
+}
+
+texunpalstats_t texture_unpalette_stats(void)
+{
+    return ms_unpalStats;
+}
+
+static bool NewPlaceholder(UnpalSlot slot, guid_t name, bool fullEmit, textureid_t* idOut)
+{
+    u32 texel = 0;
+    switch (slot)
+    {
+    default:
+    case UnpalSlot_Albedo:
+        texel = LinearToColor(f4_v(0.5f, 0.5f, 0.5f, 1.0f));
+        break;
+    case UnpalSlot_Rome:
+        texel = LinearToColor(f4_v(0.95f, 1.0f, 1.0f, fullEmit ? 1.0f : 0.0f));
+        break;
+    case UnpalSlot_Normal:
+        texel = DirectionToColor(f4_v(0.0f, 0.0f, 1.0f, 0.0f));
+        break;
+    }
+    texture_t placeholder = { 0 };
+    placeholder.size = i2_1;
+    placeholder.texels = perm_malloc(sizeof(placeholder.texels[0]));
+    placeholder.texels[0] = texel;
+    return texture_new(&placeholder, kUnpalFormats[slot], name, idOut);
+}
+
 // https://quakewiki.org/wiki/Quake_palette
+ProfileMark(pm_unpalette, texture_unpalette)
 bool texture_unpalette(
     const u8* bytes,
     int2 size,
@@ -474,98 +917,67 @@ bool texture_unpalette(
     textureid_t* romeOut,
     textureid_t* normalOut)
 {
-    char albedoName[PIM_PATH];
-    char romeName[PIM_PATH];
-    char normalName[PIM_PATH];
-
-    SPrintf(ARGS(albedoName), "%s_albedo", name);
-    SPrintf(ARGS(romeName), "%s_rome", name);
-    SPrintf(ARGS(normalName), "%s_normal", name);
+    ProfileBegin(pm_unpalette);
 
-    guid_t albedoguid = guid_str(albedoName, guid_seed);
-    guid_t romeguid = guid_str(romeName, guid_seed);
-    guid_t normalguid = guid_str(normalName, guid_seed);
-
-    bool albedoExists = false;
-    bool romeExists = false;
-    bool normalExists = false;
-
-    bool albedoAdded = false;
-    bool romeAdded = false;
-    bool normalAdded = false;
-
-    if (texture_find(albedoguid, albedoOut))
+    const i32 len = size.x * size.y;
+    const bool isSky = StrIStr(name, 16, "sky");
+    const bool isTeleport = StrIStr(name, 16, "teleport");
+    const bool isWindow = StrIStr(name, 16, "window");
+    const bool isLight = StrIStr(name, 16, "light");
+    const bool fullEmit = isSky || isTeleport || isWindow;
+
+    // names are seeded by the texels, so equal content shares textures
+    // across maps and differing content under one name does not collide
+    u64 seed = Fnv64Dword(kUnpalVersion, guid_seed);
+    seed = Fnv64Bytes(bytes, len, seed);
+    seed = Fnv64Dword(size.x, seed);
+    seed = Fnv64Dword(size.y, seed);
+
+    textureid_t* outs[UnpalSlot_COUNT] = { albedoOut, romeOut, normalOut };
+    unpaljob_t* job = NULL;
+    for (i32 i = 0; i < UnpalSlot_COUNT; ++i)
     {
-        albedoExists = true;
-        texture_retain(*albedoOut);
+        char slotName[PIM_PATH];
+        SPrintf(ARGS(slotName), "%s%s", name, kUnpalSuffixes[i]);
+        const guid_t guid = guid_str(slotName, seed);
+        if (texture_find(guid, outs[i]))
+        {
+            texture_retain(*outs[i]);
+            continue;
+        }
+        if (!job)
+        {
+            job = perm_calloc(sizeof(*job));
+            job->size = size;
+            job->fullEmit = fullEmit;
+            job->isLight = isLight;
+        }
+        if (NewPlaceholder(i, guid, fullEmit, outs[i]))
+        {
+            job->owned[i] = true;
+            job->names[i] = guid;
+            job->ids[i] = *outs[i];
+            texture_retain(*outs[i]);
+            PermReserve(ms_unpalCache, ms_unpalCacheCount + 1);
+            ms_unpalCache[ms_unpalCacheCount++] = *outs[i];
+        }
     }
-    if (texture_find(romeguid, romeOut))
+
+    if (job)
     {
-        romeExists = true;
-        texture_retain(*romeOut);
+        job->bytes = perm_malloc(len);
+        memcpy(job->bytes, bytes, len);
+        // submitted by the next update, alongside the rest of the map
+        PermReserve(ms_unpalQueue, ms_unpalQueueCount + 1);
+        ms_unpalQueue[ms_unpalQueueCount++] = job;
     }
-    if (texture_find(normalguid, normalOut))
+    else
     {
-        normalExists = true;
-        texture_retain(*normalOut);
+        ms_unpalStats.memHits += 1;
     }
 
-    const i32 len = size.x * size.y;
-    if (!albedoExists || !romeExists || !normalExists)
-    {
-        const bool isSky = StrIStr(name, 16, "sky");
-        const bool isTeleport = StrIStr(name, 16, "teleport");
-        const bool isWindow = StrIStr(name, 16, "window");
-        const bool isLight = StrIStr(name, 16, "light");
-        const bool fullEmit = isSky || isTeleport || isWindow;
-
-        u32* pim_noalias albedo = perm_malloc(len * sizeof(albedo[0]));
-        u32* pim_noalias rome = perm_malloc(len * sizeof(rome[0]));
-        u32* pim_noalias normal = perm_malloc(len * sizeof(normal[0]));
-        float2* pim_noalias gray = perm_malloc(len * sizeof(gray[0]));
-
-        task_Unpalette* tasks = tmp_calloc(sizeof(tasks[0]) * 3);
-        tasks[0].albedo = albedo;
-        tasks[0].bytes = bytes;
-        tasks[0].flags = matflags;
-        tasks[0].fullEmit = fullEmit;
-        tasks[0].gray = gray;
-        tasks[0].isLight = isLight;
-        tasks[0].max = f2_0;
-        tasks[0].min = f2_1;
-        tasks[0].normal = normal;
-        tasks[0].rome = rome;
-        tasks[0].size = size;
-
-        // cannot reuse same task across invocations, the signalling state gets corrupted
-        task_run(&tasks[0].task, UnpaletteStep1Fn, len);
-        tasks[1] = tasks[0];
-        tasks[1].task = (task_t) { 0 };
-        UnpaletteStep2Fn(&tasks[1].task);
-        tasks[2] = tasks[1];
-        tasks[2].task = (task_t) { 0 };
-        task_run(&tasks[2].task, UnpaletteStep3Fn, len);
-
-        pim_free(gray);
-        gray = NULL;
-
-        texture_t albedoMap = { 0 };
-        albedoMap.size = size;
-        albedoMap.texels = albedo;
-        albedoAdded = texture_new(&albedoMap, VK_FORMAT_R8G8B8A8_SRGB, albedoguid, albedoOut);
-
-        texture_t romeMap = { 0 };
-        romeMap.size = size;
-        romeMap.texels = rome;
-        romeAdded = texture_new(&romeMap, VK_FORMAT_R8G8B8A8_SRGB, romeguid, romeOut);
-
-        texture_t normalMap = { 0 };
-        normalMap.size = size;
-        normalMap.texels = normal;
-        normalAdded = texture_new(&normalMap, VK_FORMAT_R8G8B8A8_UNORM, normalguid, normalOut);
-    }
-
-    return albedoAdded && romeAdded && normalAdded;
+    ProfileEnd(pm_unpalette);
+    return job != NULL;
 }
 
 // ----------------------------------------------------------------------------
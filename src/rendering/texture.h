@@ -5,6 +5,8 @@
 #include "common/guid.h"
 #include "common/dbytes.h"
 #include "rendering/vulkan/vkr.h"
+#include "assets/asset_system.h"
+#include "assets/archive.h"
 
 PIM_C_BEGIN
 
@@ -26,6 +28,8 @@ typedef struct texture_s
     int2 size;
     u32* pim_noalias texels;
     vkrTexture2D vkrtex;
+    // when set, texels are a read-only view into this archive
+    archive_t* archive;
 } texture_t;
 
 #define kTextureVersion 3
@@ -63,6 +67,30 @@ bool texture_getname(textureid_t id, guid_t* nameOut);
 bool texture_save(textureid_t tid, guid_t* dst);
 bool texture_load(guid_t name, textureid_t* dst);
 
+// adds the texture to an archive, once per name
+bool texture_archive(textureid_t tid, archivewriter_t* wr, ArchiveCodec codec, guid_t* dst);
+// references the texture in place from a mapped archive
+bool texture_loadarchive(archive_t* ar, guid_t name, textureid_t* dst);
+
+// called on the main thread with a retained id, or a null id on failure
+typedef void(PIM_CDECL *texture_onload_fn)(textureid_t id, void* usr);
+assetfuture_t texture_loadasync(
+    guid_t name,
+    AssetPri priority,
+    texture_onload_fn onLoad,
+    void* usr);
+
+typedef struct texunpalstats_s
+{
+    i32 memHits;            // every output already loaded
+    i32 diskHits;           // read back from data/
+    i32 generated;
+    double cpuMs;           // task time spent on disk reads and unpaletting
+} texunpalstats_t;
+
+// returns retained ids immediately. new outputs are 1x1 placeholders until
+// a task has read them from disk or unpaletted them; texture_sys_update
+// swaps in the texels. returns true when a task was started.
 bool texture_unpalette(
     const u8* bytes,
     int2 size,
@@ -71,5 +99,8 @@ bool texture_unpalette(
     textureid_t* albedoOut,
     textureid_t* romeOut,
     textureid_t* normalOut);
+// blocks until every started unpalette has landed
+void texture_unpalette_flush(void);
+texunpalstats_t texture_unpalette_stats(void);
 
 PIM_C_END
@@ -0,0 +1,180 @@
+#include "threading/epoch.h"
+#include "threading/mutex.h"
+#include "common/atomics.h"
+#include "allocator/allocator.h"
+#include <string.h>
+
+#define kOffline    0xffffffffffffffffull
+
+typedef struct retired_s
+{
+    epoch_free_fn fn;
+    void* ptr;
+    u64 epoch;
+} retired_t;
+
+// one cache line per thread, quiescing should not bounce the line
+typedef pim_alignas(64) struct threadepoch_s
+{
+    u64 seen;
+    u8 pad[64 - sizeof(u64)];
+} threadepoch_t;
+
+static u64 ms_epoch;
+static i32 ms_init;
+static threadepoch_t ms_threads[kMaxThreads];
+static mutex_t ms_lock;
+static retired_t* ms_retired;
+static i32 ms_retiredCount;
+
+void epoch_sys_init(void)
+{
+    mutex_create(&ms_lock);
+    for (i32 t = 0; t < kMaxThreads; ++t)
+    {
+        store_u64(&ms_threads[t].seen, kOffline, MO_Relaxed);
+    }
+    // the main thread is always online
+    store_u64(&ms_epoch, 1, MO_Relaxed);
+    store_u64(&ms_threads[0].seen, 1, MO_Relaxed);
+    store_i32(&ms_init, 1, MO_Release);
+}
+
+static u64 MinSeen(void)
+{
+    u64 minSeen = kOffline;
+    for (i32 t = 0; t < kMaxThreads; ++t)
+    {
+        const u64 seen = load_u64(&ms_threads[t].seen, MO_SeqCst);
+        minSeen = seen < minSeen ? seen : minSeen;
+    }
+    return minSeen;
+}
+
+static void Collect(u64 minSeen)
+{
+    retired_t* ready = NULL;
+    i32 readyCount = 0;
+
+    mutex_lock(&ms_lock);
+    retired_t* pim_noalias retired = ms_retired;
+    const i32 count = ms_retiredCount;
+    i32 back = 0;
+    for (i32 i = 0; i < count; ++i)
+    {
+        // every online thread has loaded the epoch since this was retired
+        if (retired[i].epoch < minSeen)
+        {
+            PermReserve(ready, readyCount + 1);
+            ready[readyCount++] = retired[i];
+        }
+        else
+        {
+            retired[back++] = retired[i];
+        }
+    }
+    ms_retiredCount = back;
+    mutex_unlock(&ms_lock);
+
+    // outside the lock, a free function may retire more
+    for (i32 i = 0; i < readyCount; ++i)
+    {
+        ready[i].fn(ready[i].ptr);
+    }
+    pim_free(ready);
+}
+
+void epoch_sys_update(void)
+{
+    if (!load_i32(&ms_init, MO_Acquire))
+    {
+        return;
+    }
+    const u64 epoch = fetch_add_u64(&ms_epoch, 1, MO_SeqCst) + 1;
+    store_u64(&ms_threads[0].seen, epoch, MO_SeqCst);
+    Collect(MinSeen());
+}
+
+void epoch_sys_shutdown(void)
+{
+    if (load_i32(&ms_init, MO_Acquire))
+    {
+        while (epoch_pending() > 0)
+        {
+            Collect(kOffline);
+        }
+        store_i32(&ms_init, 0, MO_Release);
+        pim_free(ms_retired);
+        ms_retired = NULL;
+        ms_retiredCount = 0;
+        mutex_destroy(&ms_lock);
+    }
+}
+
+void epoch_quiesce(i32 tid)
+{
+    ASSERT(tid > 0);
+    ASSERT(tid < kMaxThreads);
+    const u64 epoch = load_u64(&ms_epoch, MO_Relaxed);
+    if (load_u64(&ms_threads[tid].seen, MO_Relaxed) != epoch)
+    {
+        store_u64(&ms_threads[tid].seen, epoch, MO_Release);
+    }
+}
+
+void epoch_offline(i32 tid)
+{
+    ASSERT(tid > 0);
+    ASSERT(tid < kMaxThreads);
+    store_u64(&ms_threads[tid].seen, kOffline, MO_Release);
+}
+
+void epoch_online(i32 tid)
+{
+    ASSERT(tid > 0);
+    ASSERT(tid < kMaxThreads);
+    // a full barrier: the collector must see this before the thread loads
+    // any table pointer, or it could free what the thread is about to read
+    exch_u64(&ms_threads[tid].seen, load_u64(&ms_epoch, MO_SeqCst), MO_SeqCst);
+}
+
+void epoch_defer(epoch_free_fn fn, void* ptr)
+{
+    ASSERT(fn);
+    if (!ptr)
+    {
+        return;
+    }
+    if (!load_i32(&ms_init, MO_Acquire))
+    {
+        // no task threads to race with
+        fn(ptr);
+        return;
+    }
+    mutex_lock(&ms_lock);
+    const i32 back = ms_retiredCount++;
+    PermReserve(ms_retired, ms_retiredCount);
+    ms_retired[back].fn = fn;
+    ms_retired[back].ptr = ptr;
+    // a locked add is a full barrier: the store that unpublished ptr is
+    // visible before the epoch it is tagged with
+    ms_retired[back].epoch = fetch_add_u64(&ms_epoch, 0, MO_SeqCst);
+    mutex_unlock(&ms_lock);
+}
+
+void epoch_free(void* ptr)
+{
+    epoch_defer(pim_free, ptr);
+}
+
+i32 epoch_pending(void)
+{
+    if (!load_i32(&ms_init, MO_Acquire))
+    {
+        return 0;
+    }
+    mutex_lock(&ms_lock);
+    const i32 count = ms_retiredCount;
+    mutex_unlock(&ms_lock);
+    return count;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common/macro.h"
+
+PIM_C_BEGIN
+
+// quiescent state based reclamation, for tables that are read from tasks
+// while the main thread or a loader edits them.
+// readers take no locks and announce nothing per read. instead, a task
+// thread is quiescent between work ranges and while it sleeps, and the main
+// thread is quiescent at epoch_sys_update. so a reader may hold a pointer
+// it loaded from a table until the end of its current work range.
+// writers publish the replacement first, then hand the old memory to
+// epoch_defer; it is freed once every running thread has been quiescent.
+
+typedef void(*epoch_free_fn)(void* ptr);
+
+void epoch_sys_init(void);
+// main thread, once per frame; frees whatever no thread can still see
+void epoch_sys_update(void);
+// frees everything, call once no other thread is running
+void epoch_sys_shutdown(void);
+
+// task threads only
+void epoch_quiesce(i32 tid);
+void epoch_offline(i32 tid);
+void epoch_online(i32 tid);
+
+// calls fn(ptr) once no reader can still hold ptr
+void epoch_defer(epoch_free_fn fn, void* ptr);
+// pim_free once no reader can still hold ptr
+void epoch_free(void* ptr);
+
+// retired allocations still waiting on a reader
+i32 epoch_pending(void);
+
+PIM_C_END
@@ -4,10 +4,13 @@
 #include "threading/event.h"
 #include "threading/intrin.h"
 #include "threading/sleep.h"
+#include "threading/epoch.h"
 #include "common/atomics.h"
 #include "containers/ptrqueue.h"
 #include "allocator/allocator.h"
 #include "common/profiler.h"
+#include "common/stats.h"
+#include "common/time.h"
 
 #include <string.h>
 
@@ -28,6 +31,10 @@ static thread_t ms_threads[kMaxThreads];
 static ptrqueue_t ms_queues[kMaxThreads];
 
 static pim_thread_local i32 ms_tid;
+// tasks nested through task_await
+static pim_thread_local i32 ms_depth;
+// microseconds workers spent asleep waiting for tasks
+static stat_t* ms_idleUs;
 
 // ----------------------------------------------------------------------------
 
@@ -71,11 +78,18 @@ static i32 TryRunTask(i32 tid)
         range_t range;
         while (StealWork(task, &range, gran))
         {
+            ++ms_depth;
             fn(task, range.begin, range.end);
+            --ms_depth;
             if (UpdateProgress(task, range))
             {
                 MarkComplete(task);
             }
+            // readers drop their table pointers at the end of a range
+            if (tid && !ms_depth)
+            {
+                epoch_quiesce(tid);
+            }
         }
     }
     return task != NULL;
@@ -88,17 +102,24 @@ static i32 TaskLoop(void* arg)
     const i32 tid = (i32)((isize)arg);
     ASSERT(tid);
     ms_tid = tid;
+    epoch_online(tid);
 
     while (load_i32(&ms_running, MO_Relaxed))
     {
         if (!TryRunTask(tid))
         {
+            epoch_offline(tid);
             inc_i32(&ms_numThreadsSleeping, MO_Acquire);
+            const u64 idleBegin = time_now();
             event_wait(&ms_waitPush);
+            stat_add(ms_idleUs, (i64)time_micro(time_now() - idleBegin));
             dec_i32(&ms_numThreadsSleeping, MO_Release);
+            epoch_online(tid);
         }
     }
 
+    epoch_offline(tid);
+
     dec_i32(&ms_numThreadsRunning, MO_Release);
 
     return 0;
@@ -220,8 +241,10 @@ void task_sys_schedule(void)
 void task_sys_init(void)
 {
     intrin_clockres_begin(1);
+    epoch_sys_init();
     event_create(&ms_waitPush);
     store_i32(&ms_running, 1, MO_Release);
+    ms_idleUs = stat_counter("task.idle_us");
 
     const i32 numthreads = thread_hardware_count();
     ms_numthreads = numthreads;
@@ -247,6 +270,8 @@ void task_sys_update(void)
     {
 
     }
+
+    epoch_sys_update();
 }
 
 void task_sys_shutdown(void)
@@ -266,6 +291,7 @@ void task_sys_shutdown(void)
     ptrqueue_destroy(ms_queues + 0);
 
     event_destroy(&ms_waitPush);
+    epoch_sys_shutdown();
     intrin_clockres_end(1);
 
     memset(ms_threads, 0, sizeof(ms_threads));
@@ -135,7 +135,7 @@ void thread_join(thread_t* tr)
 {
     ASSERT(tr);
     pthread_t* pt = (pthread_t*)tr;
-    i32 rv = pthread_join(pt, NULL);
+    i32 rv = pthread_join(*pt, NULL);
     ASSERT(!rv);
     tr->handle = NULL;
 }